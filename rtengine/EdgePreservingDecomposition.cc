@@ -6,6 +6,8 @@
 #endif
 #include "sleef.c"
 #include "opthelper.h"
+#include "cpudispatch.h"
+#include "epd_simd.h"
 
 #define pow_F(a,b) (xexpf(b*xlogf(a)))
 
@@ -19,7 +21,7 @@ definite problems only, which is what unconstrained smooth optimization pretty m
 Parameter pass can be passed through, containing whatever info you like it to contain (matrix info?).
 Takes less memory with OkToModify_b = true, and Preconditioner = nullptr. */
 float *SparseConjugateGradient(void Ax(float *Product, float *x, void *Pass), float *b, int n, bool OkToModify_b,
-                               float *x, float RMSResidual, void *Pass, int MaximumIterates, void Preconditioner(float *Product, float *x, void *Pass))
+                               float *x, float RMSResidual, void *Pass, int MaximumIterates, void Preconditioner(float *Product, float *x, void *Pass), rtengine::CancelCheck *Cancel)
 {
     int iterate, i;
 
@@ -78,6 +80,10 @@ float *SparseConjugateGradient(void Ax(float *Product, float *x, void *Pass), fl
     }
 
     for(iterate = 0; iterate < MaximumIterates; iterate++) {
+        if(Cancel != nullptr && Cancel->skip()) {
+            continue;    //The result isn't needed anymore, the remaining iterates are only counted.
+        }
+
         //Get step size alpha, store ax while at it.
         float ab = 0.0f;
         Ax(ax, d, Pass);
@@ -662,6 +668,7 @@ EdgePreservingDecomposition::EdgePreservingDecomposition(int width, int height)
     w = width;
     h = height;
     n = w * h;
+    Cancel = nullptr;
 
     //Initialize the matrix just once at construction.
     A = new MultiDiagonalSymmetricMatrix(n, DIAGONALS);
@@ -689,6 +696,11 @@ EdgePreservingDecomposition::~EdgePreservingDecomposition()
     delete A;
 }
 
+void EdgePreservingDecomposition::SetCancelCheck(rtengine::CancelCheck *Check)
+{
+    Cancel = Check;
+}
+
 SSEFUNCTION float *EdgePreservingDecomposition::CreateBlur(float *Source, float Scale, float EdgeStopping, int Iterates, float *Blur, bool UseBlurForEdgeStop)
 {
 
@@ -701,6 +713,15 @@ SSEFUNCTION float *EdgePreservingDecomposition::CreateBlur(float *Source, float
         return Blur;
     }
 
+    if(Cancel != nullptr && Cancel->cancelled()) {
+        //Not worth setting up the problem anymore, e.g. for the next reweighting. Its iterates are skipped.
+        for(int i = 0; i < Iterates; i++) {
+            Cancel->skip();
+        }
+
+        return Blur;
+    }
+
     //Create the edge stopping function a, rotationally symmetric and just one instead of (ax, ay). Maybe don't need Blur yet, so use its memory.
     float* RESTRICT a;
     float* RESTRICT g;
@@ -851,7 +872,7 @@ SSEFUNCTION float *EdgePreservingDecomposition::CreateBlur(float *Source, float
         memcpy(Blur, Source, n * sizeof(float));
     }
 
-    SparseConjugateGradient(A->PassThroughVectorProduct, Source, n, false, Blur, 0.0f, (void *)A, Iterates, A->PassThroughCholeskyBackSolve);
+    SparseConjugateGradient(A->PassThroughVectorProduct, Source, n, false, Blur, 0.0f, (void *)A, Iterates, A->PassThroughCholeskyBackSolve, Cancel);
     A->KillIncompleteCholeskyFactorization();
     return Blur;
 }
@@ -880,6 +901,60 @@ float *EdgePreservingDecomposition::CreateIteratedBlur(float *Source, float Scal
     return Blur;
 }
 
+// Run the log and exp passes of CompressDynamicRange with the kernels compiled for the widest instruction set of the
+// cpu, see cpudispatch.h. They return false if there are none, then the caller uses the kernels of the build flags.
+static bool epdLogDispatched(float *Source, float eps, int n)
+{
+#ifdef RT_SIMD_DISPATCH
+    const rtengine::SimdLevel level = rtengine::getSimdLevel();
+
+    if (level == rtengine::SimdLevel::NONE) {
+        return false;
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+        if (level == rtengine::SimdLevel::AVX512) {
+            rtengine::avx512::epdLog(Source, eps, n);
+        } else {
+            rtengine::avx2::epdLog(Source, eps, n);
+        }
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+static bool epdUnlogDispatched(float *Source, const float *u, float *Compressed, float eps, float temp, float DetailBoost, int n)
+{
+#ifdef RT_SIMD_DISPATCH
+    const rtengine::SimdLevel level = rtengine::getSimdLevel();
+
+    if (level == rtengine::SimdLevel::NONE) {
+        return false;
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+        if (level == rtengine::SimdLevel::AVX512) {
+            rtengine::avx512::epdUnlog(Source, u, Compressed, eps, temp, DetailBoost, n);
+        } else {
+            rtengine::avx2::epdUnlog(Source, u, Compressed, eps, temp, DetailBoost, n);
+        }
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
 SSEFUNCTION float *EdgePreservingDecomposition::CompressDynamicRange(float *Source, float Scale, float EdgeStopping, float CompressionExponent, float DetailBoost, int Iterates, int Reweightings, float *Compressed)
 {
     if(w < 300 && h < 300) { // set number of Reweightings to zero for small images (thumbnails). We could try to find a better solution here.
@@ -890,35 +965,37 @@ SSEFUNCTION float *EdgePreservingDecomposition::CompressDynamicRange(float *Sour
     const float eps = 0.0001f;
 
     //We're working with luminance, which does better logarithmic.
+    if(!epdLogDispatched(Source, eps, n)) {
 #ifdef __SSE2__
 #ifdef _OPENMP
-    #pragma omp parallel
+        #pragma omp parallel
 #endif
-    {
-        __m128 epsv = _mm_set1_ps( eps );
+        {
+            __m128 epsv = _mm_set1_ps( eps );
 #ifdef _OPENMP
-        #pragma omp for
+            #pragma omp for
 #endif
 
-        for(int ii = 0; ii < n - 3; ii += 4) {
-            _mm_storeu_ps( &Source[ii], xlogf(LVFU(Source[ii]) + epsv));
+            for(int ii = 0; ii < n - 3; ii += 4) {
+                _mm_storeu_ps( &Source[ii], xlogf(LVFU(Source[ii]) + epsv));
+            }
         }
-    }
 
-    for(int ii = n - (n % 4); ii < n; ii++) {
-        Source[ii] = xlogf(Source[ii] + eps);
-    }
+        for(int ii = n - (n % 4); ii < n; ii++) {
+            Source[ii] = xlogf(Source[ii] + eps);
+        }
 
 #else
 #ifdef _OPENMP
-    #pragma omp parallel for
+        #pragma omp parallel for
 #endif
 
-    for(int ii = 0; ii < n; ii++) {
-        Source[ii] = xlogf(Source[ii] + eps);
-    }
+        for(int ii = 0; ii < n; ii++) {
+            Source[ii] = xlogf(Source[ii] + eps);
+        }
 
 #endif
+    }
 
     //Blur. Also setup memory for Compressed (we can just use u since each element of u is used in one calculation).
     float *u = CreateIteratedBlur(Source, Scale, EdgeStopping, Iterates, Reweightings);
@@ -938,48 +1015,50 @@ SSEFUNCTION float *EdgePreservingDecomposition::CompressDynamicRange(float *Sour
         temp = CompressionExponent - 1.0f;
     }
 
+    if(!epdUnlogDispatched(Source, u, Compressed, eps, temp, DetailBoost, n)) {
 #ifdef __SSE2__
 #ifdef _OPENMP
-    #pragma omp parallel
+        #pragma omp parallel
 #endif
-    {
-        __m128 cev, uev, sourcev;
-        __m128 epsv = _mm_set1_ps( eps );
-        __m128 DetailBoostv = _mm_set1_ps( DetailBoost );
-        __m128 tempv = _mm_set1_ps( temp );
+        {
+            __m128 cev, uev, sourcev;
+            __m128 epsv = _mm_set1_ps( eps );
+            __m128 DetailBoostv = _mm_set1_ps( DetailBoost );
+            __m128 tempv = _mm_set1_ps( temp );
 #ifdef _OPENMP
-        #pragma omp for
+            #pragma omp for
 #endif
 
-        for(int i = 0; i < n - 3; i += 4) {
-            cev = xexpf(LVFU(Source[i]) + LVFU(u[i]) * (tempv)) - epsv;
-            uev = xexpf(LVFU(u[i])) - epsv;
-            sourcev = xexpf(LVFU(Source[i])) - epsv;
-            _mm_storeu_ps( &Source[i], sourcev);
-            _mm_storeu_ps( &Compressed[i], cev + DetailBoostv * (sourcev - uev) );
+            for(int i = 0; i < n - 3; i += 4) {
+                cev = xexpf(LVFU(Source[i]) + LVFU(u[i]) * (tempv)) - epsv;
+                uev = xexpf(LVFU(u[i])) - epsv;
+                sourcev = xexpf(LVFU(Source[i])) - epsv;
+                _mm_storeu_ps( &Source[i], sourcev);
+                _mm_storeu_ps( &Compressed[i], cev + DetailBoostv * (sourcev - uev) );
+            }
         }
-    }
 
-    for(int i = n - (n % 4); i < n; i++) {
-        float ce = xexpf(Source[i] + u[i] * (temp)) - eps;
-        float ue = xexpf(u[i]) - eps;
-        Source[i] = xexpf(Source[i]) - eps;
-        Compressed[i] = ce + DetailBoost * (Source[i] - ue);
-    }
+        for(int i = n - (n % 4); i < n; i++) {
+            float ce = xexpf(Source[i] + u[i] * (temp)) - eps;
+            float ue = xexpf(u[i]) - eps;
+            Source[i] = xexpf(Source[i]) - eps;
+            Compressed[i] = ce + DetailBoost * (Source[i] - ue);
+        }
 
 #else
 #ifdef _OPENMP
-    #pragma omp parallel for
+        #pragma omp parallel for
 #endif
 
-    for(int i = 0; i < n; i++) {
-        float ce = xexpf(Source[i] + u[i] * (temp)) - eps;
-        float ue = xexpf(u[i]) - eps;
-        Source[i] = xexpf(Source[i]) - eps;
-        Compressed[i] = ce + DetailBoost * (Source[i] - ue);
-    }
+        for(int i = 0; i < n; i++) {
+            float ce = xexpf(Source[i] + u[i] * (temp)) - eps;
+            float ue = xexpf(u[i]) - eps;
+            Source[i] = xexpf(Source[i]) - eps;
+            Compressed[i] = ce + DetailBoost * (Source[i] - ue);
+        }
 
 #endif
+    }
 
     if(Compressed != u) {
         delete[] u;
@@ -70,9 +70,10 @@ ben_s or nonbasketless. Enjoy!
 
 #include "opthelper.h"
 #include "noncopyable.h"
+#include "canceltoken.h"
 
-//This is for solving big symmetric positive definite linear problems.
-float *SparseConjugateGradient(void Ax(float *Product, float *x, void *Pass), float *b, int n, bool OkToModify_b = true, float *x = nullptr, float RMSResidual = 0.0f, void *Pass = nullptr, int MaximumIterates = 0, void Preconditioner(float *Product, float *x, void *Pass) = nullptr);
+//This is for solving big symmetric positive definite linear problems. Polls Cancel once per iterate, and skips the remaining ones, with x incomplete, once it is cancelled.
+float *SparseConjugateGradient(void Ax(float *Product, float *x, void *Pass), float *b, int n, bool OkToModify_b = true, float *x = nullptr, float RMSResidual = 0.0f, void *Pass = nullptr, int MaximumIterates = 0, void Preconditioner(float *Product, float *x, void *Pass) = nullptr, rtengine::CancelCheck *Cancel = nullptr);
 
 //Storage and use class for symmetric matrices, the nonzero contents of which are confined to diagonals.
 class MultiDiagonalSymmetricMatrix :
@@ -154,9 +155,14 @@ public:
     In place calculation to save memory (Source == Compressed) is totally ok. Reweightings > 0 invokes CreateIteratedBlur instead of CreateBlur. */
     float *CompressDynamicRange(float *Source, float Scale = 1.0f, float EdgeStopping = 1.4f, float CompressionExponent = 0.8f, float DetailBoost = 0.1f, int Iterates = 20, int Reweightings = 0, float *Compressed = nullptr);
 
+    //The blurs poll Check once per iterate of their solver, so it counts Iterates units per blur, and stop early once it is cancelled,
+    //leaving their output incomplete. NULL, the default, never stops.
+    void SetCancelCheck(rtengine::CancelCheck *Check);
+
 private:
     MultiDiagonalSymmetricMatrix *A;    //The equations are simple enough to not mandate a matrix class, but fast solution NEEDS a complicated preconditioner.
     int w, h, n;
+    rtengine::CancelCheck *Cancel;
 
     //Convenient access to the data in A.
     float * RESTRICT a0, * RESTRICT a_1, * RESTRICT a_w, * RESTRICT a_w_1, * RESTRICT a_w1;
@@ -38,6 +38,7 @@
 #include "cplx_wavelet_dec.h"
 #include "median.h"
 #include "iccstore.h"
+#include "fftwplancache.h"
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -667,6 +668,7 @@ SSEFUNCTION void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagef
             Tile_calc (tilesize, overlap, (options.rgbDenoiseThreadLimit == 0 && !ponder) ? (numTries == 1 ? 0 : 2) : 2, imwidth, imheight, numtiles_W, numtiles_H, tilewidth, tileheight, tileWskip, tileHskip);
             memoryAllocationFailed = false;
             const int numtiles = numtiles_W * numtiles_H;
+            CancelCheck cancelCheck (cancelToken, "RGB_denoise", numtiles);
 
             //output buffer
             Imagefloat * dsttmp;
@@ -691,35 +693,25 @@ SSEFUNCTION void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagef
             //now we have tile dimensions, overlaps
             //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 
-            // According to FFTW-Doc 'it is safe to execute the same plan in parallel by multiple threads', so we now create 4 plans
-            // outside the parallel region and use them inside the parallel region.
+            // According to FFTW-Doc 'it is safe to execute the same plan in parallel by multiple threads', so we get 4 plans
+            // outside the parallel region and use them inside the parallel region. They are kept by the plan cache.
 
             // calculate max size of numblox_W.
             int max_numblox_W = ceil((static_cast<float>(MIN(imwidth, tilewidth))) / (offset)) + 2 * blkrad;
             // calculate min size of numblox_W.
             int min_numblox_W = ceil((static_cast<float>((MIN(imwidth, ((numtiles_W - 1) * tileWskip) + tilewidth)) - ((numtiles_W - 1) * tileWskip))) / (offset)) + 2 * blkrad;
 
-            // these are needed only for creation of the plans and will be freed before entering the parallel loop
             fftwf_plan plan_forward_blox[2];
             fftwf_plan plan_backward_blox[2];
 
             if (denoiseLuminance) {
-                float *Lbloxtmp  = reinterpret_cast<float*>( fftwf_malloc(max_numblox_W * TS * TS * sizeof (float)));
-                float *fLbloxtmp = reinterpret_cast<float*>( fftwf_malloc(max_numblox_W * TS * TS * sizeof (float)));
-
-                int nfwd[2] = {TS, TS};
+                FftwPlanCache* const planCache = FftwPlanCache::getInstance ();
 
                 //for DCT:
-                fftw_r2r_kind fwdkind[2] = {FFTW_REDFT10, FFTW_REDFT10};
-                fftw_r2r_kind bwdkind[2] = {FFTW_REDFT01, FFTW_REDFT01};
-
-                // Creating the plans with FFTW_MEASURE instead of FFTW_ESTIMATE speeds up the execute a bit
-                plan_forward_blox[0]  = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, Lbloxtmp, nullptr, 1, TS * TS, fLbloxtmp, nullptr, 1, TS * TS, fwdkind, FFTW_MEASURE || FFTW_DESTROY_INPUT  );
-                plan_backward_blox[0] = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, fLbloxtmp, nullptr, 1, TS * TS, Lbloxtmp, nullptr, 1, TS * TS, bwdkind, FFTW_MEASURE || FFTW_DESTROY_INPUT  );
-                plan_forward_blox[1]  = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, Lbloxtmp, nullptr, 1, TS * TS, fLbloxtmp, nullptr, 1, TS * TS, fwdkind, FFTW_MEASURE || FFTW_DESTROY_INPUT  );
-                plan_backward_blox[1] = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, fLbloxtmp, nullptr, 1, TS * TS, Lbloxtmp, nullptr, 1, TS * TS, bwdkind, FFTW_MEASURE || FFTW_DESTROY_INPUT  );
-                fftwf_free (Lbloxtmp);
-                fftwf_free (fLbloxtmp);
+                plan_forward_blox[0]  = planCache->getManyR2r (TS, TS, max_numblox_W, FFTW_REDFT10);
+                plan_backward_blox[0] = planCache->getManyR2r (TS, TS, max_numblox_W, FFTW_REDFT01);
+                plan_forward_blox[1]  = planCache->getManyR2r (TS, TS, min_numblox_W, FFTW_REDFT10);
+                plan_backward_blox[1] = planCache->getManyR2r (TS, TS, min_numblox_W, FFTW_REDFT01);
             }
 
 #ifndef _OPENMP
@@ -762,6 +754,11 @@ SSEFUNCTION void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagef
                     LbloxArray[i]  = reinterpret_cast<float*>( fftwf_malloc(max_numblox_W * TS * TS * sizeof(float)));
                     fLbloxArray[i] = reinterpret_cast<float*>( fftwf_malloc(max_numblox_W * TS * TS * sizeof(float)));
                 }
+            } else {
+                // allocated by the tile, which may be skipped
+                for (int i = 0; i < denoiseNestedLevels * numthreads; ++i) {
+                    LbloxArray[i] = fLbloxArray[i] = nullptr;
+                }
             }
 
             TMatrix wiprof = iccStore->workingSpaceInverseMatrix (params->icm.working);
@@ -803,6 +800,10 @@ SSEFUNCTION void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagef
 
                 for (int tiletop = 0; tiletop < imheight; tiletop += tileHskip) {
                     for (int tileleft = 0; tileleft < imwidth ; tileleft += tileWskip) {
+                        if (cancelCheck.skip ()) {
+                            continue;
+                        }
+
                         //printf("titop=%d tileft=%d\n",tiletop/tileHskip, tileleft/tileWskip);
                         pos = (tiletop / tileHskip) * numtiles_W + tileleft / tileWskip ;
                         int tileright = MIN(imwidth, tileleft + tilewidth);
@@ -1053,7 +1054,7 @@ SSEFUNCTION void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagef
                             execwavelet = true;
                         }
 
-                        if (execwavelet) {//gain time if user choose only median  sliders L <=1  slider chrom master < 1
+                        if (execwavelet && !cancelCheck.cancelled ()) {//gain time if user choose only median  sliders L <=1  slider chrom master < 1
                             wavelet_decomposition* Ldecomp;
                             wavelet_decomposition* adecomp;
 
@@ -1381,6 +1382,9 @@ SSEFUNCTION void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagef
 #endif
 
                                     for (int vblk = 0; vblk < numblox_H; ++vblk) {
+                                        if (cancelCheck.cancelled ()) {
+                                            continue;
+                                        }
 
                                         int top = (vblk - blkrad) * offset;
                                         float * datarow = pBuf + blkrad * offset;
@@ -1725,15 +1729,6 @@ SSEFUNCTION void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagef
                     }
                 }
             }
-
-            if (denoiseLuminance) {
-                // destroy the plans
-                fftwf_destroy_plan(plan_forward_blox[0]);
-                fftwf_destroy_plan(plan_backward_blox[0]);
-                fftwf_destroy_plan(plan_forward_blox[1]);
-                fftwf_destroy_plan(plan_backward_blox[1]);
-                fftwf_cleanup();
-            }
         } while(memoryAllocationFailed && numTries < 2 && (options.rgbDenoiseThreadLimit == 0) && !ponder);
 
         if (memoryAllocationFailed) {
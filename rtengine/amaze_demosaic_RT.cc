@@ -62,6 +62,7 @@ SSEFUNCTION void RawImageSource::amaze_demosaic_RT(int winx, int winy, int winw,
     // We assure that Tile size is a multiple of 32 in the range [96;992]
     constexpr int ts = (AMAZETS & 992) < 96 ? 96 : (AMAZETS & 992);
     constexpr int tsh = ts / 2; // half of Tile size
+    CancelCheck cancelCheck (cancelToken, "amaze_demosaic", ((height + ts - 17) / (ts - 32)) * ((width + ts - 17) / (ts - 32)));
 
     //offset of R pixel within a Bayer quartet
     int ex, ey;
@@ -181,6 +182,10 @@ SSEFUNCTION void RawImageSource::amaze_demosaic_RT(int winx, int winy, int winw,
 
         for (int top = winy - 16; top < winy + height; top += ts - 32) {
             for (int left = winx - 16; left < winx + width; left += ts - 32) {
+                if (cancelCheck.skip ()) {
+                    continue;
+                }
+
                 memset(&nyquist[3 * tsh], 0, sizeof(unsigned char) * (ts - 6) * tsh);
                 //location of tile bottom edge
                 int bottom = min(top + ts, winy + height + 16);
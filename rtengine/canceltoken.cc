@@ -0,0 +1,127 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "canceltoken.h"
+
+#include <cstdio>
+
+#include "settings.h"
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+namespace
+{
+
+MyMutex countersMutex;
+std::vector<CancelCheck::Counters> counters;
+
+}
+
+CancelToken::CancelToken () :
+    cancelled (false)
+{
+}
+
+void CancelToken::cancel ()
+{
+    cancelled = true;
+}
+
+void CancelToken::reset ()
+{
+    cancelled = false;
+}
+
+bool CancelToken::isCancelled () const
+{
+    return cancelled.load (std::memory_order_relaxed);
+}
+
+CancelCheck::CancelCheck (const CancelToken* token, const char* stage, int units) :
+    token (token),
+    stage (stage),
+    units (units),
+    skipped (0),
+    hit (false)
+{
+}
+
+CancelCheck::~CancelCheck ()
+{
+    if (!hit) {
+        return;
+    }
+
+    if (settings->verbose) {
+        printf ("%s abandoned, %d of %d units skipped\n", stage, skipped.load (), units);
+    }
+
+    MyMutex::MyLock lock (countersMutex);
+
+    auto entry = counters.begin ();
+
+    while (entry != counters.end () && entry->stage != stage) {
+        ++entry;
+    }
+
+    if (entry == counters.end ()) {
+        entry = counters.insert (entry, {stage, 0, 0, 0});
+    }
+
+    ++entry->abandoned;
+    entry->skipped += skipped;
+    entry->units += units;
+}
+
+bool CancelCheck::skip ()
+{
+    if (!cancelled ()) {
+        return false;
+    }
+
+    ++skipped;
+    return true;
+}
+
+bool CancelCheck::cancelled ()
+{
+    if (!token || !token->isCancelled ()) {
+        return false;
+    }
+
+    hit = true;
+    return true;
+}
+
+std::vector<CancelCheck::Counters> CancelCheck::getCounters ()
+{
+    MyMutex::MyLock lock (countersMutex);
+    return counters;
+}
+
+void CancelCheck::printCounters ()
+{
+    for (const auto& entry : getCounters ()) {
+        printf ("%s: %u runs abandoned, %llu of %llu units skipped\n", entry.stage.c_str (), entry.abandoned,
+                static_cast<unsigned long long> (entry.skipped), static_cast<unsigned long long> (entry.units));
+    }
+}
+
+}
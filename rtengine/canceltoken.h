@@ -0,0 +1,92 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+/** Lets the long running stages stop early when their result isn't needed anymore, e.g. when the parameters of the
+  * preview changed again while it was computed.
+  *
+  * The stages poll the token at tile or row granularity through a CancelCheck. A stage which stops leaves its output
+  * incomplete, the caller has to check the token and drop the result.
+  */
+class CancelToken final :
+    public NonCopyable
+{
+public:
+    CancelToken ();
+
+    /** Can be called from any thread */
+    void cancel ();
+    void reset ();
+    bool isCancelled () const;
+
+private:
+    std::atomic<bool> cancelled;
+};
+
+/** Polls a token in the loops of a stage, and counts the work the stage abandoned.
+  *
+  * The token may be nullptr, the stage can't be cancelled then. The counters of the stages are printed in verbose mode
+  * when a stage is abandoned, and by CancelCheck::printCounters.
+  */
+class CancelCheck final :
+    public NonCopyable
+{
+public:
+    /** @param stage is the name of the stage, it has to be a string literal (or have static storage duration)
+      * @param units is the number of tiles or rows the stage will poll for */
+    CancelCheck (const CancelToken* token, const char* stage, int units);
+    /** Records the counters of the stage if it has been abandoned */
+    ~CancelCheck ();
+
+    /** To be called once per tile or row, from any thread.
+      * @return true if the token has been cancelled, the tile or row has to be skipped then */
+    bool skip ();
+
+    /** To be called between the steps of a tile, or of a stage done at once.
+      * @return true if the token has been cancelled, the rest of the work has to be skipped then */
+    bool cancelled ();
+
+    struct Counters {
+        std::string stage;
+        unsigned int abandoned;     // number of runs which have been abandoned
+        uint64_t skipped;           // number of units skipped by these runs
+        uint64_t units;             // total number of units of these runs
+    };
+
+    static std::vector<Counters> getCounters ();
+    /** Prints the counters of the stages which have been abandoned at least once */
+    static void printCounters ();
+
+private:
+    const CancelToken* const token;
+    const char* const stage;
+    const int units;
+    std::atomic<int> skipped;
+    std::atomic<bool> hit;
+};
+
+}
@@ -0,0 +1,372 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "cmstransformcache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glibmm.h>
+
+#include "color.h"
+#include "iccstore.h"
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+extern MyMutex* lcmsMutex;
+
+namespace
+{
+
+constexpr size_t maxTransforms = 16;
+constexpr size_t maxConversions = 8;
+
+template<typename T>
+T findEntry (std::list<std::pair<std::string, T>>& entries, const std::string& key, bool& found)
+{
+    for (auto entry = entries.begin (); entry != entries.end (); ++entry) {
+        if (entry->first == key) {
+            entries.splice (entries.begin (), entries, entry);
+            found = true;
+            return entries.front ().second;
+        }
+    }
+
+    found = false;
+    return T ();
+}
+
+template<typename T>
+void addEntry (std::list<std::pair<std::string, T>>& entries, const std::string& key, const T& value, size_t maxEntries)
+{
+    entries.emplace_front (key, value);
+
+    // the entries still held by an image are freed once it is done with them
+    while (entries.size () > maxEntries) {
+        entries.pop_back ();
+    }
+}
+
+bool invert (const double m[3][3], double inverse[3][3])
+{
+    const double det = m[0][0] * (m[1][1] * m[2][2] - m[2][1] * m[1][2])
+                       - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+                       + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+
+    if (std::fabs (det) < 1e-10) {
+        return false;
+    }
+
+    inverse[0][0] = (m[1][1] * m[2][2] - m[2][1] * m[1][2]) / det;
+    inverse[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) / det;
+    inverse[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) / det;
+    inverse[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) / det;
+    inverse[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) / det;
+    inverse[1][2] = (m[1][0] * m[0][2] - m[0][0] * m[1][2]) / det;
+    inverse[2][0] = (m[1][0] * m[2][1] - m[2][0] * m[1][1]) / det;
+    inverse[2][1] = (m[2][0] * m[0][1] - m[0][0] * m[2][1]) / det;
+    inverse[2][2] = (m[0][0] * m[1][1] - m[1][0] * m[0][1]) / det;
+    return true;
+}
+
+}
+
+constexpr int MatrixShaperLab2Rgb::chunkSize;
+
+void MatrixShaperLab2Rgb::computeIndices (const float* L, const float* a, const float* b, int n, float indices[3][chunkSize]) const
+{
+    int x = 0;
+#ifdef __SSE2__
+    vfloat matrixv[3][3];
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            matrixv[i][j] = F2V (xyz_rgb[i][j]);
+        }
+    }
+
+    const vfloat onev = F2V (1.f);
+    const vfloat c65535v = F2V (65535.f);
+
+    for (; x < n - 3; x += 4) {
+        vfloat X, Y, Z;
+        Color::Lab2XYZ (LVFU (L[x]), LVFU (a[x]), LVFU (b[x]), X, Y, Z);
+
+        for (int c = 0; c < 3; ++c) {
+            const vfloat linear = matrixv[c][0] * X + matrixv[c][1] * Y + matrixv[c][2] * Z;
+            STVFU (indices[c][x], c65535v * vsqrtf (LIMV (linear, ZEROV, onev)));
+        }
+    }
+
+#endif
+
+    for (; x < n; ++x) {
+        float X, Y, Z;
+        Color::Lab2XYZ (L[x], a[x], b[x], X, Y, Z);
+
+        for (int c = 0; c < 3; ++c) {
+            const float linear = xyz_rgb[c][0] * X + xyz_rgb[c][1] * Y + xyz_rgb[c][2] * Z;
+            indices[c][x] = 65535.f * std::sqrt (LIM01 (linear));
+        }
+    }
+}
+
+void MatrixShaperLab2Rgb::convert (const float* L, const float* a, const float* b, unsigned short* red, unsigned short* green, unsigned short* blue, int width) const
+{
+    float indices[3][chunkSize] ALIGNED16;
+
+    for (int x0 = 0; x0 < width; x0 += chunkSize) {
+        const int n = std::min (chunkSize, width - x0);
+        computeIndices (L + x0, a + x0, b + x0, n, indices);
+
+        for (int x = 0; x < n; ++x) {
+            red[x0 + x] = trc[0][indices[0][x]] + 0.5f;
+            green[x0 + x] = trc[1][indices[1][x]] + 0.5f;
+            blue[x0 + x] = trc[2][indices[2][x]] + 0.5f;
+        }
+    }
+}
+
+void MatrixShaperLab2Rgb::convert (const float* L, const float* a, const float* b, unsigned char* rgb, int width) const
+{
+    float indices[3][chunkSize] ALIGNED16;
+
+    for (int x0 = 0; x0 < width; x0 += chunkSize) {
+        const int n = std::min (chunkSize, width - x0);
+        computeIndices (L + x0, a + x0, b + x0, n, indices);
+
+        for (int x = 0; x < n; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                *rgb++ = trc[c][indices[c][x]] / 257.f + 0.5f;
+            }
+        }
+    }
+}
+
+CmsTransformCache* CmsTransformCache::getInstance ()
+{
+    static CmsTransformCache instance;
+    return &instance;
+}
+
+void CmsTransformCache::cleanup ()
+{
+    MyMutex::MyLock lock (*lcmsMutex);
+
+    transforms.clear ();
+    conversions.clear ();
+    digests.clear ();
+
+    if (labProfile) {
+        cmsCloseProfile (labProfile);
+        labProfile = nullptr;
+    }
+}
+
+cmsHPROFILE CmsTransformCache::getLabProfile ()
+{
+    MyMutex::MyLock lock (*lcmsMutex);
+
+    if (!labProfile) {
+        labProfile = cmsCreateLab4Profile (nullptr);
+
+        // it is closed by cleanup only, with the digests
+        std::string digest;
+
+        if (getDigest (labProfile, digest)) {
+            digests.emplace (labProfile, digest);
+        }
+    }
+
+    return labProfile;
+}
+
+CmsTransform CmsTransformCache::get (cmsHPROFILE input, cmsUInt32Number inputFormat, cmsHPROFILE output, cmsUInt32Number outputFormat, cmsUInt32Number intent, cmsUInt32Number flags)
+{
+    // NOCACHE is important for thread safety
+    flags |= cmsFLAGS_NOCACHE;
+
+    MyMutex::MyLock lock (*lcmsMutex);
+
+    std::string inputDigest, outputDigest;
+
+    if (!getDigest (input, inputDigest) || !getDigest (output, outputDigest)) {
+        const cmsHTRANSFORM hTransform = cmsCreateTransform (input, inputFormat, output, outputFormat, intent, flags);
+        return hTransform ? CmsTransform (hTransform, cmsDeleteTransform) : nullptr;
+    }
+
+    const std::string key = inputDigest + '|' + outputDigest + '|' + std::to_string (inputFormat) + '|' + std::to_string (outputFormat)
+                            + '|' + std::to_string (intent) + '|' + std::to_string (flags);
+
+    bool found;
+    CmsTransform transform = findEntry (transforms, key, found);
+
+    if (!found) {
+        const cmsHTRANSFORM hTransform = cmsCreateTransform (input, inputFormat, output, outputFormat, intent, flags);
+
+        if (hTransform) {
+            transform.reset (hTransform, cmsDeleteTransform);
+        }
+
+        addEntry (transforms, key, transform, maxTransforms);
+    }
+
+    return transform;
+}
+
+std::shared_ptr<const MatrixShaperLab2Rgb> CmsTransformCache::getLab2Rgb (cmsHPROFILE output, cmsUInt32Number intent, bool bpc)
+{
+    if (!output) {
+        return nullptr;
+    }
+
+    MyMutex::MyLock lock (*lcmsMutex);
+
+    std::string digest;
+
+    if (!getDigest (output, digest)) {
+        return createLab2Rgb (output, intent, bpc);
+    }
+
+    const std::string key = digest + '|' + std::to_string (intent) + '|' + std::to_string (bpc);
+
+    bool found;
+    std::shared_ptr<const MatrixShaperLab2Rgb> conversion = findEntry (conversions, key, found);
+
+    if (!found) {
+        conversion = createLab2Rgb (output, intent, bpc);
+        addEntry (conversions, key, conversion, maxConversions);
+    }
+
+    return conversion;
+}
+
+// WARNING: the caller must lock lcmsMutex
+bool CmsTransformCache::getDigest (cmsHPROFILE profile, std::string& digest)
+{
+    if (!profile) {
+        digest.clear ();
+        return true;
+    }
+
+    const auto known = digests.find (profile);
+
+    if (known != digests.end ()) {
+        digest = known->second;
+        return true;
+    }
+
+    cmsUInt32Number size = 0;
+
+    if (!cmsSaveProfileToMem (profile, nullptr, &size) || size == 0) {
+        return false;
+    }
+
+    std::vector<guint8> data (size);
+
+    if (!cmsSaveProfileToMem (profile, data.data (), &size)) {
+        return false;
+    }
+
+    digest = Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, data.data (), size);
+
+    if (iccStore->isStoreProfile (profile)) {
+        digests.emplace (profile, digest);
+    }
+
+    return true;
+}
+
+// WARNING: the caller must lock lcmsMutex
+std::shared_ptr<const MatrixShaperLab2Rgb> CmsTransformCache::createLab2Rgb (cmsHPROFILE output, cmsUInt32Number intent, bool bpc) const
+{
+    if (intent == INTENT_ABSOLUTE_COLORIMETRIC || cmsGetColorSpace (output) != cmsSigRgbData || !cmsIsMatrixShaper (output)) {
+        return nullptr;
+    }
+
+    // lcms uses the LUTs of the profile if there are some, whatever the intent
+    const cmsTagSignature lutTags[] = {cmsSigBToA0Tag, cmsSigBToA1Tag, cmsSigBToA2Tag, cmsSigDToB0Tag, cmsSigDToB1Tag, cmsSigDToB2Tag};
+
+    for (const auto tag : lutTags) {
+        if (cmsIsTag (output, tag)) {
+            return nullptr;
+        }
+    }
+
+    // lcms compensates the black point of the v4 profiles in the perceptual and saturation intents anyway
+    const bool compensated = bpc || (cmsGetEncodedICCversion (output) >= 0x4000000 && (intent == INTENT_PERCEPTUAL || intent == INTENT_SATURATION));
+
+    const cmsTagSignature colorantTags[3] = {cmsSigRedColorantTag, cmsSigGreenColorantTag, cmsSigBlueColorantTag};
+    const cmsTagSignature trcTags[3] = {cmsSigRedTRCTag, cmsSigGreenTRCTag, cmsSigBlueTRCTag};
+    double rgb_xyz[3][3];
+
+    for (int c = 0; c < 3; ++c) {
+        const cmsCIEXYZ* const colorant = static_cast<const cmsCIEXYZ*> (cmsReadTag (output, colorantTags[c]));
+
+        if (!colorant) {
+            return nullptr;
+        }
+
+        rgb_xyz[0][c] = colorant->X;
+        rgb_xyz[1][c] = colorant->Y;
+        rgb_xyz[2][c] = colorant->Z;
+    }
+
+    double xyz_rgb[3][3];
+
+    if (!invert (rgb_xyz, xyz_rgb)) {
+        return nullptr;
+    }
+
+    std::shared_ptr<MatrixShaperLab2Rgb> conversion (new MatrixShaperLab2Rgb);
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            conversion->xyz_rgb[i][j] = xyz_rgb[i][j] / 65535.0;
+        }
+    }
+
+    for (int c = 0; c < 3; ++c) {
+        const cmsToneCurve* const curve = static_cast<const cmsToneCurve*> (cmsReadTag (output, trcTags[c]));
+
+        // the compensation is a no-op if the black of the profile is 0
+        if (!curve || (compensated && cmsEvalToneCurveFloat (curve, 0.f) > 1e-6f)) {
+            return nullptr;
+        }
+
+        cmsToneCurve* const inverse = cmsReverseToneCurve (curve);
+
+        if (!inverse) {
+            return nullptr;
+        }
+
+        conversion->trc[c] (65536, LUT_CLIP_BELOW | LUT_CLIP_ABOVE);
+
+        for (int i = 0; i < 65536; ++i) {
+            const float s = i / 65535.f;
+            conversion->trc[c][i] = 65535.f * LIM01 (cmsEvalToneCurveFloat (inverse, s * s));
+        }
+
+        cmsFreeToneCurve (inverse);
+    }
+
+    return conversion;
+}
+
+}
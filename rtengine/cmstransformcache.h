@@ -0,0 +1,107 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <lcms2.h>
+
+#include "LUT.h"
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+/** A transform of CmsTransformCache, it stays valid as long as it is held */
+using CmsTransform = std::shared_ptr<void>;
+
+/** Conversion of Lab to the RGB of a matrix/shaper profile.
+  *
+  * This is what lcms does for these profiles in the non absolute intents, i.e. Lab to XYZ, the inverse of the colorant
+  * matrix and the inverse of the TRCs, with the TRCs baked into LUTs and without the per pixel overhead of the lcms
+  * pipelines.
+  */
+class MatrixShaperLab2Rgb :
+    public NonCopyable
+{
+public:
+    /** Converts a row of LabImage values to planar RGB in [0 ; 65535] */
+    void convert (const float* L, const float* a, const float* b, unsigned short* red, unsigned short* green, unsigned short* blue, int width) const;
+
+    /** Converts a row of LabImage values to interleaved RGB in [0 ; 255] */
+    void convert (const float* L, const float* a, const float* b, unsigned char* rgb, int width) const;
+
+private:
+    friend class CmsTransformCache;
+
+    static constexpr int chunkSize = 64;
+
+    MatrixShaperLab2Rgb () = default;
+
+    void computeIndices (const float* L, const float* a, const float* b, int n, float indices[3][chunkSize]) const;
+
+    float xyz_rgb[3][3];  ///< XYZ in [0 ; 65535] to linear RGB in [0 ; 1]
+    LUTf trc[3];          ///< inverse TRCs in [0 ; 65535], indexed by 65535 * sqrt (linear RGB) to keep the dark tones accurate
+};
+
+/** Cache of the lcms transforms.
+  *
+  * Creating a transform costs more than applying it to a preview crop or to a band of an export, and the images use a
+  * handful of profile pairs. The transforms are created with cmsFLAGS_NOCACHE, so that they can be shared by the
+  * threads; the profiles are identified by their content, so that the profiles built on the fly, like the gamma ones,
+  * hit the cache as well. The digests of the profiles of ICCStore are kept by handle, since these profiles are never
+  * closed, so that a lookup with them doesn't serialize them. The other profiles may be closed and their handles
+  * reused, their digest is computed at each lookup. The cache locks lcmsMutex itself, it mustn't be called with
+  * lcmsMutex held.
+  */
+class CmsTransformCache :
+    public NonCopyable
+{
+public:
+    static CmsTransformCache* getInstance ();
+
+    void cleanup ();
+
+    /** @return the Lab D50 profile (v4) owned by the cache */
+    cmsHPROFILE getLabProfile ();
+
+    /** Same parameters as cmsCreateTransform
+      * @return the transform, nullptr if lcms can't create it */
+    CmsTransform get (cmsHPROFILE input, cmsUInt32Number inputFormat, cmsHPROFILE output, cmsUInt32Number outputFormat, cmsUInt32Number intent, cmsUInt32Number flags);
+
+    /** @return the conversion of Lab to the RGB of output, nullptr if output isn't a matrix/shaper RGB profile or if
+      * the conversion needs lcms (absolute intent, black point compensation that isn't a no-op) */
+    std::shared_ptr<const MatrixShaperLab2Rgb> getLab2Rgb (cmsHPROFILE output, cmsUInt32Number intent, bool bpc);
+
+private:
+    CmsTransformCache () = default;
+
+    /** @return false if the profile can't be serialized, its transforms aren't cached then */
+    bool getDigest (cmsHPROFILE profile, std::string& digest);
+    std::shared_ptr<const MatrixShaperLab2Rgb> createLab2Rgb (cmsHPROFILE output, cmsUInt32Number intent, bool bpc) const;
+
+    cmsHPROFILE labProfile = nullptr;
+    std::map<cmsHPROFILE, std::string> digests;                                               // of the profiles never closed
+    std::list<std::pair<std::string, CmsTransform>> transforms;                               // the most recently used first
+    std::list<std::pair<std::string, std::shared_ptr<const MatrixShaperLab2Rgb>>> conversions; // the most recently used first
+};
+
+}
@@ -0,0 +1,75 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "cpudispatch.h"
+
+#include "settings.h"
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+namespace
+{
+
+SimdLevel detectCpu ()
+{
+#ifdef RT_SIMD_DISPATCH
+    // also checks that the OS saves the wider registers on context switches
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("avx512f")) {
+        return SimdLevel::AVX512;
+    }
+
+    if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma")) {
+        return SimdLevel::AVX2;
+    }
+
+#endif
+    return SimdLevel::NONE;
+}
+
+}
+
+SimdLevel getSimdLevel ()
+{
+    static const SimdLevel cpuLevel = detectCpu ();
+
+    // Settings::simdLevel: 0 = best available, 1 = build flags only, 2 = up to AVX2, 3 = up to AVX-512
+    if (settings && settings->simdLevel > 0 && settings->simdLevel - 1 < static_cast<int> (cpuLevel)) {
+        return static_cast<SimdLevel> (settings->simdLevel - 1);
+    }
+
+    return cpuLevel;
+}
+
+const char* getSimdLevelName (SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::AVX2:
+        return "AVX2";
+
+    case SimdLevel::AVX512:
+        return "AVX-512";
+
+    default:
+        return "build flags";
+    }
+}
+
+}
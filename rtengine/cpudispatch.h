@@ -0,0 +1,46 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+namespace rtengine
+{
+
+/** Runtime selection of the instruction set of the hot kernels.
+  *
+  * The code is built for the instruction set given by the compiler flags (see ProcessorTargets.cmake), SSE2 on
+  * x86-64. When RT_SIMD_DISPATCH is defined, some kernels are additionally compiled for AVX2 and AVX-512 in
+  * translation units of their own, and the widest variant supported by the cpu is picked at runtime, so that a
+  * generic build still uses 8 or 16 float wide registers where available. These kernels are:
+  * - the recursive gaussian of gauss.cc (gauss_avx2.cc, gauss_avx512.cc)
+  * - the xlogf and xexpf passes of the edge preserving decomposition (epd_avx2.cc, epd_avx512.cc), on top of the
+  *   xlogf and xexpf of sleef_simd_impl.h, which the other SLEEF users can share.
+  * The other SSE kernels, e.g. AMaZE, lab2rgb and rgbProc, only use the instruction set of the build flags.
+  */
+enum class SimdLevel {
+    NONE,       ///< the kernels of the build flags only
+    AVX2,       ///< AVX2 + FMA, 8 floats per register
+    AVX512      ///< AVX-512F, 16 floats per register
+};
+
+/** @return the widest instruction set available to the dispatched kernels: the best one supported by the cpu,
+  * limited by Settings::simdLevel, or SimdLevel::NONE if the kernels haven't been built for several instruction sets */
+SimdLevel getSimdLevel ();
+
+/** @return a readable name of the level, e.g. "AVX2" */
+const char* getSimdLevelName (SimdLevel level);
+
+}
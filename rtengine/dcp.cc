@@ -18,6 +18,7 @@
 */
 
 #include <iostream>
+#include <cstdint>
 #include <cstring>
 
 #include "dcp.h"
@@ -26,6 +27,15 @@
 #include "rawimagesource.h"
 #include "improcfun.h"
 #include "rt_math.h"
+#include "alignedbuffer.h"
+#include "settings.h"
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+}
 
 using namespace rtengine;
 using namespace rtexif;
@@ -380,6 +390,117 @@ double xyCoordToTemperature(const std::array<double, 2>& white_xy)
 
 }
 
+namespace rtengine
+{
+
+// The tables of a profile baked into a 3D LUT of ProPhoto values, with tetrahedral interpolation
+class DCPLut final :
+    public NonCopyable
+{
+public:
+    static constexpr int size = 65; // nodes per axis
+
+    DCPLut() :
+        nodes(size * size * size * 4)
+    {
+    }
+
+    float* operator ()(int r, int g, int b)
+    {
+        return nodes.data + ((r * size + g) * size + b) * 4;
+    }
+
+    // r, g and b are in [0 ; size - 1]
+    void apply(float r, float g, float b, float& out_r, float& out_g, float& out_b) const
+    {
+        constexpr int r_step = size * size * 4;
+        constexpr int g_step = size * 4;
+        constexpr int b_step = 4;
+
+        const int r_index = std::min<int>(r, size - 2);
+        const int g_index = std::min<int>(g, size - 2);
+        const int b_index = std::min<int>(b, size - 2);
+        const float fr = r - r_index;
+        const float fg = g - g_index;
+        const float fb = b - b_index;
+
+        // The cube is split along its diagonal into 6 tetrahedra, the one of the point is found by the order of the fractions
+        const float* const c0 = nodes.data + ((r_index * size + g_index) * size + b_index) * 4;
+        const float* c1;
+        const float* c2;
+        const float* const c3 = c0 + r_step + g_step + b_step;
+        float w0, w1, w2, w3;
+
+        if (fr >= fg) {
+            if (fg >= fb) {
+                c1 = c0 + r_step;
+                c2 = c0 + r_step + g_step;
+                w0 = 1.f - fr;
+                w1 = fr - fg;
+                w2 = fg - fb;
+                w3 = fb;
+            } else if (fr >= fb) {
+                c1 = c0 + r_step;
+                c2 = c0 + r_step + b_step;
+                w0 = 1.f - fr;
+                w1 = fr - fb;
+                w2 = fb - fg;
+                w3 = fg;
+            } else {
+                c1 = c0 + b_step;
+                c2 = c0 + r_step + b_step;
+                w0 = 1.f - fb;
+                w1 = fb - fr;
+                w2 = fr - fg;
+                w3 = fg;
+            }
+        } else {
+            if (fb >= fg) {
+                c1 = c0 + b_step;
+                c2 = c0 + g_step + b_step;
+                w0 = 1.f - fb;
+                w1 = fb - fg;
+                w2 = fg - fr;
+                w3 = fr;
+            } else if (fb >= fr) {
+                c1 = c0 + g_step;
+                c2 = c0 + g_step + b_step;
+                w0 = 1.f - fg;
+                w1 = fg - fb;
+                w2 = fb - fr;
+                w3 = fr;
+            } else {
+                c1 = c0 + g_step;
+                c2 = c0 + r_step + g_step;
+                w0 = 1.f - fg;
+                w1 = fg - fr;
+                w2 = fr - fb;
+                w3 = fb;
+            }
+        }
+
+#ifdef __SSE2__
+        // the nodes are padded to 4 floats, the 3 channels are interpolated at once
+        float out[4] ALIGNED16;
+        STVF(out[0], F2V(w0) * LVF(c0[0]) + F2V(w1) * LVF(c1[0]) + F2V(w2) * LVF(c2[0]) + F2V(w3) * LVF(c3[0]));
+        out_r = out[0];
+        out_g = out[1];
+        out_b = out[2];
+#else
+        out_r = w0 * c0[0] + w1 * c1[0] + w2 * c2[0] + w3 * c3[0];
+        out_g = w0 * c0[1] + w1 * c1[1] + w2 * c2[1] + w3 * c3[1];
+        out_b = w0 * c0[2] + w1 * c1[2] + w2 * c2[2] + w3 * c3[2];
+#endif
+    }
+
+private:
+    AlignedBuffer<float> nodes;
+};
+
+constexpr int DCPLut::size;
+
+}
+
 struct DCPProfile::ApplyState::Data {
     float pro_photo[3][3];
     float work[3][3];
@@ -387,6 +508,7 @@ struct DCPProfile::ApplyState::Data {
     bool use_tone_curve;
     bool apply_look_table;
     float bl_scale;
+    std::shared_ptr<const DCPLut> lut;
 };
 
 DCPProfile::ApplyState::ApplyState() :
@@ -1048,6 +1170,8 @@ void DCPProfile::apply(
             }
         }
 
+        const std::shared_ptr<const DCPLut> lut = getHueSatMapLut(delta_base, static_cast<size_t>(img->getWidth()) * img->getHeight());
+
         // Convert to ProPhoto and apply LUT
 #ifdef _OPENMP
         #pragma omp parallel for schedule(dynamic,16)
@@ -1059,23 +1183,20 @@ void DCPProfile::apply(
                 float newg = pro_photo[1][0] * img->r(y, x) + pro_photo[1][1] * img->g(y, x) + pro_photo[1][2] * img->b(y, x);
                 float newb = pro_photo[2][0] * img->r(y, x) + pro_photo[2][1] * img->g(y, x) + pro_photo[2][2] * img->b(y, x);
 
-                // If point is in negative area, just the matrix, but not the LUT. This is checked inside Color::rgb2hsvdcp
-                float h;
-                float s;
-                float v;
-
-                if(Color::rgb2hsvdcp(newr, newg, newb, h , s, v)) {
-
-                    hsdApply(delta_info, delta_base, h, s, v);
-
-                    // RT range correction
-                    if (h < 0.0f) {
-                        h += 6.0f;
-                    } else if (h >= 6.0f) {
-                        h -= 6.0f;
+                if (lut) {
+                    // The map doesn't depend on the value, the LUT is indexed by the colour scaled to a max of 1
+                    const float max_val = max(newr, newg, newb);
+
+                    // If point is in negative area, just the matrix, but not the LUT
+                    if (min(newr, newg, newb) >= 0.f && max_val > 0.f) {
+                        const float scale = (DCPLut::size - 1) / max_val;
+                        lut->apply(newr * scale, newg * scale, newb * scale, newr, newg, newb);
+                        newr *= max_val / 65535.f;
+                        newg *= max_val / 65535.f;
+                        newb *= max_val / 65535.f;
                     }
-
-                    Color::hsv2rgbdcp(h, s, v, newr, newg, newb);
+                } else {
+                    hueSatMapApply(delta_base, newr, newg, newb);
                 }
 
                 img->r(y, x) = work[0][0] * newr + work[0][1] * newg + work[0][2] * newb;
@@ -1104,6 +1225,12 @@ void DCPProfile::setStep2ApplyState(const Glib::ustring& working_space, bool use
         as_out.data->bl_scale = powf(2, baseline_exposure_offset);
     }
 
+    if (as_out.data->use_tone_curve || as_out.data->apply_look_table) {
+        as_out.data->lut = getStep2Lut(as_out.data->apply_look_table, as_out.data->use_tone_curve);
+    } else {
+        as_out.data->lut = nullptr;
+    }
+
     if (working_space == "ProPhoto") {
         as_out.data->already_pro_photo = true;
     } else {
@@ -1134,9 +1261,9 @@ void DCPProfile::step2ApplyTile(float* rc, float* gc, float* bc, int width, int
 {
 
 #define FCLIP(a) ((a)>0.0?((a)<65535.5?(a):65535.5):0.0)
-#define CLIP01(a) ((a)>0?((a)<1?(a):1):0)
 
     float exp_scale = as_in.data->bl_scale;
+    const DCPLut* const lut = as_in.data->lut.get();
 
     if (!as_in.data->use_tone_curve && !as_in.data->apply_look_table) {
         if (exp_scale == 1.f) {
@@ -1178,26 +1305,17 @@ void DCPProfile::step2ApplyTile(float* rc, float* gc, float* bc, int width, int
                 newg = FCLIP(newg);
                 newb = FCLIP(newb);
 
-                if (as_in.data->apply_look_table) {
-                    float h, s, v;
-                    Color::rgb2hsvdcp(newr, newg, newb, h, s, v);
-
-                    hsdApply(look_info, look_table, h, s, v);
-                    s = CLIP01(s);
-                    v = CLIP01(v);
-
-                    // RT range correction
-                    if (h < 0.0f) {
-                        h += 6.0f;
-                    } else if (h >= 6.0f) {
-                        h -= 6.0f;
-                    }
-
-                    Color::hsv2rgbdcp( h, s, v, newr, newg, newb);
-                }
-
-                if (as_in.data->use_tone_curve) {
-                    tone_curve.Apply(newr, newg, newb);
+                if (lut) {
+                    // The LUT is indexed by the square root of the values, which is closer to the way the tables and
+                    // the curve are sampled
+                    lut->apply(
+                        std::min(sqrtf(newr / 65535.f), 1.f) * (DCPLut::size - 1),
+                        std::min(sqrtf(newg / 65535.f), 1.f) * (DCPLut::size - 1),
+                        std::min(sqrtf(newb / 65535.f), 1.f) * (DCPLut::size - 1),
+                        newr, newg, newb
+                    );
+                } else {
+                    step2Apply(as_in.data->apply_look_table, as_in.data->use_tone_curve, newr, newg, newb);
                 }
 
                 if (as_in.data->already_pro_photo) {
@@ -1683,6 +1801,152 @@ void DCPProfile::hsdApply(const HsdTableInfo& table_info, const std::vector<HsbM
     }
 }
 
+void DCPProfile::hueSatMapApply(const std::vector<HsbModify>& delta_base, float& r, float& g, float& b) const
+{
+    // If point is in negative area, just the matrix, but not the LUT. This is checked inside Color::rgb2hsvdcp
+    float h;
+    float s;
+    float v;
+
+    if (Color::rgb2hsvdcp(r, g, b, h, s, v)) {
+        hsdApply(delta_info, delta_base, h, s, v);
+
+        // RT range correction
+        if (h < 0.0f) {
+            h += 6.0f;
+        } else if (h >= 6.0f) {
+            h -= 6.0f;
+        }
+
+        Color::hsv2rgbdcp(h, s, v, r, g, b);
+    }
+}
+
+void DCPProfile::step2Apply(bool apply_look_table, bool use_tone_curve, float& r, float& g, float& b) const
+{
+    // r, g and b are clipped to [0 ; 65535]
+    if (apply_look_table) {
+        float h, s, v;
+        Color::rgb2hsvdcp(r, g, b, h, s, v);
+
+        hsdApply(look_info, look_table, h, s, v);
+        s = LIM01(s);
+        v = LIM01(v);
+
+        // RT range correction
+        if (h < 0.0f) {
+            h += 6.0f;
+        } else if (h >= 6.0f) {
+            h -= 6.0f;
+        }
+
+        Color::hsv2rgbdcp(h, s, v, r, g, b);
+    }
+
+    if (use_tone_curve) {
+        tone_curve.Apply(r, g, b);
+    }
+}
+
+std::shared_ptr<const DCPLut> DCPProfile::getHueSatMapLut(const std::vector<HsbModify>& delta_base, size_t pixels) const
+{
+    // The LUT is indexed by the colour scaled to a max of 1, which only works if the map scales with the value. Maps
+    // with value divisions, or sRGB gamma encoded values, are applied as they are.
+    if (!settings->dcpBakedLuts || delta_info.val_divisions >= 2 || delta_info.srgb_gamma) {
+        return nullptr;
+    }
+
+    // The map depends on the white balance through the mix of the 2 maps of the profile
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (const auto& delta : delta_base) {
+        const float values[3] = {delta.hue_shift, delta.sat_scale, delta.val_scale};
+        const unsigned char* const bytes = reinterpret_cast<const unsigned char*>(values);
+
+        for (size_t i = 0; i < sizeof(values); ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    }
+
+    const std::string key = "hsm-" + std::to_string(hash);
+    std::shared_ptr<const DCPLut> lut = DCPStore::getInstance()->getLut(this, key);
+
+    // Baking costs about one evaluation of the map per node, and the map changes with each white balance. The LUT
+    // only pays off on images with many more pixels than nodes, i.e. the full size ones and the exports, the previews
+    // evaluate the map per pixel unless the LUT of their white balance is already there.
+    constexpr size_t min_pixels = 8 * DCPLut::size * DCPLut::size * DCPLut::size;
+
+    if (!lut && pixels >= min_pixels) {
+        const std::shared_ptr<DCPLut> new_lut(new DCPLut);
+
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+
+        for (int i = 0; i < DCPLut::size; ++i) {
+            for (int j = 0; j < DCPLut::size; ++j) {
+                for (int k = 0; k < DCPLut::size; ++k) {
+                    float r = 65535.f * i / (DCPLut::size - 1);
+                    float g = 65535.f * j / (DCPLut::size - 1);
+                    float b = 65535.f * k / (DCPLut::size - 1);
+                    hueSatMapApply(delta_base, r, g, b);
+
+                    float* const node = (*new_lut)(i, j, k);
+                    node[0] = r;
+                    node[1] = g;
+                    node[2] = b;
+                    node[3] = 0.f;
+                }
+            }
+        }
+
+        lut = new_lut;
+        DCPStore::getInstance()->putLut(this, key, lut);
+    }
+
+    return lut;
+}
+
+std::shared_ptr<const DCPLut> DCPProfile::getStep2Lut(bool apply_look_table, bool use_tone_curve) const
+{
+    if (!settings->dcpBakedLuts) {
+        return nullptr;
+    }
+
+    const std::string key = std::string("step2-") + (apply_look_table ? "look" : "") + (use_tone_curve ? "-tone" : "");
+    std::shared_ptr<const DCPLut> lut = DCPStore::getInstance()->getLut(this, key);
+
+    if (!lut) {
+        const std::shared_ptr<DCPLut> new_lut(new DCPLut);
+
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+
+        for (int i = 0; i < DCPLut::size; ++i) {
+            for (int j = 0; j < DCPLut::size; ++j) {
+                for (int k = 0; k < DCPLut::size; ++k) {
+                    float r = 65535.f * SQR(static_cast<float>(i) / (DCPLut::size - 1));
+                    float g = 65535.f * SQR(static_cast<float>(j) / (DCPLut::size - 1));
+                    float b = 65535.f * SQR(static_cast<float>(k) / (DCPLut::size - 1));
+                    step2Apply(apply_look_table, use_tone_curve, r, g, b);
+
+                    float* const node = (*new_lut)(i, j, k);
+                    node[0] = r;
+                    node[1] = g;
+                    node[2] = b;
+                    node[3] = 0.f;
+                }
+            }
+        }
+
+        lut = new_lut;
+        DCPStore::getInstance()->putLut(this, key, lut);
+    }
+
+    return lut;
+}
+
 DCPStore* DCPStore::getInstance()
 {
     static DCPStore instance;
@@ -1792,3 +2056,35 @@ DCPProfile* DCPStore::getStdProfile(const Glib::ustring& cam_short_name) const
 
     return nullptr;
 }
+
+std::shared_ptr<const DCPLut> DCPStore::getLut(const DCPProfile* profile, const std::string& key) const
+{
+    MyMutex::MyLock lock(lut_mutex);
+
+    for (auto entry = lut_cache.begin(); entry != lut_cache.end(); ++entry) {
+        if (std::get<0>(*entry) == profile && std::get<1>(*entry) == key) {
+            lut_cache.splice(lut_cache.begin(), lut_cache, entry);
+            return std::get<2>(lut_cache.front());
+        }
+    }
+
+    return nullptr;
+}
+
+void DCPStore::putLut(const DCPProfile* profile, const std::string& key, const std::shared_ptr<const DCPLut>& lut) const
+{
+    // The step 2 LUTs of a couple of profiles and the hue/sat map LUTs of the last white balances
+    constexpr std::size_t max_luts = 6;
+
+    MyMutex::MyLock lock(lut_mutex);
+
+    lut_cache.remove_if([profile, &key](const std::tuple<const DCPProfile*, std::string, std::shared_ptr<const DCPLut>>& entry) {
+        return std::get<0>(entry) == profile && std::get<1>(entry) == key;
+    });
+    lut_cache.emplace_front(profile, key, lut);
+
+    // the LUTs still used by an image are freed once it is done with them
+    while (lut_cache.size() > max_luts) {
+        lut_cache.pop_back();
+    }
+}
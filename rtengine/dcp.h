@@ -22,7 +22,10 @@
 #include <map>
 #include <vector>
 #include <array>
+#include <list>
 #include <memory>
+#include <string>
+#include <tuple>
 
 #include <glibmm.h>
 
@@ -36,6 +39,8 @@
 namespace rtengine
 {
 
+class DCPLut;
+
 class DCPProfile final
 {
 public:
@@ -120,6 +125,10 @@ private:
     Matrix makeXyzCam(const ColorTemp& white_balance, const Triple& pre_mul, const Matrix& cam_wb_matrix, int preferred_illuminant) const;
     std::vector<HsbModify> makeHueSatMap(const ColorTemp& white_balance, int preferred_illuminant) const;
     void hsdApply(const HsdTableInfo& table_info, const std::vector<HsbModify>& table_base, float& h, float& s, float& v) const;
+    void hueSatMapApply(const std::vector<HsbModify>& delta_base, float& r, float& g, float& b) const;
+    void step2Apply(bool apply_look_table, bool use_tone_curve, float& r, float& g, float& b) const;
+    std::shared_ptr<const DCPLut> getHueSatMapLut(const std::vector<HsbModify>& delta_base, size_t pixels) const;
+    std::shared_ptr<const DCPLut> getStep2Lut(bool apply_look_table, bool use_tone_curve) const;
 
     Matrix color_matrix_1;
     Matrix color_matrix_2;
@@ -159,16 +168,24 @@ public:
     DCPProfile* getProfile(const Glib::ustring& filename) const;
     DCPProfile* getStdProfile(const Glib::ustring& camShortName) const;
 
+    // The tables of the profiles baked into 3D LUTs, key identifies the tables and the white balance
+    std::shared_ptr<const DCPLut> getLut(const DCPProfile* profile, const std::string& key) const;
+    void putLut(const DCPProfile* profile, const std::string& key, const std::shared_ptr<const DCPLut>& lut) const;
+
 private:
     DCPStore() = default;
 
     mutable MyMutex mutex;
+    mutable MyMutex lut_mutex;
 
     // these contain standard profiles from RT. keys are all in uppercase, file path is value
     std::map<Glib::ustring, Glib::ustring> file_std_profiles;
 
     // Maps file name to profile as cache
     mutable std::map<Glib::ustring, DCPProfile*> profile_cache;
+
+    // The most recently used first, a few MiB each
+    mutable std::list<std::tuple<const DCPProfile*, std::string, std::shared_ptr<const DCPLut>>> lut_cache;
 };
 
 }
@@ -10,6 +10,7 @@
 /*RT*/#define LOCALTIME
 /*RT*/#define DJGPP
 /*RT*/#include "jpeg.h"
+/*RT*/#include <vector>
 
 #include "opthelper.h"
 
@@ -44,6 +45,7 @@
 #define _GNU_SOURCE
 #endif
 #define _USE_MATH_DEFINES
+#include <atomic>
 #include <cctype>
 #include <cerrno>
 #include <fcntl.h>
@@ -895,15 +897,176 @@ ushort * CLASS ljpeg_row (int jrow, struct jhead *jh)
   return row[2];
 }
 
+/*RT*/
+int CLASS ljpeg_decoder_t::start (struct jhead *jh)
+{
+  ushort c, tag, len;
+  const uchar *data, *dp;
+
+  memset (jh, 0, sizeof *jh);
+  jh->restart = INT_MAX;
+  if (end - pos < 2 || pos[1] != 0xd8) return 0;
+  pos += 2;
+  do {
+    if (end - pos < 4) return 0;
+    tag =  pos[0] << 8 | pos[1];
+    len = (pos[2] << 8 | pos[3]) - 2;
+    if (tag <= 0xff00 || end - pos - 4 < len) return 0;
+    data = pos + 4;
+    pos = data + len;
+    switch (tag) {
+      case 0xffc3:
+	jh->sraw = ((data[7] >> 4) * (data[7] & 15) - 1) & 3;
+      case 0xffc1:
+      case 0xffc0:
+	jh->algo = tag & 0xff;
+	jh->bits = data[0];
+	jh->high = data[1] << 8 | data[2];
+	jh->wide = data[3] << 8 | data[4];
+	jh->clrs = data[5] + jh->sraw;
+	if (len == 9 && !parent->dng_version && pos < end) pos++;
+	break;
+      case 0xffc4:
+	for (dp = data; dp < data+len && !((c = *dp++) & -20); )
+	  jh->free[c] = jh->huff[c] = parent->make_decoder_ref (&dp);
+	break;
+      case 0xffda:
+	jh->psv = data[1+data[0]*2];
+	jh->bits -= data[3+data[0]*2] & 15;
+	break;
+      case 0xffdb:
+	FORC(64) jh->quant[c] = data[c*2+1] << 8 | data[c*2+2];
+	break;
+      case 0xffdd:
+	jh->restart = data[0] << 8 | data[1];
+    }
+  } while (tag != 0xffda);
+  if (jh->bits > 16 || jh->clrs > 6 ||
+     !jh->bits || !jh->high || !jh->wide || !jh->clrs) return 0;
+  if (!jh->huff[0]) return 0;
+  FORC(19) if (!jh->huff[c+1]) jh->huff[c+1] = jh->huff[c];
+  if (jh->sraw) {
+    FORC(4)        jh->huff[2+c] = jh->huff[1];
+    FORC(jh->sraw) jh->huff[1+c] = jh->huff[0];
+  }
+  jh->row = (ushort *) calloc (2 * jh->wide*jh->clrs, 4);
+  parent->merror (jh->row, "ljpeg_decoder_t::start()");
+  return 1;
+}
+
+// loads whole bytes until 57 bits are available or a marker is reached
+inline void CLASS ljpeg_decoder_t::fill()
+{
+  while (vbits <= 56 && !reset && pos < end) {
+    uchar c = *pos;
+    if (c == 0xff) {
+      if (end - pos < 2 || pos[1]) {
+	reset = 1;
+	break;
+      }
+      pos += 2;
+    } else
+      pos++;
+    bitbuf = (bitbuf << 8) | c;
+    vbits += 8;
+  }
+}
+
+inline unsigned CLASS ljpeg_decoder_t::readbits (int nbits)
+{
+  unsigned c;
+
+  if (nbits <= 0 || vbits < 0) return 0;
+  if (vbits < nbits) fill();
+  if (LIKELY(vbits >= nbits))
+    c = (bitbuf >> (vbits - nbits)) & ((1u << nbits) - 1);
+  else
+    c = (bitbuf << (nbits - vbits)) & ((1u << nbits) - 1);
+  if ((vbits -= nbits) < 0) errors++;
+  return c;
+}
+
+// the tables of make_decoder() are indexed by the next huff[0] bits
+inline unsigned CLASS ljpeg_decoder_t::readhuff (ushort *huff)
+{
+  int nbits = huff[0];
+  unsigned c;
+
+  if (nbits <= 0 || vbits < 0) return 0;
+  if (vbits < nbits) fill();
+  if (LIKELY(vbits >= nbits))
+    c = (bitbuf >> (vbits - nbits)) & ((1u << nbits) - 1);
+  else
+    c = (bitbuf << (nbits - vbits)) & ((1u << nbits) - 1);
+  c = huff[c+1];
+  if ((vbits -= c >> 8) < 0) errors++;
+  return (uchar) c;
+}
+
+inline int CLASS ljpeg_decoder_t::decode_diff (ushort *huff)
+{
+  int len, diff;
+
+  len = readhuff(huff);
+  if (len == 16 && (!parent->dng_version || parent->dng_version >= 0x1010000))
+    return -32768;
+  diff = readbits(len);
+  if ((diff & (1 << (len-1))) == 0)
+    diff -= (1 << len) - 1;
+  return diff;
+}
+
+ushort * CLASS ljpeg_decoder_t::row (int jrow, struct jhead *jh)
+{
+  int col, c, diff, pred, spred=0;
+  ushort *row[3];
+
+  if (jrow * jh->wide % jh->restart == 0) {
+    FORC(6) jh->vpred[c] = 1 << (jh->bits-1);
+    if (jrow) {
+      // skip the padding up to the restart marker, fill() stops at its first byte
+      while (end - pos >= 2 && !(pos[0] == 0xff && pos[1] >> 4 == 0xd)) pos++;
+      pos = end - pos >= 2 ? pos + 2 : end;
+    }
+    bitbuf = vbits = reset = 0;
+  }
+  FORC3 row[c] = (jh->row + ((jrow & 1) + 1) * (jh->wide*jh->clrs*((jrow+c) & 1)));
+  for (col=0; col < jh->wide; col++)
+    FORC(jh->clrs) {
+      diff = decode_diff (jh->huff[c]);
+      if (jh->sraw && c <= jh->sraw && (col | c))
+		    pred = spred;
+      else if (col) pred = row[0][-jh->clrs];
+      else	    pred = (jh->vpred[c] += diff) - diff;
+      if (jh->psv != 1 && jrow && col) switch (jh->psv) {
+	case 2: pred = row[1][0];					break;
+	case 3: pred = row[1][-jh->clrs];				break;
+	case 4: pred = pred +   row[1][0] - row[1][-jh->clrs];		break;
+	case 5: pred = pred + ((row[1][0] - row[1][-jh->clrs]) >> 1);	break;
+	case 6: pred = row[1][0] + ((pred - row[1][-jh->clrs]) >> 1);	break;
+	case 7: pred = (pred + row[1][0]) >> 1;				break;
+	default: pred = 0;
+      }
+      if (UNLIKELY((**row = pred + diff) >> jh->bits)) errors++;
+      if (c <= jh->sraw) spred = **row;
+      row[0]++; row[1]++;
+    }
+  return row[2];
+}
+
 void CLASS lossless_jpeg_load_raw()
 {
   struct jhead jh;
   int row=0, col=0;
 
-  if (!ljpeg_start (&jh, 0)) return;
+/*RT*/  ljpeg_decoder_t decoder (this, fdata(ftell(ifp), ifp), fdata(ifp->size, ifp));
+  if (!decoder.start (&jh)) {
+    ljpeg_end (&jh);
+    return;
+  }
   int jwide = jh.wide * jh.clrs;
   ushort *rp[2];
-  rp[0] = ljpeg_row (0, &jh);
+  rp[0] = decoder.row (0, &jh);
 
   for (int jrow=0; jrow < jh.high; jrow++) {
 #ifdef _OPENMP
@@ -915,7 +1078,7 @@ void CLASS lossless_jpeg_load_raw()
 #endif
     {
         if(jrow < jh.high - 1)
-            rp[(jrow + 1)&1] = ljpeg_row (jrow + 1, &jh);
+            rp[(jrow + 1)&1] = decoder.row (jrow + 1, &jh);
     }
 #ifdef _OPENMP
      #pragma omp section
@@ -944,6 +1107,7 @@ void CLASS lossless_jpeg_load_raw()
     }
 }
   }
+  if (decoder.get_errors()) derror();
   ljpeg_end (&jh);
 }
 
@@ -1073,12 +1237,70 @@ void CLASS ljpeg_idct (struct jhead *jh)
   FORC(64) jh->idct[c] = CLIP(((float *)work[2])[c]+0.5);
 }
 
+/*RT*/
+/* The tiles are independent lossless JPEG streams, they are decoded in parallel.
+   Returns 0 if the sequential decoder has to be used, i.e. for lossy tiles. */
+int CLASS lossless_dng_load_tiles()
+{
+  struct dng_tile {
+    unsigned offset, row, col;
+  };
+  std::vector<dng_tile> tiles;
+  unsigned save = ftell(ifp), trow, tcol;
+  std::atomic<bool> lossy (false);
+  int errors = 0;
+
+  for (trow=tcol=0; trow < raw_height; ) {
+    tiles.push_back ({get4(), trow, tcol});
+    if ((tcol += tile_width) >= raw_width)
+      trow += tile_length + (tcol = 0);
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+:errors)
+#endif
+  for (int t=0; t < (int) tiles.size(); t++) {
+    struct jhead jh;
+    unsigned jwide, jrow, jcol, row, col;
+    ushort *rp;
+
+    if (lossy || tiles[t].offset >= (unsigned) ifp->size) continue;
+    ljpeg_decoder_t decoder (this, fdata(tiles[t].offset, ifp), fdata(ifp->size, ifp));
+    if (decoder.start (&jh)) {
+      if (jh.algo != 0xc3)
+	lossy = true;
+      else {
+	jwide = jh.wide;
+	if (filters) jwide *= jh.clrs;
+	jwide /= MIN (is_raw, tiff_samples);
+	for (row=col=jrow=0; jrow < jh.high; jrow++) {
+	  rp = decoder.row (jrow, &jh);
+	  for (jcol=0; jcol < jwide; jcol++) {
+	    adobe_copy_pixel (tiles[t].row+row, tiles[t].col+col, &rp);
+	    if (++col >= tile_width || col >= raw_width)
+	      row += 1 + (col = 0);
+	  }
+	}
+	errors += decoder.get_errors();
+      }
+    }
+    ljpeg_end (&jh);
+  }
+  if (lossy) {
+    fseek (ifp, save, SEEK_SET);
+    return 0;
+  }
+  if (errors) derror();
+  return 1;
+}
+
 void CLASS lossless_dng_load_raw()
 {
   unsigned save, trow=0, tcol=0, jwide, jrow, jcol, row, col, i, j;
   struct jhead jh;
   ushort *rp;
 
+/*RT*/  if (tile_length < INT_MAX && !sequential_dng_tiles && lossless_dng_load_tiles()) return;
   while (trow < raw_height) {
     save = ftell(ifp);
     if (tile_length < INT_MAX)
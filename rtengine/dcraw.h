@@ -22,6 +22,7 @@
 
 #include "myfile.h"
 #include <csetjmp>
+#include <cstdint>
 
 
 class DCraw
@@ -70,6 +71,11 @@ public:
     }
 
     //int main (int argc, const char **argv);
+
+    // Decodes the compressed RAF files with the former reader of the strips, which the tests compare the current one to
+    void setFujiReferenceReader (bool enable) { fuji_reference_reader = enable; }
+    // Decodes the lossless JPEG tiles of DNG files one after the other, which the tests compare the parallel decoder to
+    void setSequentialDngTiles (bool enable) { sequential_dng_tiles = enable; }
 protected:
     int exif_base, ciff_base, ciff_len;
     IMFILE *ifp;
@@ -118,11 +124,13 @@ protected:
     struct fuji_compressed_block {
         int         cur_bit;         // current bit being read (from left to right)
         int         cur_pos;         // current position in a buffer
+        int         cur_buf_size;    // size of the compressed data of the strip
+        uchar       *cur_buf;        // compressed data of the strip, followed by 8 zero bytes
+        // state of the reference reader, which refills a 64 KiB buffer and reads bit by bit
+        bool        reference_reader;
         INT64       cur_buf_offset;  // offset of this buffer in a file
-        unsigned	max_read_size;	 // Amount of data to be read
-        int         cur_buf_size;    // buffer size
-        uchar       *cur_buf;        // currently read block
-        int         fillbytes;          // Counter to add extra byte for block size N*16
+        unsigned    max_read_size;   // Amount of data to be read
+        int         fillbytes;       // Counter to add extra byte for block size N*16
         IMFILE      *input;
         struct int_pair grad_even[3][41];    // tables of gradients
         struct int_pair grad_odd[3][41];
@@ -131,6 +139,8 @@ protected:
     };
 
     int fuji_total_lines, fuji_total_blocks, fuji_block_width, fuji_bits, fuji_raw_type;
+    bool fuji_reference_reader = false;
+    bool sequential_dng_tiles = false;
 
     ushort raw_height, raw_width, height, width, top_margin, left_margin;
     ushort shrink, iheight, iwidth, fuji_width, thumb_width, thumb_height;
@@ -252,6 +262,27 @@ private:
 };
 getbithuff_t getbithuff;
 
+// lossless JPEG decoder reading from memory with its own state, so that the tiles of a DNG can be decoded in parallel
+class ljpeg_decoder_t
+{
+public:
+   ljpeg_decoder_t(DCraw *p, const uchar *data, const uchar *end):parent(p),pos(data),end(end),bitbuf(0),vbits(0),reset(0),errors(0){}
+   int start(struct jhead *jh);                 // like ljpeg_start()
+   ushort * row(int jrow, struct jhead *jh);    // like ljpeg_row()
+   int get_errors() const { return errors; }    // count of the derror() calls of the sequential decoder
+
+private:
+   void fill();
+   unsigned readbits(int nbits);
+   unsigned readhuff(ushort *huff);
+   int decode_diff(ushort *huff);
+
+   DCraw *parent;
+   const uchar *pos, *end;
+   UINT64 bitbuf;
+   int vbits, reset, errors;
+};
+
 ushort * make_decoder_ref (const uchar **source);
 ushort * make_decoder (const uchar *source);
 void crw_init_tables (unsigned table, ushort *huff[2]);
@@ -267,11 +298,16 @@ void ljpeg_idct (struct jhead *jh);
 
 void canon_sraw_load_raw();
 void adobe_copy_pixel (unsigned row, unsigned col, ushort **rp);
+int lossless_dng_load_tiles();
 void lossless_dng_load_raw();
 void packed_dng_load_raw();
 void deflate_dng_load_raw();
 void init_fuji_compr(struct fuji_compressed_params* info);
+uint64_t fuji_peek_bits(const struct fuji_compressed_block *info);
+void fuji_skip_bits(struct fuji_compressed_block *info, int count);
 void fuji_fill_buffer(struct fuji_compressed_block *info);
+void fuji_zerobits_reference(struct fuji_compressed_block* info, int *count);
+void fuji_read_code_reference(struct fuji_compressed_block* info, int *data, int bits_to_read);
 void init_fuji_block(struct fuji_compressed_block* info, const struct fuji_compressed_params *params, INT64 raw_offset, unsigned dsize);
 void copy_line_to_xtrans(struct fuji_compressed_block* info, int cur_line, int cur_block, int cur_block_width);
 void copy_line_to_bayer(struct fuji_compressed_block* info, int cur_line, int cur_block, int cur_block_width);
@@ -22,6 +22,7 @@
 #include "mytime.h"
 #include "refreshmap.h"
 #include "rt_math.h"
+#include "profiler.h"
 
 namespace
 {
@@ -43,7 +44,7 @@ extern const Settings* settings;
 Crop::Crop (ImProcCoordinator* parent, EditDataProvider *editDataProvider, bool isDetailWindow)
     : PipetteBuffer(editDataProvider), origCrop(nullptr), laboCrop(nullptr), labnCrop(nullptr),
       cropImg(nullptr), cbuf_real(nullptr), cshmap(nullptr), transCrop(nullptr), cieCrop(nullptr), cbuffer(nullptr),
-      updating(false), newUpdatePending(false), skip(10),
+      updating(false), newUpdatePending(false), abandonedTodo(0), skip(10),
       cropx(0), cropy(0), cropw(-1), croph(-1),
       trafx(0), trafy(0), trafw(-1), trafh(-1),
       rqcropx(0), rqcropy(0), rqcropw(-1), rqcroph(-1),
@@ -130,6 +131,7 @@ bool Crop::hasListener()
 void Crop::update (int todo)
 {
     MyMutex::MyLock cropLock(cropMutex);
+    ProfileStage totalStage ("Crop::update", "total");
 
     ProcParams& params = parent->params;
 //       CropGUIListener* cropgl;
@@ -159,6 +161,10 @@ void Crop::update (int todo)
         todo = ALL;
     }
 
+    // the buffers of the stages which have been cancelled are incomplete
+    todo |= abandonedTodo;
+    abandonedTodo = 0;
+
     // Tells to the ImProcFunctions' tool what is the preview scale, which may lead to some simplifications
     parent->ipf.setScale (skip);
 
@@ -657,6 +663,7 @@ void Crop::update (int todo)
                 int kall = 0;
 
                 float chaut, redaut, blueaut, maxredaut, maxblueaut, nresi, highresi;
+                ProfileStage denoiseStage ("Crop::update", "RGB_denoise");
                 parent->ipf.RGB_denoise(kall, origCrop, origCrop, calclum, parent->denoiseInfoStore.ch_M, parent->denoiseInfoStore.max_r, parent->denoiseInfoStore.max_b, parent->imgsrc->isRAW(), /*Roffset,*/ denoiseParams, parent->imgsrc->getDirPyrDenoiseExpComp(), noiseLCurve, noiseCCurve, chaut, redaut, blueaut, maxredaut, maxblueaut, nresi, highresi);
 
                 if (parent->adnListener) {
@@ -699,11 +706,12 @@ void Crop::update (int todo)
             transCrop = new Imagefloat (cropw, croph);
         }
 
-        if (needstransform)
+        if (needstransform) {
+            ProfileStage transformStage ("Crop::update", "transform");
             parent->ipf.transform (baseCrop, transCrop, cropx / skip, cropy / skip, trafx / skip, trafy / skip, skips(parent->fw, skip), skips(parent->fh, skip), parent->getFullWidth(), parent->getFullHeight(),
                                    parent->imgsrc->getMetaData()->getFocalLen(), parent->imgsrc->getMetaData()->getFocalLen35mm(),
                                    parent->imgsrc->getMetaData()->getFocusDist(), parent->imgsrc->getRotateDegree(), false);
-        else
+        } else
             baseCrop->copyData(transCrop);
 
         if (transCrop) {
@@ -718,7 +726,7 @@ void Crop::update (int todo)
     }
 
     if ((todo & (M_TRANSFORM | M_RGBCURVE))  && params.dirpyrequalizer.cbdlMethod == "bef" && params.dirpyrequalizer.enabled && !params.colorappearance.enabled) {
-
+        ProfileStage cbdlStage ("Crop::update", "dirpyrequalizer");
         const int W = baseCrop->getWidth();
         const int H = baseCrop->getHeight();
         LabImage labcbdl(W, H);
@@ -741,6 +749,7 @@ void Crop::update (int todo)
             cshmap = new SHMap (cropw, croph, true);
         }
 
+        ProfileStage shmapStage ("Crop::update", "shmap");
         cshmap->update (baseCrop, shradius, parent->ipf.lumimul, params.sh.hq, skip);
 
         if(parent->shmap->min_f < 65535.f) { // don't call forceStat with wrong values
@@ -768,6 +777,7 @@ void Crop::update (int todo)
         DCPProfile *dcpProf = parent->imgsrc->getDCP(params.icm, parent->currWB, as);
 
         LUTu histToneCurve;
+        ProfileStage rgbProcStage ("Crop::update", "rgbProc");
         parent->ipf.rgbProc (baseCrop, laboCrop, this, parent->hltonecurve, parent->shtonecurve, parent->tonecurve, cshmap,
                              params.toneCurve.saturation, parent->rCurve, parent->gCurve, parent->bCurve, parent->colourToningSatLimit , parent->colourToningSatLimitOpacity, parent->ctColorCurve, parent->ctOpacityCurve, parent->opautili, parent->clToningcurve, parent->cl2Toningcurve,
                              parent->customToneCurve1, parent->customToneCurve2, parent->beforeToneCurveBW, parent->afterToneCurveBW, rrm, ggm, bbm,
@@ -808,16 +818,23 @@ void Crop::update (int todo)
         LUTu dummy;
         int moderetinex;
         //    parent->ipf.MSR(labnCrop, labnCrop->W, labnCrop->H, 1);
+        ProfileStage labCurveStage ("Crop::update", "chromiLuminanceCurve");
         parent->ipf.chromiLuminanceCurve (this, 1, labnCrop, labnCrop, parent->chroma_acurve, parent->chroma_bcurve, parent->satcurve, parent->lhskcurve,  parent->clcurve, parent->lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+        labCurveStage.stop ();
+        ProfileStage vibranceStage ("Crop::update", "vibrance");
         parent->ipf.vibrance (labnCrop);
+        vibranceStage.stop ();
 
         if((params.colorappearance.enabled && !params.colorappearance.tonecie) ||  (!params.colorappearance.enabled)) {
+            ProfileStage epdStage ("Crop::update", "EPDToneMap");
             parent->ipf.EPDToneMap(labnCrop, 5, 1);
         }
 
         //parent->ipf.EPDToneMap(labnCrop, 5, 1);    //Go with much fewer than normal iterates for fast redisplay.
         // for all treatments Defringe, Sharpening, Contrast detail , Microcontrast they are activated if "CIECAM" function are disabled
         if (skip == 1) {
+            ProfileStage detailStage ("Crop::update", "detail");
+
             if((params.colorappearance.enabled && !settings->autocielab)  || (!params.colorappearance.enabled)) {
                 parent->ipf.impulsedenoise (labnCrop);
             }
@@ -839,6 +856,7 @@ void Crop::update (int todo)
 
         if(params.dirpyrequalizer.cbdlMethod == "aft") {
             if(((params.colorappearance.enabled && !settings->autocielab)  || (!params.colorappearance.enabled))) {
+                ProfileStage cbdlStage ("Crop::update", "dirpyrequalizer");
                 parent->ipf.dirpyrequalizer (labnCrop, skip);
                 //  parent->ipf.Lanczoslab (labnCrop,labnCrop , 1.f/skip);
             }
@@ -924,6 +942,7 @@ void Crop::update (int todo)
 
             params.wavelet.getCurves(wavCLVCurve, waOpacityCurveRG, waOpacityCurveBY, waOpacityCurveW, waOpacityCurveWL);
 
+            ProfileStage waveletStage ("Crop::update", "ip_wavelet");
             parent->ipf.ip_wavelet(labnCrop, labnCrop, kall, WaveParams, wavCLVCurve, waOpacityCurveRG, waOpacityCurveBY, waOpacityCurveW, waOpacityCurveWL, parent->wavclCurve, wavcontlutili, skip);
         }
 
@@ -958,6 +977,8 @@ void Crop::update (int todo)
                 cieCrop = new CieImage (cropw, croph);
             }
 
+            ProfileStage ciecamStage ("Crop::update", "ciecam");
+
             if(settings->ciecamfloat) {
                 float d; // not used after this block
                 parent->ipf.ciecam_02float (cieCrop, float(adap), begh, endh, 1, 2, labnCrop, &params, parent->customColCurve1, parent->customColCurve2, parent->customColCurve3,
@@ -982,9 +1003,14 @@ void Crop::update (int todo)
     PipetteBuffer::setReady();
 
     // Computing the preview image, i.e. converting from lab->Monitor color space (soft-proofing disabled) or lab->Output profile->Monitor color space (soft-proofing enabled)
+    ProfileStage monitorStage ("Crop::update", "lab2monitorRgb");
     parent->ipf.lab2monitorRgb (labnCrop, cropImg);
+    monitorStage.stop ();
 
-    if (cropImageListener) {
+    // an incomplete crop isn't shown, the cancelled update is done again
+    if (parent->ipf.isCancelled ()) {
+        abandonedTodo = todo;
+    } else if (cropImageListener) {
         // Computing the internal image for analysis, i.e. conversion from lab->Output profile (rtSettings.HistogramWorking disabled) or lab->WCS (rtSettings.HistogramWorking enabled)
 
         // internal image in output color space for analysis
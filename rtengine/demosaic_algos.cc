@@ -3714,6 +3714,7 @@ BENCHFUN
     int numTiles = wTiles * hTiles;
     int tilesDone = 0;
     constexpr int cldf = 2; // factor to multiply cache line distance. 1 = 64 bytes, 2 = 128 bytes ...
+    CancelCheck cancelCheck (cancelToken, "dcb_demosaic", numTiles);
 
 #ifdef _OPENMP
     #pragma omp parallel
@@ -3734,6 +3735,10 @@ BENCHFUN
 #endif
 
     for( int iTile = 0; iTile < numTiles; iTile++) {
+        if (cancelCheck.skip ()) {
+            continue;
+        }
+
         int xTile = iTile % wTiles;
         int yTile = iTile / wTiles;
         int x0 = xTile * TILESIZE;
@@ -0,0 +1,342 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "demosaiccache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <glib/gstdio.h>
+#include <zlib.h>
+
+#include "settings.h"
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+namespace
+{
+
+constexpr char fileMagic[4] = {'R', 'T', 'D', 'M'};
+constexpr uint32_t fileVersion = 1;
+constexpr int bandRows = 32;  // rows of a plane compressed together
+
+const Glib::ustring fileExtension = ".rtdm";
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t bandRows;
+};
+
+// The bytes of same significance of the floats are grouped, which makes the planes much more compressible
+void shuffle (const float* src, size_t n, unsigned char* dst)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*> (src);
+
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t k = 0; k < sizeof (float); ++k) {
+            dst[k * n + i] = bytes[i * sizeof (float) + k];
+        }
+    }
+}
+
+void unshuffle (const unsigned char* src, size_t n, float* dst)
+{
+    unsigned char* bytes = reinterpret_cast<unsigned char*> (dst);
+
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t k = 0; k < sizeof (float); ++k) {
+            bytes[i * sizeof (float) + k] = src[k * n + i];
+        }
+    }
+}
+
+}
+
+DemosaicCache* DemosaicCache::getInstance ()
+{
+    static DemosaicCache instance;
+    return &instance;
+}
+
+bool DemosaicCache::isEnabled () const
+{
+    return settings->demosaicCacheSize > 0 && !settings->demosaicCacheDir.empty ();
+}
+
+Glib::ustring DemosaicCache::getKey (const Glib::ustring& fname, const Glib::ustring& params) const
+{
+    GStatBuf fileStat;
+
+    if (g_stat (fname.c_str (), &fileStat) != 0) {
+        return {};
+    }
+
+    // like CacheManager::getMD5, the file is identified by its name and its size, plus its modification time
+    const auto identifier = Glib::ustring::compose ("%1%2-%3-%4", fname, static_cast<int64_t> (fileStat.st_size), static_cast<int64_t> (fileStat.st_mtime), params);
+    return Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, identifier);
+}
+
+Glib::ustring DemosaicCache::getFileName (const Glib::ustring& key) const
+{
+    return Glib::build_filename (settings->demosaicCacheDir, key + fileExtension);
+}
+
+bool DemosaicCache::load (const Glib::ustring& key, int W, int H, array2D<float>& red, array2D<float>& green, array2D<float>& blue)
+{
+    if (key.empty ()) {
+        return false;
+    }
+
+    const Glib::ustring fname = getFileName (key);
+    FILE* const f = g_fopen (fname.c_str (), "rb");
+
+    if (!f) {
+        return false;
+    }
+
+    FileHeader header;
+
+    if (fread (&header, sizeof (header), 1, f) != 1
+            || memcmp (header.magic, fileMagic, sizeof (fileMagic)) != 0 || header.version != fileVersion
+            || header.width != W || header.height != H || header.bandRows != bandRows) {
+        fclose (f);
+        return false;
+    }
+
+    red (W, H);
+    green (W, H);
+    blue (W, H);
+    float** const planes[3] = {red, green, blue};
+
+    const int numBands = (H + bandRows - 1) / bandRows;
+    bool truncated = false;  // only accessed in the ordered section
+    int failed = 0;
+
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+        std::vector<unsigned char> packed;
+        std::vector<unsigned char> shuffled (static_cast<size_t> (bandRows) * W * sizeof (float));
+
+#ifdef _OPENMP
+        #pragma omp for ordered schedule(static,1)
+#endif
+
+        for (int band = 0; band < 3 * numBands; ++band) {
+            bool read = false;
+
+#ifdef _OPENMP
+            #pragma omp ordered
+#endif
+            {
+                uint32_t size;
+
+                if (!truncated && fread (&size, sizeof (size), 1, f) == 1 && size <= compressBound (shuffled.size ())) {
+                    packed.resize (size);
+                    read = fread (packed.data (), 1, size, f) == size;
+                }
+
+                truncated = !read;
+            }
+
+            if (!read) {
+                continue;
+            }
+
+            float** const plane = planes[band / numBands];
+            const int row = (band % numBands) * bandRows;
+            const int rows = std::min (bandRows, H - row);
+            const size_t n = static_cast<size_t> (rows) * W;
+            uLongf length = n * sizeof (float);
+
+            if (uncompress (shuffled.data (), &length, packed.data (), packed.size ()) != Z_OK || length != n * sizeof (float)) {
+#ifdef _OPENMP
+                #pragma omp atomic
+#endif
+                failed++;
+                continue;
+            }
+
+            // the rows of array2D are contiguous
+            unshuffle (shuffled.data (), n, plane[row]);
+        }
+    }
+
+    fclose (f);
+
+    if (truncated || failed) {
+        if (settings->verbose) {
+            printf ("Demosaic cache: %s is damaged\n", fname.c_str ());
+        }
+
+        g_remove (fname.c_str ());
+        return false;
+    }
+
+    // the entry is the most recently used
+    g_utime (fname.c_str (), nullptr);
+    return true;
+}
+
+void DemosaicCache::store (const Glib::ustring& key, int W, int H, array2D<float>& red, array2D<float>& green, array2D<float>& blue)
+{
+    if (key.empty ()) {
+        return;
+    }
+
+    if (g_mkdir_with_parents (settings->demosaicCacheDir.c_str (), 511) != 0) {
+        return;
+    }
+
+    // written aside, so that concurrent readers never see a partial entry
+    const Glib::ustring fname = getFileName (key);
+    const Glib::ustring tmpName = Glib::ustring::compose ("%1.%2.tmp", fname, g_random_int ());
+    FILE* const f = g_fopen (tmpName.c_str (), "wb");
+
+    if (!f) {
+        return;
+    }
+
+    FileHeader header;
+    memcpy (header.magic, fileMagic, sizeof (fileMagic));
+    header.version = fileVersion;
+    header.width = W;
+    header.height = H;
+    header.bandRows = bandRows;
+
+    bool ok = fwrite (&header, sizeof (header), 1, f) == 1;
+
+    float** const planes[3] = {red, green, blue};
+    const int numBands = (H + bandRows - 1) / bandRows;
+
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+        std::vector<unsigned char> shuffled (static_cast<size_t> (bandRows) * W * sizeof (float));
+        std::vector<unsigned char> packed (compressBound (shuffled.size ()));
+
+#ifdef _OPENMP
+        #pragma omp for ordered schedule(static,1)
+#endif
+
+        for (int band = 0; band < 3 * numBands; ++band) {
+            float** const plane = planes[band / numBands];
+            const int row = (band % numBands) * bandRows;
+            const int rows = std::min (bandRows, H - row);
+            const size_t n = static_cast<size_t> (rows) * W;
+
+            shuffle (plane[row], n, shuffled.data ());
+            uLongf length = packed.size ();
+            const bool compressed = compress2 (packed.data (), &length, shuffled.data (), n * sizeof (float), 1) == Z_OK;
+
+#ifdef _OPENMP
+            #pragma omp ordered
+#endif
+            {
+                if (ok && compressed) {
+                    const uint32_t size = length;
+                    ok = fwrite (&size, sizeof (size), 1, f) == 1 && fwrite (packed.data (), 1, length, f) == length;
+                } else {
+                    ok = false;
+                }
+            }
+        }
+    }
+
+    if (fclose (f) != 0) {
+        ok = false;
+    }
+
+    if (!ok || g_rename (tmpName.c_str (), fname.c_str ()) != 0) {
+        g_remove (tmpName.c_str ());
+        return;
+    }
+
+    trim ();
+}
+
+void DemosaicCache::trim ()
+{
+    MyMutex::MyLock lock (mutex);
+
+    struct Entry {
+        Glib::ustring name;
+        int64_t size;
+        time_t time;
+    };
+
+    std::vector<Entry> entries;
+    int64_t total = 0;
+
+    try {
+        Glib::Dir dir (settings->demosaicCacheDir);
+
+        for (Glib::DirIterator entry = dir.begin (); entry != dir.end (); ++entry) {
+            const Glib::ustring name = *entry;
+
+            if (name.size () <= fileExtension.size () || name.substr (name.size () - fileExtension.size ()) != fileExtension) {
+                continue;
+            }
+
+            const Glib::ustring path = Glib::build_filename (settings->demosaicCacheDir, name);
+            GStatBuf fileStat;
+
+            if (g_stat (path.c_str (), &fileStat) == 0) {
+                entries.push_back ({path, static_cast<int64_t> (fileStat.st_size), fileStat.st_mtime});
+                total += fileStat.st_size;
+            }
+        }
+    } catch (Glib::Exception&) {
+        return;
+    }
+
+    const int64_t budget = static_cast<int64_t> (settings->demosaicCacheSize) << 20;
+
+    if (total <= budget) {
+        return;
+    }
+
+    std::sort (entries.begin (), entries.end (), [] (const Entry & a, const Entry & b) {
+        return a.time < b.time;
+    });
+
+    for (const auto& entry : entries) {
+        if (total <= budget) {
+            break;
+        }
+
+        if (g_remove (entry.name.c_str ()) == 0) {
+            total -= entry.size;
+
+            if (settings->verbose) {
+                printf ("Demosaic cache: removed %s\n", entry.name.c_str ());
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,63 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <glibmm.h>
+
+#include "array2D.h"
+#include "noncopyable.h"
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+/** On-disk cache of the demosaiced red, green and blue planes of the raw files.
+  *
+  * The entries are stored in settings->demosaicCacheDir, one file per raw file and set of parameters, the planes
+  * being compressed by bands of rows in parallel. The least recently used entries are removed once the size of
+  * the directory exceeds settings->demosaicCacheSize MiB; a size of 0 disables the cache.
+  */
+class DemosaicCache :
+    public NonCopyable
+{
+public:
+    static DemosaicCache* getInstance ();
+
+    bool isEnabled () const;
+
+    /** @param fname is the raw file
+      * @param params identifies the content of the planes, i.e. the preprocessing and the demosaic parameters
+      * @return the key of the entry, empty if the file can't be identified */
+    Glib::ustring getKey (const Glib::ustring& fname, const Glib::ustring& params) const;
+
+    /** Reads the planes of an entry, they are resized to W x H.
+      * @return true if the entry was found and read completely */
+    bool load (const Glib::ustring& key, int W, int H, array2D<float>& red, array2D<float>& green, array2D<float>& blue);
+
+    /** Writes the planes of an entry and trims the cache to its size */
+    void store (const Glib::ustring& key, int W, int H, array2D<float>& red, array2D<float>& green, array2D<float>& blue);
+
+private:
+    DemosaicCache () = default;
+
+    Glib::ustring getFileName (const Glib::ustring& key) const;
+    void trim ();
+
+    MyMutex mutex;  // serializes the trimming of the directory
+};
+
+}
@@ -21,6 +21,7 @@
 #include <giomm.h>
 #include "../rtgui/guiutils.h"
 #include "rawimage.h"
+#include "framestacker.h"
 #include <sstream>
 #include <iostream>
 #include <cstdio>
@@ -48,6 +49,8 @@ inline dfInfo& dfInfo::operator =(const dfInfo &o)
             delete ri;
             ri = nullptr;
         }
+
+        master.reset();
     }
 
     return *this;
@@ -112,7 +115,6 @@ RawImage* dfInfo::getRawImage()
     }
 
     updateRawImage();
-    updateBadPixelList( ri );
 
     return ri;
 }
@@ -121,81 +123,39 @@ std::vector<badPix>& dfInfo::getHotPixels()
 {
     if( !ri ) {
         updateRawImage();
-        updateBadPixelList( ri );
     }
 
     return badPixels;
 }
 /* updateRawImage() load into ri the actual pixel data from pathname if there is a single shot
- * otherwise load each file from the pathNames list and extract a template from the media;
- * the first file is used also for reading all information other than pixels
+ * otherwise load each file from the pathNames list and extract a template from them (see framestacker.h);
+ * the first file is used also for reading all information other than pixels.
+ * The templates are kept in the master frame cache with their hot pixels, and mapped from it the next times.
  */
 void dfInfo::updateRawImage()
 {
-    typedef unsigned int acc_t;
-
     if( !pathNames.empty() ) {
-        std::list<Glib::ustring>::iterator iName = pathNames.begin();
-        ri = new RawImage(*iName); // First file used also for extra pixels informations (width,height, shutter, filters etc.. )
-
-        if( ri->loadRaw(true)) {
-            delete ri;
-            ri = nullptr;
-        } else {
-            int H = ri->get_height();
-            int W = ri->get_width();
-            ri->compress_image();
-            int rSize = W * ((ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS) ? 1 : 3);
-            acc_t **acc = new acc_t*[H];
-
-            for( int row = 0; row < H; row++) {
-                acc[row] = new acc_t[rSize ];
-            }
-
-            // copy first image into accumulators
-            for (int row = 0; row < H; row++)
-                for (int col = 0; col < rSize; col++) {
-                    acc[row][col] = ri->data[row][col];
-                }
+        MasterFrameCache* masterCache = MasterFrameCache::getInstance();
+        // the groups of the same key are told apart by their timestamp
+        const Glib::ustring cacheKey = masterCache->getKey("df", key() + " " + std::to_string(timestamp), pathNames, std::to_string(settings->masterFrameStacking));
+        master = masterCache->load(cacheKey);
 
-            int nFiles = 1; // First file data already loaded
-
-            for( ++iName; iName != pathNames.end(); ++iName) {
-                RawImage* temp = new RawImage(*iName);
-
-                if( !temp->loadRaw(true)) {
-                    temp->compress_image();     //\ TODO would be better working on original, because is temporary
-                    nFiles++;
-
-                    if( ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS ) {
-                        for( int row = 0; row < H; row++) {
-                            for( int col = 0; col < W; col++) {
-                                acc[row][col] += temp->data[row][col];
-                            }
-                        }
-                    } else {
-                        for( int row = 0; row < H; row++) {
-                            for( int col = 0; col < W; col++) {
-                                acc[row][3 * col + 0] += temp->data[row][3 * col + 0];
-                                acc[row][3 * col + 1] += temp->data[row][3 * col + 1];
-                                acc[row][3 * col + 2] += temp->data[row][3 * col + 2];
-                            }
-                        }
-                    }
-                }
+        if( master ) {
+            ri = master->createRawImage(pathNames.front());
 
-                delete temp;
+            if( ri ) {
+                badPixels = master->getHotPixels();
+                return;
             }
 
-            for (int row = 0; row < H; row++) {
-                for (int col = 0; col < rSize; col++) {
-                    ri->data[row][col] = acc[row][col] / nFiles;
-                }
+            master.reset();
+        }
 
-                delete [] acc[row];
-            }
+        ri = stackRawFrames(pathNames, static_cast<StackingMethod>(settings->masterFrameStacking));
 
-            delete [] acc;
+        if( ri ) {
+            updateBadPixelList( ri );
+            masterCache->store(cacheKey, ri, badPixels);
         }
     } else {
         ri = new RawImage(pathname);
@@ -205,6 +165,7 @@ void dfInfo::updateRawImage()
             ri = nullptr;
         } else {
             ri->compress_image();
+            updateBadPixelList( ri );
         }
     }
 }
@@ -314,7 +275,7 @@ void DFManager::init( Glib::ustring pathname )
             if( !i.pathname.empty() ) {
                 printf( "%s:  %s\n", i.key().c_str(), i.pathname.c_str());
             } else {
-                printf( "%s: MEAN of \n    ", i.key().c_str());
+                printf( "%s: STACK of \n    ", i.key().c_str());
 
                 for( std::list<Glib::ustring>::iterator iter = i.pathNames.begin(); iter != i.pathNames.end(); ++iter  ) {
                     printf( "%s, ", iter->c_str() );
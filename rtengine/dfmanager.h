@@ -20,7 +20,9 @@
 #include <glibmm/ustring.h>
 #include <map>
 #include <cmath>
+#include <memory>
 #include "rawimage.h"
+#include "masterframecache.h"
 
 namespace rtengine
 {
@@ -69,6 +71,7 @@ public:
 protected:
     RawImage *ri; ///< Dark Frame raw data
     std::vector<badPix> badPixels; ///< Extracted hot pixels
+    std::unique_ptr<MasterFrame> master; ///< Average of pathNames mapped from the cache, holds the pixels of ri
 
     void updateBadPixelList( RawImage *df );
     void updateRawImage();
@@ -0,0 +1,22 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// The log and exp passes of the edge preserving decomposition for AVX-512F, compiled with -mavx512f -mfma (see
+// rtengine/CMakeLists.txt and cpudispatch.h)
+#define RT_SIMD_WIDTH 16
+#define RT_SIMD_NAMESPACE avx512
+
+#include "epd_simd_impl.h"
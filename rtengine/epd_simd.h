@@ -0,0 +1,37 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+namespace rtengine
+{
+
+// The log and exp passes of EdgePreservingDecomposition::CompressDynamicRange compiled for each instruction set of
+// cpudispatch.h, see epd_simd_impl.h. They have to be called by all the threads of a parallel region, or outside of
+// any.
+namespace avx2
+{
+void epdLog (float* source, float eps, int n);
+void epdUnlog (float* source, const float* u, float* compressed, float eps, float compression, float detailBoost, int n);
+}
+
+namespace avx512
+{
+void epdLog (float* source, float eps, int n);
+void epdUnlog (float* source, const float* u, float* compressed, float eps, float compression, float detailBoost, int n);
+}
+
+}
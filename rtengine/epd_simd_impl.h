@@ -0,0 +1,106 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The log and exp passes of EdgePreservingDecomposition::CompressDynamicRange with the xlogf and xexpf of
+// sleef_simd_impl.h. It is included by epd_avx2.cc and epd_avx512.cc, which define RT_SIMD_WIDTH and RT_SIMD_NAMESPACE.
+
+#include "epd_simd.h"
+#include "sleef_simd_impl.h"
+
+namespace rtengine
+{
+
+namespace RT_SIMD_NAMESPACE
+{
+
+using namespace sleef;
+
+void epdLog (float* source, float eps, int n)
+{
+    const vfloatN epsv = broadcast (eps);
+
+#ifdef _OPENMP
+    #pragma omp for
+#endif
+
+    for (int i = 0; i < n - (N - 1); i += N) {
+        store (&source[i], xlogf (load (&source[i]) + epsv));
+    }
+
+    // the remaining values go through the same code, so that they don't depend on the sse or scalar versions
+#ifdef _OPENMP
+    #pragma omp single
+#endif
+    {
+        const int start = n - n % N;
+
+        if (start < n) {
+            float tail[N] = {};
+            memcpy (tail, &source[start], (n - start) * sizeof (float));
+            store (tail, xlogf (load (tail) + epsv));
+            memcpy (&source[start], tail, (n - start) * sizeof (float));
+        }
+    }
+}
+
+void epdUnlog (float* source, const float* u, float* compressed, float eps, float compression, float detailBoost, int n)
+{
+    const vfloatN epsv = broadcast (eps);
+    const vfloatN compressionv = broadcast (compression);
+    const vfloatN detailBoostv = broadcast (detailBoost);
+
+    const auto unlog = [&] (float* src, const float* uu, float* dst) {
+        const vfloatN sourcev = load (src);
+        const vfloatN uv = load (uu);
+        const vfloatN cev = xexpf (sourcev + uv * compressionv) - epsv;
+        const vfloatN uev = xexpf (uv) - epsv;
+        const vfloatN expv = xexpf (sourcev) - epsv;
+        store (src, expv);
+        // compressed may be u
+        store (dst, cev + detailBoostv * (expv - uev));
+    };
+
+#ifdef _OPENMP
+    #pragma omp for
+#endif
+
+    for (int i = 0; i < n - (N - 1); i += N) {
+        unlog (&source[i], &u[i], &compressed[i]);
+    }
+
+#ifdef _OPENMP
+    #pragma omp single
+#endif
+    {
+        const int start = n - n % N;
+
+        if (start < n) {
+            float tailSource[N] = {};
+            float tailU[N] = {};
+            float tailCompressed[N];
+            memcpy (tailSource, &source[start], (n - start) * sizeof (float));
+            memcpy (tailU, &u[start], (n - start) * sizeof (float));
+            unlog (tailSource, tailU, tailCompressed);
+            memcpy (&source[start], tailSource, (n - start) * sizeof (float));
+            memcpy (&compressed[start], tailCompressed, (n - start) * sizeof (float));
+        }
+    }
+}
+
+}
+
+}
@@ -19,6 +19,7 @@
 #include "ffmanager.h"
 #include "../rtgui/options.h"
 #include "rawimage.h"
+#include "framestacker.h"
 #include "imagedata.h"
 #include "median.h"
 
@@ -44,6 +45,8 @@ inline ffInfo& ffInfo::operator =(const ffInfo &o)
             delete ri;
             ri = nullptr;
         }
+
+        master.reset();
     }
 
     return *this;
@@ -118,78 +121,33 @@ RawImage* ffInfo::getRawImage()
 }
 
 /* updateRawImage() load into ri the actual pixel data from pathname if there is a single shot
- * otherwise load each file from the pathNames list and extract a template from the media;
- * the first file is used also for reading all information other than pixels
+ * otherwise load each file from the pathNames list and extract a template from them (see framestacker.h);
+ * the first file is used also for reading all information other than pixels.
+ * The templates are kept in the master frame cache once filtered, and mapped from it the next times.
  */
 void ffInfo::updateRawImage()
 {
-    typedef unsigned int acc_t;
+    MasterFrameCache* masterCache = MasterFrameCache::getInstance();
+    Glib::ustring cacheKey;
 
-    // averaging of flatfields if more than one is found matching the same key.
+    // combination of flatfields if more than one is found matching the same key.
     // this may not be necessary, as flatfield is further blurred before being applied to the processed image.
     if( !pathNames.empty() ) {
-        std::list<Glib::ustring>::iterator iName = pathNames.begin();
-        ri = new RawImage(*iName); // First file used also for extra pixels informations (width,height, shutter, filters etc.. )
+        // the groups of the same key are told apart by their timestamp
+        cacheKey = masterCache->getKey("ff", key() + " " + std::to_string(timestamp), pathNames, std::to_string(settings->masterFrameStacking));
+        master = masterCache->load(cacheKey);
 
-        if( ri->loadRaw(true)) {
-            delete ri;
-            ri = nullptr;
-        } else {
-            int H = ri->get_height();
-            int W = ri->get_width();
-            ri->compress_image();
-            int rSize = W * ((ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS) ? 1 : 3);
-            acc_t **acc = new acc_t*[H];
+        if( master ) {
+            ri = master->createRawImage(pathNames.front());
 
-            for( int row = 0; row < H; row++) {
-                acc[row] = new acc_t[rSize ];
+            if( ri ) {
+                return;
             }
 
-            // copy first image into accumulators
-            for (int row = 0; row < H; row++)
-                for (int col = 0; col < rSize; col++) {
-                    acc[row][col] = ri->data[row][col];
-                }
-
-            int nFiles = 1; // First file data already loaded
-
-            for( ++iName; iName != pathNames.end(); ++iName) {
-                RawImage* temp = new RawImage(*iName);
-
-                if( !temp->loadRaw(true)) {
-                    temp->compress_image();     //\ TODO would be better working on original, because is temporary
-                    nFiles++;
-
-                    if( ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS ) {
-                        for( int row = 0; row < H; row++) {
-                            for( int col = 0; col < W; col++) {
-                                acc[row][col] += temp->data[row][col];
-                            }
-                        }
-                    } else {
-                        for( int row = 0; row < H; row++) {
-                            for( int col = 0; col < W; col++) {
-                                acc[row][3 * col + 0] += temp->data[row][3 * col + 0];
-                                acc[row][3 * col + 1] += temp->data[row][3 * col + 1];
-                                acc[row][3 * col + 2] += temp->data[row][3 * col + 2];
-                            }
-                        }
-                    }
-                }
-
-                delete temp;
-            }
-
-            for (int row = 0; row < H; row++) {
-                for (int col = 0; col < rSize; col++) {
-                    ri->data[row][col] = acc[row][col] / nFiles;
-                }
-
-                delete [] acc[row];
-            }
-
-            delete [] acc;
+            master.reset();
         }
+
+        ri = stackRawFrames(pathNames, static_cast<StackingMethod>(settings->masterFrameStacking));
     } else {
         ri = new RawImage(pathname);
 
@@ -227,6 +185,8 @@ void ffInfo::updateRawImage()
 
         free (cfatmp);
 
+        // the key is empty for a single shot, which isn't cached
+        masterCache->store(cacheKey, ri, {});
     }
 }
 
@@ -273,7 +233,7 @@ void FFManager::init( Glib::ustring pathname )
             if( !i.pathname.empty() ) {
                 printf( "%s:  %s\n", i.key().c_str(), i.pathname.c_str());
             } else {
-                printf( "%s: MEAN of \n    ", i.key().c_str());
+                printf( "%s: STACK of \n    ", i.key().c_str());
 
                 for( std::list<Glib::ustring>::iterator iter = i.pathNames.begin(); iter != i.pathNames.end(); ++iter  ) {
                     printf( "%s, ", iter->c_str() );
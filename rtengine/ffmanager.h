@@ -20,7 +20,9 @@
 #include <glibmm/ustring.h>
 #include <map>
 #include <cmath>
+#include <memory>
 #include "rawimage.h"
+#include "masterframecache.h"
 
 namespace rtengine
 {
@@ -68,6 +70,7 @@ public:
 
 protected:
     RawImage *ri; ///< Flat Field raw data
+    std::unique_ptr<MasterFrame> master; ///< Average of pathNames mapped from the cache, holds the pixels of ri
 
     void updateRawImage();
 };
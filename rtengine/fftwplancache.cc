@@ -0,0 +1,131 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "fftwplancache.h"
+
+#include <cstdio>
+
+#include <glib/gstdio.h>
+
+#include "settings.h"
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+FftwPlanCache* FftwPlanCache::getInstance ()
+{
+    static FftwPlanCache instance;
+    return &instance;
+}
+
+FftwPlanCache::FftwPlanCache () :
+    wisdomChanged (false)
+{
+}
+
+void FftwPlanCache::init ()
+{
+    if (!settings->fftwWisdom || settings->fftwWisdomFile.empty ()) {
+        return;
+    }
+
+    MyMutex::MyLock lock (mutex);
+
+    FILE* file = g_fopen (settings->fftwWisdomFile.c_str (), "r");
+
+    if (!file) {
+        return;
+    }
+
+    // the wisdom of an other version of FFTW or of an other machine is rejected, or at worst gives slower plans
+    if (!fftwf_import_wisdom_from_file (file) && settings->verbose) {
+        printf ("Can't read the FFTW wisdom from %s\n", settings->fftwWisdomFile.c_str ());
+    }
+
+    fclose (file);
+}
+
+void FftwPlanCache::cleanup ()
+{
+    MyMutex::MyLock lock (mutex);
+
+    if (wisdomChanged && settings->fftwWisdom && !settings->fftwWisdomFile.empty ()) {
+        // written to a temporary file first, a partial file would be rejected at the next start
+        const Glib::ustring tmpFileName = settings->fftwWisdomFile + ".tmp";
+        FILE* file = g_fopen (tmpFileName.c_str (), "w");
+        bool written = false;
+
+        if (file) {
+            fftwf_export_wisdom_to_file (file);
+            written = !ferror (file);
+            written = fclose (file) == 0 && written;
+        }
+
+        if (!written || g_rename (tmpFileName.c_str (), settings->fftwWisdomFile.c_str ()) != 0) {
+            g_remove (tmpFileName.c_str ());
+
+            if (settings->verbose) {
+                printf ("Can't write the FFTW wisdom to %s\n", settings->fftwWisdomFile.c_str ());
+            }
+        }
+    }
+
+    for (const auto& plan : plans) {
+        fftwf_destroy_plan (plan.second);
+    }
+
+    plans.clear ();
+    wisdomChanged = false;
+    fftwf_cleanup ();
+}
+
+fftwf_plan FftwPlanCache::getManyR2r (int n0, int n1, int howmany, fftw_r2r_kind kind)
+{
+    MyMutex::MyLock lock (mutex);
+
+    const Key key (n0, n1, howmany, kind);
+    const auto iterator = plans.find (key);
+
+    if (iterator != plans.end ()) {
+        return iterator->second;
+    }
+
+    // measuring overwrites the arrays, they are only needed to get the alignment of the ones of the callers
+    const int size = n0 * n1;
+    float* in = static_cast<float*> (fftwf_malloc (static_cast<size_t> (howmany) * size * sizeof (float)));
+    float* out = static_cast<float*> (fftwf_malloc (static_cast<size_t> (howmany) * size * sizeof (float)));
+
+    const int n[2] = {n0, n1};
+    const fftw_r2r_kind kinds[2] = {kind, kind};
+
+    // the plans of the wisdom are used as is, only the new ones are measured
+    fftwf_plan plan = fftwf_plan_many_r2r (2, n, howmany, in, nullptr, 1, size, out, nullptr, 1, size, kinds, FFTW_WISDOM_ONLY | FFTW_MEASURE | FFTW_DESTROY_INPUT);
+
+    if (!plan) {
+        plan = fftwf_plan_many_r2r (2, n, howmany, in, nullptr, 1, size, out, nullptr, 1, size, kinds, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+        wisdomChanged = true;
+    }
+
+    fftwf_free (in);
+    fftwf_free (out);
+
+    plans.emplace (key, plan);
+    return plan;
+}
+
+}
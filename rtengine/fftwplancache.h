@@ -0,0 +1,65 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <map>
+#include <tuple>
+
+#include <fftw3.h>
+#include <glibmm.h>
+
+#include "noncopyable.h"
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+/** Process-wide cache of the FFTW plans.
+  *
+  * Measuring a plan takes much longer than executing it, so the plans are made once per transform and kept until
+  * cleanup(). The wisdom of the planner is read from settings->fftwWisdomFile by init() and written back by
+  * cleanup() if new plans were measured, so that they are measured once per machine rather than once per run.
+  *
+  * The plans are single-threaded, they can be executed by several threads at once with the new-array execute
+  * functions on arrays allocated by fftwf_malloc(). They must not be destroyed by the callers.
+  */
+class FftwPlanCache :
+    public NonCopyable
+{
+public:
+    static FftwPlanCache* getInstance ();
+
+    void init ();
+    /** Destroys the plans and saves the wisdom */
+    void cleanup ();
+
+    /** @return a plan of howmany contiguous 2D real-to-real transforms of n0 x n1 floats of the same kind along
+      * both dimensions, from an array to another one */
+    fftwf_plan getManyR2r (int n0, int n1, int howmany, fftw_r2r_kind kind);
+
+private:
+    // n0, n1, howmany, kind
+    typedef std::tuple<int, int, int, int> Key;
+
+    FftwPlanCache ();
+
+    MyMutex mutex;  // the planner isn't thread-safe
+    std::map<Key, fftwf_plan> plans;
+    bool wisdomChanged;
+};
+
+}
@@ -0,0 +1,254 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "flatfieldmaps.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include <glib/gstdio.h>
+
+#include "rawimage.h"
+#include "rt_math.h"
+#include "settings.h"
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+namespace
+{
+
+constexpr size_t maxEntries = 2;        // the maps of a 24 MPix flat field take 100 to 200 MiB
+constexpr size_t maxDiskEntries = 8;    // the maps change with each blur radius tried in the editor
+
+constexpr char fileMagic[4] = {'R', 'T', 'F', 'M'};
+constexpr uint32_t fileVersion = 1;
+
+const std::string fileExtension = ".rtfm";
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    uint32_t hasLines;
+};
+
+std::string getFileName (const std::string& key)
+{
+    return Glib::build_filename (settings->masterFrameCacheDir, Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, key) + fileExtension);
+}
+
+// keeps the most recent files
+void trimDirectory ()
+{
+    std::vector<std::pair<time_t, std::string>> files;
+
+    try {
+        Glib::Dir dir (settings->masterFrameCacheDir);
+
+        for (const auto& entry : dir) {
+            if (entry.size () > fileExtension.size () && entry.compare (entry.size () - fileExtension.size (), fileExtension.size (), fileExtension) == 0) {
+                const std::string fname = Glib::build_filename (settings->masterFrameCacheDir, entry);
+                GStatBuf fileStat;
+
+                if (g_stat (fname.c_str (), &fileStat) == 0) {
+                    files.emplace_back (fileStat.st_mtime, fname);
+                }
+            }
+        }
+    } catch (const Glib::Error&) {
+        return;
+    }
+
+    if (files.size () <= maxDiskEntries) {
+        return;
+    }
+
+    std::sort (files.begin (), files.end ());
+
+    for (size_t i = 0; i < files.size () - maxDiskEntries; ++i) {
+        g_remove (files[i].second.c_str ());
+    }
+}
+
+}
+
+FlatFieldMapCache* FlatFieldMapCache::getInstance ()
+{
+    static FlatFieldMapCache instance;
+    return &instance;
+}
+
+std::string FlatFieldMapCache::getKey (RawImage* flatField, RawImage* image, int width, int height, const Glib::ustring& blurType, int blurRadius, const unsigned short black[4]) const
+{
+    // a flat field combined from several files is named after the first one, a sample of its pixels tells them apart
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (int row = 0; row < height; row += max (1, height / 64)) {
+        for (int col = 0; col < width; col += max (1, width / 64)) {
+            uint32_t bits;
+            memcpy (&bits, &flatField->data[row][col], sizeof (bits));
+            hash = (hash ^ bits) * 0x100000001b3ULL;
+        }
+    }
+
+    char xtransMatrix[6][6];
+    image->getXtransMatrix (xtransMatrix);
+
+    std::ostringstream s;
+    s << flatField->get_filename () << '|' << hash << '|' << width << 'x' << height << '|' << blurType << '|' << blurRadius << '|'
+      << black[0] << ' ' << black[1] << ' ' << black[2] << ' ' << black[3] << '|' << image->get_filters () << '|'
+      << std::string (&xtransMatrix[0][0], sizeof (xtransMatrix));
+    return s.str ();
+}
+
+std::shared_ptr<const FlatFieldMaps> FlatFieldMapCache::get (const std::string& key)
+{
+    {
+        MyMutex::MyLock lock (mutex);
+
+        for (auto entry = entries.begin (); entry != entries.end (); ++entry) {
+            if (entry->first == key) {
+                entries.splice (entries.begin (), entries, entry);
+                return entries.front ().second;
+            }
+        }
+    }
+
+    if (!settings->flatFieldMapsOnDisk) {
+        return nullptr;
+    }
+
+    // read outside of the lock, the other images don't wait for it
+    const auto maps = load (key);
+
+    if (maps) {
+        MyMutex::MyLock lock (mutex);
+        add (key, maps);
+    }
+
+    return maps;
+}
+
+void FlatFieldMapCache::put (const std::string& key, const std::shared_ptr<const FlatFieldMaps>& maps)
+{
+    {
+        MyMutex::MyLock lock (mutex);
+        add (key, maps);
+    }
+
+    if (settings->flatFieldMapsOnDisk) {
+        store (key, *maps);
+    }
+}
+
+void FlatFieldMapCache::add (const std::string& key, const std::shared_ptr<const FlatFieldMaps>& maps)
+{
+    entries.remove_if ([&key] (const std::pair<std::string, std::shared_ptr<const FlatFieldMaps>>& entry) {
+        return entry.first == key;
+    });
+    entries.emplace_front (key, maps);
+
+    // the maps still used by an image are freed once it is done with them
+    while (entries.size () > maxEntries) {
+        entries.pop_back ();
+    }
+}
+
+std::shared_ptr<const FlatFieldMaps> FlatFieldMapCache::load (const std::string& key) const
+{
+    const std::string fname = getFileName (key);
+    FILE* const f = g_fopen (fname.c_str (), "rb");
+
+    if (!f) {
+        return nullptr;
+    }
+
+    FileHeader header;
+
+    if (fread (&header, sizeof (header), 1, f) != 1 || memcmp (header.magic, fileMagic, sizeof (fileMagic)) != 0
+            || header.version != fileVersion || header.width <= 0 || header.height <= 0) {
+        fclose (f);
+        return nullptr;
+    }
+
+    std::shared_ptr<FlatFieldMaps> maps (new FlatFieldMaps);
+    maps->width = header.width;
+    maps->height = header.height;
+
+    const size_t size = static_cast<size_t> (header.width) * header.height;
+    maps->vignette.resize (size);
+    bool read = fread (maps->vignette.data (), sizeof (float), size, f) == size;
+
+    if (read && header.hasLines) {
+        maps->lines.resize (size);
+        read = fread (maps->lines.data (), sizeof (float), size, f) == size;
+    }
+
+    fclose (f);
+
+    if (!read) {
+        g_remove (fname.c_str ());
+        return nullptr;
+    }
+
+    // the file is the most recently used
+    g_utime (fname.c_str (), nullptr);
+    return maps;
+}
+
+void FlatFieldMapCache::store (const std::string& key, const FlatFieldMaps& maps) const
+{
+    if (settings->masterFrameCacheDir.empty () || g_mkdir_with_parents (settings->masterFrameCacheDir.c_str (), 0755) != 0) {
+        return;
+    }
+
+    FileHeader header;
+    memcpy (header.magic, fileMagic, sizeof (fileMagic));
+    header.version = fileVersion;
+    header.width = maps.width;
+    header.height = maps.height;
+    header.hasLines = !maps.lines.empty ();
+
+    // written to a temporary file first, so that a partial file is never read
+    const std::string fname = getFileName (key);
+    const std::string tmpFileName = fname + ".tmp";
+    FILE* const f = g_fopen (tmpFileName.c_str (), "wb");
+
+    if (!f) {
+        return;
+    }
+
+    bool written = fwrite (&header, sizeof (header), 1, f) == 1
+                   && fwrite (maps.vignette.data (), sizeof (float), maps.vignette.size (), f) == maps.vignette.size ()
+                   && fwrite (maps.lines.data (), sizeof (float), maps.lines.size (), f) == maps.lines.size ();
+    written = fclose (f) == 0 && written;
+
+    if (!written || g_rename (tmpFileName.c_str (), fname.c_str ()) != 0) {
+        g_remove (tmpFileName.c_str ());
+        return;
+    }
+
+    trimDirectory ();
+}
+
+}
@@ -0,0 +1,79 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glibmm.h>
+
+#include "noncopyable.h"
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+class RawImage;
+
+/** Correction maps of a flat field, i.e. the factors RawImageSource::processFlatField applies to the raw values
+  * once the black level is subtracted */
+struct FlatFieldMaps {
+    int width = 0;
+    int height = 0;
+    std::vector<float> vignette;    ///< reference value / blurred flat field, before the clip control
+    std::vector<float> lines;       ///< correction of the vertical and horizontal lines, empty unless both are corrected
+};
+
+/** Cache of the flat field correction maps.
+  *
+  * Blurring the flat field takes a few full size passes, while the flat field, its blur and the black levels rarely
+  * change from one image of a session to the next one, or from a preview update to the next one. The cache keeps
+  * the last few maps in memory; they are also stored in settings->masterFrameCacheDir if
+  * settings->flatFieldMapsOnDisk is set.
+  */
+class FlatFieldMapCache :
+    public NonCopyable
+{
+public:
+    static FlatFieldMapCache* getInstance ();
+
+    /** @param flatField is the flat field, in the format of RawImage::compress_image ()
+      * @param image is the raw image it corrects, of the given size
+      * @param black are the black levels of image
+      * @return the key of the maps of flatField for image, for the given blur */
+    std::string getKey (RawImage* flatField, RawImage* image, int width, int height, const Glib::ustring& blurType, int blurRadius, const unsigned short black[4]) const;
+
+    /** @param key identifies the flat field, the blur and the black levels
+      * @return the maps, nullptr if they aren't cached */
+    std::shared_ptr<const FlatFieldMaps> get (const std::string& key);
+    void put (const std::string& key, const std::shared_ptr<const FlatFieldMaps>& maps);
+
+private:
+    FlatFieldMapCache () = default;
+
+    std::shared_ptr<const FlatFieldMaps> load (const std::string& key) const;
+    void store (const std::string& key, const FlatFieldMaps& maps) const;
+    void add (const std::string& key, const std::shared_ptr<const FlatFieldMaps>& maps);
+
+    MyMutex mutex;
+    std::list<std::pair<std::string, std::shared_ptr<const FlatFieldMaps>>> entries; // the most recently used first
+};
+
+}
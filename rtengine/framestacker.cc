@@ -0,0 +1,521 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "framestacker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <glib/gstdio.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "mytime.h"
+#include "noncopyable.h"
+#include "settings.h"
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+namespace
+{
+
+constexpr int maxConcurrentDecodes = 4;     // each decode holds a few copies of a frame
+constexpr size_t stackingMemory = 512 << 20; // bytes of the frames kept in memory, and of the bands
+constexpr float clipSigmas = 3.f;
+constexpr int clipIterations = 2;
+constexpr double minClipLimit = 1.0;         // the raw values are integers, the ones next to the mean are never outliers
+
+typedef unsigned int acc_t;                  // as the former averaging loops
+
+int getRowSize (RawImage* ri)
+{
+    // same as RawImage::compress_image ()
+    const bool oneChannel = ri->getSensorType () == ST_BAYER || ri->getSensorType () == ST_FUJI_XTRANS || ri->get_colors () == 1;
+    return ri->get_width () * (oneChannel ? 1 : 3);
+}
+
+int getDecodeThreads ()
+{
+#ifdef _OPENMP
+    return std::min (omp_get_max_threads (), maxConcurrentDecodes);
+#else
+    return 1;
+#endif
+}
+
+/** @return the frame i, nullptr if it can't be decoded or if its geometry differs from the one of the first frame */
+RawImage* decodeFrame (const FrameDecoder& decode, size_t i, RawImage* first)
+{
+    RawImage* const frame = decode (i);
+
+    if (frame && (frame->get_width () != first->get_width () || frame->get_height () != first->get_height ()
+                  || frame->getSensorType () != first->getSensorType () || frame->get_colors () != first->get_colors ())) {
+        if (settings->verbose) {
+            printf ("Stacking: %s skipped\n", frame->get_filename ().c_str ());
+        }
+
+        delete frame;
+        return nullptr;
+    }
+
+    return frame;
+}
+
+bool seek (FILE* f, uint64_t offset)
+{
+#ifdef WIN32
+    return _fseeki64 (f, offset, SEEK_SET) == 0;
+#else
+    return fseeko (f, offset, SEEK_SET) == 0;
+#endif
+}
+
+/** Frames of the same geometry, in memory or one after the other in a temporary file */
+class FrameStore :
+    public NonCopyable
+{
+public:
+    FrameStore (int numFrames, int H, int rowSize, size_t memoryBudget) :
+        H (H),
+        rowSize (rowSize),
+        frameBytes (static_cast<uint64_t> (H) * rowSize * sizeof (float)),
+        file (nullptr),
+        fileEnd (0)
+    {
+        if (numFrames * frameBytes <= memoryBudget) {
+            memory.resize (static_cast<size_t> (numFrames) * H * rowSize);
+        } else {
+            offsets.resize (numFrames, 0);
+        }
+    }
+
+    ~FrameStore ()
+    {
+        if (file) {
+            fclose (file);
+            g_remove (fileName.c_str ());
+        }
+    }
+
+    bool onDisk () const
+    {
+        return !offsets.empty ();
+    }
+
+    /** Can be called concurrently for different frames */
+    bool put (int frame, float** data)
+    {
+        if (!onDisk ()) {
+            float* dst = &memory[static_cast<size_t> (frame) * H * rowSize];
+
+            for (int row = 0; row < H; ++row) {
+                memcpy (dst + static_cast<size_t> (row) * rowSize, data[row], rowSize * sizeof (float));
+            }
+
+            return true;
+        }
+
+        MyMutex::MyLock lock (fileMutex);
+
+        if (!file && !openFile ()) {
+            return false;
+        }
+
+        // the frames are appended in the order they are decoded
+        offsets[frame] = fileEnd;
+
+        if (!seek (file, fileEnd)) {
+            return false;
+        }
+
+        for (int row = 0; row < H; ++row) {
+            if (fwrite (data[row], sizeof (float), rowSize, file) != static_cast<size_t> (rowSize)) {
+                return false;
+            }
+        }
+
+        fileEnd += frameBytes;
+        return true;
+    }
+
+    bool getBand (int frame, int row, int rows, float* dst)
+    {
+        const size_t size = static_cast<size_t> (rows) * rowSize;
+
+        if (!onDisk ()) {
+            memcpy (dst, &memory[(static_cast<size_t> (frame) * H + row) * rowSize], size * sizeof (float));
+            return true;
+        }
+
+        MyMutex::MyLock lock (fileMutex);
+
+        // the reads follow the writes, a seek is needed in between
+        return seek (file, offsets[frame] + static_cast<uint64_t> (row) * rowSize * sizeof (float))
+               && fread (dst, sizeof (float), size, file) == size;
+    }
+
+private:
+    bool openFile ()
+    {
+        gchar* name = nullptr;
+        const gint fd = g_file_open_tmp ("rt-stack-XXXXXX", &name, nullptr);
+
+        if (fd == -1) {
+            return false;
+        }
+
+        g_close (fd, nullptr);
+        fileName = name;
+        g_free (name);
+
+        file = g_fopen (fileName.c_str (), "w+b");
+
+        if (!file) {
+            g_remove (fileName.c_str ());
+            return false;
+        }
+
+        return true;
+    }
+
+    const int H;
+    const int rowSize;
+    const uint64_t frameBytes;
+    std::vector<float> memory;
+    std::vector<uint64_t> offsets;  // of the frames in the file
+    MyMutex fileMutex;
+    FILE* file;
+    std::string fileName;
+    uint64_t fileEnd;
+};
+
+void stackMean (RawImage* ri, size_t numFiles, const FrameDecoder& decode, int& numFrames)
+{
+    const int H = ri->get_height ();
+    const int rowSize = getRowSize (ri);
+    const int numThreads = getDecodeThreads ();
+
+    // Each thread adds the frames it decodes to sums of its own, allocated with its first frame. The values are
+    // truncated to integers, and the integer mean of the sums, as the former averaging loops did.
+    std::vector<std::vector<acc_t>> acc (numThreads);
+    std::vector<int> counts (numThreads, 0);
+
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(numThreads)
+#endif
+    {
+#ifdef _OPENMP
+        const int thread = omp_get_thread_num ();
+#else
+        const int thread = 0;
+#endif
+        std::vector<acc_t>& threadAcc = acc[thread];
+
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+
+        for (size_t i = 1; i < numFiles; ++i) {
+            RawImage* frame = decodeFrame (decode, i, ri);
+
+            if (!frame) {
+                continue;
+            }
+
+            if (threadAcc.empty ()) {
+                threadAcc.resize (static_cast<size_t> (H) * rowSize, 0);
+            }
+
+            for (int row = 0; row < H; ++row) {
+                acc_t* const dst = &threadAcc[static_cast<size_t> (row) * rowSize];
+                const float* const src = frame->data[row];
+
+                for (int col = 0; col < rowSize; ++col) {
+                    dst[col] += src[col];
+                }
+            }
+
+            ++counts[thread];
+            delete frame;
+        }
+    }
+
+    numFrames = 1;
+    std::vector<const acc_t*> sums;
+
+    for (int thread = 0; thread < numThreads; ++thread) {
+        numFrames += counts[thread];
+
+        if (!acc[thread].empty ()) {
+            sums.push_back (acc[thread].data ());
+        }
+    }
+
+    const acc_t n = numFrames;
+
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+
+    for (int row = 0; row < H; ++row) {
+        float* const dst = ri->data[row];
+        const size_t offset = static_cast<size_t> (row) * rowSize;
+
+        for (int col = 0; col < rowSize; ++col) {
+            acc_t sum = dst[col];
+
+            for (const acc_t* threadSums : sums) {
+                sum += threadSums[offset + col];
+            }
+
+            dst[col] = sum / n;
+        }
+    }
+}
+
+void clippedMeanRow (const float* band, size_t frameStride, int numFrames, int rowSize, float* dst, std::vector<double>& buffer, std::vector<int>& count, std::vector<float>& values)
+{
+    buffer.resize (4 * rowSize);
+    count.resize (rowSize);
+    values.resize (numFrames);
+    double* const sum = buffer.data ();
+    double* const sumSq = sum + rowSize;
+    double* const mean = sumSq + rowSize;
+    double* const limit = mean + rowSize;
+    const int middle = numFrames / 2;
+
+    // The first sigma is estimated from the median absolute deviation: a single outlier among a few frames raises the
+    // standard deviation so much that it would stay within 3 sigmas of the mean
+    for (int col = 0; col < rowSize; ++col) {
+        for (int f = 0; f < numFrames; ++f) {
+            values[f] = band[f * frameStride + col];
+        }
+
+        std::nth_element (values.begin (), values.begin () + middle, values.end ());
+        const float median = values[middle];
+
+        for (int f = 0; f < numFrames; ++f) {
+            values[f] = std::fabs (values[f] - median);
+        }
+
+        std::nth_element (values.begin (), values.begin () + middle, values.end ());
+        mean[col] = median;
+        limit[col] = std::max (clipSigmas * 1.4826 * values[middle], minClipLimit);
+    }
+
+    // the loops go over the columns for a frame at a time, so that they vectorize
+    for (int iteration = 0; iteration < clipIterations; ++iteration) {
+        std::fill (count.begin (), count.end (), 0);
+        std::fill (sum, sum + 2 * rowSize, 0.0);
+
+        for (int f = 0; f < numFrames; ++f) {
+            const float* const frameValues = band + f * frameStride;
+
+            for (int col = 0; col < rowSize; ++col) {
+                const bool keep = std::fabs (frameValues[col] - mean[col]) <= limit[col];
+                sum[col] += keep ? frameValues[col] : 0.0;
+                sumSq[col] += keep ? static_cast<double> (frameValues[col]) * frameValues[col] : 0.0;
+                count[col] += keep;
+            }
+        }
+
+        // one of the values kept at least is within a sigma of their mean, none of the counts is 0
+        for (int col = 0; col < rowSize; ++col) {
+            mean[col] = sum[col] / count[col];
+            limit[col] = std::max (clipSigmas * std::sqrt (std::max (sumSq[col] / count[col] - mean[col] * mean[col], 0.0)), minClipLimit);
+        }
+    }
+
+    for (int col = 0; col < rowSize; ++col) {
+        dst[col] = mean[col];
+    }
+}
+
+void medianRow (const float* band, size_t frameStride, int numFrames, int rowSize, float* dst, std::vector<float>& values)
+{
+    values.resize (numFrames);
+    const int middle = numFrames / 2;
+
+    for (int col = 0; col < rowSize; ++col) {
+        for (int f = 0; f < numFrames; ++f) {
+            values[f] = band[f * frameStride + col];
+        }
+
+        std::nth_element (values.begin (), values.begin () + middle, values.end ());
+
+        if (numFrames % 2) {
+            dst[col] = values[middle];
+        } else {
+            // the lower middle value is the largest one of the lower half
+            dst[col] = 0.5f * (values[middle] + *std::max_element (values.begin (), values.begin () + middle));
+        }
+    }
+}
+
+void stackByBands (RawImage* ri, size_t numFiles, const FrameDecoder& decode, StackingMethod method, size_t memoryBudget, int& numFrames)
+{
+    const int H = ri->get_height ();
+    const int rowSize = getRowSize (ri);
+
+    FrameStore store (numFiles, H, rowSize, memoryBudget);
+    std::vector<char> valid (numFiles, false);
+    valid[0] = store.put (0, ri->data);
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(getDecodeThreads ())
+#endif
+
+    for (size_t i = 1; i < numFiles; ++i) {
+        RawImage* frame = decodeFrame (decode, i, ri);
+
+        if (frame) {
+            valid[i] = store.put (i, frame->data);
+            delete frame;
+        }
+    }
+
+    std::vector<int> frames;
+
+    for (size_t i = 0; i < numFiles; ++i) {
+        if (valid[i]) {
+            frames.push_back (i);
+        }
+    }
+
+    numFrames = frames.size ();
+
+    if (numFrames < 2) {
+        // the pixels of the first file are kept as is
+        numFrames = 1;
+        return;
+    }
+
+    const size_t rowBytes = static_cast<size_t> (rowSize) * numFrames * sizeof (float);
+    const int bandRows = std::max<int> (1, std::min<size_t> (H, memoryBudget / rowBytes));
+    const size_t frameStride = static_cast<size_t> (bandRows) * rowSize;
+    std::vector<float> band (frameStride * numFrames);
+
+    for (int row = 0; row < H; row += bandRows) {
+        const int rows = std::min (bandRows, H - row);
+        bool failed = false;
+
+        // the frames are read one after the other from the temporary file
+        for (int f = 0; f < numFrames && !failed; ++f) {
+            failed = !store.getBand (frames[f], row, rows, &band[f * frameStride]);
+        }
+
+        if (failed) {
+            // the pixels of the first file are kept for the rest of the rows
+            if (settings->verbose) {
+                printf ("Stacking: can't read the temporary files\n");
+            }
+
+            break;
+        }
+
+#ifdef _OPENMP
+        #pragma omp parallel
+#endif
+        {
+            std::vector<double> buffer;
+            std::vector<int> count;
+            std::vector<float> values;
+
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic,16)
+#endif
+
+            for (int i = 0; i < rows; ++i) {
+                const float* const src = &band[static_cast<size_t> (i) * rowSize];
+
+                if (method == StackingMethod::MEDIAN) {
+                    medianRow (src, frameStride, numFrames, rowSize, ri->data[row + i], values);
+                } else {
+                    clippedMeanRow (src, frameStride, numFrames, rowSize, ri->data[row + i], buffer, count, values);
+                }
+            }
+        }
+    }
+}
+
+}
+
+RawImage* stackRawFrames (const std::list<Glib::ustring>& files, StackingMethod method)
+{
+    const std::vector<Glib::ustring> names (files.begin (), files.end ());
+
+    // the first file is used also for the informations other than the pixels
+    return stackRawFrames (names.size (), [&names] (size_t i) -> RawImage* {
+        RawImage* const frame = new RawImage (names[i]);
+
+        if (frame->loadRaw (true)) {
+            if (i > 0 && settings->verbose) {
+                printf ("Stacking: %s skipped\n", names[i].c_str ());
+            }
+
+            delete frame;
+            return nullptr;
+        }
+
+        frame->compress_image ();
+        return frame;
+    }, method, stackingMemory);
+}
+
+RawImage* stackRawFrames (size_t numFrames, const FrameDecoder& decode, StackingMethod method, size_t memoryBudget)
+{
+    if (numFrames == 0) {
+        return nullptr;
+    }
+
+    MyTime t1, t2;
+    t1.set ();
+
+    RawImage* const ri = decode (0);
+
+    if (!ri) {
+        return nullptr;
+    }
+
+    int stacked = 1;
+
+    if (numFrames > 1) {
+        if (method == StackingMethod::MEAN) {
+            stackMean (ri, numFrames, decode, stacked);
+        } else {
+            stackByBands (ri, numFrames, decode, method, memoryBudget, stacked);
+        }
+    }
+
+    if (settings->verbose) {
+        t2.set ();
+        printf ("Stacked %d of %d frames in %d usec\n", stacked, static_cast<int> (numFrames), t2.etime (t1));
+    }
+
+    return ri;
+}
+
+}
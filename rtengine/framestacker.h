@@ -0,0 +1,58 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <functional>
+#include <list>
+
+#include <glibmm.h>
+
+#include "rawimage.h"
+
+namespace rtengine
+{
+
+/** How the frames of a master dark frame or flat field are combined, see Settings::masterFrameStacking */
+enum class StackingMethod {
+    MEAN,
+    SIGMA_CLIPPED_MEAN, ///< mean of the values within 3 sigmas of the mean, which drops the cosmic ray hits and the other outliers
+    MEDIAN
+};
+
+/** Combines the raw files of a master dark frame or flat field.
+  *
+  * The files are decoded concurrently. The mean is accumulated in integers as the frames are decoded, by each thread
+  * on its own, and truncated as the former averaging loops of dfInfo and ffInfo did. The other methods need all the
+  * values of a pixel at once, they work by bands of rows on the frames kept in memory, or in a temporary file if they
+  * exceed the memory budget of the stacking. The files whose geometry differs from the one of the first file are
+  * skipped.
+  *
+  * @return the first file with the combined pixels, in the format of RawImage::compress_image (), nullptr if the
+  * first file can't be loaded
+  */
+RawImage* stackRawFrames (const std::list<Glib::ustring>& files, StackingMethod method);
+
+/** @return the frame of index i of a stack, with its pixels in the format of RawImage::compress_image (), or nullptr
+  * if it can't be loaded. It is called concurrently for the frames other than the first one, which are deleted once
+  * stored or accumulated. */
+using FrameDecoder = std::function<RawImage* (size_t i)>;
+
+/** stackRawFrames on the frames given by decode, with memoryBudget bytes of frames in memory instead of the default
+  * budget; for the tests */
+RawImage* stackRawFrames (size_t numFrames, const FrameDecoder& decode, StackingMethod method, size_t memoryBudget);
+
+}
@@ -83,8 +83,37 @@ void CLASS init_fuji_compr (struct fuji_compressed_params* info)
     }
 }
 
+// The bits are read through a 64 bit window starting at the current byte, so the buffer holds
+// the whole compressed strip followed by 8 zero bytes.
+uint64_t CLASS fuji_peek_bits (const struct fuji_compressed_block *info)
+{
+    const uchar *src = info->cur_buf + info->cur_pos;
+    uint64_t bits;
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy (&bits, src, sizeof (bits));
+    bits = __builtin_bswap64 (bits);
+#else
+    bits = 0;
+
+    for (int i = 0; i < 8; i++) {
+        bits = (bits << 8) | src[i];
+    }
+
+#endif
+    // at least 57 valid bits, msb first
+    return bits << info->cur_bit;
+}
+
+void CLASS fuji_skip_bits (struct fuji_compressed_block *info, int count)
+{
+    count += info->cur_bit;
+    info->cur_pos = std::min (info->cur_pos + (count >> 3), info->cur_buf_size);
+    info->cur_bit = count & 7;
+}
+
 #define FUJI_BUF_SIZE 0x10000u
 
+// Refill of the reference reader
 void CLASS fuji_fill_buffer (struct fuji_compressed_block *info)
 {
     if (info->cur_pos >= info->cur_buf_size) {
@@ -116,10 +145,8 @@ void CLASS init_fuji_block (struct fuji_compressed_block* info, const struct fuj
     info->linealloc = (ushort*)calloc (sizeof (ushort), _ltotal * (params->line_width + 2));
     merror (info->linealloc, "init_fuji_block()");
 
-    info->input = ifp;
-    INT64 fsize = info->input->size;
-    info->max_read_size = std::min (unsigned (fsize - raw_offset), dsize + 16); // Data size may be incorrect?
-    info->fillbytes = 1;
+    INT64 fsize = ifp->size;
+    unsigned max_read_size = std::min (unsigned (fsize - raw_offset), dsize + 16); // Data size may be incorrect?
 
     info->linebuf[_R0] = info->linealloc;
 
@@ -127,12 +154,31 @@ void CLASS init_fuji_block (struct fuji_compressed_block* info, const struct fuj
         info->linebuf[i] = info->linebuf[i - 1] + params->line_width + 2;
     }
 
-    // init buffer
-    info->cur_buf = (uchar*)malloc (FUJI_BUF_SIZE);
-    merror (info->cur_buf, "init_fuji_block()");
+    info->reference_reader = fuji_reference_reader;
     info->cur_bit = 0;
     info->cur_pos = 0;
-    info->cur_buf_offset = raw_offset;
+
+    if (info->reference_reader) {
+        info->input = ifp;
+        info->max_read_size = max_read_size;
+        info->fillbytes = 1;
+        info->cur_buf_offset = raw_offset;
+        info->cur_buf_size = 0;
+        info->cur_buf = (uchar*)malloc (FUJI_BUF_SIZE);
+        merror (info->cur_buf, "init_fuji_block()");
+        fuji_fill_buffer (info);
+    } else {
+        // read the whole strip at once, the strips are decoded in parallel from the shared file
+        info->cur_buf = (uchar*)calloc (max_read_size + 8, 1);
+        merror (info->cur_buf, "init_fuji_block()");
+#ifdef _OPENMP
+        #pragma omp critical
+#endif
+        {
+            fseek (ifp, raw_offset, SEEK_SET);
+            info->cur_buf_size = fread (info->cur_buf, 1, max_read_size, ifp);
+        }
+    }
 
     for (int j = 0; j < 3; j++)
         for (int i = 0; i < 41; i++) {
@@ -141,9 +187,6 @@ void CLASS init_fuji_block (struct fuji_compressed_block* info, const struct fuj
             info->grad_odd[j][i].value1 = params->maxDiff;
             info->grad_odd[j][i].value2 = 1;
         }
-
-    info->cur_buf_size = 0;
-    fuji_fill_buffer (info);
 }
 
 void CLASS copy_line_to_xtrans (struct fuji_compressed_block* info, int cur_line, int cur_block, int cur_block_width)
@@ -257,7 +300,7 @@ void CLASS copy_line_to_bayer (struct fuji_compressed_block *info, int cur_line,
 
 #define fuji_quant_gradient(i,v1,v2) (9*i->q_table[i->q_point[4]+(v1)] + i->q_table[i->q_point[4]+(v2)])
 
-void CLASS fuji_zerobits (struct fuji_compressed_block* info, int *count)
+void CLASS fuji_zerobits_reference (struct fuji_compressed_block* info, int *count)
 {
     uchar zero = 0;
     *count = 0;
@@ -280,7 +323,7 @@ void CLASS fuji_zerobits (struct fuji_compressed_block* info, int *count)
     }
 }
 
-void CLASS fuji_read_code (struct fuji_compressed_block* info, int *data, int bits_to_read)
+void CLASS fuji_read_code_reference (struct fuji_compressed_block* info, int *data, int bits_to_read)
 {
     uchar bits_left = bits_to_read;
     uchar bits_left_in_byte = 8 - (info->cur_bit & 7);
@@ -312,6 +355,60 @@ void CLASS fuji_read_code (struct fuji_compressed_block* info, int *data, int bi
     info->cur_bit = (8 - (bits_left_in_byte & 7)) & 7;
 }
 
+void CLASS fuji_zerobits (struct fuji_compressed_block* info, int *count)
+{
+    if (info->reference_reader) {
+        fuji_zerobits_reference (info, count);
+        return;
+    }
+
+    *count = 0;
+
+    while (true) {
+        const uint64_t bits = fuji_peek_bits (info);
+
+        if (bits) {
+#ifdef __GNUC__
+            const int zeros = __builtin_clzll (bits);
+#else
+            int zeros = 0;
+
+            while (!(bits & (uint64_t (1) << (63 - zeros)))) {
+                ++zeros;
+            }
+
+#endif
+            *count += zeros;
+            fuji_skip_bits (info, zeros + 1);
+            return;
+        }
+
+        if (info->cur_pos >= info->cur_buf_size) { // end of the data
+            return;
+        }
+
+        // all the valid bits of the window are zero
+        *count += 64 - info->cur_bit;
+        fuji_skip_bits (info, 64 - info->cur_bit);
+    }
+}
+
+void CLASS fuji_read_code (struct fuji_compressed_block* info, int *data, int bits_to_read)
+{
+    if (info->reference_reader) {
+        fuji_read_code_reference (info, data, bits_to_read);
+        return;
+    }
+
+    if (!bits_to_read) {
+        *data = 0;
+        return;
+    }
+
+    *data = fuji_peek_bits (info) >> (64 - bits_to_read);
+    fuji_skip_bits (info, bits_to_read);
+}
+
 int CLASS bitDiff (int value1, int value2)
 {
     int decBits = 0;
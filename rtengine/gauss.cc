@@ -21,6 +21,8 @@
 #include <cstdlib>
 #include "opthelper.h"
 #include "boxblur.h"
+#include "cpudispatch.h"
+#include "gauss_simd.h"
 
 namespace
 {
@@ -1139,6 +1141,46 @@ template<class T> void gaussVerticalmult (T** src, T** dst, const int W, const i
 }
 #endif
 
+// Runs the recursive gaussian with the kernels compiled for the widest instruction set of the cpu, see cpudispatch.h.
+// Returns false if there are none, then the caller uses the kernels of the build flags.
+template<class T> bool gaussDispatched (T** src, T** dst, T** buffer2, const int W, const int H, const double sigma, eGaussType gausstype)
+{
+    return false;
+}
+
+#ifdef RT_SIMD_DISPATCH
+template<> bool gaussDispatched<float> (float** src, float** dst, float** buffer2, const int W, const int H, const double sigma, eGaussType gausstype)
+{
+    const rtengine::SimdLevel level = rtengine::getSimdLevel ();
+
+    if (level == rtengine::SimdLevel::NONE) {
+        return false;
+    }
+
+    rtengine::GaussIIRCoeffs c;
+    calculateYvVFactors<double>(sigma, c.b1, c.b2, c.b3, c.B, c.M);
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++) {
+            c.M[i][j] *= (1.0 + c.b2 + (c.b1 - c.b3) * c.b3);
+            c.M[i][j] /= (1.0 + c.b1 - c.b2 + c.b3) * (1.0 - c.b1 - c.b2 - c.b3);
+        }
+
+    // same passes as with the SSE kernels below, GAUSS_MULT blurs src in place horizontally
+    float** const tmp = gausstype == GAUSS_MULT ? src : dst;
+
+    if (level == rtengine::SimdLevel::AVX512) {
+        rtengine::avx512::gaussHorizontal (src, tmp, W, H, c);
+        rtengine::avx512::gaussVertical (tmp, dst, buffer2, W, H, c, gausstype);
+    } else {
+        rtengine::avx2::gaussHorizontal (src, tmp, W, H, c);
+        rtengine::avx2::gaussVertical (tmp, dst, buffer2, W, H, c, gausstype);
+    }
+
+    return true;
+}
+#endif
+
 template<class T> void gaussianBlurImpl(T** src, T** dst, const int W, const int H, const double sigma, T *buffer = nullptr, eGaussType gausstype = GAUSS_STANDARD, T** buffer2 = nullptr)
 {
     static constexpr auto GAUSS_SKIP = 0.25;
@@ -1236,7 +1278,9 @@ template<class T> void gaussianBlurImpl(T** src, T** dst, const int W, const int
         } else {
 #ifdef __SSE2__
 
-            if (sigma < GAUSS_DOUBLE) {
+            if (sigma < GAUSS_DOUBLE && gaussDispatched<T> (src, dst, buffer2, W, H, sigma, gausstype)) {
+                // done with AVX2 or AVX-512
+            } else if (sigma < GAUSS_DOUBLE) {
                 switch (gausstype) {
                 case GAUSS_MULT : {
                     gaussHorizontalSse<T> (src, src, W, H, sigma);
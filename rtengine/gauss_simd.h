@@ -0,0 +1,44 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "gauss.h"
+
+namespace rtengine
+{
+
+// Coefficients of the recursive (Young / van Vliet) gaussian, M already scaled for the border handling
+struct GaussIIRCoeffs {
+    double B, b1, b2, b3;
+    double M[3][3];
+};
+
+// The recursive gaussian compiled for each instruction set of cpudispatch.h, see gauss_simd_impl.h.
+// Like the kernels of gauss.cc, they have to be called by all the threads of a parallel region, or outside of any.
+namespace avx2
+{
+void gaussHorizontal (float** src, float** dst, const int W, const int H, const GaussIIRCoeffs& c);
+void gaussVertical (float** src, float** dst, float** divBuffer, const int W, const int H, const GaussIIRCoeffs& c, eGaussType gausstype);
+}
+
+namespace avx512
+{
+void gaussHorizontal (float** src, float** dst, const int W, const int H, const GaussIIRCoeffs& c);
+void gaussVertical (float** src, float** dst, float** divBuffer, const int W, const int H, const GaussIIRCoeffs& c, eGaussType gausstype);
+}
+
+}
@@ -0,0 +1,338 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The recursive gaussian of gauss.cc (gaussHorizontalSse, gaussVerticalSse and its mult/div variants), written with
+// the vector extension of GCC and clang so that the same code gives 8 or 16 floats per register depending on the
+// compiler flags. It is included by gauss_avx2.cc and gauss_avx512.cc, which define RT_SIMD_WIDTH and RT_SIMD_NAMESPACE.
+//
+// Beware: these translation units are compiled with -mavx2 or -mavx512f, so they must not use inline functions or
+// templates of other headers (rt_math.h, <algorithm>, <vector>...). Their copies would be compiled with the wider
+// instructions as well, and the linker could keep them for the code which has to run on any cpu.
+
+#include <cstring>
+
+#include "gauss_simd.h"
+
+namespace rtengine
+{
+
+namespace RT_SIMD_NAMESPACE
+{
+
+namespace
+{
+
+constexpr int N = RT_SIMD_WIDTH;
+
+typedef float vfloatN __attribute__ ((vector_size (RT_SIMD_WIDTH * sizeof (float))));
+
+inline vfloatN broadcast (float x)
+{
+    vfloatN v;
+
+    for (int k = 0; k < N; ++k) {
+        v[k] = x;
+    }
+
+    return v;
+}
+
+// memcpy gives unaligned loads and stores, the rows of the images are only 16 byte aligned
+inline vfloatN load (const float* p)
+{
+    vfloatN v;
+    memcpy (&v, p, sizeof (v));
+    return v;
+}
+
+inline void store (float* p, const vfloatN& v)
+{
+    memcpy (p, &v, sizeof (v));
+}
+
+template<eGaussType gausstype> inline void put (float** dst, float** divBuffer, int row, int col, vfloatN v)
+{
+    if (gausstype == GAUSS_MULT) {
+        store (&dst[row][col], load (&dst[row][col]) * v);
+    } else if (gausstype == GAUSS_DIV) {
+        const vfloatN div = load (&divBuffer[row][col]);
+
+        for (int k = 0; k < N; ++k) {
+            v[k] = div[k] / (v[k] > 0.f ? v[k] : 1.f);
+        }
+
+        store (&dst[row][col], v);
+    } else {
+        store (&dst[row][col], v);
+    }
+}
+
+template<eGaussType gausstype> inline void put (float** dst, float** divBuffer, int row, int col, float v)
+{
+    if (gausstype == GAUSS_MULT) {
+        dst[row][col] *= v;
+    } else if (gausstype == GAUSS_DIV) {
+        dst[row][col] = divBuffer[row][col] / (v > 0.f ? v : 1.f);
+    } else {
+        dst[row][col] = v;
+    }
+}
+
+template<eGaussType gausstype> void gaussVerticalImpl (float** src, float** dst, float** divBuffer, const int W, const int H, const GaussIIRCoeffs& c)
+{
+    const double B = c.B, b1 = c.b1, b2 = c.b2, b3 = c.b3;
+    const vfloatN Bv = broadcast (B);
+    const vfloatN b1v = broadcast (b1);
+    const vfloatN b2v = broadcast (b2);
+    const vfloatN b3v = broadcast (b3);
+    vfloatN Mv[3][3];
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++) {
+            Mv[i][j] = broadcast (c.M[i][j]);
+        }
+
+    // the forward pass of a strip of N columns, too large for the stack with AVX-512
+    float* const tmp = new float[H * N];
+
+#ifdef _OPENMP
+    #pragma omp for nowait
+#endif
+
+    for (int i = 0; i < W - (N - 1); i += N) {
+        vfloatN Tv = load (&src[0][i]);
+        vfloatN Rv = Tv * (Bv + b1v + b2v + b3v);
+        vfloatN Tm3v = Rv;
+        store (tmp, Rv);
+
+        Rv = load (&src[1][i]) * Bv + Rv * b1v + Tv * (b2v + b3v);
+        vfloatN Tm2v = Rv;
+        store (tmp + N, Rv);
+
+        Rv = load (&src[2][i]) * Bv + Rv * b1v + Tm3v * b2v + Tv * b3v;
+        store (tmp + 2 * N, Rv);
+
+        for (int j = 3; j < H; j++) {
+            Tv = Rv;
+            Rv = load (&src[j][i]) * Bv + Tv * b1v + Tm2v * b2v + Tm3v * b3v;
+            store (tmp + j * N, Rv);
+            Tm3v = Tm2v;
+            Tm2v = Tv;
+        }
+
+        Tv = load (&src[H - 1][i]);
+
+        const vfloatN temp2Wp1 = Tv + Mv[2][0] * (Rv - Tv) + Mv[2][1] * (Tm2v - Tv) + Mv[2][2] * (Tm3v - Tv);
+        const vfloatN temp2W = Tv + Mv[1][0] * (Rv - Tv) + Mv[1][1] * (Tm2v - Tv) + Mv[1][2] * (Tm3v - Tv);
+
+        Rv = Tv + Mv[0][0] * (Rv - Tv) + Mv[0][1] * (Tm2v - Tv) + Mv[0][2] * (Tm3v - Tv);
+        put<gausstype> (dst, divBuffer, H - 1, i, Rv);
+
+        Tm2v = Bv * Tm2v + b1v * Rv + b2v * temp2W + b3v * temp2Wp1;
+        put<gausstype> (dst, divBuffer, H - 2, i, Tm2v);
+
+        Tm3v = Bv * Tm3v + b1v * Tm2v + b2v * Rv + b3v * temp2W;
+        put<gausstype> (dst, divBuffer, H - 3, i, Tm3v);
+
+        Tv = Rv;
+        Rv = Tm3v;
+        Tm3v = Tv;
+
+        for (int j = H - 4; j >= 0; j--) {
+            Tv = Rv;
+            Rv = load (tmp + j * N) * Bv + Tv * b1v + Tm2v * b2v + Tm3v * b3v;
+            put<gausstype> (dst, divBuffer, j, i, Rv);
+            Tm3v = Tm2v;
+            Tm2v = Tv;
+        }
+    }
+
+    // Remaining columns are done without vectors, the implicit barrier ends the pass
+#ifdef _OPENMP
+    #pragma omp for
+#endif
+
+    for (int i = W - (W % N); i < W; i++) {
+        tmp[0] = src[0][i] * (B + b1 + b2 + b3);
+        tmp[1] = B * src[1][i] + b1 * tmp[0] + src[0][i] * (b2 + b3);
+        tmp[2] = B * src[2][i] + b1 * tmp[1] + b2 * tmp[0] + b3 * src[0][i];
+
+        for (int j = 3; j < H; j++) {
+            tmp[j] = B * src[j][i] + b1 * tmp[j - 1] + b2 * tmp[j - 2] + b3 * tmp[j - 3];
+        }
+
+        const float temp2Hm1 = src[H - 1][i] + c.M[0][0] * (tmp[H - 1] - src[H - 1][i]) + c.M[0][1] * (tmp[H - 2] - src[H - 1][i]) + c.M[0][2] * (tmp[H - 3] - src[H - 1][i]);
+        const float temp2H   = src[H - 1][i] + c.M[1][0] * (tmp[H - 1] - src[H - 1][i]) + c.M[1][1] * (tmp[H - 2] - src[H - 1][i]) + c.M[1][2] * (tmp[H - 3] - src[H - 1][i]);
+        const float temp2Hp1 = src[H - 1][i] + c.M[2][0] * (tmp[H - 1] - src[H - 1][i]) + c.M[2][1] * (tmp[H - 2] - src[H - 1][i]) + c.M[2][2] * (tmp[H - 3] - src[H - 1][i]);
+
+        tmp[H - 1] = temp2Hm1;
+        tmp[H - 2] = B * tmp[H - 2] + b1 * tmp[H - 1] + b2 * temp2H + b3 * temp2Hp1;
+        tmp[H - 3] = B * tmp[H - 3] + b1 * tmp[H - 2] + b2 * tmp[H - 1] + b3 * temp2H;
+
+        for (int j = H - 4; j >= 0; j--) {
+            tmp[j] = B * tmp[j] + b1 * tmp[j + 1] + b2 * tmp[j + 2] + b3 * tmp[j + 3];
+        }
+
+        for (int j = 0; j < H; j++) {
+            put<gausstype> (dst, divBuffer, j, i, tmp[j]);
+        }
+    }
+
+    delete [] tmp;
+}
+
+}
+
+void gaussHorizontal (float** src, float** dst, const int W, const int H, const GaussIIRCoeffs& c)
+{
+    const double B = c.B, b1 = c.b1, b2 = c.b2, b3 = c.b3;
+    const vfloatN Bv = broadcast (B);
+    const vfloatN b1v = broadcast (b1);
+    const vfloatN b2v = broadcast (b2);
+    const vfloatN b3v = broadcast (b3);
+    vfloatN Mv[3][3];
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++) {
+            Mv[i][j] = broadcast (c.M[i][j]);
+        }
+
+    // N rows are processed at once, transposed so that each vector holds one column of them
+    float* const tmp = new float[W * N];
+
+#ifdef _OPENMP
+    #pragma omp for nowait
+#endif
+
+    for (int i = 0; i < H - (N - 1); i += N) {
+        const auto column = [src, i] (int j) {
+            vfloatN v;
+
+            for (int k = 0; k < N; ++k) {
+                v[k] = src[i + k][j];
+            }
+
+            return v;
+        };
+
+        vfloatN Tv = column (0);
+        vfloatN Tm3v = Tv * (Bv + b1v + b2v + b3v);
+        store (tmp, Tm3v);
+
+        vfloatN Tm2v = column (1) * Bv + Tm3v * b1v + Tv * (b2v + b3v);
+        store (tmp + N, Tm2v);
+
+        vfloatN Rv = column (2) * Bv + Tm2v * b1v + Tm3v * b2v + Tv * b3v;
+        store (tmp + 2 * N, Rv);
+
+        for (int j = 3; j < W; j++) {
+            Tv = Rv;
+            Rv = column (j) * Bv + Tv * b1v + Tm2v * b2v + Tm3v * b3v;
+            store (tmp + j * N, Rv);
+            Tm3v = Tm2v;
+            Tm2v = Tv;
+        }
+
+        Tv = column (W - 1);
+
+        const vfloatN temp2Wp1 = Tv + Mv[2][0] * (Rv - Tv) + Mv[2][1] * (Tm2v - Tv) + Mv[2][2] * (Tm3v - Tv);
+        const vfloatN temp2W = Tv + Mv[1][0] * (Rv - Tv) + Mv[1][1] * (Tm2v - Tv) + Mv[1][2] * (Tm3v - Tv);
+
+        Rv = Tv + Mv[0][0] * (Rv - Tv) + Mv[0][1] * (Tm2v - Tv) + Mv[0][2] * (Tm3v - Tv);
+        store (tmp + (W - 1) * N, Rv);
+
+        Tm2v = Bv * Tm2v + b1v * Rv + b2v * temp2W + b3v * temp2Wp1;
+        store (tmp + (W - 2) * N, Tm2v);
+
+        Tm3v = Bv * Tm3v + b1v * Tm2v + b2v * Rv + b3v * temp2W;
+        store (tmp + (W - 3) * N, Tm3v);
+
+        Tv = Rv;
+        Rv = Tm3v;
+        Tm3v = Tv;
+
+        for (int j = W - 4; j >= 0; j--) {
+            Tv = Rv;
+            Rv = load (tmp + j * N) * Bv + Tv * b1v + Tm2v * b2v + Tm3v * b3v;
+            store (tmp + j * N, Rv);
+            Tm3v = Tm2v;
+            Tm2v = Tv;
+        }
+
+        for (int k = 0; k < N; ++k) {
+            float* const row = dst[i + k];
+
+            for (int j = 0; j < W; j++) {
+                row[j] = tmp[j * N + k];
+            }
+        }
+    }
+
+    // Remaining rows are done without vectors, the implicit barrier ends the pass
+#ifdef _OPENMP
+    #pragma omp for
+#endif
+
+    for (int i = H - (H % N); i < H; i++) {
+        tmp[0] = src[i][0] * (B + b1 + b2 + b3);
+        tmp[1] = B * src[i][1] + b1 * tmp[0] + src[i][0] * (b2 + b3);
+        tmp[2] = B * src[i][2] + b1 * tmp[1] + b2 * tmp[0] + b3 * src[i][0];
+
+        for (int j = 3; j < W; j++) {
+            tmp[j] = B * src[i][j] + b1 * tmp[j - 1] + b2 * tmp[j - 2] + b3 * tmp[j - 3];
+        }
+
+        const float temp2Wm1 = src[i][W - 1] + c.M[0][0] * (tmp[W - 1] - src[i][W - 1]) + c.M[0][1] * (tmp[W - 2] - src[i][W - 1]) + c.M[0][2] * (tmp[W - 3] - src[i][W - 1]);
+        const float temp2W   = src[i][W - 1] + c.M[1][0] * (tmp[W - 1] - src[i][W - 1]) + c.M[1][1] * (tmp[W - 2] - src[i][W - 1]) + c.M[1][2] * (tmp[W - 3] - src[i][W - 1]);
+        const float temp2Wp1 = src[i][W - 1] + c.M[2][0] * (tmp[W - 1] - src[i][W - 1]) + c.M[2][1] * (tmp[W - 2] - src[i][W - 1]) + c.M[2][2] * (tmp[W - 3] - src[i][W - 1]);
+
+        tmp[W - 1] = temp2Wm1;
+        tmp[W - 2] = B * tmp[W - 2] + b1 * tmp[W - 1] + b2 * temp2W + b3 * temp2Wp1;
+        tmp[W - 3] = B * tmp[W - 3] + b1 * tmp[W - 2] + b2 * tmp[W - 1] + b3 * temp2W;
+
+        for (int j = W - 4; j >= 0; j--) {
+            tmp[j] = B * tmp[j] + b1 * tmp[j + 1] + b2 * tmp[j + 2] + b3 * tmp[j + 3];
+        }
+
+        for (int j = 0; j < W; j++) {
+            dst[i][j] = tmp[j];
+        }
+    }
+
+    delete [] tmp;
+}
+
+void gaussVertical (float** src, float** dst, float** divBuffer, const int W, const int H, const GaussIIRCoeffs& c, eGaussType gausstype)
+{
+    switch (gausstype) {
+    case GAUSS_MULT:
+        gaussVerticalImpl<GAUSS_MULT> (src, dst, divBuffer, W, H, c);
+        break;
+
+    case GAUSS_DIV:
+        gaussVerticalImpl<GAUSS_DIV> (src, dst, divBuffer, W, H, c);
+        break;
+
+    case GAUSS_STANDARD:
+        gaussVerticalImpl<GAUSS_STANDARD> (src, dst, divBuffer, W, H, c);
+        break;
+    }
+}
+
+}
+
+}
@@ -772,6 +772,26 @@ uint8_t ICCStore::getProofIntents (cmsHPROFILE profile) const
     return getSupportedIntents (profile, LCMS_USED_AS_PROOF);
 }
 
+bool ICCStore::isStoreProfile (cmsHPROFILE profile) const
+{
+    MyMutex::MyLock lock (mutex_);
+
+    if (profile == xyz || profile == srgb) {
+        return true;
+    }
+
+    // init drops the profiles of the former directories from the maps, but doesn't close them
+    for (const ProfileMap* profiles : {&wProfiles, &wProfilesGamma, &fileProfiles, &fileStdProfiles}) {
+        for (const auto& entry : *profiles) {
+            if (entry.second == profile) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
 // Reads all profiles from the given profiles dir
 void ICCStore::init (const Glib::ustring& usrICCDir, const Glib::ustring& rtICCDir)
 {
@@ -128,6 +128,9 @@ public:
     uint8_t     getInputIntents  (const Glib::ustring& name) const;
     uint8_t     getOutputIntents (const Glib::ustring& name) const;
     uint8_t     getProofIntents  (const Glib::ustring& name) const;
+
+    // true if the profile is one of the store, these are never closed
+    bool        isStoreProfile   (cmsHPROFILE profile) const;
 };
 
 #define iccStore ICCStore::getInstance()
@@ -19,6 +19,7 @@
 #ifndef _IIMAGE_
 #define _IIMAGE_
 
+#include <string>
 #include <glibmm.h>
 #include <vector>
 #include "rt_math.h"
@@ -1145,6 +1146,16 @@ public:
         }
     }
 
+    // Append a raw dump of the data to a buffer, in the same layout as writeData
+    void writeData  (std::string& buffer)
+    {
+        for (T** plane : {r.ptrs, g.ptrs, b.ptrs}) {
+            for (int i = 0; i < height; i++) {
+                buffer.append (reinterpret_cast<const char*>(plane[i]), sizeof(T) * width);
+            }
+        }
+    }
+
 };
 
 // --------------------------------------------------------------------
@@ -1705,6 +1716,14 @@ public:
         }
     }
 
+    // Append a raw dump of the data to a buffer, in the same layout as writeData
+    void writeData  (std::string& buffer)
+    {
+        for (int i = 0; i < height; i++) {
+            buffer.append (reinterpret_cast<const char*>(r(i)), sizeof(T) * 3 * width);
+        }
+    }
+
 };
 
 // --------------------------------------------------------------------
@@ -29,6 +29,19 @@ extern "C" IptcData *iptc_data_new_from_jpeg_file (FILE* infile);
 namespace
 {
 
+// The tags are scattered over the first part of the file: reading it by large blocks saves most of the seeks
+// and small reads of the parser, which matters when browsing directories on slow or remote disks
+FILE* openMetaData (const Glib::ustring& fname)
+{
+    FILE* const f = g_fopen (fname.c_str (), "rb");
+
+    if (f) {
+        setvbuf (f, nullptr, _IOFBF, 64 * 1024);
+    }
+
+    return f;
+}
+
 Glib::ustring to_utf8 (const std::string& str)
 {
     try {
@@ -52,7 +65,7 @@ ImageData::ImageData (Glib::ustring fname, RawMetaDataLocation* ri) : iso_speed(
     iptc = nullptr;
 
     if (ri && (ri->exifBase >= 0 || ri->ciffBase >= 0)) {
-        FILE* f = g_fopen (fname.c_str (), "rb");
+        FILE* f = openMetaData (fname);
 
         if (f) {
             if (ri->exifBase >= 0) {
@@ -73,7 +86,7 @@ ImageData::ImageData (Glib::ustring fname, RawMetaDataLocation* ri) : iso_speed(
             extractInfo ();
         }
     } else if (hasJpegExtension(fname)) {
-        FILE* f = g_fopen (fname.c_str (), "rb");
+        FILE* f = openMetaData (fname);
 
         if (f) {
             root = rtexif::ExifManager::parseJPEG (f);
@@ -84,7 +97,7 @@ ImageData::ImageData (Glib::ustring fname, RawMetaDataLocation* ri) : iso_speed(
             fclose (ff);
         }
     } else if (hasTiffExtension(fname)) {
-        FILE* f = g_fopen (fname.c_str (), "rb");
+        FILE* f = openMetaData (fname);
 
         if (f) {
             root = rtexif::ExifManager::parseTIFF (f);
@@ -448,7 +448,7 @@ void my_error_exit (j_common_ptr cinfo)
 }
 
 
-int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize)
+int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize, int minW, int minH)
 {
     jpeg_decompress_struct cinfo;
     jpeg_create_decompress(&cinfo);
@@ -499,6 +499,17 @@ int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize)
         embProfile = nullptr;
     }
 
+    if (minW > 0 || minH > 0) {
+        // scaling in the DCT domain skips most of the inverse transform, which makes it much faster than decoding the whole image
+        for (unsigned int denom = 8; denom > 1; denom /= 2) {
+            if ((cinfo.image_width + denom - 1) / denom >= (unsigned int)minW && (cinfo.image_height + denom - 1) / denom >= (unsigned int)minH) {
+                cinfo.scale_num = 1;
+                cinfo.scale_denom = denom;
+                break;
+            }
+        }
+    }
+
     jpeg_start_decompress(&cinfo);
 
     unsigned int width = cinfo.output_width;
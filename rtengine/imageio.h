@@ -157,7 +157,8 @@ public:
     static int getPNGSampleFormat  (Glib::ustring fname, IIOSampleFormat &sFormat, IIOSampleArrangement &sArrangement);
     static int getTIFFSampleFormat (Glib::ustring fname, IIOSampleFormat &sFormat, IIOSampleArrangement &sArrangement);
 
-    int loadJPEGFromMemory (const char* buffer, int bufsize);
+    /** @param minW, minH if not 0, the image is downscaled by a power of two when decoded, as long as it remains at least that large */
+    int loadJPEGFromMemory (const char* buffer, int bufsize, int minW = 0, int minH = 0);
     int loadPPMFromMemory(const char* buffer, int width, int height, bool swap, int bps);
 
     int savePNG  (Glib::ustring fname, int compression = -1, volatile int bps = -1);
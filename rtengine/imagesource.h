@@ -31,6 +31,7 @@
 #include "image8.h"
 #include "image16.h"
 #include "imagefloat.h"
+#include "canceltoken.h"
 
 namespace rtengine
 {
@@ -60,10 +61,11 @@ protected:
     ImageData* idata;
     ImageMatrices imatrices;
     double dirpyrdenoiseExpComp;
+    const CancelToken* cancelToken;
 
 public:
     ImageSource () : references (1), redAWBMul(-1.), greenAWBMul(-1.), blueAWBMul(-1.),
-        embProfile(nullptr), idata(nullptr), dirpyrdenoiseExpComp(INFINITY) {}
+        embProfile(nullptr), idata(nullptr), dirpyrdenoiseExpComp(INFINITY), cancelToken(nullptr) {}
 
     virtual ~ImageSource            () {}
     virtual int         load        (const Glib::ustring &fname, bool batch = false) = 0;
@@ -116,6 +118,12 @@ public:
 
     virtual void        setProgressListener (ProgressListener* pl) {}
 
+    // the costly demosaicers stop early once the token is cancelled, leaving the demosaiced data incomplete
+    void        setCancelToken (const CancelToken* token)
+    {
+        cancelToken = token;
+    }
+
     void        increaseRef ()
     {
         references++;
@@ -24,6 +24,9 @@
 #include "colortemp.h"
 #include "improcfun.h"
 #include "iccstore.h"
+#include "profiler.h"
+#include <algorithm>
+#include <utility>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -32,11 +35,55 @@ namespace rtengine
 
 extern const Settings* settings;
 
+namespace
+{
+
+// The progressive updates start when an update of the preview takes longer than this, in ms
+constexpr int progressiveUpdateTime = 300;
+// The coarse update is done at this fraction of the scale of the preview, i.e. with about 1/9 of its pixels
+constexpr int coarseScaleFactor = 3;
+
+// The stages of updatePreviewImage, with the groups of the pp3 file of the tools they read. They are derived from
+// refreshmap and refreshgroups: the values changed by an event are read by the first stage the event refreshes, the
+// following ones run anyway when it does. The tools which only work at 100% (sharpening, impulse denoise...) are done
+// by the crops only.
+std::vector<PipelineCache::Stage> previewStages ()
+{
+    // in processing order
+    std::vector<PipelineCache::Stage> stages = {
+        {M_PREPROC, {}}, {M_RAW, {}}, {M_RETINEX, {}}, {M_INIT | M_LINDENOISE, {}}, {M_TRANSFORM, {}}, {M_BLURMAP, {}},
+        {M_AUTOEXP, {}}, {M_RGBCURVE, {}}, {M_LUMACURVE, {}}, {M_LUMINANCE | M_COLOR, {}}
+    };
+
+    for (int event = 0; event < NUMOFEVENTS; ++event) {
+        for (auto& stage : stages) {
+            if (!(refreshmap[event] & stage.refresh)) {
+                continue;
+            }
+
+            std::vector<Glib::ustring> groups = Glib::Regex::split_simple (";", refreshgroups[event]);
+
+            for (const auto& group : groups) {
+                if (!group.empty () && std::find (stage.groups.begin (), stage.groups.end (), group) == stage.groups.end ()) {
+                    stage.groups.push_back (group);
+                }
+            }
+
+            break;
+        }
+    }
+
+    return stages;
+}
+}
+
+}
+
 ImProcCoordinator::ImProcCoordinator ()
     : orig_prev(nullptr), oprevi(nullptr), oprevl(nullptr), nprevl(nullptr), previmg(nullptr), workimg(nullptr),
       ncie(nullptr), imgsrc(nullptr), shmap(nullptr), lastAwbEqual(0.), lastAwbTempBias(0.0), ipf(&params, true), monitorIntent(RI_RELATIVE),
-      softProof(false), gamutCheck(false), scale(10), highDetailPreprocessComputed(false), highDetailRawComputed(false),
-      allocated(false), bwAutoR(-9000.f), bwAutoG(-9000.f), bwAutoB(-9000.f), CAMMean(NAN),
+      softProof(false), gamutCheck(false), scale(10), previewScale(10), highDetailPreprocessComputed(false), highDetailRawComputed(false), demosaicAbandoned(false),
+      allocated(false), pipelineCache(previewStages ()), bwAutoR(-9000.f), bwAutoG(-9000.f), bwAutoB(-9000.f), CAMMean(NAN),
 
       ctColorCurve(),
       hltonecurve(65536),
@@ -88,13 +135,41 @@ ImProcCoordinator::ImProcCoordinator ()
       fullw(1), fullh(1),
       pW(-1), pH(-1),
       plistener(nullptr), imageListener(nullptr), aeListener(nullptr), acListener(nullptr), abwListener(nullptr), awbListener(nullptr), actListener(nullptr), adnListener(nullptr), awavListener(nullptr), dehaListener(nullptr), hListener(nullptr),
-      resultValid(false), lastOutputProfile("BADFOOD"), lastOutputIntent(RI__COUNT), lastOutputBPC(false), thread(nullptr), changeSinceLast(0), updaterRunning(false), destroying(false), utili(false), autili(false), wavcontlutili(false),
+      resultValid(false), previmgShown(false), replacedPrevimg(nullptr), shownPrevimg(nullptr), otherBuffers(previewStages ()), lastOutputProfile("BADFOOD"), lastOutputIntent(RI__COUNT), lastOutputBPC(false), thread(nullptr), changeSinceLast(0), updaterRunning(false), destroying(false), utili(false), autili(false), wavcontlutili(false),
       butili(false), ccutili(false), cclutili(false), clcutili(false), opautili(false), conversionBuffer(1, 1), colourToningSatLimit(0.f), colourToningSatLimitOpacity(0.f)
+{
+    // the long stages of the updates, of the preview and of the crops, stop as soon as new parameters come in, see process
+    ipf.setCancelToken (&cancelToken);
+}
+
+ImProcCoordinator::PreviewBuffers::PreviewBuffers (const std::vector<PipelineCache::Stage>& stages)
+    : orig_prev(nullptr), oprevi(nullptr), oprevl(nullptr), nprevl(nullptr), previmg(nullptr), workimg(nullptr), ncie(nullptr), shmap(nullptr),
+      scale(10), pW(-1), pH(-1), allocated(false), resultValid(false), previmgShown(false), pipelineCache(stages)
 {}
 
+void ImProcCoordinator::swapBuffers ()
+{
+    std::swap (orig_prev, otherBuffers.orig_prev);
+    std::swap (oprevi, otherBuffers.oprevi);
+    std::swap (oprevl, otherBuffers.oprevl);
+    std::swap (nprevl, otherBuffers.nprevl);
+    std::swap (previmg, otherBuffers.previmg);
+    std::swap (workimg, otherBuffers.workimg);
+    std::swap (ncie, otherBuffers.ncie);
+    std::swap (shmap, otherBuffers.shmap);
+    std::swap (scale, otherBuffers.scale);
+    std::swap (pW, otherBuffers.pW);
+    std::swap (pH, otherBuffers.pH);
+    std::swap (allocated, otherBuffers.allocated);
+    std::swap (resultValid, otherBuffers.resultValid);
+    std::swap (previmgShown, otherBuffers.previmgShown);
+    pipelineCache.swap (otherBuffers.pipelineCache);
+}
+
 void ImProcCoordinator::assign (ImageSource* imgsrc)
 {
     this->imgsrc = imgsrc;
+    imgsrc->setCancelToken (&cancelToken);
 }
 
 ImProcCoordinator::~ImProcCoordinator ()
@@ -111,12 +186,22 @@ ImProcCoordinator::~ImProcCoordinator ()
     mProcessing.unlock();
     freeAll ();
 
+    // and the ones of the coarse updates
+    swapBuffers ();
+    freeAll ();
+    swapBuffers ();
+
+    if (replacedPrevimg) {
+        imageListener->delImage (replacedPrevimg);
+    }
+
     std::vector<Crop*> toDel = crops;
 
     for (size_t i = 0; i < toDel.size(); i++) {
         delete toDel[i];
     }
 
+    imgsrc->setCancelToken (nullptr);
     imgsrc->decreaseRef ();
     updaterThreadStart.unlock ();
 }
@@ -130,10 +215,45 @@ DetailedCrop* ImProcCoordinator::createCrop  (::EditDataProvider *editDataProvid
 
 // todo: bitmask containing desired actions, taken from changesSinceLast
 // cropCall: calling crop, used to prevent self-updates  ...doesn't seem to be used
-void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
+bool ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall, bool coarse, int* stagesRun)
 {
 
     MyMutex::MyLock processingLock(mProcessing);
+    ProfileStage totalStage ("updatePreviewImage", "total");
+
+    // A coarse update works on its own buffers, which are exchanged with the ones of the preview until it returns
+    class UpdateScope
+    {
+    public:
+        UpdateScope (ImProcCoordinator* coordinator, bool coarse, const int& todo, int* stagesRun) :
+            coordinator (coordinator), coarse (coarse), todo (todo), stagesRun (stagesRun)
+        {
+            if (coarse) {
+                coordinator->swapBuffers ();
+            }
+        }
+
+        ~UpdateScope ()
+        {
+            if (coarse) {
+                coordinator->swapBuffers ();
+            }
+
+            if (stagesRun) {
+                *stagesRun = todo;
+            }
+        }
+
+    private:
+        ImProcCoordinator* const coordinator;
+        const bool coarse;
+        const int& todo;
+        int* const stagesRun;
+    } updateScope (this, coarse, todo, stagesRun);
+
+    MyTime startTime;
+    startTime.set ();
+
     int numofphases = 14;
     int readyphase = 0;
 
@@ -143,6 +263,18 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
         todo |= TRANSFORM;    // Change about Crop does affect TRANSFORM
     }
 
+    // The crops get the bits of the events, they do tools which aren't done here
+    const int requested = todo;
+
+    if (todo & (M_INIT | M_LINDENOISE)) {
+        // the scale of the preview is part of the state of the cache, which setScale resets when it reallocates the
+        // buffers, so it has to be set first
+        MyMutex::MyLock initLock(minit);  // Also used in crop window
+        setScale (coarse ? previewScale * coarseScaleFactor : previewScale, coarse);
+    }
+
+    todo = pipelineCache.update (todo, params, scale);
+
     bool highDetailNeeded = false;
 
     if (options.prevdemo == PD_Sidecar) {
@@ -185,8 +317,11 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
 
     // raw auto CA is bypassed if no high detail is needed, so we have to compute it when high detail is needed
     if ( (todo & M_PREPROC) || (!highDetailPreprocessComputed && highDetailNeeded)) {
+        ProfileStage preprocessStage ("updatePreviewImage", "preprocess");
         imgsrc->preprocess( rp, params.lensProf, params.coarse );
         imgsrc->getRAWHistogram( histRedRaw, histGreenRaw, histBlueRaw );
+        // the raw data is shared by the buffers of both scales
+        otherBuffers.pipelineCache.invalidate ();
 
         if (highDetailNeeded) {
             highDetailPreprocessComputed = true;
@@ -209,6 +344,7 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
 
     if (   (todo & M_RAW)
             || (!highDetailRawComputed && highDetailNeeded)
+            || demosaicAbandoned
             || ( params.toneCurve.hrenabled && params.toneCurve.method != "Color" && imgsrc->IsrgbSourceModified())
             || (!params.toneCurve.hrenabled && params.toneCurve.method == "Color" && imgsrc->IsrgbSourceModified())) {
 
@@ -220,9 +356,21 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
             }
         }
 
+        ProfileStage demosaicStage ("updatePreviewImage", "demosaic");
         imgsrc->demosaic( rp);//enabled demosaic
-        // if a demosaic happened we should also call getimage later, so we need to set the M_INIT flag
-        todo |= M_INIT;
+        demosaicStage.stop ();
+
+        otherBuffers.pipelineCache.invalidate ();
+
+        // the demosaiced data may be incomplete, it is done again by the next update whatever its stages
+        demosaicAbandoned = abandoned ();
+
+        if (demosaicAbandoned) {
+            return false;
+        }
+
+        // if a demosaic happened we should also call getimage later, so we need to set the M_INIT flag, and the following ones
+        todo |= ALLNORAW;
 
         if (highDetailNeeded) {
             highDetailRawComputed = true;
@@ -239,6 +387,7 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
     }
 
     if ((todo & (M_RETINEX | M_INIT)) && params.retinex.enabled) {
+        ProfileStage retinexStage ("updatePreviewImage", "retinex");
         bool dehacontlutili = false;
         bool mapcontlutili = false;
         bool useHsl = false;
@@ -252,6 +401,10 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
         if(dehaListener) {
             dehaListener->minmaxChanged(maxCD, minCD, mini, maxi, Tmean, Tsigma, Tmin, Tmax);
         }
+
+        if (todo & M_RETINEX) {
+            otherBuffers.pipelineCache.invalidate ();
+        }
     }
 
 
@@ -264,7 +417,7 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
                 params.toneCurve.hrenabled = true;
 
                 // forcing INIT to be done, to reconstruct HL again
-                todo |= M_INIT;
+                todo |= ALLNORAW;
             }
         }
     }
@@ -315,13 +468,14 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
 
         imgsrc->getFullSize (fw, fh, tr);
 
-        // Will (re)allocate the preview's buffers
-        setScale (scale);
+        // the buffers of the preview have been (re)allocated by setScale above
         PreviewProps pp (0, 0, fw, fh, scale);
         // Tells to the ImProcFunctions' tools what is the preview scale, which may lead to some simplifications
         ipf.setScale (scale);
 
+        ProfileStage getImageStage ("updatePreviewImage", "getImage");
         imgsrc->getImage (currWB, tr, orig_prev, pp, params.toneCurve, params.icm, params.raw);
+        getImageStage.stop ();
         denoiseInfoStore.valid = false;
         //ColorTemp::CAT02 (orig_prev, &params) ;
         //   printf("orig_prevW=%d\n  scale=%d",orig_prev->width, scale);
@@ -374,31 +528,40 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
     readyphase++;
 
     progress ("Rotate / Distortion...", 100 * readyphase / numofphases);
-    // Remove transformation if unneeded
-    bool needstransform = ipf.needsTransform();
-
-    if (!needstransform && !((todo & (M_TRANSFORM | M_RGBCURVE))  && params.dirpyrequalizer.cbdlMethod == "bef" && params.dirpyrequalizer.enabled && !params.colorappearance.enabled) && orig_prev != oprevi) {
-        delete oprevi;
-        oprevi = orig_prev;
-    }
+    // oprevi is kept until orig_prev or the transformation change, it's orig_prev itself if there's nothing to do
+    if (todo & M_TRANSFORM) {
+        bool needstransform = ipf.needsTransform();
+        bool cbdlBefore = params.dirpyrequalizer.cbdlMethod == "bef" && params.dirpyrequalizer.enabled && !params.colorappearance.enabled;
+
+        if (!needstransform && !cbdlBefore) {
+            if (orig_prev != oprevi) {
+                delete oprevi;
+                oprevi = orig_prev;
+            }
+        } else {
+            if(!oprevi || oprevi == orig_prev)
+                oprevi = new Imagefloat (pW, pH);
+            if (needstransform) {
+                ProfileStage transformStage ("updatePreviewImage", "transform");
+                ipf.transform (orig_prev, oprevi, 0, 0, 0, 0, pW, pH, fw, fh, imgsrc->getMetaData()->getFocalLen(),
+                               imgsrc->getMetaData()->getFocalLen35mm(), imgsrc->getMetaData()->getFocusDist(), imgsrc->getRotateDegree(), false);
+            } else
+                orig_prev->copyData(oprevi);
+        }
 
-    if ((needstransform || ((todo & (M_TRANSFORM | M_RGBCURVE))  && params.dirpyrequalizer.cbdlMethod == "bef" && params.dirpyrequalizer.enabled && !params.colorappearance.enabled)) ) {
-        if(!oprevi || oprevi == orig_prev)
-            oprevi = new Imagefloat (pW, pH);
-        if (needstransform)
-            ipf.transform (orig_prev, oprevi, 0, 0, 0, 0, pW, pH, fw, fh, imgsrc->getMetaData()->getFocalLen(),
-                           imgsrc->getMetaData()->getFocalLen35mm(), imgsrc->getMetaData()->getFocusDist(), imgsrc->getRotateDegree(), false);
-        else
-            orig_prev->copyData(oprevi);
+        if (cbdlBefore) {
+            ProfileStage cbdlStage ("updatePreviewImage", "dirpyrequalizer");
+            const int W = oprevi->getWidth();
+            const int H = oprevi->getHeight();
+            LabImage labcbdl(W, H);
+            ipf.rgb2lab(*oprevi, labcbdl, params.icm.working);
+            ipf.dirpyrequalizer (&labcbdl, scale);
+            ipf.lab2rgb(labcbdl, *oprevi, params.icm.working);
+        }
     }
 
-    if ((todo & (M_TRANSFORM | M_RGBCURVE))  && params.dirpyrequalizer.cbdlMethod == "bef" && params.dirpyrequalizer.enabled && !params.colorappearance.enabled) {
-        const int W = oprevi->getWidth();
-        const int H = oprevi->getHeight();
-        LabImage labcbdl(W, H);
-        ipf.rgb2lab(*oprevi, labcbdl, params.icm.working);
-        ipf.dirpyrequalizer (&labcbdl, scale);
-        ipf.lab2rgb(labcbdl, *oprevi, params.icm.working);
+    if (abandoned ()) {
+        return false;
     }
 
     readyphase++;
@@ -416,6 +579,7 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
             shmap = new SHMap (pW, pH, true);
         }
 
+        ProfileStage shmapStage ("updatePreviewImage", "shmap");
         shmap->update (oprevi, shradius, ipf.lumimul, params.sh.hq, scale);
     }
 
@@ -439,6 +603,10 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
 
     progress ("Exposure curve & CIELAB conversion...", 100 * readyphase / numofphases);
 
+    if (abandoned ()) {
+        return false;
+    }
+
     if ((todo & M_RGBCURVE) || (todo & M_CROP)) {
 //        if (hListener) oprevi->calcCroppedHistogram(params, scale, histCropped);
 
@@ -543,6 +711,7 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
             DCPProfile::ApplyState as;
             DCPProfile *dcpProf = imgsrc->getDCP(params.icm, currWB, as);
 
+            ProfileStage rgbProcStage ("updatePreviewImage", "rgbProc");
             ipf.rgbProc (oprevi, oprevl, nullptr, hltonecurve, shtonecurve, tonecurve, shmap, params.toneCurve.saturation,
                          rCurve, gCurve, bCurve, colourToningSatLimit , colourToningSatLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, beforeToneCurveBW, afterToneCurveBW, rrm, ggm, bbm, bwAutoR, bwAutoG, bwAutoB, params.toneCurve.expcomp, params.toneCurve.hlcompr, params.toneCurve.hlcomprthresh, dcpProf, as, histToneCurve);
 
@@ -608,6 +777,10 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
                                        params.labCurve.lccurve, chroma_acurve, chroma_bcurve, satcurve, lhskcurve, scale == 1 ? 1 : 16);
     }
 
+    if (abandoned ()) {
+        return false;
+    }
+
     if (todo & (M_LUMINANCE + M_COLOR) ) {
         nprevl->CopyFrom(oprevl);
 
@@ -615,10 +788,15 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
         //   ipf.MSR(nprevl, nprevl->W, nprevl->H, 1);
         histCCurve.clear();
         histLCurve.clear();
+        ProfileStage labCurveStage ("updatePreviewImage", "chromiLuminanceCurve");
         ipf.chromiLuminanceCurve (nullptr, pW, nprevl, nprevl, chroma_acurve, chroma_bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, histCCurve, histLCurve);
+        labCurveStage.stop ();
+        ProfileStage vibranceStage ("updatePreviewImage", "vibrance");
         ipf.vibrance(nprevl);
+        vibranceStage.stop ();
 
         if((params.colorappearance.enabled && !params.colorappearance.tonecie) ||  (!params.colorappearance.enabled)) {
+            ProfileStage epdStage ("updatePreviewImage", "EPDToneMap");
             ipf.EPDToneMap(nprevl, 5, 1);
         }
 
@@ -668,6 +846,7 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
         if(params.dirpyrequalizer.cbdlMethod == "aft") {
             if(((params.colorappearance.enabled && !settings->autocielab) || (!params.colorappearance.enabled)) ) {
                 progress ("Pyramid wavelet...", 100 * readyphase / numofphases);
+                ProfileStage cbdlStage ("updatePreviewImage", "dirpyrequalizer");
                 ipf.dirpyrequalizer (nprevl, scale);
                 //ipf.Lanczoslab (ip_wavelet(LabImage * lab, LabImage * dst, const procparams::EqualizerParams & eqparams), nprevl, 1.f/scale);
                 readyphase++;
@@ -680,6 +859,10 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
         CurveFactory::curveWavContL(wavcontlutili, params.wavelet.wavclCurve, wavclCurve, scale == 1 ? 1 : 16);
 
 
+        if (abandoned ()) {
+            return false;
+        }
+
         if((params.wavelet.enabled)) {
             WaveletParams WaveParams = params.wavelet;
             //      WaveParams.getCurves(wavCLVCurve, waOpacityCurveRG, waOpacityCurveBY);
@@ -688,11 +871,16 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
             int kall = 0;
             progress ("Wavelet...", 100 * readyphase / numofphases);
             //  ipf.ip_wavelet(nprevl, nprevl, kall, WaveParams, wavCLVCurve, waOpacityCurveRG, waOpacityCurveBY, scale);
+            ProfileStage waveletStage ("updatePreviewImage", "ip_wavelet");
             ipf.ip_wavelet(nprevl, nprevl, kall, WaveParams, wavCLVCurve, waOpacityCurveRG, waOpacityCurveBY, waOpacityCurveW, waOpacityCurveWL, wavclCurve, wavcontlutili, scale);
 
         }
 
 
+        if (abandoned ()) {
+            return false;
+        }
+
         if(params.colorappearance.enabled) {
             //L histo  and Chroma histo for ciecam
             // histogram well be for Lab (Lch) values, because very difficult to do with J,Q, M, s, C
@@ -752,7 +940,9 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
             CAMBrightCurveJ.dirty = true;
             CAMBrightCurveQ.dirty = true;
 
+            ProfileStage ciecamStage ("updatePreviewImage", "ciecam_02float");
             ipf.ciecam_02float (ncie, float(adap), begh, endh, pW, 2, nprevl, &params, customColCurve1, customColCurve2, customColCurve3, histLCAM, histCCAM, CAMBrightCurveJ, CAMBrightCurveQ, CAMMean, 5, 1, execsharp, d, scale, 1);
+            ciecamStage.stop ();
 
             if(params.colorappearance.autodegree && acListener && params.colorappearance.enabled) {
                 acListener->autoCamChanged(100.*(double)d);
@@ -789,16 +979,35 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
         ipf.updateColorProfiles(monitorProfile, monitorIntent, softProof, gamutCheck);
     }
 
-    // process crop, if needed
-    for (size_t i = 0; i < crops.size(); i++)
-        if (crops[i]->hasListener () && cropCall != crops[i] ) {
-            crops[i]->update (todo);    // may call ourselves
+    if (abandoned ()) {
+        return false;
+    }
+
+    // the duration of the stages which ran, see process
+    MyTime endTime;
+    endTime.set ();
+
+    // process crop, if needed; the detail windows are left to the refined update
+    if (!coarse) {
+        for (size_t i = 0; i < crops.size(); i++)
+            if (crops[i]->hasListener () && cropCall != crops[i] ) {
+                crops[i]->update (todo | requested);    // may call ourselves
+            }
+
+        // the crops dropped their result
+        if (abandoned ()) {
+            return false;
         }
+    }
 
     progress ("Conversion to RGB...", 100 * readyphase / numofphases);
 
-    if ((todo != CROP && todo != MINUPDATE) || (todo & M_MONITOR)) {
+    // nothing changed if the requested stages were all up to date
+    const bool upToDate = (requested & ALL) && !(todo & ALL);
+
+    if ((todo != CROP && todo != MINUPDATE && !upToDate) || (todo & M_MONITOR)) {
         MyMutex::MyLock prevImgLock(previmg->getMutex());
+        ProfileStage lab2rgbStage ("updatePreviewImage", "lab2monitorRgb");
 
         try {
             // Computing the preview image, i.e. converting from WCS->Monitor color space (soft-proofing disabled) or WCS->Printer profile->Monitor color space (soft-proofing enabled)
@@ -809,15 +1018,20 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
             workimg = ipf.lab2rgb (nprevl, 0, 0, pW, pH, params.icm);
         } catch(char * str) {
             progress ("Error converting file...", 0);
-            return;
+            return true;
         }
     }
 
-    if (!resultValid) {
+    pipelineCache.done (todo, params, endTime.etime (startTime) / 1000);
+
+    // the listener may show the image of the other scale
+    if (!resultValid || shownPrevimg != previmg) {
         resultValid = true;
 
         if (imageListener) {
             imageListener->setImage (previmg, scale, params.crop);
+            previmgShown = true;
+            shownPrevimg = previmg;
         }
     }
 
@@ -825,6 +1039,12 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
         // TODO: The WB tool should be advertised too in order to get the AutoWB's temp and green values
     {
         imageListener->imageReady (params.crop);
+
+        // the new image is shown, the listener can drop the former one
+        if (replacedPrevimg) {
+            imageListener->delImage (replacedPrevimg);
+            replacedPrevimg = nullptr;
+        }
     }
 
     readyphase++;
@@ -833,6 +1053,8 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
         updateLRGBHistograms ();
         hListener->histogramChanged (histRed, histGreen, histBlue, histLuma, histToneCurve, histLCurve, histCCurve, /*histCLurve, histLLCurve,*/ histLCAM, histCCAM, histRedRaw, histGreenRaw, histBlueRaw, histChroma, histLRETI);
     }
+
+    return true;
 }
 
 
@@ -862,12 +1084,23 @@ void ImProcCoordinator::freeAll ()
 
         ncie      = nullptr;
 
-        if (imageListener) {
-            imageListener->delImage (previmg);
+        if (imageListener && previmgShown) {
+            // it stays on screen until the image of the new buffers is set, see updatePreviewImage
+            if (replacedPrevimg) {
+                imageListener->delImage (replacedPrevimg);
+            }
+
+            replacedPrevimg = previmg;
         } else {
             delete previmg;
         }
 
+        if (shownPrevimg == previmg) {
+            shownPrevimg = nullptr;
+        }
+
+        previmg = nullptr;
+
         delete workimg;
 
         if(shmap) {
@@ -879,6 +1112,7 @@ void ImProcCoordinator::freeAll ()
     }
 
     allocated = false;
+    pipelineCache.invalidate ();
 }
 
 /** @brief Handles image buffer (re)allocation and trigger sizeChanged of SizeListener[s]
@@ -886,8 +1120,9 @@ void ImProcCoordinator::freeAll ()
  * It will then tell to the SizeListener that size has changed (sizeChanged)
  *
  * @param prevscale New Preview's scale.
+ * @param coarse true for the coarse update of a progressive update, prevscale is then used as is
  */
-void ImProcCoordinator::setScale (int prevscale)
+void ImProcCoordinator::setScale (int prevscale, bool coarse)
 {
 
     if (settings->verbose) {
@@ -899,13 +1134,20 @@ void ImProcCoordinator::setScale (int prevscale)
     int nW, nH;
     imgsrc->getFullSize (fw, fh, tr);
 
-    prevscale++;
-
-    do {
-        prevscale--;
+    if (coarse) {
         PreviewProps pp (0, 0, fw, fh, prevscale);
         imgsrc->getSize (pp, nW, nH);
-    } while(nH < 400 && prevscale > 1 && (nW * nH < 1000000) ); // sctually hardcoded values, perhaps a better choice is possible
+    } else {
+        prevscale++;
+
+        do {
+            prevscale--;
+            PreviewProps pp (0, 0, fw, fh, prevscale);
+            imgsrc->getSize (pp, nW, nH);
+        } while(nH < 400 && prevscale > 1 && (nW * nH < 1000000) ); // sctually hardcoded values, perhaps a better choice is possible
+
+        previewScale = prevscale;
+    }
 
     if (settings->verbose) {
         printf ("setscale starts (%d, %d)\n", nW, nH);
@@ -924,6 +1166,7 @@ void ImProcCoordinator::setScale (int prevscale)
         nprevl = new LabImage (pW, pH);
         //ncie is only used in ImProcCoordinator::updatePreviewImage, it will be allocated on first use and deleted if not used anymore
         previmg = new Image8 (pW, pH);
+        previmgShown = false;
         workimg = new Image8 (pW, pH);
 
         if(params.sh.enabled) {
@@ -1163,7 +1406,10 @@ void ImProcCoordinator::saveInputICCReference (const Glib::ustring& fname, bool
     ppar.icm.input = "(none)";
     Imagefloat* im = new Imagefloat (fW, fH);
     imgsrc->preprocess( ppar.raw, ppar.lensProf, ppar.coarse );
+    // the reference image is saved whatever the parameters which come in meanwhile
+    imgsrc->setCancelToken (nullptr);
     imgsrc->demosaic(ppar.raw );
+    imgsrc->setCancelToken (&cancelToken);
     ColorTemp currWB = ColorTemp (params.wb.temperature, params.wb.green, params.wb.equal, params.wb.method);
 
     if (params.wb.method == "Camera") {
@@ -1293,6 +1539,8 @@ void ImProcCoordinator::startProcessing(int changeCode)
 {
     paramsUpdateMutex.lock();
     changeSinceLast |= changeCode;
+    cancelToken.cancel ();
+
     paramsUpdateMutex.unlock();
 
     startProcessing ();
@@ -1310,11 +1558,43 @@ void ImProcCoordinator::process ()
         params = nextParams;
         int change = changeSinceLast;
         changeSinceLast = 0;
+        // the update is abandoned for the next parameters, see endUpdateParams
+        cancelToken.reset ();
         paramsUpdateMutex.unlock ();
 
         // M_VOID means no update, and is a bit higher that the rest
         if (change & (M_VOID - 1)) {
-            updatePreviewImage (change);
+            // When the stages to run took long the last time, e.g. with wavelets or CIECAM, a preview of a fraction of
+            // the resolution is shown first. It has buffers of its own, which keep the outputs of its stages as well.
+            // The raw data is shared by both scales, its changes aren't shown progressively. Both updates are abandoned
+            // as soon as new parameters come in, e.g. while a slider is dragged, and the pending stages are done with
+            // the new parameters.
+            const int pending = imageListener ? pipelineCache.getPending (change, params, previewScale) : 0;
+            const bool progressive = (pending & ALLNORAW) && !(pending & (M_PREPROC | M_RAW | M_RETINEX)) && !demosaicAbandoned
+                                     && pipelineCache.getDuration (pending) > progressiveUpdateTime;
+
+            bool complete = true;
+
+            if (progressive) {
+                const ProcParams requestedParams = params;  // the auto tools may change them
+                int coarseStages = 0;
+                // the stages of the coarse buffers which are out of date run too, the raw data is up to date
+                complete = updatePreviewImage ((change & ~(M_PREPROC | M_RAW | M_RETINEX)) | ALLNORAW, nullptr, true, &coarseStages);
+                params = requestedParams;
+
+                // The curves and histograms computed along the stages which ran are the ones of the coarse scale now,
+                // these stages run again at the scale of the preview. They are the ones the refined update runs anyway,
+                // unless the coarse buffers had to catch up.
+                coarseStages &= ALLNORAW;
+                pipelineCache.invalidate (coarseStages);
+                change |= coarseStages;
+            }
+
+            if (!complete || !updatePreviewImage (change)) {
+                paramsUpdateMutex.lock ();
+                changeSinceLast |= change;
+                paramsUpdateMutex.unlock ();
+            }
         }
 
         paramsUpdateMutex.lock ();
@@ -1343,6 +1623,7 @@ void ImProcCoordinator::endUpdateParams (ProcEvent change)
 void ImProcCoordinator::endUpdateParams (int changeFlags)
 {
     changeSinceLast |= changeFlags;
+    cancelToken.cancel ();
 
     paramsUpdateMutex.unlock ();
     startProcessing ();
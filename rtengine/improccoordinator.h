@@ -19,6 +19,8 @@
 #ifndef _IMPROCCOORDINATOR_H_
 #define _IMPROCCOORDINATOR_H_
 
+#include <atomic>
+
 #include "rtengine.h"
 #include "improcfun.h"
 #include "image8.h"
@@ -27,6 +29,7 @@
 #include "procevents.h"
 #include "dcrop.h"
 #include "LUT.h"
+#include "pipelinecache.h"
 #include "../rtgui/threadutils.h"
 
 namespace rtengine
@@ -79,9 +82,12 @@ protected:
     bool gamutCheck;
 
     int scale;
+    int previewScale;   // of the preview, scale is larger during the coarse update of a progressive update
     bool highDetailPreprocessComputed;
     bool highDetailRawComputed;
+    bool demosaicAbandoned;     // the demosaiced data is incomplete
     bool allocated;
+    PipelineCache pipelineCache;    // drops the stages of the events whose parameters didn't change
 
     void freeAll ();
 
@@ -170,14 +176,46 @@ protected:
     std::vector<Crop*> crops;
 
     bool resultValid;
+    bool previmgShown;          // previmg has been set to the imageListener
+    Image8* replacedPrevimg;    // still shown by the imageListener until the image of the new buffers is set
+    Image8* shownPrevimg;       // the previmg last set to the imageListener, of these buffers or of otherBuffers
+
+    // The buffers of the preview at one scale, with the outputs of the pipeline they hold
+    struct PreviewBuffers {
+        explicit PreviewBuffers (const std::vector<PipelineCache::Stage>& stages);
+
+        Imagefloat* orig_prev;
+        Imagefloat* oprevi;
+        LabImage* oprevl;
+        LabImage* nprevl;
+        Image8* previmg;
+        Image8* workimg;
+        CieImage* ncie;
+        SHMap* shmap;
+        int scale;
+        int pW, pH;
+        bool allocated;
+        bool resultValid;
+        bool previmgShown;
+        PipelineCache pipelineCache;
+    };
+
+    // The buffers of the coarse updates of the progressive updates, exchanged with the ones of the preview while a
+    // coarse update runs, see process
+    PreviewBuffers otherBuffers;
+    void swapBuffers ();
 
     MyMutex minit;  // to gain mutually exclusive access to ... to what exactly?
 
     void progress (Glib::ustring str, int pr);
     void reallocAll ();
     void updateLRGBHistograms ();
-    void setScale (int prevscale);
-    void updatePreviewImage (int todo, Crop* cropCall = nullptr);
+    void setScale (int prevscale, bool coarse = false);
+    /** @param coarse true for the coarse update of a progressive update, see process
+      * @param stagesRun if not null, receives the bits of the stages which ran, or may have run if the update has been
+      * abandoned
+      * @return false if the update has been abandoned for newer parameters */
+    bool updatePreviewImage (int todo, Crop* cropCall = nullptr, bool coarse = false, int* stagesRun = nullptr);
 
     MyMutex mProcessing;
     ProcParams params;
@@ -193,10 +231,11 @@ protected:
     Glib::Thread* thread;
     MyMutex updaterThreadStart;
     MyMutex paramsUpdateMutex;
-    int  changeSinceLast;
+    std::atomic<int> changeSinceLast;
     bool updaterRunning;
     ProcParams nextParams;
     bool destroying;
+    CancelToken cancelToken;        // cancelled when new parameters come in, reset when the update for them starts
     bool utili;
     bool autili;
     bool butili;
@@ -207,6 +246,10 @@ protected:
     bool wavcontlutili;
     void startProcessing ();
     void process ();
+    bool abandoned () const
+    {
+        return cancelToken.isCancelled ();
+    }
     float colourToningSatLimit;
     float colourToningSatLimitOpacity;
 
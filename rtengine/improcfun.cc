@@ -68,6 +68,16 @@ void ImProcFunctions::setScale (double iscale)
     scale = iscale;
 }
 
+void ImProcFunctions::setCancelToken (const CancelToken* token)
+{
+    cancelToken = token;
+}
+
+bool ImProcFunctions::isCancelled () const
+{
+    return cancelToken && cancelToken->isCancelled ();
+}
+
 void ImProcFunctions::updateColorProfiles (const Glib::ustring& monitorProfile, RenderingIntent monitorIntent, bool softProof, bool gamutCheck)
 {
     // set up monitor transform
@@ -1901,6 +1911,7 @@ void ImProcFunctions::ciecam_02float (CieImage* ncie, float adap, int begh, int
 #ifdef __SSE2__
         int bufferLength = ((width + 3) / 4) * 4; // bufferLength has to be a multiple of 4
 #endif
+        CancelCheck cancelCheck (cancelToken, "ciecam_02float", height);
 #ifndef _DEBUG
         #pragma omp parallel
 #endif
@@ -1921,6 +1932,10 @@ void ImProcFunctions::ciecam_02float (CieImage* ncie, float adap, int begh, int
 #endif
 
             for (int i = 0; i < height; i++) {
+                if (cancelCheck.skip ()) {
+                    continue;
+                }
+
 #ifdef __SSE2__
                 // vectorized conversion from Lab to jchqms
                 int k;
@@ -6586,8 +6601,16 @@ void ImProcFunctions::EPDToneMap(LabImage *lab, unsigned int Iterates, int skip)
     fwrite(L, N, sizeof(float), f);
     fclose(f);*/
 
+    // polled per iterate of the blurs, CompressDynamicRange does one blur for small images and rew + 1 otherwise
+    const int blurs = rew > 0 && (lab->W >= 300 || lab->H >= 300) ? int(rew) + 1 : 1;
+    CancelCheck cancelCheck (cancelToken, "EPDToneMap", Iterates * blurs);
+    epd.SetCancelCheck(&cancelCheck);
     epd.CompressDynamicRange(L, sca / float(skip), edgest, Compression, DetailBoost, Iterates, rew, L);
 
+    if (cancelCheck.cancelled ()) {
+        return;
+    }
+
     //Restore past range, also desaturate a bit per Mantiuk's Color correction for tone mapping.
     float s = (1.0f + 38.7889f) * powf(Compression, 1.5856f) / (1.0f + 38.7889f * powf(Compression, 1.5856f));
 #ifdef _OPENMP
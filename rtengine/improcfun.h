@@ -34,6 +34,7 @@
 #include "curves.h"
 #include "cplx_wavelet_dec.h"
 #include "pipettebuffer.h"
+#include "canceltoken.h"
 
 namespace rtengine
 {
@@ -51,6 +52,7 @@ class ImProcFunctions
     const ProcParams* params;
     double scale;
     bool multiThread;
+    const CancelToken* cancelToken;     // polled by the long stages, may be nullptr
 
     void calcVignettingParams(int oW, int oH, const VignettingParams& vignetting, double &w2, double &h2, double& maxRadius, double &v, double &b, double &mul);
 
@@ -196,13 +198,18 @@ public:
     double lumimul[3];
 
     ImProcFunctions       (const ProcParams* iparams, bool imultiThread = true)
-        : monitorTransform(nullptr), lab2outputTransform(nullptr), output2monitorTransform(nullptr), params(iparams), scale(1), multiThread(imultiThread), lumimul{} {}
+        : monitorTransform(nullptr), lab2outputTransform(nullptr), output2monitorTransform(nullptr), params(iparams), scale(1), multiThread(imultiThread), cancelToken(nullptr), lumimul{} {}
     ~ImProcFunctions      ();
 
     void setScale         (double iscale);
+    /** The long stages (RGB_denoise, ip_wavelet, EPDToneMap, ciecam_02float) stop early once the token is cancelled,
+      * see CancelToken. nullptr, the default, makes them run to completion. */
+    void setCancelToken   (const CancelToken* token);
+    bool isCancelled      () const;
 
     bool needsTransform   ();
     bool needsPCVignetting ();
+    bool needsLuminanceOnly (); // true if transform() only scales pixels in place, i.e. doesn't move them
 
     void firstAnalysis    (const Imagefloat* const working, const ProcParams &params, LUTu & vhist16);
     void updateColorProfiles (const Glib::ustring& monitorProfile, RenderingIntent monitorIntent, bool softProof, bool gamutCheck);
@@ -241,7 +248,12 @@ public:
     void lab2monitorRgb   (LabImage* lab, Image8* image);
     void resize           (Image16* src, Image16* dst, float dScale);
     void Lanczos (const LabImage* src, LabImage* dst, float scale);
+    // resamples the rows of dst, which start at row dstTop of the resized image, from the rows of src, which start at
+    // row srcTop of a source image of srcHeight rows: src has to hold the rows given by getLanczosRows
+    void Lanczos (const LabImage* src, LabImage* dst, float scale, int srcTop, int srcHeight, int dstTop);
     void Lanczos (const Image16* src, Image16* dst, float scale);
+    // the rows [srcTop, srcBottom) of the source image which the rows [dstTop, dstBottom) of the resized image are resampled from
+    static void getLanczosRows (float scale, int dstTop, int dstBottom, int srcHeight, int &srcTop, int &srcBottom);
 
     void deconvsharpening (float** luminance, float** buffer, int W, int H, const SharpeningParams &sharpenParam);
     void MLsharpen (LabImage* lab);// Manuel's clarity / sharpening
@@ -16,6 +16,7 @@
  *  You should have received a copy of the GNU General Public License
  *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <cstdio>
 #include "rtengine.h"
 #include "iccstore.h"
 #include "dcp.h"
@@ -27,7 +28,11 @@
 #include "dfmanager.h"
 #include "ffmanager.h"
 #include "rtthumbnail.h"
-#include "../rtgui/profilestore.h"
+#include "profiler.h"
+#include "canceltoken.h"
+#include "cpudispatch.h"
+#include "fftwplancache.h"
+#include "cmstransformcache.h"
 #include "../rtgui/threadutils.h"
 
 namespace rtengine
@@ -40,16 +45,21 @@ MyMutex* lcmsMutex = nullptr;
 int init (const Settings* s, Glib::ustring baseDir, Glib::ustring userSettingsDir)
 {
     settings = s;
+
+    if (settings->verbose) {
+        printf ("Vector kernels: %s\n", getSimdLevelName (getSimdLevel ()));
+    }
+
     iccStore->init (s->iccDirectory, baseDir + "/iccprofiles");
     iccStore->findDefaultMonitorProfile();
     DCPStore::getInstance()->init (baseDir + "/dcpprofiles");
 
     CameraConstantsStore::getInstance ()->init (baseDir, userSettingsDir);
-    profileStore.init ();
     ProcParams::init ();
     Color::init ();
     PerceptualToneCurve::init ();
     RawImageSource::init ();
+    FftwPlanCache::getInstance ()->init ();
     delete lcmsMutex;
     lcmsMutex = new MyMutex;
     dfm.init( s->darkFramesPath );
@@ -59,10 +69,19 @@ int init (const Settings* s, Glib::ustring baseDir, Glib::ustring userSettingsDi
 
 void cleanup ()
 {
+    if (ProfileStage::isEnabled () && !ProfileStage::dump (settings->profileFile)) {
+        printf ("Error: can't write the profile to %s\n", settings->profileFile.c_str ());
+    }
+
+    if (settings->verbose) {
+        CancelCheck::printCounters ();
+    }
 
     ProcParams::cleanup ();
     Color::cleanup ();
     RawImageSource::cleanup ();
+    FftwPlanCache::getInstance ()->cleanup ();
+    CmsTransformCache::getInstance ()->cleanup ();
 }
 
 StagedImageProcessor* StagedImageProcessor::create (InitialImage* initialImage)
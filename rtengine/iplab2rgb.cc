@@ -26,6 +26,7 @@
 #include "curves.h"
 #include "alignedbuffer.h"
 #include "color.h"
+#include "cmstransformcache.h"
 
 namespace rtengine
 {
@@ -167,49 +168,56 @@ Image8* ImProcFunctions::lab2rgb (LabImage* lab, int cx, int cy, int cw, int ch,
             oprofG = ICCStore::makeStdGammaProfile(oprof);
         }
 
-        cmsUInt32Number flags = cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE;
-        if (icm.outputBPC) {
-            flags |= cmsFLAGS_BLACKPOINTCOMPENSATION;
-        }
-        lcmsMutex->lock ();
-        cmsHPROFILE LabIProf  = cmsCreateLab4Profile(nullptr);
-        cmsHTRANSFORM hTransform = cmsCreateTransform (LabIProf, TYPE_Lab_DBL, oprofG, TYPE_RGB_8, icm.outputIntent, flags);  // NOCACHE is important for thread safety
-        cmsCloseProfile(LabIProf);
-        lcmsMutex->unlock ();
-
         unsigned char *data = image->data;
+        const auto conversion = CmsTransformCache::getInstance ()->getLab2Rgb (oprofG, icm.outputIntent, icm.outputBPC);
 
-        // cmsDoTransform is relatively expensive
+        if (conversion) {
+            // matrix/shaper profile, no need for lcms
 #ifdef _OPENMP
-        #pragma omp parallel
+            #pragma omp parallel for schedule(dynamic,16)
 #endif
-        {
-            AlignedBuffer<double> pBuf(3 * cw);
-            double *buffer = pBuf.data;
-            int condition = cy + ch;
 
+            for (int i = cy; i < cy + ch; i++) {
+                conversion->convert (lab->L[i] + cx, lab->a[i] + cx, lab->b[i] + cx, data + i * 3 * cw, cw);
+            }
+        } else {
+            cmsUInt32Number flags = cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE;
+            if (icm.outputBPC) {
+                flags |= cmsFLAGS_BLACKPOINTCOMPENSATION;
+            }
+            const auto transform = CmsTransformCache::getInstance ()->get (CmsTransformCache::getInstance ()->getLabProfile (), TYPE_Lab_DBL, oprofG, TYPE_RGB_8, icm.outputIntent, flags);
+            const cmsHTRANSFORM hTransform = transform.get ();
+
+            // cmsDoTransform is relatively expensive
 #ifdef _OPENMP
-            #pragma omp for firstprivate(lab) schedule(dynamic,16)
+            #pragma omp parallel
 #endif
+            {
+                AlignedBuffer<double> pBuf(3 * cw);
+                double *buffer = pBuf.data;
+                int condition = cy + ch;
 
-            for (int i = cy; i < condition; i++) {
-                const int ix = i * 3 * cw;
-                int iy = 0;
-                float* rL = lab->L[i];
-                float* ra = lab->a[i];
-                float* rb = lab->b[i];
+#ifdef _OPENMP
+                #pragma omp for firstprivate(lab) schedule(dynamic,16)
+#endif
 
-                for (int j = cx; j < cx + cw; j++) {
-                    buffer[iy++] = rL[j] / 327.68f;
-                    buffer[iy++] = ra[j] / 327.68f;
-                    buffer[iy++] = rb[j] / 327.68f;
-                }
+                for (int i = cy; i < condition; i++) {
+                    const int ix = i * 3 * cw;
+                    int iy = 0;
+                    float* rL = lab->L[i];
+                    float* ra = lab->a[i];
+                    float* rb = lab->b[i];
 
-                cmsDoTransform (hTransform, buffer, data + ix, cw);
-            }
-        } // End of parallelization
+                    for (int j = cx; j < cx + cw; j++) {
+                        buffer[iy++] = rL[j] / 327.68f;
+                        buffer[iy++] = ra[j] / 327.68f;
+                        buffer[iy++] = rb[j] / 327.68f;
+                    }
 
-        cmsDeleteTransform(hTransform);
+                    cmsDoTransform (hTransform, buffer, data + ix, cw);
+                }
+            } // End of parallelization
+        }
 
         if (oprofG != oprof) {
             cmsCloseProfile(oprofG);
@@ -294,17 +302,34 @@ Image16* ImProcFunctions::lab2rgb16 (LabImage* lab, int cx, int cy, int cw, int
     }
 
     if (oprof) {
-        cmsUInt32Number flags = cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE;
-        if (icm.outputBPC) {
-            flags |= cmsFLAGS_BLACKPOINTCOMPENSATION;
+        const auto conversion = CmsTransformCache::getInstance ()->getLab2Rgb (oprof, icm.outputIntent, icm.outputBPC);
+
+        if (conversion) {
+            // matrix/shaper profile, which is the case of the usual output profiles
+#ifdef _OPENMP
+            #pragma omp parallel for schedule(dynamic,16) if (multiThread)
+#endif
+
+            for (int i = cy; i < cy + ch; i++) {
+                conversion->convert (lab->L[i] + cx, lab->a[i] + cx, lab->b[i] + cx, image->r(i - cy), image->g(i - cy), image->b(i - cy), cw);
+            }
+        } else {
+            cmsUInt32Number flags = cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE;
+            if (icm.outputBPC) {
+                flags |= cmsFLAGS_BLACKPOINTCOMPENSATION;
+            }
+            const auto transform = CmsTransformCache::getInstance ()->get (CmsTransformCache::getInstance ()->getLabProfile (), TYPE_Lab_FLT, oprof, TYPE_RGB_16, icm.outputIntent, flags);
+
+            if (transform) {
+                image->ExecCMSTransform(transform.get (), *lab, cx, cy);
+            }
         }
-        lcmsMutex->lock ();
-        cmsHPROFILE iprof = cmsCreateLab4Profile(nullptr);
-        cmsHTRANSFORM hTransform = cmsCreateTransform (iprof, TYPE_Lab_FLT, oprof, TYPE_RGB_16, icm.outputIntent, flags);
-        lcmsMutex->unlock ();
 
-        image->ExecCMSTransform(hTransform, *lab, cx, cy);
-        cmsDeleteTransform(hTransform);
+        if (ga) {
+            lcmsMutex->lock ();
+            cmsCloseProfile(oprof);
+            lcmsMutex->unlock ();
+        }
     } else {
 #ifdef _OPENMP
         #pragma omp parallel for schedule(dynamic,16) if (multiThread)
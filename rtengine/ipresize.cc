@@ -171,7 +171,25 @@ void ImProcFunctions::Lanczos(const Image16* src, Image16* dst, float scale)
 }
 
 
-SSEFUNCTION void ImProcFunctions::Lanczos(const LabImage* src, LabImage* dst, float scale)
+void ImProcFunctions::Lanczos(const LabImage* src, LabImage* dst, float scale)
+{
+    Lanczos(src, dst, scale, 0, src->H, 0);
+}
+
+void ImProcFunctions::getLanczosRows(float scale, int dstTop, int dstBottom, int srcHeight, int &srcTop, int &srcBottom)
+{
+    const float delta = 1.0f / scale;
+    const float a = 3.0f;
+    const float sc = min(scale, 1.0f);
+
+    // the same bounds as in Lanczos, widened by a row against the rounding of the centers
+    float y0 = (static_cast<float>(dstTop) + 0.5f) * delta - 0.5f;
+    srcTop = max(0, static_cast<int>(floorf(y0 - a / sc)));
+    y0 = (static_cast<float>(dstBottom - 1) + 0.5f) * delta - 0.5f;
+    srcBottom = min(srcHeight, static_cast<int>(floorf(y0 + a / sc)) + 2);
+}
+
+SSEFUNCTION void ImProcFunctions::Lanczos(const LabImage* src, LabImage* dst, float scale, int srcTop, int srcHeight, int dstTop)
 {
     const float delta = 1.0f / scale;
     const float a = 3.0f;
@@ -230,13 +248,13 @@ SSEFUNCTION void ImProcFunctions::Lanczos(const LabImage* src, LabImage* dst, fl
 
         for (int i = 0; i < dst->H; i++) {
             // y coord of the center of pixel on src image
-            float y0 = (static_cast<float>(i) + 0.5f) * delta - 0.5f;
+            float y0 = (static_cast<float>(dstTop + i) + 0.5f) * delta - 0.5f;
 
             // sum of weights used for normalization
             float ws = 0.0f;
 
             int ii0 = max(0, static_cast<int>(floorf(y0 - a / sc)) + 1);
-            int ii1 = min(src->H, static_cast<int>(floorf(y0 + a / sc)) + 1);
+            int ii1 = min(srcHeight, static_cast<int>(floorf(y0 + a / sc)) + 1);
 
             // calculate weights for vertical interpolation
             for (int ii = ii0; ii < ii1; ii++) {
@@ -264,9 +282,9 @@ SSEFUNCTION void ImProcFunctions::Lanczos(const LabImage* src, LabImage* dst, fl
                 for (int ii = ii0; ii < ii1; ii++) {
                     int k = ii - ii0;
                     wkv = _mm_set1_ps(w[k]);
-                    Lv += wkv * LVFU(src->L[ii][j]);
-                    av += wkv * LVFU(src->a[ii][j]);
-                    bv += wkv * LVFU(src->b[ii][j]);
+                    Lv += wkv * LVFU(src->L[ii - srcTop][j]);
+                    av += wkv * LVFU(src->a[ii - srcTop][j]);
+                    bv += wkv * LVFU(src->b[ii - srcTop][j]);
                 }
 
                 STVF(lL[j], Lv);
@@ -284,9 +302,9 @@ SSEFUNCTION void ImProcFunctions::Lanczos(const LabImage* src, LabImage* dst, fl
                 for (int ii = ii0; ii < ii1; ii++) {
                     int k = ii - ii0;
 
-                    L += w[k] * src->L[ii][j];
-                    a += w[k] * src->a[ii][j];
-                    b += w[k] * src->b[ii][j];
+                    L += w[k] * src->L[ii - srcTop][j];
+                    a += w[k] * src->a[ii - srcTop][j];
+                    b += w[k] * src->b[ii - srcTop][j];
                 }
 
                 lL[j] = L;
@@ -301,7 +301,7 @@ void ImProcFunctions::transform (Imagefloat* original, Imagefloat* transformed,
                                                   original->getWidth(), original->getHeight(), params->coarse, rawRotationDeg);
     }
 
-    if (!(needsCA() || needsDistortion() || needsRotation() || needsPerspective() || needsLCP()) && (needsVignetting() || needsPCVignetting() || needsGradient())) {
+    if (needsLuminanceOnly()) {
         transformLuminanceOnly (original, transformed, cx, cy, oW, oH, fW, fH);
     } else if (!needsCA() && scale != 1) {
         transformPreview (original, transformed, cx, cy, sx, sy, oW, oH, fW, fH, pLCPMap);
@@ -1133,6 +1133,11 @@ bool ImProcFunctions::needsTransform ()
     return needsCA () || needsDistortion () || needsRotation () || needsPerspective () || needsGradient () || needsPCVignetting () || needsVignetting () || needsLCP();
 }
 
+bool ImProcFunctions::needsLuminanceOnly ()
+{
+    return !(needsCA() || needsDistortion() || needsRotation() || needsPerspective() || needsLCP()) && (needsVignetting() || needsPCVignetting() || needsGradient());
+}
+
 
 }
 
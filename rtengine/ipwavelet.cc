@@ -558,6 +558,7 @@ SSEFUNCTION void ImProcFunctions::ip_wavelet(LabImage * lab, LabImage * dst, int
     Tile_calc (tilesize, overlap, kall, imwidth, imheight, numtiles_W, numtiles_H, tilewidth, tileheight, tileWskip, tileHskip);
 
     const int numtiles = numtiles_W * numtiles_H;
+    CancelCheck cancelCheck (cancelToken, "ip_wavelet", numtiles);
     LabImage * dsttmp;
 
     if(numtiles == 1) {
@@ -694,6 +695,10 @@ SSEFUNCTION void ImProcFunctions::ip_wavelet(LabImage * lab, LabImage * dst, int
 
         for (int tiletop = 0; tiletop < imheight; tiletop += tileHskip) {
             for (int tileleft = 0; tileleft < imwidth ; tileleft += tileWskip) {
+                if (cancelCheck.skip ()) {
+                    continue;
+                }
+
                 int tileright = MIN(imwidth, tileleft + tilewidth);
                 int tilebottom = MIN(imheight, tiletop + tileheight);
                 int width  = tileright - tileleft;
@@ -862,7 +867,7 @@ SSEFUNCTION void ImProcFunctions::ip_wavelet(LabImage * lab, LabImage * dst, int
                 //  else {
                 //      if(levwavL < 3) levwavL=3;//to allow edge  => I always allocate 3 (4) levels..because if user select wavelet it is to do something !!
                 //  }
-                if(levwavL > 0) {
+                if(levwavL > 0 && !cancelCheck.cancelled ()) {
                     wavelet_decomposition* Ldecomp = new wavelet_decomposition (labco->data, labco->W, labco->H, levwavL, 1, skip, max(1, wavNestedLevels), DaubLen );
 
                     if(!Ldecomp->memoryAllocationFailed) {
@@ -978,7 +983,7 @@ SSEFUNCTION void ImProcFunctions::ip_wavelet(LabImage * lab, LabImage * dst, int
                     }
 
                     //printf("Levwava after: %d\n",levwava);
-                    if(levwava > 0) {
+                    if(levwava > 0 && !cancelCheck.cancelled ()) {
                         wavelet_decomposition* adecomp = new wavelet_decomposition (labco->data + datalen, labco->W, labco->H, levwava, 1, skip, max(1, wavNestedLevels), DaubLen );
 
                         if(!adecomp->memoryAllocationFailed) {
@@ -999,7 +1004,7 @@ SSEFUNCTION void ImProcFunctions::ip_wavelet(LabImage * lab, LabImage * dst, int
                     }
 
                     //  printf("Levwavb after: %d\n",levwavb);
-                    if(levwavb > 0) {
+                    if(levwavb > 0 && !cancelCheck.cancelled ()) {
                         wavelet_decomposition* bdecomp = new wavelet_decomposition (labco->data + 2 * datalen, labco->W, labco->H, levwavb, 1, skip, max(1, wavNestedLevels), DaubLen );
 
                         if(!bdecomp->memoryAllocationFailed) {
@@ -0,0 +1,293 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "masterframecache.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#include <glib/gstdio.h>
+
+#ifdef WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "settings.h"
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+namespace
+{
+
+constexpr char fileMagic[4] = {'R', 'T', 'M', 'F'};
+constexpr uint32_t fileVersion = 1;
+
+const Glib::ustring fileExtension = ".rtmf";
+
+// followed by the pixels, as floats, then by the x and y of the hot pixels, as uint16_t
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+    uint32_t filters;
+    char xtrans[6][6];
+    uint32_t hotPixels;
+};
+
+// the pixels are mapped right after the header, they have to be aligned
+static_assert (sizeof (FileHeader) % sizeof (float) == 0, "the pixels are not aligned");
+
+int getChannels (unsigned filters, int colors)
+{
+    // same as RawImage::compress_image ()
+    return filters != 0 || colors == 1 ? 1 : 3;
+}
+
+}
+
+MasterFrame::~MasterFrame ()
+{
+#ifdef WIN32
+    if (address) {
+        UnmapViewOfFile (address);
+    }
+
+    if (handle) {
+        CloseHandle (handle);
+    }
+#else
+    if (address) {
+        munmap (const_cast<char*> (address), size);
+    }
+#endif
+}
+
+RawImage* MasterFrame::createRawImage (const Glib::ustring& fname) const
+{
+    RawImage* ri = new RawImage (fname);
+
+    // only the informations of the file are read, not its pixels
+    if (ri->loadRaw (false) || getChannels (ri->get_filters (), ri->get_colors ()) != getChannels (filters, ri->get_colors ())) {
+        delete ri;
+        return nullptr;
+    }
+
+    ri->setMasterData (width, height, filters, xtrans, pixels);
+    return ri;
+}
+
+const std::vector<badPix>& MasterFrame::getHotPixels () const
+{
+    return hotPixels;
+}
+
+MasterFrameCache* MasterFrameCache::getInstance ()
+{
+    static MasterFrameCache instance;
+    return &instance;
+}
+
+bool MasterFrameCache::isEnabled () const
+{
+    return settings->masterFrameCache && !settings->masterFrameCacheDir.empty ();
+}
+
+Glib::ustring MasterFrameCache::getKey (const std::string& kind, const std::string& name, const std::list<Glib::ustring>& files, const std::string& params) const
+{
+    Glib::ustring stamps = params + '|';
+
+    for (const auto& fname : files) {
+        GStatBuf fileStat;
+
+        if (g_stat (fname.c_str (), &fileStat) != 0) {
+            return {};
+        }
+
+        // like DemosaicCache::getKey, the file is identified by its name, its size and its modification time
+        stamps += Glib::ustring::compose ("%1-%2-%3|", fname, static_cast<int64_t> (fileStat.st_size), static_cast<int64_t> (fileStat.st_mtime));
+    }
+
+    // the name comes first, to find the entries of the other versions of the files of the master
+    return Glib::ustring (kind) + '-' + Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, name) + '-'
+           + Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, stamps);
+}
+
+Glib::ustring MasterFrameCache::getFileName (const Glib::ustring& key) const
+{
+    return Glib::build_filename (settings->masterFrameCacheDir, key + fileExtension);
+}
+
+std::unique_ptr<MasterFrame> MasterFrameCache::load (const Glib::ustring& key) const
+{
+    if (key.empty () || !isEnabled ()) {
+        return nullptr;
+    }
+
+    const Glib::ustring fname = getFileName (key);
+    FILE* const f = g_fopen (fname.c_str (), "rb");
+
+    if (!f) {
+        return nullptr;
+    }
+
+    FileHeader header;
+    GStatBuf fileStat;
+
+    if (fread (&header, sizeof (header), 1, f) != 1 || g_stat (fname.c_str (), &fileStat) != 0
+            || memcmp (header.magic, fileMagic, sizeof (fileMagic)) != 0 || header.version != fileVersion
+            || header.width <= 0 || header.height <= 0 || header.channels != getChannels (header.filters, 3)
+            || static_cast<uint64_t> (fileStat.st_size) > std::numeric_limits<size_t>::max ()
+            || static_cast<uint64_t> (fileStat.st_size) != sizeof (header)
+            + static_cast<uint64_t> (header.width) * header.height * header.channels * sizeof (float)
+            + static_cast<uint64_t> (header.hotPixels) * 2 * sizeof (uint16_t)) {
+        fclose (f);
+        return nullptr;
+    }
+
+    std::unique_ptr<MasterFrame> master (new MasterFrame);
+    const size_t size = fileStat.st_size;
+
+#ifdef WIN32
+    master->handle = CreateFileMappingW (reinterpret_cast<HANDLE> (_get_osfhandle (_fileno (f))), nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (master->handle) {
+        master->address = static_cast<const char*> (MapViewOfFile (master->handle, FILE_MAP_READ, 0, 0, size));
+    }
+#else
+    void* const address = mmap (nullptr, size, PROT_READ, MAP_SHARED, fileno (f), 0);
+
+    if (address != MAP_FAILED) {
+        master->address = static_cast<const char*> (address);
+    }
+#endif
+
+    // the mapping stays valid once the file is closed
+    fclose (f);
+
+    if (!master->address) {
+        return nullptr;
+    }
+
+    master->size = size;
+    master->width = header.width;
+    master->height = header.height;
+    master->filters = header.filters;
+    memcpy (master->xtrans, header.xtrans, sizeof (header.xtrans));
+    // the images only read the pixels of the masters, they are mapped read-only
+    master->pixels = reinterpret_cast<float*> (const_cast<char*> (master->address + sizeof (header)));
+
+    const char* hotPixels = master->address + size - static_cast<size_t> (header.hotPixels) * 2 * sizeof (uint16_t);
+    master->hotPixels.reserve (header.hotPixels);
+
+    for (uint32_t i = 0; i < header.hotPixels; ++i) {
+        uint16_t xy[2];
+        memcpy (xy, hotPixels + i * sizeof (xy), sizeof (xy));
+        master->hotPixels.emplace_back (xy[0], xy[1]);
+    }
+
+    if (settings->verbose) {
+        printf ("Master frame cache: mapped %s\n", fname.c_str ());
+    }
+
+    return master;
+}
+
+void MasterFrameCache::store (const Glib::ustring& key, RawImage* ri, const std::vector<badPix>& hotPixels)
+{
+    if (key.empty () || !isEnabled () || !ri || !ri->data) {
+        return;
+    }
+
+    if (g_mkdir_with_parents (settings->masterFrameCacheDir.c_str (), 0755) != 0) {
+        return;
+    }
+
+    FileHeader header;
+    memcpy (header.magic, fileMagic, sizeof (fileMagic));
+    header.version = fileVersion;
+    header.width = ri->get_width ();
+    header.height = ri->get_height ();
+    header.filters = ri->get_filters ();
+    header.channels = getChannels (header.filters, ri->get_colors ());
+    ri->getXtransMatrix (header.xtrans);
+    header.hotPixels = hotPixels.size ();
+
+    if (header.channels != getChannels (header.filters, 3)) {
+        // monochrome sensors, which aren't worth an other layout
+        return;
+    }
+
+    // written to a temporary file first, so that a partial entry is never mapped
+    const Glib::ustring fname = getFileName (key);
+    const Glib::ustring tmpFileName = fname + ".tmp";
+    FILE* const f = g_fopen (tmpFileName.c_str (), "wb");
+
+    if (!f) {
+        return;
+    }
+
+    bool written = fwrite (&header, sizeof (header), 1, f) == 1;
+
+    // the rows of the images are contiguous, see RawImage::compress_image ()
+    const size_t rowSize = static_cast<size_t> (header.width) * header.channels;
+
+    for (int row = 0; row < header.height && written; ++row) {
+        written = fwrite (ri->data[row], sizeof (float), rowSize, f) == rowSize;
+    }
+
+    for (size_t i = 0; i < hotPixels.size () && written; ++i) {
+        const uint16_t xy[2] = {hotPixels[i].x, hotPixels[i].y};
+        written = fwrite (xy, sizeof (xy), 1, f) == 1;
+    }
+
+    written = fclose (f) == 0 && written;
+
+    if (!written || g_rename (tmpFileName.c_str (), fname.c_str ()) != 0) {
+        g_remove (tmpFileName.c_str ());
+        return;
+    }
+
+    // the entries of the master made of older versions of its files are of no use anymore
+    const Glib::ustring prefix = key.substr (0, key.rfind ('-') + 1);
+
+    try {
+        Glib::Dir dir (settings->masterFrameCacheDir);
+
+        for (const auto& entry : dir) {
+            const Glib::ustring name (entry);
+
+            if (name.compare (0, prefix.size (), prefix) == 0 && name != key + fileExtension) {
+                g_remove (Glib::build_filename (settings->masterFrameCacheDir, name).c_str ());
+            }
+        }
+    } catch (const Glib::Error&) {}
+
+    if (settings->verbose) {
+        printf ("Master frame cache: stored %s\n", fname.c_str ());
+    }
+}
+
+}
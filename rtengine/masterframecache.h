@@ -0,0 +1,98 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glibmm.h>
+
+#include "noncopyable.h"
+#include "rawimage.h"
+
+namespace rtengine
+{
+
+/** A master dark frame or flat field mapped from the cache */
+class MasterFrame :
+    public NonCopyable
+{
+public:
+    ~MasterFrame ();
+
+    /** @param fname is one of the files of the master, for the informations other than the pixels
+      * @return a new image whose pixels are the ones of the master, nullptr if the file can't be read. It must be
+      * deleted before the master. */
+    RawImage* createRawImage (const Glib::ustring& fname) const;
+
+    const std::vector<badPix>& getHotPixels () const;
+
+private:
+    friend class MasterFrameCache;
+
+    MasterFrame () = default;
+
+    const char* address = nullptr;
+    size_t size = 0;
+#ifdef WIN32
+    void* handle = nullptr;
+#endif
+
+    int width = 0;
+    int height = 0;
+    unsigned filters = 0;
+    char xtrans[6][6] = {};
+    float* pixels = nullptr;
+    std::vector<badPix> hotPixels;
+};
+
+/** On-disk cache of the master dark frames and flat fields combined from several files.
+  *
+  * A master is stored once, uncompressed so that it can be mapped rather than read, with the hot pixels extracted
+  * from it. The entries are stored in settings->masterFrameCacheDir; their key includes the size and the modification
+  * time of the files of the master, and storing a master removes the entries of the previous versions of its files.
+  */
+class MasterFrameCache :
+    public NonCopyable
+{
+public:
+    static MasterFrameCache* getInstance ();
+
+    bool isEnabled () const;
+
+    /** @param kind tells the dark frames from the flat fields
+      * @param name identifies the master, e.g. the camera and the ISO of a dark frame
+      * @param files are the files the master is combined from
+      * @param params identifies how the files are combined
+      * @return the key of the entry, empty if one of the files can't be identified */
+    Glib::ustring getKey (const std::string& kind, const std::string& name, const std::list<Glib::ustring>& files, const std::string& params) const;
+
+    /** @return the mapped master, nullptr if there is no complete entry */
+    std::unique_ptr<MasterFrame> load (const Glib::ustring& key) const;
+
+    /** @param ri is the master, in the format of RawImage::compress_image () */
+    void store (const Glib::ustring& key, RawImage* ri, const std::vector<badPix>& hotPixels);
+
+private:
+    MasterFrameCache () = default;
+
+    Glib::ustring getFileName (const Glib::ustring& key) const;
+};
+
+}
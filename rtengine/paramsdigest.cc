@@ -0,0 +1,337 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "paramsdigest.h"
+
+#include <cstring>
+#include <utility>
+
+#include "procparams.h"
+
+namespace rtengine
+{
+
+namespace procparams
+{
+
+namespace
+{
+
+constexpr char binaryMagic[4] = {'R', 'T', 'K', 'F'};
+constexpr uint32_t binaryVersion = 1;
+
+// 64 bit FNV-1a
+constexpr uint64_t hashSeed = 0xcbf29ce484222325ULL;
+
+uint64_t hashBytes (uint64_t hash, const char* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char> (data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+uint64_t hashString (uint64_t hash, const std::string& str)
+{
+    // the terminating null separates the strings
+    return hashBytes (hash, str.c_str (), str.size () + 1);
+}
+
+template<typename T>
+uint64_t hashValue (uint64_t hash, const T& value)
+{
+    return hashBytes (hash, reinterpret_cast<const char*> (&value), sizeof (value));
+}
+
+void writeUInt (std::string& data, uint32_t value)
+{
+    data.append (reinterpret_cast<const char*> (&value), sizeof (value));
+}
+
+void writeString (std::string& data, const std::string& str)
+{
+    writeUInt (data, str.size ());
+    data.append (str);
+}
+
+class Reader
+{
+public:
+    Reader (const char* data, size_t size) :
+        data (data),
+        size (size)
+    {
+    }
+
+    bool readUInt (uint32_t& value)
+    {
+        if (size < sizeof (value)) {
+            return false;
+        }
+
+        memcpy (&value, data, sizeof (value));
+        data += sizeof (value);
+        size -= sizeof (value);
+        return true;
+    }
+
+    bool readString (Glib::ustring& str)
+    {
+        uint32_t length;
+
+        if (!readUInt (length) || length > size) {
+            return false;
+        }
+
+        str.assign (data, data + length);
+        data += length;
+        size -= length;
+        return true;
+    }
+
+    bool atEnd () const
+    {
+        return size == 0;
+    }
+
+private:
+    const char* data;
+    size_t size;
+};
+
+}
+
+ParamsDigest::ParamsDigest () :
+    hash (0)
+{
+}
+
+ParamsDigest::ParamsDigest (const ProcParams& params) :
+    ParamsDigest ()
+{
+    ParamsDigestWriter writer;
+
+    if (params.saveToDigest (writer)) {
+        return;
+    }
+
+    groups = std::move (writer.groups);
+    hash = hashSeed;
+
+    for (auto& group : groups) {
+        // 0 marks the missing groups
+        if (!group.second) {
+            group.second = 1;
+        }
+
+        hash = hashString (hash, group.first);
+        hash = hashValue (hash, group.second);
+    }
+}
+
+bool ParamsDigest::empty () const
+{
+    return groups.empty ();
+}
+
+uint64_t ParamsDigest::getHash () const
+{
+    return hash;
+}
+
+uint64_t ParamsDigest::getHash (const Glib::ustring& group) const
+{
+    const auto iterator = groups.find (group.raw ());
+    return iterator != groups.end () ? iterator->second : 0;
+}
+
+std::vector<Glib::ustring> ParamsDigest::diff (const ParamsDigest& other) const
+{
+    std::vector<Glib::ustring> result;
+
+    // both maps are sorted, they are merged
+    auto a = groups.begin ();
+    auto b = other.groups.begin ();
+
+    while (a != groups.end () || b != other.groups.end ()) {
+        if (b == other.groups.end () || (a != groups.end () && a->first < b->first)) {
+            result.push_back (a->first);
+            ++a;
+        } else if (a == groups.end () || b->first < a->first) {
+            result.push_back (b->first);
+            ++b;
+        } else {
+            if (a->second != b->second) {
+                result.push_back (a->first);
+            }
+
+            ++a;
+            ++b;
+        }
+    }
+
+    return result;
+}
+
+bool ParamsDigest::operator== (const ParamsDigest& other) const
+{
+    return hash == other.hash && groups == other.groups;
+}
+
+bool ParamsDigest::operator!= (const ParamsDigest& other) const
+{
+    return !(*this == other);
+}
+
+ParamsDigestWriter::ParamsDigestWriter () :
+    current (nullptr)
+{
+}
+
+uint64_t& ParamsDigestWriter::begin (const Glib::ustring& group, const Glib::ustring& key, char type)
+{
+    if (!current || group.raw () != currentGroup) {
+        currentGroup = group.raw ();
+        current = &groups.emplace (currentGroup, hashSeed).first->second;
+    }
+
+    *current = hashString (*current, key.raw ());
+    *current = hashValue (*current, type);
+    return *current;
+}
+
+void ParamsDigestWriter::set_boolean (const Glib::ustring& group, const Glib::ustring& key, bool value)
+{
+    uint64_t& hash = begin (group, key, 'b');
+    hash = hashValue (hash, value);
+}
+
+void ParamsDigestWriter::set_integer (const Glib::ustring& group, const Glib::ustring& key, int value)
+{
+    uint64_t& hash = begin (group, key, 'i');
+    hash = hashValue (hash, value);
+}
+
+void ParamsDigestWriter::set_double (const Glib::ustring& group, const Glib::ustring& key, double value)
+{
+    uint64_t& hash = begin (group, key, 'd');
+    hash = hashValue (hash, value);
+}
+
+void ParamsDigestWriter::set_string (const Glib::ustring& group, const Glib::ustring& key, const Glib::ustring& value)
+{
+    uint64_t& hash = begin (group, key, 's');
+    hash = hashString (hash, value.raw ());
+}
+
+void ParamsDigestWriter::set_integer_list (const Glib::ustring& group, const Glib::ustring& key, const Glib::ArrayHandle<int>& list)
+{
+    uint64_t& hash = begin (group, key, 'I');
+    hash = hashValue (hash, list.size ());
+
+    for (const int value : list) {
+        hash = hashValue (hash, value);
+    }
+}
+
+void ParamsDigestWriter::set_double_list (const Glib::ustring& group, const Glib::ustring& key, const Glib::ArrayHandle<double>& list)
+{
+    uint64_t& hash = begin (group, key, 'D');
+    hash = hashValue (hash, list.size ());
+
+    for (const double value : list) {
+        hash = hashValue (hash, value);
+    }
+}
+
+void ParamsDigestWriter::set_string_list (const Glib::ustring& group, const Glib::ustring& key, const Glib::ArrayHandle<Glib::ustring>& list)
+{
+    uint64_t& hash = begin (group, key, 'S');
+    hash = hashValue (hash, list.size ());
+
+    for (const Glib::ustring& value : list) {
+        hash = hashString (hash, value.raw ());
+    }
+}
+
+void keyFileToBinary (const Glib::KeyFile& keyFile, std::string& data)
+{
+    data.clear ();
+    data.append (binaryMagic, sizeof (binaryMagic));
+    writeUInt (data, binaryVersion);
+
+    const auto groups = keyFile.get_groups ();
+    writeUInt (data, groups.size ());
+
+    for (const auto& group : groups) {
+        const auto keys = keyFile.get_keys (group);
+        writeString (data, group.raw ());
+        writeUInt (data, keys.size ());
+
+        // the raw values are kept, i.e. with their escapes and list separators
+        for (const auto& key : keys) {
+            writeString (data, key.raw ());
+            writeString (data, keyFile.get_value (group, key).raw ());
+        }
+    }
+}
+
+bool keyFileFromBinary (const char* data, size_t size, Glib::KeyFile& keyFile)
+{
+    if (size < sizeof (binaryMagic) || memcmp (data, binaryMagic, sizeof (binaryMagic)) != 0) {
+        return false;
+    }
+
+    Reader reader (data + sizeof (binaryMagic), size - sizeof (binaryMagic));
+    uint32_t version;
+    uint32_t numGroups;
+
+    if (!reader.readUInt (version) || version != binaryVersion || !reader.readUInt (numGroups)) {
+        return false;
+    }
+
+    try {
+        for (uint32_t i = 0; i < numGroups; ++i) {
+            Glib::ustring group;
+            uint32_t numKeys;
+
+            if (!reader.readString (group) || !reader.readUInt (numKeys)) {
+                return false;
+            }
+
+            for (uint32_t j = 0; j < numKeys; ++j) {
+                Glib::ustring key;
+                Glib::ustring value;
+
+                if (!reader.readString (key) || !reader.readString (value)) {
+                    return false;
+                }
+
+                keyFile.set_value (group, key, value);
+            }
+        }
+    } catch (const Glib::Error&) {
+        return false;
+    }
+
+    return reader.atEnd ();
+}
+
+}
+
+}
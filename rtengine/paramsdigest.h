@@ -0,0 +1,102 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glibmm.h>
+
+namespace rtengine
+{
+
+namespace procparams
+{
+
+class ProcParams;
+class ParamsDigestWriter;
+
+/** Hashes of the parameters, by group of their pp3 form.
+  *
+  * Comparing two digests tells which groups, i.e. which tools, differ without comparing the values, e.g. to know
+  * which stages of a pipeline have to run again.
+  */
+class ParamsDigest
+{
+public:
+    ParamsDigest ();
+    /** The values are hashed as ProcParams::saveToKeyFile would store them, without formatting them.
+      * The digest is empty if they can't be stored. */
+    explicit ParamsDigest (const ProcParams& params);
+
+    bool empty () const;
+
+    /** @return the hash of all the groups */
+    uint64_t getHash () const;
+    /** @return the hash of the keys and values of the group, 0 if there is no such group */
+    uint64_t getHash (const Glib::ustring& group) const;
+
+    /** @return the groups whose values differ, including the groups which are in one of the digests only */
+    std::vector<Glib::ustring> diff (const ParamsDigest& other) const;
+
+    bool operator== (const ParamsDigest& other) const;
+    bool operator!= (const ParamsDigest& other) const;
+
+private:
+    std::map<std::string, uint64_t> groups;
+    uint64_t hash;
+};
+
+/** The sink of ProcParams::saveToDigest: it has the setters of Glib::KeyFile used by ProcParams, and hashes the
+  * typed values by group instead of formatting them. */
+class ParamsDigestWriter
+{
+public:
+    ParamsDigestWriter ();
+
+    void set_boolean (const Glib::ustring& group, const Glib::ustring& key, bool value);
+    void set_integer (const Glib::ustring& group, const Glib::ustring& key, int value);
+    void set_double (const Glib::ustring& group, const Glib::ustring& key, double value);
+    void set_string (const Glib::ustring& group, const Glib::ustring& key, const Glib::ustring& value);
+    void set_integer_list (const Glib::ustring& group, const Glib::ustring& key, const Glib::ArrayHandle<int>& list);
+    void set_double_list (const Glib::ustring& group, const Glib::ustring& key, const Glib::ArrayHandle<double>& list);
+    void set_string_list (const Glib::ustring& group, const Glib::ustring& key, const Glib::ArrayHandle<Glib::ustring>& list);
+
+private:
+    friend class ParamsDigest;
+
+    /** Hashes the key and the type of its value into the hash of the group, which it returns */
+    uint64_t& begin (const Glib::ustring& group, const Glib::ustring& key, char type);
+
+    std::map<std::string, uint64_t> groups;
+    // the values of a group mostly follow each other, the lookup is skipped for them
+    std::string currentGroup;
+    uint64_t* current;
+};
+
+/** Writes the groups, keys and values of a key file in a compact binary form, which is faster to read than the text
+  * of a pp3 file. The text stays the reference: the binary form is only meant to be cached under a hash of the text
+  * it was read from. */
+void keyFileToBinary (const Glib::KeyFile& keyFile, std::string& data);
+/** @return false if the data isn't a complete key file in the binary form of this version */
+bool keyFileFromBinary (const char* data, size_t size, Glib::KeyFile& keyFile);
+
+}
+
+}
@@ -0,0 +1,205 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "pipelinecache.h"
+
+#include <utility>
+
+#include "paramsdigest.h"
+#include "procparams.h"
+
+namespace rtengine
+{
+
+namespace
+{
+
+// 64 bit FNV-1a
+constexpr uint64_t hashSeed = 0xcbf29ce484222325ULL;
+
+uint64_t hashBytes (uint64_t hash, const char* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char> (data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+uint64_t hashString (uint64_t hash, const Glib::ustring& str)
+{
+    // the terminating null separates the strings
+    return hashBytes (hash, str.c_str (), str.bytes () + 1);
+}
+
+}
+
+PipelineCache::PipelineCache (const std::vector<Stage>& stages) :
+    stages (stages),
+    hashes (stages.size (), 0),
+    context (0),
+    durations (stages.size (), -1)
+{
+}
+
+PipelineCache::~PipelineCache () = default;
+
+std::vector<uint64_t> PipelineCache::hashStages (const procparams::ProcParams& params, uint64_t context) const
+{
+    std::vector<uint64_t> result (stages.size (), 0);
+    const procparams::ParamsDigest digest (params);
+
+    if (digest.empty ()) {
+        // no hash, every stage will run
+        return result;
+    }
+
+    for (size_t i = 0; i < stages.size (); ++i) {
+        uint64_t hash = hashBytes (hashSeed, reinterpret_cast<const char*> (&context), sizeof (context));
+
+        for (const auto& group : stages[i].groups) {
+            const uint64_t groupHash = digest.getHash (group);
+            hash = hashString (hash, group);
+            hash = hashBytes (hash, reinterpret_cast<const char*> (&groupHash), sizeof (groupHash));
+        }
+
+        // 0 marks the stages without output
+        result[i] = hash ? hash : 1;
+    }
+
+    return result;
+}
+
+int PipelineCache::getPending (int todo, const std::vector<uint64_t>& current) const
+{
+    bool upstreamRuns = false;
+
+    for (size_t i = 0; i < stages.size (); ++i) {
+        if (upstreamRuns) {
+            todo |= stages[i].refresh;
+        } else if (todo & stages[i].refresh) {
+            if (hashes[i] && hashes[i] == current[i]) {
+                todo &= ~stages[i].refresh;
+            } else {
+                upstreamRuns = true;
+            }
+        }
+    }
+
+    return todo;
+}
+
+int PipelineCache::getFirstStage (int todo) const
+{
+    for (size_t i = 0; i < stages.size (); ++i) {
+        if (todo & stages[i].refresh) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int PipelineCache::update (int todo, const procparams::ProcParams& params, uint64_t context)
+{
+    if (context != this->context) {
+        invalidate ();
+        this->context = context;
+    }
+
+    pendingHashes = hashStages (params, context);
+
+    if (pendingParams) {
+        *pendingParams = params;
+    } else {
+        pendingParams.reset (new procparams::ProcParams (params));
+    }
+
+    todo = getPending (todo, pendingHashes);
+
+    // the outputs are overwritten, they are only valid again once the run is done
+    for (size_t i = 0; i < stages.size (); ++i) {
+        if (todo & stages[i].refresh) {
+            hashes[i] = 0;
+        }
+    }
+
+    return todo;
+}
+
+int PipelineCache::getPending (int todo, const procparams::ProcParams& params, uint64_t context) const
+{
+    if (context != this->context) {
+        // the stored outputs will be dropped
+        return getPending (todo, std::vector<uint64_t> (stages.size (), 0));
+    }
+
+    return getPending (todo, hashStages (params, context));
+}
+
+void PipelineCache::done (int todo, const procparams::ProcParams& params, int duration)
+{
+    const std::vector<uint64_t> current = pendingParams && *pendingParams == params ? pendingHashes : hashStages (params, context);
+
+    for (size_t i = 0; i < stages.size (); ++i) {
+        if (todo & stages[i].refresh) {
+            hashes[i] = current[i];
+        }
+    }
+
+    const int first = getFirstStage (todo);
+
+    if (duration >= 0 && first >= 0) {
+        durations[first] = duration;
+    }
+}
+
+int PipelineCache::getDuration (int todo) const
+{
+    for (int i = getFirstStage (todo); i >= 0; --i) {
+        if (durations[i] >= 0) {
+            return durations[i];
+        }
+    }
+
+    return 0;
+}
+
+void PipelineCache::invalidate ()
+{
+    hashes.assign (stages.size (), 0);
+}
+
+void PipelineCache::invalidate (int todo)
+{
+    for (size_t i = 0; i < stages.size (); ++i) {
+        if (todo & stages[i].refresh) {
+            hashes[i] = 0;
+        }
+    }
+}
+
+void PipelineCache::swap (PipelineCache& other)
+{
+    std::swap (hashes, other.hashes);
+    std::swap (context, other.context);
+    std::swap (durations, other.durations);
+    std::swap (pendingHashes, other.pendingHashes);
+    std::swap (pendingParams, other.pendingParams);
+}
+
+}
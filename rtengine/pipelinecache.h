@@ -0,0 +1,95 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glibmm.h>
+
+namespace rtengine
+{
+
+namespace procparams
+{
+class ProcParams;
+}
+
+/** Incremental recomputation of a processing pipeline.
+  *
+  * The events only tell which stages may be affected through the coarse bits of refreshmap.h, e.g. every tool of
+  * the Detail tab sends M_LUMINANCE|M_COLOR. The pipeline keeps the output of each stage in its buffers; this class
+  * remembers a hash of the parameters each stage read to compute it, i.e. of the groups of the pp3 file of the tools
+  * it uses, and drops from the requested bits the stages whose parameters didn't change since they last ran.
+  * A stage which runs makes all the following stages run as well.
+  */
+class PipelineCache
+{
+public:
+    struct Stage {
+        int refresh;                            ///< bits of refreshmap.h which make the stage run
+        std::vector<Glib::ustring> groups;      ///< groups of the pp3 file whose values are read by the stage
+    };
+
+    /** @param stages are the stages of the pipeline, in processing order */
+    explicit PipelineCache (const std::vector<Stage>& stages);
+    ~PipelineCache ();
+
+    /** Called before running the pipeline.
+      * @param todo are the bits of refreshmap.h of the pending events
+      * @param params are the parameters of the run
+      * @param context is a hash of everything else the outputs depend on, e.g. the scale of the preview
+      * @return todo without the bits of the stages whose output is up to date, with the bits of the stages
+      * following a stage which has to run */
+    int update (int todo, const procparams::ProcParams& params, uint64_t context);
+
+    /** @return what update would return, without changing the stored outputs */
+    int getPending (int todo, const procparams::ProcParams& params, uint64_t context) const;
+
+    /** Called once the pipeline ran successfully, with the final parameters (auto tools may have changed them). The
+      * parameters are only hashed again if they differ from the ones given to update.
+      * @param todo are the bits of the stages which ran, i.e. the result of update, possibly extended by the pipeline
+      * @param duration is the time the stages took, in ms, see getDuration */
+    void done (int todo, const procparams::ProcParams& params, int duration = -1);
+
+    /** @return the time in ms of the last run which started with the first stage of todo, or else of the last run
+      * which started with an earlier stage, i.e. which did more; 0 if there's none */
+    int getDuration (int todo) const;
+
+    /** Forgets the outputs of all the stages, e.g. when their buffers are freed */
+    void invalidate ();
+    /** Forgets the outputs of the stages of the bits of refreshmap.h */
+    void invalidate (int todo);
+
+    /** Exchanges the stored outputs with the ones of a cache of the same stages, along with the buffers they are in */
+    void swap (PipelineCache& other);
+
+private:
+    std::vector<uint64_t> hashStages (const procparams::ProcParams& params, uint64_t context) const;
+    int getPending (int todo, const std::vector<uint64_t>& current) const;
+    int getFirstStage (int todo) const;
+
+    const std::vector<Stage> stages;
+    std::vector<uint64_t> hashes;   // hash of the parameters of the stored output of each stage, 0 if none
+    uint64_t context;
+    std::vector<int> durations;     // of the last run which started with each stage, -1 if none
+    std::vector<uint64_t> pendingHashes;                    // hashes of the parameters given to update
+    std::unique_ptr<procparams::ProcParams> pendingParams;  // the parameters given to update
+};
+
+}
@@ -18,6 +18,7 @@
  */
 #include <glib/gstdio.h>
 #include "procparams.h"
+#include "paramsdigest.h"
 #include "rt_math.h"
 #include "curves.h"
 #include "../rtgui/multilangmgr.h"
@@ -1331,10 +1332,35 @@ int ProcParams::save (const Glib::ustring &fname, const Glib::ustring &fname2, b
     }
 
     Glib::ustring sPParams;
+    Glib::KeyFile keyFile;
 
-    try {
+    if (!saveToKeyFile (keyFile, fname, fnameAbsolute, pedited)) {
+        sPParams = keyFile.to_data();
+    }
+
+    if (sPParams.empty ()) {
+        return 1;
+    }
+
+    int error1, error2;
+    error1 = write (fname, sPParams);
+
+    if (!fname2.empty ()) {
+
+        error2 = write (fname2, sPParams);
+        // If at least one file has been saved, it's a success
+        return error1 & error2;
+    } else {
+        return error1;
+    }
+}
 
-        Glib::KeyFile keyFile;
+// The values are passed to the key file one by one, a ParamsDigestWriter hashes them in place of a Glib::KeyFile
+template<typename KeyFileType>
+int ProcParams::saveTo (KeyFileType &keyFile, const Glib::ustring &fname, bool fnameAbsolute, ParamsEdited* pedited) const
+{
+
+    try {
 
         keyFile.set_string  ("Version", "AppVersion", APPVERSION);
         keyFile.set_integer ("Version", "Version",    PPVERSION);
@@ -3411,25 +3437,21 @@ int ProcParams::save (const Glib::ustring &fname, const Glib::ustring &fname2, b
             }
         }
 
-        sPParams = keyFile.to_data();
-
-    } catch(Glib::KeyFileError&) {}
-
-    if (sPParams.empty ()) {
+    } catch(Glib::KeyFileError&) {
         return 1;
     }
 
-    int error1, error2;
-    error1 = write (fname, sPParams);
+    return 0;
+}
 
-    if (!fname2.empty ()) {
+int ProcParams::saveToKeyFile (Glib::KeyFile &keyFile, const Glib::ustring &fname, bool fnameAbsolute, ParamsEdited* pedited)
+{
+    return saveTo (keyFile, fname, fnameAbsolute, pedited);
+}
 
-        error2 = write (fname2, sPParams);
-        // If at least one file has been saved, it's a success
-        return error1 & error2;
-    } else {
-        return error1;
-    }
+int ProcParams::saveToDigest (ParamsDigestWriter &writer) const
+{
+    return saveTo (writer, "", true, nullptr);
 }
 
 int ProcParams::write (const Glib::ustring &fname, const Glib::ustring &content) const
@@ -3468,26 +3490,63 @@ int ProcParams::load (const Glib::ustring &fname, ParamsEdited* pedited)
             pedited->set(false);
         }
 
-        FILE* f = g_fopen (fname.c_str (), "rt");
-
-        if (!f) {
+        if (readKeyFile (fname, keyFile)) {
             return 1;
         }
+    } catch (const Glib::Error& e) {
+        printf ("-->%s\n", e.what().c_str());
+        setDefaults ();
+        return 1;
+    } catch (...) {
+        printf ("-->unknown exception!\n");
+        setDefaults ();
+        return 1;
+    }
 
-        char* buffer = new char[1024];
-        std::ostringstream ostr;
+    return loadFromKeyFile (keyFile, fname, pedited);
+}
 
-        while (fgets (buffer, 1024, f)) {
-            ostr << buffer << "\n";
-        }
+int ProcParams::readKeyFile (const Glib::ustring &fname, Glib::KeyFile &keyFile)
+{
+    std::string content;
 
-        delete [] buffer;
+    if (readFile (fname, content)) {
+        return 1;
+    }
 
-        if (!keyFile.load_from_data (ostr.str())) {
-            return 1;
-        }
+    return keyFile.load_from_data (content) ? 0 : 1;
+}
 
-        fclose (f);
+int ProcParams::readFile (const Glib::ustring &fname, std::string &content)
+{
+    FILE* f = g_fopen (fname.c_str (), "rt");
+
+    if (!f) {
+        return 1;
+    }
+
+    content.clear ();
+    char buffer[4096];
+    size_t length;
+
+    while ((length = fread (buffer, 1, sizeof (buffer), f)) > 0) {
+        content.append (buffer, length);
+    }
+
+    fclose (f);
+
+    return 0;
+}
+
+int ProcParams::loadFromKeyFile (const Glib::KeyFile &keyFile, const Glib::ustring &fname, ParamsEdited* pedited)
+{
+    setlocale(LC_NUMERIC, "C"); // to set decimal point to "."
+
+    try {
+
+        if (pedited) {
+            pedited->set(false);
+        }
 
         // load tonecurve:
 
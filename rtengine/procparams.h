@@ -57,6 +57,8 @@ enum RenderingIntent {
 namespace procparams
 {
 
+class ParamsDigestWriter;
+
 template <typename T>
 class Threshold
 {
@@ -1339,6 +1341,20 @@ public:
       * @return Error code (=0 if all supplied filenames where created correctly)
       */
     int     save        (const Glib::ustring &fname, const Glib::ustring &fname2 = "", bool fnameAbsolute = true, ParamsEdited* pedited = nullptr);
+    /**
+      * Stores the parameters in a key file, with the same groups and keys as the files written by save.
+      * @param keyFile the key file to fill
+      * @param fname the name of the file the key file will be written to, to store embedded filenames relatively to it (optional)
+      * @param fnameAbsolute set to false if embedded filenames should be stored as relative filenames, see save
+      * @param pedited pointer to a ParamsEdited object (optional) to store which values has to be saved
+      * @return Error code (=0 if no error)
+      */
+    int     saveToKeyFile (Glib::KeyFile &keyFile, const Glib::ustring &fname = "", bool fnameAbsolute = true, ParamsEdited* pedited = nullptr);
+    /**
+      * Passes the values to a ParamsDigestWriter, by the groups and keys of saveToKeyFile but without formatting them.
+      * @return Error code (=0 if no error)
+      */
+    int     saveToDigest (ParamsDigestWriter &writer) const;
     /**
       * Loads the parameters from a file.
       * @param fname the name of the file
@@ -1346,6 +1362,28 @@ public:
       * @return Error code (=0 if no error)
       */
     int     load        (const Glib::ustring &fname, ParamsEdited* pedited = nullptr);
+    /**
+      * Loads the parameters from a key file, e.g. one parsed beforehand, with the same groups and keys as the files read by load.
+      * @param keyFile the key file to read
+      * @param fname the name of the file the key file was read from, embedded relative filenames are expanded from it
+      * @params pedited pointer to a ParamsEdited object (optional) to store which values has been loaded
+      * @return Error code (=0 if no error)
+      */
+    int     loadFromKeyFile (const Glib::KeyFile &keyFile, const Glib::ustring &fname, ParamsEdited* pedited = nullptr);
+    /**
+      * Parses a file written by save, without loading its values.
+      * @param fname the name of the file
+      * @param keyFile the key file to fill
+      * @return Error code (=0 if no error), a Glib::Error is thrown if the file is malformed
+      */
+    static int readKeyFile (const Glib::ustring &fname, Glib::KeyFile &keyFile);
+    /**
+      * Reads the text of a file written by save, e.g. to hash it before parsing it.
+      * @param fname the name of the file
+      * @param content the text of the file
+      * @return Error code (=0 if no error)
+      */
+    static int readFile (const Glib::ustring &fname, std::string &content);
 
     /** Creates a new instance of ProcParams.
       * @return a pointer to the new ProcParams instance. */
@@ -1362,6 +1400,9 @@ public:
     bool operator!= (const ProcParams& other);
 
 private:
+    template<typename KeyFileType>
+    int saveTo (KeyFileType &keyFile, const Glib::ustring &fname, bool fnameAbsolute, ParamsEdited* pedited) const;
+
     /** Write the ProcParams's text in the file of the given name.
     * @param fname the name of the file
     * @param content the text to write
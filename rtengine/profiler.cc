@@ -0,0 +1,234 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef WIN32
+#include <windows.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "settings.h"
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+namespace
+{
+
+struct Record {
+    const char* category;
+    const char* name;
+    int64_t start;      // us, monotonic clock
+    int64_t wall;       // us
+    int64_t processCpu; // us, whole process
+    int threads;
+    int tid;
+    size_t boundaryHeapBytes; // largest heap usage sampled at the boundaries of the stage and of its nested stages
+};
+
+// Records beyond that are dropped, so that a forgotten profiling session can't eat up the memory
+constexpr size_t maxRecords = 1000000;
+
+MyMutex recordsMutex;
+std::vector<Record> records;
+
+std::atomic<int> threadCount(0);
+thread_local int threadId = -1;
+thread_local ProfileStage* currentStage = nullptr;
+
+int64_t getCpuTime ()
+{
+#ifdef WIN32
+    FILETIME creation, exit, kernel, user;
+
+    if (!GetProcessTimes (GetCurrentProcess (), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+
+    return ((int64_t (kernel.dwHighDateTime) << 32 | kernel.dwLowDateTime) + (int64_t (user.dwHighDateTime) << 32 | user.dwLowDateTime)) / 10;
+#elif defined(CLOCK_PROCESS_CPUTIME_ID)
+    timespec t;
+    clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &t);
+    return int64_t (t.tv_sec) * 1000000 + t.tv_nsec / 1000;
+#else
+    return int64_t (clock ()) * 1000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+// Bytes currently allocated on the heap, 0 if unknown on this platform
+size_t getHeapBytes ()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 mi = mallinfo2 ();
+    return mi.uordblks + mi.hblkhd;
+#elif defined(__GLIBC__)
+    const struct mallinfo mi = mallinfo ();
+    return size_t (unsigned (mi.uordblks)) + size_t (unsigned (mi.hblkhd));
+#else
+    return 0;
+#endif
+}
+
+Glib::ustring escape (const char* s)
+{
+    Glib::ustring res;
+
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            res += '\\';
+        }
+
+        res += *s;
+    }
+
+    return res;
+}
+
+}
+
+ProfileStage::ProfileStage (const char* category, const char* name) :
+    category(category),
+    name(name),
+    running(isEnabled ()),
+    startWall(0),
+    startCpu(0),
+    threads(1),
+    boundaryHeapBytes(0),
+    parent(nullptr)
+{
+    if (!running) {
+        return;
+    }
+
+    if (threadId < 0) {
+        threadId = threadCount++;
+    }
+
+#ifdef _OPENMP
+    threads = omp_get_max_threads ();
+#endif
+    boundaryHeapBytes = getHeapBytes ();
+    parent = currentStage;
+    currentStage = this;
+    startCpu = getCpuTime ();
+    startWall = g_get_monotonic_time ();
+}
+
+ProfileStage::~ProfileStage ()
+{
+    stop ();
+}
+
+void ProfileStage::stop ()
+{
+    if (!running) {
+        return;
+    }
+
+    running = false;
+
+    const int64_t wall = g_get_monotonic_time () - startWall;
+    const int64_t processCpu = getCpuTime () - startCpu;
+    boundaryHeapBytes = std::max (boundaryHeapBytes, getHeapBytes ());
+
+    // stages are expected to be nested, but an early stop() of a parent must not break the chain
+    if (currentStage == this) {
+        currentStage = parent;
+    }
+
+    if (parent) {
+        parent->boundaryHeapBytes = std::max (parent->boundaryHeapBytes, boundaryHeapBytes);
+    }
+
+    MyMutex::MyLock lock (recordsMutex);
+
+    if (records.size () < maxRecords) {
+        records.push_back ({category, name, startWall, wall, processCpu, threads, threadId, boundaryHeapBytes});
+    }
+}
+
+bool ProfileStage::isEnabled ()
+{
+    return settings && !settings->profileFile.empty ();
+}
+
+bool ProfileStage::dump (const Glib::ustring& fname)
+{
+    std::vector<Record> recs;
+
+    {
+        MyMutex::MyLock lock (recordsMutex);
+        recs = records;
+    }
+
+    FILE* f = g_fopen (fname.c_str (), "wt");
+
+    if (!f) {
+        return false;
+    }
+
+    const bool json = fname.size () >= 5 && fname.substr (fname.size () - 5).lowercase () == ".json";
+
+    if (json) {
+        // Complete events ("ph":"X") of the Trace Event Format, times in microseconds
+        fprintf (f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+        for (size_t i = 0; i < recs.size (); ++i) {
+            const Record& r = recs[i];
+            fprintf (f, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,"
+                     "\"args\":{\"process_cpu_ms\":%.3f,\"threads\":%d,\"heap_bytes_at_boundaries\":%llu}}",
+                     i ? "," : "", escape (r.name).c_str (), escape (r.category).c_str (), r.tid, (long long)r.start, (long long)r.wall,
+                     r.processCpu / 1000.0, r.threads, (unsigned long long)r.boundaryHeapBytes);
+        }
+
+        fprintf (f, "\n]}\n");
+    } else {
+        fprintf (f, "category,stage,thread,start_us,wall_ms,process_cpu_ms,threads,heap_bytes_at_boundaries\n");
+
+        for (const auto& r : recs) {
+            fprintf (f, "%s,%s,%d,%lld,%.3f,%.3f,%d,%llu\n", r.category, r.name, r.tid, (long long)r.start,
+                     r.wall / 1000.0, r.processCpu / 1000.0, r.threads, (unsigned long long)r.boundaryHeapBytes);
+        }
+    }
+
+    return fclose (f) == 0;
+}
+
+void ProfileStage::clear ()
+{
+    MyMutex::MyLock lock (recordsMutex);
+    records.clear ();
+}
+
+}
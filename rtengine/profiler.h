@@ -0,0 +1,73 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glibmm/ustring.h>
+
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+/** Runtime profiling of the processing pipelines.
+  *
+  * Unlike StopWatch (BENCHFUN), which needs a rebuild with -DBENCHMARK, the stages are always instrumented and
+  * recorded as soon as Settings::profileFile is set. Each stage records its wall time, the CPU time of the whole
+  * process during the stage (so that the OpenMP workers are accounted for, but also the other threads), the number
+  * of OpenMP threads available to it and the largest heap usage sampled at its boundaries and at the boundaries of
+  * its nested stages; the heap isn't sampled in between, so this is a lower bound of the peak. The records are
+  * written to Settings::profileFile by rtengine::cleanup(), or on demand by ProfileStage::dump().
+  */
+class ProfileStage final :
+    public NonCopyable
+{
+public:
+    /** @param category is the pipeline the stage belongs to, e.g. "processImage"
+      * @param name is the name of the stage, e.g. "demosaic"
+      * Both have to be string literals (or have static storage duration). */
+    ProfileStage (const char* category, const char* name);
+    ~ProfileStage ();
+
+    /** Ends the stage before the end of the scope. */
+    void stop ();
+
+    /** @return true if the stages are being recorded */
+    static bool isEnabled ();
+
+    /** Writes the records to fname, as Chrome trace JSON ("chrome://tracing", Perfetto) if fname ends with ".json",
+      * as CSV otherwise. The records are kept.
+      * @return true on success */
+    static bool dump (const Glib::ustring& fname);
+
+    /** Discards the records. */
+    static void clear ();
+
+private:
+    const char* category;
+    const char* name;
+    bool running;
+    int64_t startWall;
+    int64_t startCpu;
+    int threads;
+    size_t boundaryHeapBytes;
+    ProfileStage* parent;
+};
+
+}
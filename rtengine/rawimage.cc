@@ -748,6 +748,28 @@ float** RawImage::compress_image()
     return data;
 }
 
+void RawImage::setMasterData (int W, int H, unsigned masterFilters, const char xtransMatrix[6][6], float* pixels)
+{
+    // the crop of the camera constants may have shifted the pattern of the master
+    width = iwidth = W;
+    height = iheight = H;
+    filters = masterFilters;
+
+    for (int row = 0; row < 6; row++)
+        for (int col = 0; col < 6; col++) {
+            xtrans[row][col] = xtransMatrix[row][col];
+        }
+
+    const int rowSize = (isBayer() || isXtrans() || colors == 1) ? W : 3 * W;
+
+    delete [] data;
+    data = new float*[H];
+
+    for (int i = 0; i < H; i++) {
+        data[i] = pixels + i * rowSize;
+    }
+}
+
 bool
 RawImage::is_supportedThumb() const
 {
@@ -120,6 +120,10 @@ public:
         return image;
     }
     float** compress_image(); // revert to compressed pixels format and release image data
+    /** Uses the pixels of a master dark frame or flat field instead of loading them, after loadRaw (false). The pixels
+      * are in the format of compress_image (), with the geometry of the master; they aren't owned by the image, and
+      * are only read. */
+    void setMasterData (int W, int H, unsigned masterFilters, const char xtransMatrix[6][6], float* pixels);
     float** data;             // holds pixel values, data[i][j] corresponds to the ith row and jth column
     unsigned prefilters;               // original filters saved ( used for 4 color processing )
 protected:
@@ -18,6 +18,7 @@
  */
 #include <cmath>
 #include <iostream>
+#include <sstream>
 
 #include "rtengine.h"
 #include "rawimagesource.h"
@@ -27,10 +28,13 @@
 #include "rawimage.h"
 #include "mytime.h"
 #include "iccstore.h"
+#include "cmstransformcache.h"
 #include "curves.h"
 #include "dfmanager.h"
 #include "ffmanager.h"
 #include "dcp.h"
+#include "demosaiccache.h"
+#include "flatfieldmaps.h"
 #include "rt_math.h"
 #include "improcfun.h"
 #ifdef _OPENMP
@@ -1719,6 +1723,23 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
         printf( "Flat Field Correction:%s\n", rif->get_filename().c_str());
     }
 
+    {
+        // everything rawData depends on, for the demosaic cache
+        std::ostringstream key;
+        key.precision(10);
+        key << (rid ? rid->get_filename() : "") << '|' << (rif ? rif->get_filename() : "") << '|'
+            << raw.ff_BlurRadius << '|' << raw.ff_BlurType << '|' << raw.ff_AutoClipControl << '|' << raw.ff_clipControl << '|'
+            << raw.ca_autocorrect << '|' << raw.caautostrength << '|' << raw.cared << '|' << raw.cablue << '|'
+            << raw.expos << '|' << raw.preser << '|'
+            << raw.hotPixelFilter << '|' << raw.deadPixelFilter << '|' << raw.hotdeadpix_thresh << '|'
+            << raw.bayersensor.black0 << '|' << raw.bayersensor.black1 << '|' << raw.bayersensor.black2 << '|' << raw.bayersensor.black3 << '|'
+            << raw.bayersensor.twogreen << '|' << raw.bayersensor.linenoise << '|' << raw.bayersensor.greenthresh << '|'
+            << (raw.bayersensor.method == RAWParams::BayerSensor::methodstring[RAWParams::BayerSensor::vng4]) << '|'
+            << raw.xtranssensor.blackred << '|' << raw.xtranssensor.blackgreen << '|' << raw.xtranssensor.blackblue << '|'
+            << (lensProf.useVign ? lensProf.lcpFile : "") << '|' << coarse.rotate << '|' << coarse.hflip << '|' << coarse.vflip;
+        preprocessKey = key.str();
+    }
+
     copyOriginalPixels(raw, ri, rid, rif);
     //FLATFIELD end
 
@@ -1918,6 +1939,40 @@ void RawImageSource::demosaic(const RAWParams &raw)
     MyTime t1, t2;
     t1.set();
 
+    // only the costly methods are worth caching
+    std::ostringstream params;
+
+    if (ri->getSensorType() == ST_BAYER) {
+        if (raw.bayersensor.method != RAWParams::BayerSensor::methodstring[RAWParams::BayerSensor::fast]
+                && raw.bayersensor.method != RAWParams::BayerSensor::methodstring[RAWParams::BayerSensor::mono]
+                && raw.bayersensor.method != RAWParams::BayerSensor::methodstring[RAWParams::BayerSensor::none]) {
+            params << raw.bayersensor.method << '|' << raw.bayersensor.dcb_iterations << '|' << raw.bayersensor.dcb_enhance << '|' << raw.bayersensor.lmmse_iterations;
+        }
+    } else if (ri->getSensorType() == ST_FUJI_XTRANS) {
+        if (raw.xtranssensor.method == RAWParams::XTransSensor::methodstring[RAWParams::XTransSensor::onePass]
+                || raw.xtranssensor.method == RAWParams::XTransSensor::methodstring[RAWParams::XTransSensor::threePass]) {
+            params << raw.xtranssensor.method;
+        }
+    }
+
+    DemosaicCache* const demosaicCache = DemosaicCache::getInstance();
+    Glib::ustring cacheKey;
+
+    if (demosaicCache->isEnabled() && !preprocessKey.empty() && !params.str().empty()) {
+        cacheKey = demosaicCache->getKey(fileName, preprocessKey + '|' + params.str());
+
+        if (demosaicCache->load(cacheKey, W, H, red, green, blue)) {
+            rgbSourceModified = false;
+            t2.set();
+
+            if( settings->verbose ) {
+                printf("Demosaicing read from the cache - %d usec\n", t2.etime(t1));
+            }
+
+            return;
+        }
+    }
+
     if (ri->getSensorType() == ST_BAYER) {
         if ( raw.bayersensor.method == RAWParams::BayerSensor::methodstring[RAWParams::BayerSensor::hphd] ) {
             hphd_demosaic ();
@@ -1962,6 +2017,19 @@ void RawImageSource::demosaic(const RAWParams &raw)
         nodemosaic(true);
     }
 
+    if (cancelToken && cancelToken->isCancelled()) {
+        // incomplete, the caller drops it and asks for it again
+        if( settings->verbose ) {
+            printf("Demosaicing abandoned\n");
+        }
+
+        return;
+    }
+
+    if (!cacheKey.empty()) {
+        demosaicCache->store(cacheKey, W, H, red, green, blue);
+    }
+
     t2.set();
 
 
@@ -2685,40 +2753,145 @@ void RawImageSource::HLRecovery_Global(ToneCurveParams hrp)
 }
 
 
-void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile, unsigned short black[4])
+std::shared_ptr<const FlatFieldMaps> RawImageSource::getFlatFieldMaps(const RAWParams &raw, RawImage *riFlatFile, unsigned short black[4])
 {
-//    BENCHFUN
-    float *cfablur = (float (*)) malloc (H * W * sizeof * cfablur);
     int BS = raw.ff_BlurRadius;
     BS += BS & 1;
+    const bool vhBlur = raw.ff_BlurType == RAWParams::ff_BlurTypestring[RAWParams::vh_ff];
+
+    const std::string key = FlatFieldMapCache::getInstance()->getKey(riFlatFile, ri, W, H, raw.ff_BlurType, BS, black);
+    std::shared_ptr<const FlatFieldMaps> cached = FlatFieldMapCache::getInstance()->get(key);
+
+    if (cached && cached->width == W && cached->height == H) {
+        return cached;
+    }
+
+    std::shared_ptr<FlatFieldMaps> maps(new FlatFieldMaps);
+    maps->width = W;
+    maps->height = H;
+    maps->vignette.resize(static_cast<size_t>(W) * H);
+    float *vignette = maps->vignette.data();
+
+    float *cfablur = (float (*)) malloc (H * W * sizeof * cfablur);
 
     //function call to cfabloxblur
     if (raw.ff_BlurType == RAWParams::ff_BlurTypestring[RAWParams::v_ff]) {
         cfaboxblur(riFlatFile, cfablur, 2 * BS, 0);
     } else if (raw.ff_BlurType == RAWParams::ff_BlurTypestring[RAWParams::h_ff]) {
         cfaboxblur(riFlatFile, cfablur, 0, 2 * BS);
-    } else if (raw.ff_BlurType == RAWParams::ff_BlurTypestring[RAWParams::vh_ff]) {
+    } else if (vhBlur) {
         //slightly more complicated blur if trying to correct both vertical and horizontal anomalies
         cfaboxblur(riFlatFile, cfablur, BS, BS);    //first do area blur to correct vignette
     } else { //(raw.ff_BlurType == RAWParams::ff_BlurTypestring[RAWParams::area_ff])
         cfaboxblur(riFlatFile, cfablur, BS, BS);
     }
 
+    // black levels of the image, by position in the 2x2 pattern for bayer and by color for xtrans
+    unsigned int c4[2][2] = {};
+    float refcolor[2][2] = {};
+    float xtransRefcolor[3] = {0.f};
+
     if(ri->getSensorType() == ST_BAYER) {
-        float refcolor[2][2];
+        unsigned int c[2][2]  = {{FC(0, 0), FC(0, 1)}, {FC(1, 0), FC(1, 1)}};
+        c4[0][0] = ( c[0][0] == 1) ? 3 : c[0][0];
+        c4[0][1] = ( c[0][1] == 1) ? 3 : c[0][1];
+        c4[1][0] = c[1][0];
+        c4[1][1] = c[1][1];
 
         //find centre average values by channel
         for (int m = 0; m < 2; m++)
             for (int n = 0; n < 2; n++) {
                 int row = 2 * (H >> 2) + m;
                 int col = 2 * (W >> 2) + n;
-                int c  = FC(row, col);
-                int c4 = ( c == 1 && !(row & 1) ) ? 3 : c;
-                refcolor[m][n] = max(0.0f, cfablur[row * W + col] - black[c4]);
+                refcolor[m][n] = max(0.0f, cfablur[row * W + col] - black[c4[m][n]]);
+            }
+
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+
+        for (int row = 0; row < H; row ++) {
+            for (int col = 0; col < W; col ++) {
+                vignette[row * W + col] = refcolor[row & 1][col & 1] / max(1e-5f, cfablur[row * W + col] - black[c4[row & 1][col & 1]]);
+            }
+        }
+    } else {
+        int cCount[3] = {0};
+
+        //find center ave values by channel
+        for (int m = -3; m < 3; m++)
+            for (int n = -3; n < 3; n++) {
+                int row = 2 * (H >> 2) + m;
+                int col = 2 * (W >> 2) + n;
+                int c  = riFlatFile->XTRANSFC(row, col);
+                xtransRefcolor[c] += max(0.0f, cfablur[row * W + col] - black[c]);
+                cCount[c] ++;
+            }
+
+        for(int c = 0; c < 3; c++) {
+            xtransRefcolor[c] = xtransRefcolor[c] / cCount[c];
+        }
+
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+
+        for (int row = 0; row < H; row++) {
+            for (int col = 0; col < W; col++) {
+                int c  = ri->XTRANSFC(row, col);
+                vignette[row * W + col] = xtransRefcolor[c] / max(1e-5f, cfablur[row * W + col] - black[c]);
             }
+        }
+    }
+
+    if (vhBlur) {
+        maps->lines.resize(static_cast<size_t>(W) * H);
+        float *lines = maps->lines.data();
+        float *cfablur1 = (float (*)) malloc (H * W * sizeof * cfablur1);
+        float *cfablur2 = (float (*)) malloc (H * W * sizeof * cfablur2);
+        //slightly more complicated blur if trying to correct both vertical and horizontal anomalies
+        cfaboxblur(riFlatFile, cfablur1, 0, 2 * BS); //now do horizontal blur
+        cfaboxblur(riFlatFile, cfablur2, 2 * BS, 0); //now do vertical blur
 
-        float limitFactor = 1.f;
+        const bool bayer = ri->getSensorType() == ST_BAYER;
 
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+
+        for (int row = 0; row < H; row++) {
+            for (int col = 0; col < W; col++) {
+                const float blackLevel = bayer ? black[c4[row & 1][col & 1]] : black[ri->XTRANSFC(row, col)];
+                lines[row * W + col] = SQR(max(1e-5f, cfablur[row * W + col] - blackLevel)) /
+                                       (max(1e-5f, cfablur1[row * W + col] - blackLevel) * max(1e-5f, cfablur2[row * W + col] - blackLevel));
+            }
+        }
+
+        free (cfablur1);
+        free (cfablur2);
+    }
+
+    free (cfablur);
+
+    FlatFieldMapCache::getInstance()->put(key, maps);
+    return maps;
+}
+
+void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile, unsigned short black[4])
+{
+//    BENCHFUN
+    if (ri->getSensorType() != ST_BAYER && ri->getSensorType() != ST_FUJI_XTRANS) {
+        return;
+    }
+
+    // the maps don't depend on the image, they are cached
+    const std::shared_ptr<const FlatFieldMaps> maps = getFlatFieldMaps(raw, riFlatFile, black);
+    const float *vignette = maps->vignette.data();
+    const float *lines = maps->lines.empty() ? nullptr : maps->lines.data();
+
+    float limitFactor = 1.f;
+
+    if(ri->getSensorType() == ST_BAYER) {
         if(raw.ff_AutoClipControl) {
             int clipControlGui = 0;
 
@@ -2738,7 +2911,7 @@ void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile
 
                         for (int row = 0; row < H - m; row += 2) {
                             for (int col = 0; col < W - n; col += 2) {
-                                float tempval = (rawData[row + m][col + n] - black[c4]) * ( refcolor[m][n] / max(1e-5f, cfablur[(row + m) * W + col + n] - black[c4]) );
+                                float tempval = (rawData[row + m][col + n] - black[c4]) * vignette[(row + m) * W + col + n];
 
                                 if(tempval > maxvalthr) {
                                     maxvalthr = tempval;
@@ -2770,12 +2943,6 @@ void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile
             limitFactor = max((float)(100 - raw.ff_clipControl) / 100.f, 0.01f);
         }
 
-        for (int m = 0; m < 2; m++)
-            for (int n = 0; n < 2; n++) {
-                refcolor[m][n] *= limitFactor;
-            }
-
-
         unsigned int c[2][2]  = {{FC(0, 0), FC(0, 1)}, {FC(1, 0), FC(1, 1)}};
         unsigned int c4[2][2];
         c4[0][0] = ( c[0][0] == 1) ? 3 : c[0][0];
@@ -2784,14 +2951,11 @@ void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile
         c4[1][1] = c[1][1];
 
 #ifdef __SSE2__
-        vfloat refcolorv[2] = {_mm_set_ps(refcolor[0][1], refcolor[0][0], refcolor[0][1], refcolor[0][0]),
-                               _mm_set_ps(refcolor[1][1], refcolor[1][0], refcolor[1][1], refcolor[1][0])
-                              };
         vfloat blackv[2] = {_mm_set_ps(black[c4[0][1]], black[c4[0][0]], black[c4[0][1]], black[c4[0][0]]),
                             _mm_set_ps(black[c4[1][1]], black[c4[1][0]], black[c4[1][1]], black[c4[1][0]])
                            };
 
-        vfloat epsv = F2V(1e-5f);
+        vfloat limitFactorv = F2V(limitFactor);
 #endif
 #ifdef _OPENMP
         #pragma omp parallel for schedule(dynamic,16)
@@ -2801,42 +2965,27 @@ void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile
             int col = 0;
 #ifdef __SSE2__
             vfloat rowBlackv = blackv[row & 1];
-            vfloat rowRefcolorv = refcolorv[row & 1];
 
             for (; col < W - 3; col += 4) {
-                vfloat vignettecorrv = rowRefcolorv / vmaxf(epsv, LVFU(cfablur[(row) * W + col]) - rowBlackv);
+                vfloat corrv = limitFactorv * LVFU(vignette[row * W + col]);
+
+                if (lines) {
+                    corrv *= LVFU(lines[row * W + col]);
+                }
+
                 vfloat valv = LVFU(rawData[row][col]);
                 valv -= rowBlackv;
-                STVFU(rawData[row][col], valv * vignettecorrv + rowBlackv);
+                STVFU(rawData[row][col], valv * corrv + rowBlackv);
             }
 
 #endif
 
             for (; col < W; col ++) {
-                float vignettecorr = refcolor[row & 1][col & 1] / max(1e-5f, cfablur[(row) * W + col] - black[c4[row & 1][col & 1]]);
-                rawData[row][col] = (rawData[row][col] - black[c4[row & 1][col & 1]]) * vignettecorr + black[c4[row & 1][col & 1]];
-            }
-        }
-    } else if(ri->getSensorType() == ST_FUJI_XTRANS) {
-        float refcolor[3] = {0.f};
-        int cCount[3] = {0};
-
-        //find center ave values by channel
-        for (int m = -3; m < 3; m++)
-            for (int n = -3; n < 3; n++) {
-                int row = 2 * (H >> 2) + m;
-                int col = 2 * (W >> 2) + n;
-                int c  = riFlatFile->XTRANSFC(row, col);
-                refcolor[c] += max(0.0f, cfablur[row * W + col] - black[c]);
-                cCount[c] ++;
+                float corr = limitFactor * vignette[row * W + col] * (lines ? lines[row * W + col] : 1.f);
+                rawData[row][col] = (rawData[row][col] - black[c4[row & 1][col & 1]]) * corr + black[c4[row & 1][col & 1]];
             }
-
-        for(int c = 0; c < 3; c++) {
-            refcolor[c] = refcolor[c] / cCount[c];
         }
-
-        float limitFactor = 1.f;
-
+    } else {
         if(raw.ff_AutoClipControl) {
             // determine maximum calculated value to avoid clipping
 //            int clipControlGui = 0;
@@ -2853,7 +3002,7 @@ void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile
 
                 for (int row = 0; row < H; row++) {
                     for (int col = 0; col < W; col++) {
-                        float tempval = (rawData[row][col] - black[0]) * ( refcolor[ri->XTRANSFC(row, col)] / max(1e-5f, cfablur[(row) * W + col] - black[0]) );
+                        float tempval = (rawData[row][col] - black[0]) * vignette[row * W + col];
 
                         if(tempval > maxvalthr) {
                             maxvalthr = tempval;
@@ -2880,11 +3029,6 @@ void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile
             limitFactor = max((float)(100 - raw.ff_clipControl) / 100.f, 0.01f);
         }
 
-
-        for(int c = 0; c < 3; c++) {
-            refcolor[c] *= limitFactor;
-        }
-
 #ifdef _OPENMP
         #pragma omp parallel for
 #endif
@@ -2892,80 +3036,11 @@ void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile
         for (int row = 0; row < H; row++) {
             for (int col = 0; col < W; col++) {
                 int c  = ri->XTRANSFC(row, col);
-                float vignettecorr = ( refcolor[c] / max(1e-5f, cfablur[(row) * W + col] - black[c]) );
-                rawData[row][col] = (rawData[row][col] - black[c]) * vignettecorr + black[c];
+                float corr = limitFactor * vignette[row * W + col] * (lines ? lines[row * W + col] : 1.f);
+                rawData[row][col] = (rawData[row][col] - black[c]) * corr + black[c];
             }
         }
     }
-
-    if (raw.ff_BlurType == RAWParams::ff_BlurTypestring[RAWParams::vh_ff]) {
-        float *cfablur1 = (float (*)) malloc (H * W * sizeof * cfablur1);
-        float *cfablur2 = (float (*)) malloc (H * W * sizeof * cfablur2);
-        //slightly more complicated blur if trying to correct both vertical and horizontal anomalies
-        cfaboxblur(riFlatFile, cfablur1, 0, 2 * BS); //now do horizontal blur
-        cfaboxblur(riFlatFile, cfablur2, 2 * BS, 0); //now do vertical blur
-
-        if(ri->getSensorType() == ST_BAYER) {
-            unsigned int c[2][2]  = {{FC(0, 0), FC(0, 1)}, {FC(1, 0), FC(1, 1)}};
-            unsigned int c4[2][2];
-            c4[0][0] = ( c[0][0] == 1) ? 3 : c[0][0];
-            c4[0][1] = ( c[0][1] == 1) ? 3 : c[0][1];
-            c4[1][0] = c[1][0];
-            c4[1][1] = c[1][1];
-
-#ifdef __SSE2__
-            vfloat blackv[2] = {_mm_set_ps(black[c4[0][1]], black[c4[0][0]], black[c4[0][1]], black[c4[0][0]]),
-                                _mm_set_ps(black[c4[1][1]], black[c4[1][0]], black[c4[1][1]], black[c4[1][0]])
-                               };
-
-            vfloat epsv = F2V(1e-5f);
-#endif
-#ifdef _OPENMP
-            #pragma omp parallel for schedule(dynamic,16)
-#endif
-
-            for (int row = 0; row < H; row ++) {
-                int col = 0;
-#ifdef __SSE2__
-                vfloat rowBlackv = blackv[row & 1];
-
-                for (; col < W - 3; col += 4) {
-                    vfloat linecorrv = SQRV(vmaxf(epsv, LVFU(cfablur[row * W + col]) - rowBlackv)) /
-                                       (vmaxf(epsv, LVFU(cfablur1[row * W + col]) - rowBlackv) * vmaxf(epsv, LVFU(cfablur2[row * W + col]) - rowBlackv));
-                    vfloat valv = LVFU(rawData[row][col]);
-                    valv -= rowBlackv;
-                    STVFU(rawData[row][col], valv * linecorrv + rowBlackv);
-                }
-
-#endif
-
-                for (; col < W; col ++) {
-                    float linecorr = SQR(max(1e-5f, cfablur[row * W + col] - black[c4[row & 1][col & 1]])) /
-                                     (max(1e-5f, cfablur1[row * W + col] - black[c4[row & 1][col & 1]]) * max(1e-5f, cfablur2[row * W + col] - black[c4[row & 1][col & 1]])) ;
-                    rawData[row][col] = (rawData[row][col] - black[c4[row & 1][col & 1]]) * linecorr + black[c4[row & 1][col & 1]];
-                }
-            }
-        } else if(ri->getSensorType() == ST_FUJI_XTRANS) {
-#ifdef _OPENMP
-            #pragma omp parallel for
-#endif
-
-            for (int row = 0; row < H; row++) {
-                for (int col = 0; col < W; col++) {
-                    int c  = ri->XTRANSFC(row, col);
-                    float hlinecorr = (max(1e-5f, cfablur[(row) * W + col] - black[c]) / max(1e-5f, cfablur1[(row) * W + col] - black[c]) );
-                    float vlinecorr = (max(1e-5f, cfablur[(row) * W + col] - black[c]) / max(1e-5f, cfablur2[(row) * W + col] - black[c]) );
-                    rawData[row][col] = ((rawData[row][col] - black[c]) * hlinecorr * vlinecorr + black[c]);
-                }
-            }
-
-        }
-
-        free (cfablur1);
-        free (cfablur2);
-    }
-
-    free (cfablur);
 }
 
 //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -3897,11 +3972,10 @@ void RawImageSource::colorSpaceConversion_ (Imagefloat* im, ColorManagementParam
         }
 
         // Initialize transform
-        cmsHTRANSFORM hTransform;
+        CmsTransform transform;
         cmsHPROFILE prophoto = iccStore->workingSpace("ProPhoto"); // We always use Prophoto to apply the ICC profile to minimize problems with clipping in LUT conversion.
         bool transform_via_pcs_lab = false;
         bool separate_pcs_lab_highlights = false;
-        lcmsMutex->lock ();
 
         switch (camera_icc_type) {
             case CAMERA_ICC_TYPE_PHASE_ONE:
@@ -3910,7 +3984,7 @@ void RawImageSource::colorSpaceConversion_ (Imagefloat* im, ColorManagementParam
                 transform_via_pcs_lab = true;
                 separate_pcs_lab_highlights = true;
                 // We transform to Lab because we can and that we avoid getting an unnecessary unmatched gamma conversion which we would need to revert.
-                hTransform = cmsCreateTransform (in, TYPE_RGB_FLT, nullptr, TYPE_Lab_FLT, INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE );
+                transform = CmsTransformCache::getInstance ()->get (in, TYPE_RGB_FLT, nullptr, TYPE_Lab_FLT, INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE );
 
                 for (int i = 0; i < 3; i++) {
                     for (int j = 0; j < 3; j++) {
@@ -3928,19 +4002,17 @@ void RawImageSource::colorSpaceConversion_ (Imagefloat* im, ColorManagementParam
             case CAMERA_ICC_TYPE_NIKON:
             case CAMERA_ICC_TYPE_GENERIC:
             default:
-                hTransform = cmsCreateTransform (in, TYPE_RGB_FLT, prophoto, TYPE_RGB_FLT, INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE );  // NOCACHE is important for thread safety
+                transform = CmsTransformCache::getInstance ()->get (in, TYPE_RGB_FLT, prophoto, TYPE_RGB_FLT, INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE );  // NOCACHE is important for thread safety
                 break;
         }
 
-        lcmsMutex->unlock ();
-
-        if (hTransform == nullptr) {
+        if (!transform) {
             // Fallback: create transform from camera profile. Should not happen normally.
-            lcmsMutex->lock ();
-            hTransform = cmsCreateTransform (camprofile, TYPE_RGB_FLT, prophoto, TYPE_RGB_FLT, INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE );
-            lcmsMutex->unlock ();
+            transform = CmsTransformCache::getInstance ()->get (camprofile, TYPE_RGB_FLT, prophoto, TYPE_RGB_FLT, INTENT_RELATIVE_COLORIMETRIC, cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE );
         }
 
+        const cmsHTRANSFORM hTransform = transform.get ();
+
         TMatrix toxyz = {}, torgb = {};
 
         if (!working_space_is_prophoto) {
@@ -4133,7 +4205,6 @@ void RawImageSource::colorSpaceConversion_ (Imagefloat* im, ColorManagementParam
                 }
             }
         } // End of parallelization
-        cmsDeleteTransform(hTransform);
     }
 
 //t3.set ();
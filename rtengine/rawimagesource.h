@@ -25,12 +25,15 @@
 #include "curves.h"
 #include "color.h"
 #include "iimage.h"
+#include <memory>
 
 #define HR_SCALE 2
 
 namespace rtengine
 {
 
+struct FlatFieldMaps;
+
 class RawImageSource : public ImageSource
 {
 
@@ -78,6 +81,7 @@ protected:
     int threshold;
 
     array2D<float> rawData;  // holds preprocessed pixel values, rowData[i][j] corresponds to the ith row and jth column
+    Glib::ustring preprocessKey;  // identifies the parameters rawData was preprocessed with, see DemosaicCache
 
     // the interpolated green plane:
     array2D<float> green;
@@ -124,6 +128,7 @@ public:
         return rgbSourceModified;   // tracks whether cached rgb output of demosaic has been modified
     }
 
+    std::shared_ptr<const FlatFieldMaps> getFlatFieldMaps(const RAWParams &raw, RawImage *riFlatFile, unsigned short black[4]);
     void        processFlatField(const RAWParams &raw, RawImage *riFlatFile, unsigned short black[4]);
     void        copyOriginalPixels(const RAWParams &raw, RawImage *ri, RawImage *riDark, RawImage *riFlatFile  );
     void        cfaboxblur  (RawImage *riFlatFile, float* cfablur, int boxH, int boxW);
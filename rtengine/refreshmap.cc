@@ -474,3 +474,453 @@ int refreshmap[rtengine::NUMOFEVENTS] = {
 
 };
 
+// The groups of the pp3 file whose values each event changes, separated by ';', "" if it doesn't change the values of
+// a tool. With refreshmap, they tell the parameters each stage of the pipelines reads, see PipelineCache.
+const char* const refreshgroups[] = {
+    "",                                      // EvPhotoLoaded
+    "",                                      // EvProfileLoaded
+    "",                                      // EvProfileChanged
+    "",                                      // EvHistoryBrowsed
+    "Exposure",                              // EvBrightness
+    "Exposure",                              // EvContrast
+    "Exposure",                              // EvBlack
+    "Exposure",                              // EvExpComp
+    "Exposure",                              // EvHLCompr
+    "Exposure",                              // EvSHCompr
+    "Exposure",                              // EvToneCurve1
+    "Exposure",                              // EvAutoExp
+    "Exposure",                              // EvClip
+    "Luminance Curve",                       // EvLBrightness
+    "Luminance Curve",                       // EvLContrast
+    "Luminance Curve",                       // EvLBlack
+    "Luminance Curve",                       // EvLHLCompr
+    "Luminance Curve",                       // EvLSHCompr
+    "Luminance Curve",                       // EvLLCurve
+    "Sharpening",                            // EvShrEnabled
+    "Sharpening",                            // EvShrRadius
+    "Sharpening",                            // EvShrAmount
+    "Sharpening",                            // EvShrThresh
+    "Sharpening",                            // EvShrEdgeOnly
+    "Sharpening",                            // EvShrEdgeRadius
+    "Sharpening",                            // EvShrEdgeTolerance
+    "Sharpening",                            // EvShrHaloControl
+    "Sharpening",                            // EvShrHaloAmount
+    "Sharpening",                            // EvShrMethod
+    "Sharpening",                            // EvShrDRadius
+    "Sharpening",                            // EvShrDAmount
+    "Sharpening",                            // EvShrDDamping
+    "Sharpening",                            // EvShrDIterations
+    "LensProfile",                           // EvLCPUseDist
+    "LensProfile",                           // EvLCPUseVign
+    "LensProfile",                           // EvLCPUseCA
+    "Exposure",                              // EvFixedExp
+    "White Balance",                         // EvWBMethod
+    "White Balance",                         // EvWBTemp
+    "White Balance",                         // EvWBGreen
+    "Exposure",                              // EvToneCurveMode1
+    "Exposure",                              // EvToneCurve2
+    "Exposure",                              // EvToneCurveMode2
+    "Luminance Denoising",                   // EvLDNRadius
+    "Luminance Denoising",                   // EvLDNEdgeTolerance
+    "Chrominance Denoising",                 // EvCDNEnabled
+    "Color Management",                      // EvBlendCMSMatrix
+    "Color Management",                      // EvDCPToneCurve
+    "Color Management",                      // EvDCPIlluminant
+    "Shadows & Highlights",                  // EvSHEnabled
+    "Shadows & Highlights",                  // EvSHHighlights
+    "Shadows & Highlights",                  // EvSHShadows
+    "Shadows & Highlights",                  // EvSHHLTonalW
+    "Shadows & Highlights",                  // EvSHSHTonalW
+    "Shadows & Highlights",                  // EvSHLContrast
+    "Shadows & Highlights",                  // EvSHRadius
+    "Coarse Transformation",                 // EvCTRotate
+    "Coarse Transformation",                 // EvCTHFlip
+    "Coarse Transformation",                 // EvCTVFlip
+    "Rotation",                              // EvROTDegree
+    "Common Properties for Transformations", // EvTransAutoFill
+    "Distortion",                            // EvDISTAmount
+    "",                                      // EvBookmarkSelected
+    "Crop",                                  // EvCrop
+    "CACorrection",                          // EvCACorr
+    "HLRecovery",                            // EvHREnabled
+    "HLRecovery",                            // EvHRAmount
+    "HLRecovery",                            // EvHRMethod
+    "Color Management",                      // EvWProfile
+    "Color Management",                      // EvOProfile
+    "Color Management",                      // EvIProfile
+    "Vignetting Correction",                 // EvVignettingAmount
+    "Channel Mixer",                         // EvChMixer
+    "Resize",                                // EvResizeScale
+    "Resize",                                // EvResizeMethod
+    "Exif",                                  // EvExif
+    "IPTC",                                  // EvIPTC
+    "Resize",                                // EvResizeSpec
+    "Resize",                                // EvResizeWidth
+    "Resize",                                // EvResizeHeight
+    "Resize",                                // EvResizeEnabled
+    "",                                      // EvProfileChangeNotification
+    "Shadows & Highlights",                  // EvSHHighQuality
+    "Perspective",                           // EvPerspCorr
+    "LensProfile",                           // EvLCPFile
+    "RGB Curves",                            // EvRGBrCurveLumamode
+    "Impulse Denoising",                     // EvIDNEnabled
+    "Impulse Denoising",                     // EvIDNThresh
+    "Directional Pyramid Denoising",         // EvDPDNEnabled
+    "Directional Pyramid Denoising",         // EvDPDNLuma
+    "Directional Pyramid Denoising",         // EvDPDNChroma
+    "Directional Pyramid Denoising",         // EvDPDNGamma
+    "Directional Pyramid Equalizer",         // EvDirPyrEqualizer
+    "Directional Pyramid Equalizer",         // EvDirPyrEqlEnabled
+    "Luminance Curve",                       // EvLSaturation
+    "Luminance Curve",                       // EvLaCurve
+    "Luminance Curve",                       // EvLbCurve
+    "RAW Bayer;RAW X-Trans",                 // EvDemosaicMethod
+    "RAW",                                   // EvPreProcessHotPixel
+    "Exposure",                              // EvSaturation
+    "HSV Equalizer",                         // EvHSVEqualizerH
+    "HSV Equalizer",                         // EvHSVEqualizerS
+    "HSV Equalizer",                         // EvHSVEqualizerV
+    "HSV Equalizer",                         // EvHSVEqEnabled
+    "Defringing",                            // EvDefringeEnabled
+    "Defringing",                            // EvDefringeRadius
+    "Defringing",                            // EvDefringeThreshold
+    "Exposure",                              // EvHLComprThreshold
+    "Resize",                                // EvResizeBoundingBox
+    "Resize",                                // EvResizeAppliesTo
+    "Luminance Curve",                       // EvLAvoidColorShift
+    "Luminance Curve",                       // EvLSatLimiter
+    "Luminance Curve",                       // EvLRSTProtection
+    "RAW Bayer",                             // EvDemosaicDCBIter
+    "RAW Bayer;RAW X-Trans",                 // EvDemosaicFalseColorIter
+    "RAW Bayer",                             // EvDemosaicDCBEnhanced
+    "RAW",                                   // EvPreProcessCARed
+    "RAW",                                   // EvPreProcessCABlue
+    "RAW Bayer",                             // EvPreProcessLineDenoise
+    "RAW Bayer",                             // EvPreProcessGEquilThresh
+    "RAW",                                   // EvPreProcessAutoCA
+    "RAW",                                   // EvPreProcessAutoDF
+    "RAW",                                   // EvPreProcessDFFile
+    "RAW",                                   // EvPreProcessExpCorrLinear
+    "RAW",                                   // EvPreProcessExpCorrPH
+    "RAW",                                   // EvFlatFieldFile
+    "RAW",                                   // EvFlatFieldAutoSelect
+    "RAW",                                   // EvFlatFieldBlurRadius
+    "RAW",                                   // EvFlatFieldBlurType
+    "Distortion",                            // EvAutoDIST
+    "Directional Pyramid Denoising",         // EvDPDNLumCurve
+    "Directional Pyramid Denoising",         // EvDPDNChromCurve
+    "Color Management",                      // EvGAMMA
+    "Color Management",                      // EvGAMPOS
+    "Color Management",                      // EvGAMFREE
+    "Color Management",                      // EvSLPOS
+    "RAW Bayer",                             // EvPreProcessExpBlackzero
+    "RAW Bayer",                             // EvPreProcessExpBlackone
+    "RAW Bayer",                             // EvPreProcessExpBlacktwo
+    "RAW Bayer",                             // EvPreProcessExpBlackthree
+    "RAW Bayer",                             // EvPreProcessExptwoGreen
+    "SharpenEdge",                           // EvSharpenEdgePasses
+    "SharpenEdge",                           // EvSharpenEdgeAmount
+    "SharpenMicro",                          // EvSharpenMicroAmount
+    "SharpenMicro",                          // EvSharpenMicroUniformity
+    "SharpenEdge",                           // EvSharpenEdgeEnabled
+    "SharpenEdge",                           // EvSharpenEdgeThreechannels
+    "SharpenMicro",                          // EvSharpenMicroEnabled
+    "SharpenMicro",                          // EvSharpenMicroMatrix
+    "RAW Bayer",                             // EvDemosaicALLEnhanced
+    "Vibrance",                              // EvVibranceEnabled
+    "Vibrance",                              // EvVibrancePastels
+    "Vibrance",                              // EvVibranceSaturated
+    "Vibrance",                              // EvVibranceProtectSkins
+    "Vibrance",                              // EvVibranceAvoidColorShift
+    "Vibrance",                              // EvVibrancePastSatTog
+    "Vibrance",                              // EvVibrancePastSatThreshold
+    "EPD",                                   // EvEPDStrength
+    "EPD",                                   // EvEPDEdgeStopping
+    "EPD",                                   // EvEPDScale
+    "EPD",                                   // EvEPDReweightingIterates
+    "EPD",                                   // EvEPDEnabled
+    "RGB Curves",                            // EvRGBrCurve
+    "RGB Curves",                            // EvRGBgCurve
+    "RGB Curves",                            // EvRGBbCurve
+    "Exposure;HLRecovery",                   // EvNeutralExp
+    "RAW Bayer;RAW X-Trans",                 // EvDemosaicMethodPreProc
+    "Luminance Curve",                       // EvLCCCurve
+    "Luminance Curve",                       // EvLCHCurve
+    "Vibrance",                              // EvVibranceSkinTonesCurve
+    "Luminance Curve",                       // EvLLCCurve
+    "Luminance Curve",                       // EvLLCredsk
+    "Directional Pyramid Denoising",         // EvDPDNLdetail
+    "Color appearance",                      // EvCATEnabled
+    "Color appearance",                      // EvCATDegree
+    "Color appearance",                      // EvCATMethodsur
+    "Color appearance",                      // EvCATAdapscen
+    "Color appearance",                      // EvCATAdapLum
+    "Color appearance",                      // EvCATMethodWB
+    "Color appearance",                      // EvCATJLight
+    "Color appearance",                      // EvCATChroma
+    "Color appearance",                      // EvCATAutoDegree
+    "Color appearance",                      // EvCATContrast
+    "Color appearance",                      // EvCATsurr
+    "Color appearance",                      // EvCATgamut
+    "Color appearance",                      // EvCATMethodalg
+    "Color appearance",                      // EvCATRstpro
+    "Color appearance",                      // EvCATQbright
+    "Color appearance",                      // EvCATQContrast
+    "Color appearance",                      // EvCATSChroma
+    "Color appearance",                      // EvCATMChroma
+    "Color appearance",                      // EvCAThue
+    "Color appearance",                      // EvCATCurve1
+    "Color appearance",                      // EvCATCurve2
+    "Color appearance",                      // EvCATCurveMode1
+    "Color appearance",                      // EvCATCurveMode2
+    "Color appearance",                      // EvCATCurve3
+    "Color appearance",                      // EvCATCurveMode3
+    "Color appearance",                      // EvCATdatacie
+    "Color appearance",                      // EvCATtonecie
+    "Directional Pyramid Denoising",         // EvDPDNredchro
+    "Directional Pyramid Denoising",         // EvDPDNbluechro
+    "Directional Pyramid Denoising",         // EvDPDNmet
+    "RAW Bayer",                             // EvDemosaicLMMSEIter
+    "Color appearance",                      // EvCATbadpix
+    "Color appearance",                      // EvCATAutoAdap
+    "Defringing",                            // EvPFCurve
+    "White Balance",                         // EvWBequal
+    "White Balance",                         // EvWBequalbo
+    "Gradient",                              // EvGradientDegree
+    "Gradient",                              // EvGradientEnabled
+    "PCVignette",                            // EvPCVignetteStrength
+    "PCVignette",                            // EvPCVignetteEnabled
+    "Black & White",                         // EvBWChmixEnabled
+    "Black & White",                         // EvBWred
+    "Black & White",                         // EvBWgreen
+    "Black & White",                         // EvBWblue
+    "Black & White",                         // EvBWredgam
+    "Black & White",                         // EvBWgreengam
+    "Black & White",                         // EvBWbluegam
+    "Black & White",                         // EvBWfilter
+    "Black & White",                         // EvBWsetting
+    "Black & White",                         // EvBWoran
+    "Black & White",                         // EvBWyell
+    "Black & White",                         // EvBWcyan
+    "Black & White",                         // EvBWmag
+    "Black & White",                         // EvBWpur
+    "Black & White",                         // EvBWLuminanceEqual
+    "Black & White",                         // EvBWChmixEnabledLm
+    "Black & White",                         // EvBWmethod
+    "Black & White",                         // EvBWBeforeCurve
+    "Black & White",                         // EvBWBeforeCurveMode
+    "Black & White",                         // EvBWAfterCurve
+    "Black & White",                         // EvBWAfterCurveMode
+    "Black & White",                         // EvAutoch
+    "",                                      // --unused--
+    "Black & White",                         // EvNeutralBW
+    "Gradient",                              // EvGradientFeather
+    "Gradient",                              // EvGradientStrength
+    "Gradient",                              // EvGradientCenter
+    "PCVignette",                            // EvPCVignetteFeather
+    "PCVignette",                            // EvPCVignetteRoundness
+    "Vignetting Correction",                 // EvVignettingRadius
+    "Vignetting Correction",                 // EvVignettingStrenght
+    "Vignetting Correction",                 // EvVignettingCenter
+    "Luminance Curve",                       // EvLCLCurve
+    "Luminance Curve",                       // EvLLHCurve
+    "Luminance Curve",                       // EvLHHCurve
+    "Directional Pyramid Equalizer",         // EvDirPyrEqualizerThreshold
+    "Directional Pyramid Denoising",         // EvDPDNenhance
+    "Black & White",                         // EvBWMethodalg
+    "Directional Pyramid Equalizer",         // EvDirPyrEqualizerSkin
+    "Directional Pyramid Equalizer",         // EvDirPyrEqlgamutlab
+    "Directional Pyramid Equalizer",         // EvDirPyrEqualizerHueskin
+    "Directional Pyramid Denoising",         // EvDPDNmedian
+    "Directional Pyramid Denoising",         // EvDPDNmedmet
+    "ColorToning",                           // EvColorToningEnabled
+    "ColorToning",                           // EvColorToningColor
+    "ColorToning",                           // EvColorToningOpacity
+    "ColorToning",                           // EvColorToningCLCurve
+    "ColorToning",                           // EvColorToningMethod
+    "ColorToning",                           // EvColorToningLLCurve
+    "ColorToning",                           // EvColorToningredlow
+    "ColorToning",                           // EvColorToninggreenlow
+    "ColorToning",                           // EvColorToningbluelow
+    "ColorToning",                           // EvColorToningredmed
+    "ColorToning",                           // EvColorToninggreenmed
+    "ColorToning",                           // EvColorToningbluemed
+    "ColorToning",                           // EvColorToningredhigh
+    "ColorToning",                           // EvColorToninggreenhigh
+    "ColorToning",                           // EvColorToningbluehigh
+    "ColorToning",                           // EvColorToningbalance
+    "ColorToning",                           // EvColorToningNeutral
+    "ColorToning",                           // EvColorToningsatlow
+    "ColorToning",                           // EvColorToningsathigh
+    "ColorToning",                           // EvColorToningTwocolor
+    "ColorToning",                           // EvColorToningNeutralcur
+    "ColorToning",                           // EvColorToningLumamode
+    "ColorToning",                           // EvColorToningShadows
+    "ColorToning",                           // EvColorToningHighights
+    "ColorToning",                           // EvColorToningSatProtection
+    "ColorToning",                           // EvColorToningSatThreshold
+    "ColorToning",                           // EvColorToningStrength
+    "ColorToning",                           // EvColorToningautosat
+    "Directional Pyramid Denoising",         // EvDPDNmetmed
+    "Directional Pyramid Denoising",         // EvDPDNrgbmet
+    "Directional Pyramid Denoising",         // EvDPDNpasses
+    "RAW",                                   // EvFlatFieldClipControl
+    "RAW",                                   // EvFlatFieldAutoClipControl
+    "RAW X-Trans",                           // EvPreProcessExpBlackRed
+    "RAW X-Trans",                           // EvPreProcessExpBlackGreen
+    "RAW X-Trans",                           // EvPreProcessExpBlackBlue
+    "Film Simulation",                       // EvFilmSimulationEnabled
+    "Film Simulation",                       // EvFilmSimulationStrength
+    "Film Simulation",                       // EvFilmSimulationFilename
+    "Directional Pyramid Denoising",         // EvDPDNLCurve
+    "Directional Pyramid Denoising",         // EvDPDNsmet
+    "RAW",                                   // EvPreProcessDeadPixel
+    "Directional Pyramid Denoising",         // EvDPDNCCCurve
+    "Directional Pyramid Denoising",         // EvDPDNautochroma
+    "Directional Pyramid Denoising",         // EvDPDNLmet
+    "Directional Pyramid Denoising",         // EvDPDNCmet
+    "Directional Pyramid Denoising",         // EvDPDNC2met
+    "Wavelet",                               // EvWavelet
+    "Wavelet",                               // EvWavEnabled
+    "Wavelet",                               // EvWavLmet
+    "Wavelet",                               // EvWavCLmet
+    "Wavelet",                               // EvWavDirmeto
+    "Wavelet",                               // EvWavtiles
+    "Wavelet",                               // EvWavsky
+    "Wavelet",                               // EvWavthres
+    "Wavelet",                               // EvWavthr
+    "Wavelet",                               // EvWavchroma
+    "Wavelet",                               // EvWavmedian
+    "Wavelet",                               // EvWavunif
+    "Wavelet",                               // EvWavSkin
+    "Wavelet",                               // EvWavHueskin
+    "Wavelet",                               // EvWavThreshold
+    "Wavelet",                               // EvWavlhl
+    "Wavelet",                               // EvWavlbl
+    "Wavelet",                               // EvWavThreshold2
+    "Wavelet",                               // EvWavavoid
+    "Wavelet",                               // EvWavCCCurve
+    "Wavelet",                               // EvWavpast
+    "Wavelet",                               // EvWavsat
+    "Wavelet",                               // EvWavCHmet
+    "Wavelet",                               // EvWavHSmet
+    "Wavelet",                               // EvWavchro
+    "Wavelet",                               // EvWavColor
+    "Wavelet",                               // EvWavOpac
+    "Wavelet",                               // EvWavsup
+    "Wavelet",                               // EvWavTilesmet
+    "Wavelet",                               // EvWavrescon
+    "Wavelet",                               // EvWavreschro
+    "Wavelet",                               // EvWavresconH
+    "Wavelet",                               // EvWavthrH
+    "Wavelet",                               // EvWavHueskin2
+    "Wavelet",                               // EvWavedgrad
+    "Wavelet",                               // EvWavedgval
+    "Wavelet",                               // EvWavStrength
+    "Wavelet",                               // EvWavdaubcoeffmet
+    "Wavelet",                               // EvWavedgreinf
+    "Wavelet",                               // EvWaveletch
+    "Wavelet",                               // EvWavCHSLmet
+    "Wavelet",                               // EvWavedgcont
+    "Wavelet",                               // EvWavEDmet
+    "Wavelet",                               // EvWavlev0nois
+    "Wavelet",                               // EvWavlev1nois
+    "Wavelet",                               // EvWavlev2nois
+    "Wavelet",                               // EvWavmedianlev
+    "Wavelet",                               // EvWavHHCurve
+    "Wavelet",                               // EvWavBackmet
+    "Wavelet",                               // EvWavedgedetect
+    "Wavelet",                               // EvWavlipst
+    "Wavelet",                               // EvWavedgedetectthr
+    "Wavelet",                               // EvWavedgedetectthr2
+    "Wavelet",                               // EvWavlinkedg
+    "Wavelet",                               // EvWavCHCurve
+    "RAW",                                   // EvPreProcessHotDeadThresh
+    "EPD",                                   // EvEPDgamma
+    "Wavelet",                               // EvWavtmr
+    "Wavelet",                               // EvWavTMmet
+    "Wavelet",                               // EvWavtmrs
+    "Wavelet",                               // EvWavbalance
+    "Wavelet",                               // EvWaviter
+    "Wavelet",                               // EvWavgamma
+    "Wavelet",                               // EvWavCLCurve
+    "Wavelet",                               // EvWavopacity
+    "Wavelet",                               // EvWavBAmet
+    "Wavelet",                               // EvWavopacityWL
+    "PostResizeSharpening",                  // EvPrShrEnabled
+    "PostResizeSharpening",                  // EvPrShrRadius
+    "PostResizeSharpening",                  // EvPrShrAmount
+    "PostResizeSharpening",                  // EvPrShrThresh
+    "PostResizeSharpening",                  // EvPrShrEdgeOnly
+    "PostResizeSharpening",                  // EvPrShrEdgeRadius
+    "PostResizeSharpening",                  // EvPrShrEdgeTolerance
+    "PostResizeSharpening",                  // EvPrShrHaloControl
+    "PostResizeSharpening",                  // EvPrShrHaloAmount
+    "PostResizeSharpening",                  // EvPrShrMethod
+    "PostResizeSharpening",                  // EvPrShrDRadius
+    "PostResizeSharpening",                  // EvPrShrDAmount
+    "PostResizeSharpening",                  // EvPrShrDDamping
+    "PostResizeSharpening",                  // EvPrShrDIterations
+    "Wavelet",                               // EvWavcbenab
+    "Wavelet",                               // EvWavgreenhigh
+    "Wavelet",                               // EvWavbluehigh
+    "Wavelet",                               // EvWavgreenmed
+    "Wavelet",                               // EvWavbluemed
+    "Wavelet",                               // EvWavgreenlow
+    "Wavelet",                               // EvWavbluelow
+    "Wavelet",                               // EvWavNeutral
+    "Color Management",                      // EvDCPApplyLookTable
+    "Color Management",                      // EvDCPApplyBaselineExposureOffset
+    "Color Management",                      // EvDCPApplyHueSatMap
+    "Wavelet",                               // EvWavenacont
+    "Wavelet",                               // EvWavenachrom
+    "Wavelet",                               // EvWavenaedge
+    "Wavelet",                               // EvWavenares
+    "Wavelet",                               // EvWavenafin
+    "Wavelet",                               // EvWavenatoning
+    "Wavelet",                               // EvWavenanoise
+    "Wavelet",                               // EvWavedgesensi
+    "Wavelet",                               // EvWavedgeampli
+    "Wavelet",                               // EvWavlev3nois
+    "Wavelet",                               // EvWavNPmet
+    "Retinex",                               // EvretinexMethod
+    "Retinex",                               // EvLneigh
+    "Retinex",                               // EvLgain
+    "Retinex",                               // EvLoffs
+    "Retinex",                               // EvLstr
+    "Retinex",                               // EvLscal
+    "Retinex",                               // EvLvart
+    "Retinex",                               // EvLCDCurve
+    "Retinex",                               // EvRetinextransmission
+    "Retinex",                               // EvRetinexEnabled
+    "Retinex",                               // EvRetinexmedianmap
+    "Retinex",                               // EvLlimd
+    "Retinex",                               // EvretinexColorSpace
+    "Retinex",                               // EvLCDHCurve
+    "Retinex",                               // Evretinexgamma
+    "Retinex",                               // EvLgam
+    "Retinex",                               // EvLslope
+    "Retinex",                               // EvLhighl
+    "Retinex",                               // EvLbaselog
+    "Retinex",                               // EvRetinexlhcurve
+    "Color Management",                      // EvOIntent
+    "",                                      // EvMonitorTransform
+    "Retinex",                               // EvLiter
+    "Retinex",                               // EvLgrad
+    "Retinex",                               // EvLgrads
+    "Retinex",                               // EvLhighlights
+    "Retinex",                               // EvLh_tonalwidth
+    "Retinex",                               // EvLshadows
+    "Retinex",                               // EvLs_tonalwidth
+    "Retinex",                               // EvLradius
+    "Retinex",                               // EvmapMethod
+    "Retinex",                               // EvRetinexmapcurve
+    "Retinex",                               // EvviewMethod
+    "Directional Pyramid Equalizer",         // EvcbdlMethod
+    "Retinex",                               // EvRetinexgaintransmission
+    "Retinex",                               // EvLskal
+    "Color Management",                      // EvOBPCompens
+    "White Balance"                          // EvWBtempBias
+};
+
+static_assert (sizeof (refreshgroups) / sizeof (refreshgroups[0]) == rtengine::NUMOFEVENTS, "an event is missing in refreshgroups");
@@ -72,4 +72,5 @@
 #define OUTPUTPROFILE     M_MONITOR
 
 extern int refreshmap[];
+extern const char* const refreshgroups[];
 #endif
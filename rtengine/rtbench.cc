@@ -0,0 +1,742 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * rtbench times the hot kernels of rtengine on synthetic images, so that the numbers only depend on the
+ * code, the compiler and the machine: no raw file, no user profile and no network access are needed.
+ *
+ * The Bayer (RGGB) and X-Trans mosaics and the RGB/Lab images are generated from the same deterministic
+ * scene (zone plate, coloured blocks, gradients and hashed noise), each kernel is run on them with every
+ * requested number of threads, and the fastest of the runs is reported in megapixels per second along
+ * with the scaling efficiency relative to the smallest number of threads.
+ *
+ * The results can be written to a CSV file, which can later be given back as baseline: rtbench then
+ * exits with 1 if a kernel got slower than the tolerance, which is what upgrades of the compiler or of
+ * the libraries are gated on.
+ */
+
+#ifdef __GNUC__
+#if defined(__FAST_MATH__)
+#error Using the -ffast-math CFLAG is known to lead to problems. Disable it to compile RawTherapee.
+#endif
+#endif
+
+#include "config.h"
+#include <glibmm.h>
+#include <giomm.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <locale.h>
+
+#include "rawimagesource.h"
+#include "improcfun.h"
+#include "labimage.h"
+#include "imagefloat.h"
+#include "gauss.h"
+#include "curves.h"
+#include "mytime.h"
+#include "cpudispatch.h"
+#include "rt_math.h"
+#include "../rtgui/options.h"
+#include "version.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+extern Options options;
+
+// stores path to data files
+Glib::ustring argv0;
+Glib::ustring argv1;
+bool simpleEditor;
+
+namespace
+{
+
+using namespace rtengine;
+using namespace rtengine::procparams;
+
+// Stateless integer hash, so that the noise doesn't depend on the order the pixels are generated in
+inline uint32_t hash (uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+// The synthetic scene, in [0;1]: a zone plate (all the frequencies up to Nyquist, hard on the demosaicers),
+// coloured blocks (sharp edges), a gradient per channel and some noise
+float sceneValue (int c, int row, int col, int width, int height)
+{
+    const float radius = std::min (width, height) / 2.f;
+    const float dx = col - width / 2.f;
+    const float dy = row - height / 2.f;
+    const float zone = 0.5f + 0.5f * std::cos (static_cast<float> (RT_PI_2) * (dx * dx + dy * dy) / radius);
+
+    static const float blockColours[4][3] = {{0.8f, 0.3f, 0.2f}, {0.2f, 0.7f, 0.3f}, {0.25f, 0.3f, 0.9f}, {0.6f, 0.6f, 0.6f}};
+    const float block = blockColours[((row >> 6) + (col >> 6) * 3) & 3][c];
+
+    const float gradient = c == 0 ? float (col) / width : c == 1 ? float (row) / height : 1.f - float (col + row) / (width + height);
+    const float noise = hash ((uint32_t (row) * 0x9e3779b9U) ^ (uint32_t (col) * 0x85ebca6bU) ^ uint32_t (c)) / 4294967296.f - 0.5f;
+
+    return std::max (0.f, std::min (1.f, 0.35f * zone + 0.35f * block + 0.15f * gradient + 0.04f * noise + 0.02f));
+}
+
+class BenchRawImage :
+    public RawImage
+{
+public:
+    BenchRawImage (bool xtransSensor, int w, int h) :
+        RawImage ("")
+    {
+        // Fuji X-Trans layout of the X-Pro1, 0: red, 1: green, 2: blue
+        static const char xtransPattern[6][6] = {
+            {1, 1, 0, 1, 1, 2},
+            {1, 1, 2, 1, 1, 0},
+            {2, 0, 1, 0, 2, 1},
+            {1, 1, 2, 1, 1, 0},
+            {1, 1, 0, 1, 1, 2},
+            {0, 2, 1, 2, 0, 1}
+        };
+
+        filters = xtransSensor ? 9 : 0x94949494; // RGGB otherwise
+        prefilters = filters;
+        colors = 3;
+        width = raw_width = w;
+        height = raw_height = h;
+        maximum = 65535;
+        memcpy (xtrans, xtransPattern, sizeof (xtrans));
+
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                rgb_cam[i][j] = i == j;
+            }
+        }
+
+        for (int c = 0; c < 4; ++c) {
+            pre_mul[c] = cam_mul[c] = 1.f;
+        }
+    }
+};
+
+// Feeds the protected demosaicers of RawImageSource with a synthetic mosaic, as if preprocess() had been done
+class BenchRawImageSource :
+    public RawImageSource
+{
+public:
+    BenchRawImageSource (bool xtransSensor, int width, int height) :
+        mosaic (width, height)
+    {
+        ri = new BenchRawImage (xtransSensor, width, height);
+        W = width;
+        H = height;
+        initialGain = 1.0;
+
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                imatrices.rgb_cam[i][j] = imatrices.cam_rgb[i][j] = i == j;
+            }
+        }
+
+        rawData (W, H);
+        red (W, H);
+        green (W, H);
+        blue (W, H);
+
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+
+        for (int row = 0; row < H; ++row) {
+            for (int col = 0; col < W; ++col) {
+                const unsigned c = xtransSensor ? ri->XTRANSFC (row, col) : ri->FC (row, col);
+                mosaic[row][col] = 65535.f * 0.9f * sceneValue (c, row, col, W, H);
+            }
+        }
+    }
+
+    // Some kernels work in place, so the mosaic is restored before each run
+    void reset ()
+    {
+        for (int row = 0; row < H; ++row) {
+            memcpy (rawData[row], mosaic[row], W * sizeof (float));
+        }
+    }
+
+    void amaze ()
+    {
+        amaze_demosaic_RT (0, 0, W, H);
+    }
+    void ahd ()
+    {
+        ahd_demosaic (0, 0, W, H);
+    }
+    void dcb (const RAWParams::BayerSensor& bayer)
+    {
+        dcb_demosaic (bayer.dcb_iterations, bayer.dcb_enhance);
+    }
+    void eahd ()
+    {
+        eahd_demosaic ();
+    }
+    void hphd ()
+    {
+        hphd_demosaic ();
+    }
+    void igv ()
+    {
+        igv_interpolate (W, H);
+    }
+    void lmmse (const RAWParams::BayerSensor& bayer)
+    {
+        lmmse_interpolate_omp (W, H, bayer.lmmse_iterations);
+    }
+    void vng4 ()
+    {
+        vng4_demosaic ();
+    }
+    void fast ()
+    {
+        fast_demosaic (0, 0, W, H);
+    }
+    void caCorrect (const RAWParams& raw)
+    {
+        CA_correct_RT (raw.cared, raw.cablue, 10.0 - raw.caautostrength);
+    }
+    void xtrans (int passes, bool useCieLab)
+    {
+        xtrans_interpolate (passes, useCieLab);
+    }
+    void fastXtrans ()
+    {
+        fast_xtrans_interpolate ();
+    }
+
+private:
+    array2D<float> mosaic;
+};
+
+struct Result {
+    std::string kernel;
+    int threads;
+    double ms;
+    double mps;
+    double efficiency;
+};
+
+class Bench
+{
+public:
+    Bench (int width, int height, const std::vector<int>& threadCounts, int runs, const std::vector<std::string>& kernels) :
+        width (width), height (height), threadCounts (threadCounts), runs (runs), kernels (kernels) {}
+
+    bool isSelected (const std::string& kernel) const
+    {
+        return kernels.empty () || std::find (kernels.begin (), kernels.end (), kernel) != kernels.end ();
+    }
+
+    bool isAnySelected (const std::vector<std::string>& names) const
+    {
+        for (const auto& name : names) {
+            if (isSelected (name)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Times run() with each thread count, setup() is called before each run and isn't timed
+    void measure (const std::string& kernel, const std::function<void ()>& setup, const std::function<void ()>& run)
+    {
+        if (!isSelected (kernel)) {
+            return;
+        }
+
+        double baseMs = 0.0;
+        int baseThreads = 0;
+
+        for (int threads : threadCounts) {
+#ifdef _OPENMP
+            omp_set_num_threads (threads);
+#endif
+            int best = -1;
+
+            for (int i = 0; i < runs; ++i) {
+                setup ();
+                MyTime t0, t1;
+                t0.set ();
+                run ();
+                t1.set ();
+
+                if (best < 0 || t1.etime (t0) < best) {
+                    best = t1.etime (t0);
+                }
+            }
+
+            const double ms = std::max (best, 1) / 1000.0;
+
+            if (!baseThreads) {
+                baseMs = ms;
+                baseThreads = threads;
+            }
+
+            Result result = {kernel, threads, ms, width * height / (ms * 1000.0), baseMs * baseThreads / (ms * threads)};
+            results.push_back (result);
+
+            std::cout << std::left << std::setw (20) << kernel << std::right << std::setw (8) << threads
+                      << std::fixed << std::setprecision (1) << std::setw (12) << ms
+                      << std::setprecision (2) << std::setw (10) << result.mps
+                      << std::setprecision (1) << std::setw (10) << result.efficiency * 100.0 << "%" << std::endl;
+        }
+    }
+
+    const std::vector<Result>& getResults () const
+    {
+        return results;
+    }
+
+    const int width;
+    const int height;
+
+private:
+    const std::vector<int> threadCounts;
+    const int runs;
+    const std::vector<std::string> kernels;
+    std::vector<Result> results;
+};
+
+const std::vector<std::string> bayerKernels = {"amaze", "ahd", "dcb", "eahd", "hphd", "igv", "lmmse", "vng4", "fast", "CA_correct_RT"};
+const std::vector<std::string> xtransKernels = {"xtrans3pass", "xtrans1pass", "xtransfast"};
+const std::vector<std::string> labKernels = {"gaussianBlur-small", "gaussianBlur-large", "RGB_denoise", "ip_wavelet", "EPDToneMap", "Lanczos", "lab2rgb16"};
+
+void runRawKernels (Bench& bench, const ProcParams& params)
+{
+    if (bench.isAnySelected (bayerKernels)) {
+        BenchRawImageSource src (false, bench.width, bench.height);
+        const auto reset = std::bind (&BenchRawImageSource::reset, &src);
+        const RAWParams::BayerSensor& bayer = params.raw.bayersensor;
+
+        bench.measure ("amaze", reset, [&] { src.amaze (); });
+        bench.measure ("ahd", reset, [&] { src.ahd (); });
+        bench.measure ("dcb", reset, [&] { src.dcb (bayer); });
+        bench.measure ("eahd", reset, [&] { src.eahd (); });
+        bench.measure ("hphd", reset, [&] { src.hphd (); });
+        bench.measure ("igv", reset, [&] { src.igv (); });
+        bench.measure ("lmmse", reset, [&] { src.lmmse (bayer); });
+        bench.measure ("vng4", reset, [&] { src.vng4 (); });
+        bench.measure ("fast", reset, [&] { src.fast (); });
+        bench.measure ("CA_correct_RT", reset, [&] { src.caCorrect (params.raw); });
+    }
+
+    if (bench.isAnySelected (xtransKernels)) {
+        BenchRawImageSource src (true, bench.width, bench.height);
+        const auto reset = std::bind (&BenchRawImageSource::reset, &src);
+
+        bench.measure ("xtrans3pass", reset, [&] { src.xtrans (3, true); });
+        bench.measure ("xtrans1pass", reset, [&] { src.xtrans (1, false); });
+        bench.measure ("xtransfast", reset, [&] { src.fastXtrans (); });
+    }
+}
+
+void runLabKernels (Bench& bench, ProcParams& params)
+{
+    if (!bench.isAnySelected (labKernels)) {
+        return;
+    }
+
+    const int W = bench.width;
+    const int H = bench.height;
+
+    // The tools are enabled with moderate settings, the other parameters are the defaults
+    params.dirpyrDenoise.enabled = true;
+    params.dirpyrDenoise.luma = 20.0;
+    params.dirpyrDenoise.chroma = 15.0;
+    params.epd.enabled = true;
+    params.wavelet.enabled = true;
+    params.wavelet.expcontrast = true;
+
+    for (int i = 0; i < 9; ++i) {
+        params.wavelet.c[i] = 20;
+    }
+
+    ImProcFunctions ipf (&params, true);
+
+    Imagefloat rgb (W, H);
+
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+
+    for (int row = 0; row < H; ++row) {
+        for (int col = 0; col < W; ++col) {
+            rgb.r (row, col) = 65535.f * sceneValue (0, row, col, W, H);
+            rgb.g (row, col) = 65535.f * sceneValue (1, row, col, W, H);
+            rgb.b (row, col) = 65535.f * sceneValue (2, row, col, W, H);
+        }
+    }
+
+    LabImage lab (W, H);
+    ipf.rgb2lab (rgb, lab, params.icm.working);
+
+    LabImage work (W, H);
+    const auto resetLab = [&] { work.CopyFrom (&lab); };
+    const auto noSetup = [] {};
+
+    array2D<float> blurred (W, H);
+
+    bench.measure ("gaussianBlur-small", noSetup, [&] {
+#ifdef _OPENMP
+        #pragma omp parallel
+#endif
+        gaussianBlur (lab.L, blurred, W, H, 1.0);
+    });
+    bench.measure ("gaussianBlur-large", noSetup, [&] {
+#ifdef _OPENMP
+        #pragma omp parallel
+#endif
+        gaussianBlur (lab.L, blurred, W, H, 25.0);
+    });
+
+    if (bench.isSelected ("RGB_denoise")) {
+        NoiseCurve noiseLCurve;
+        NoiseCurve noiseCCurve;
+        params.dirpyrDenoise.getCurves (noiseLCurve, noiseCCurve);
+
+        int numtiles_W, numtiles_H, tilewidth, tileheight, tileWskip, tileHskip;
+        const bool bigTiles = options.rtSettings.leveldnti == 0;
+        ipf.Tile_calc (bigTiles ? 1024 : 768, bigTiles ? 128 : 96, 2, W, H, numtiles_W, numtiles_H, tilewidth, tileheight, tileWskip, tileHskip);
+        std::vector<float> ch_M (std::max (numtiles_W * numtiles_H, 9)), max_r (ch_M.size ()), max_b (ch_M.size ());
+
+        Imagefloat denoised (W, H);
+        bench.measure ("RGB_denoise", [&] { rgb.copyData (&denoised); }, [&] {
+            float chaut, redaut, blueaut, maxredaut, maxblueaut, nresi, highresi;
+            ipf.RGB_denoise (2, &denoised, &denoised, nullptr, ch_M.data (), max_r.data (), max_b.data (), true, params.dirpyrDenoise, 0.0,
+                             noiseLCurve, noiseCCurve, chaut, redaut, blueaut, maxredaut, maxblueaut, nresi, highresi);
+        });
+    }
+
+    if (bench.isSelected ("ip_wavelet")) {
+        WavCurve wavCLVCurve;
+        WavOpacityCurveRG waOpacityCurveRG;
+        WavOpacityCurveBY waOpacityCurveBY;
+        WavOpacityCurveW waOpacityCurveW;
+        WavOpacityCurveWL waOpacityCurveWL;
+        params.wavelet.getCurves (wavCLVCurve, waOpacityCurveRG, waOpacityCurveBY, waOpacityCurveW, waOpacityCurveWL);
+
+        LUTf wavclCurve (65536, 0);
+        bool wavcontlutili = false;
+        CurveFactory::curveWavContL (wavcontlutili, params.wavelet.wavclCurve, wavclCurve, 1);
+
+        bench.measure ("ip_wavelet", resetLab, [&] {
+            ipf.ip_wavelet (&work, &work, 2, params.wavelet, wavCLVCurve, waOpacityCurveRG, waOpacityCurveBY, waOpacityCurveW, waOpacityCurveWL, wavclCurve, wavcontlutili, 1);
+        });
+    }
+
+    bench.measure ("EPDToneMap", resetLab, [&] { ipf.EPDToneMap (&work, 5, 1); });
+
+    LabImage half (W / 2, H / 2);
+    bench.measure ("Lanczos", noSetup, [&] { ipf.Lanczos (&lab, &half, 0.5f); });
+
+    // export to the default output profile
+    bench.measure ("lab2rgb16", noSetup, [&] { delete ipf.lab2rgb16 (&lab, 0, 0, W, H, params.icm, false); });
+}
+
+bool saveResults (const Glib::ustring& fileName, const Bench& bench)
+{
+    std::ofstream file (fileName);
+
+    if (!file.is_open ()) {
+        std::cerr << "Error: can't write the results to \"" << fileName << "\"" << std::endl;
+        return false;
+    }
+
+    file << "kernel,width,height,threads,ms,mps,efficiency" << std::endl;
+
+    for (const auto& r : bench.getResults ()) {
+        file << r.kernel << "," << bench.width << "," << bench.height << "," << r.threads << "," << r.ms << "," << r.mps << "," << r.efficiency << std::endl;
+    }
+
+    return true;
+}
+
+// Compares the results with a previous CSV output of rtbench, only the kernels measured with the same size and thread count are compared
+bool compareResults (const Glib::ustring& fileName, const Bench& bench, double tolerance, bool& regression)
+{
+    std::ifstream file (fileName);
+
+    if (!file.is_open ()) {
+        std::cerr << "Error: can't open the baseline \"" << fileName << "\"" << std::endl;
+        return false;
+    }
+
+    std::map<std::pair<std::string, int>, double> baseline;
+    std::string line;
+
+    while (std::getline (file, line)) {
+        std::replace (line.begin (), line.end (), ',', ' ');
+        std::istringstream fields (line);
+        std::string kernel;
+        int width, height, threads;
+        double ms, mps;
+
+        if (fields >> kernel >> width >> height >> threads >> ms >> mps && width == bench.width && height == bench.height) {
+            baseline[std::make_pair (kernel, threads)] = mps;
+        }
+    }
+
+    regression = false;
+
+    for (const auto& r : bench.getResults ()) {
+        const auto base = baseline.find (std::make_pair (r.kernel, r.threads));
+
+        if (base == baseline.end ()) {
+            continue;
+        }
+
+        const double change = (r.mps / base->second - 1.0) * 100.0;
+
+        if (change < -tolerance) {
+            regression = true;
+            std::cout << "REGRESSION: ";
+        }
+
+        std::cout << r.kernel << " with " << r.threads << " threads: " << std::fixed << std::setprecision (2) << base->second << " -> " << r.mps
+                  << " MP/s (" << std::showpos << std::setprecision (1) << change << std::noshowpos << "%)" << std::endl;
+    }
+
+    return true;
+}
+
+void printUsage (const char* argv0)
+{
+    const Glib::ustring name = Glib::path_get_basename (argv0);
+
+    std::cout << "  Benchmark of the processing kernels of RawTherapee on synthetic images." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Usage:" << std::endl;
+    std::cout << "  " << name << " [-s <width>x<height>] [-t <threads,...>] [-r <runs>] [-k <kernel,...>] [-o <csv>] [-b <csv> [-T <percent>]] [-S <level>]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -s <width>x<height>  Size of the synthetic images (default: 4000x3000)." << std::endl;
+    std::cout << "  -t <threads,...>     Thread counts to measure (default: powers of 2 up to the number of processors, and the latter)." << std::endl;
+    std::cout << "  -r <runs>            Runs per kernel and thread count, the fastest one is reported (default: 3)." << std::endl;
+    std::cout << "  -k <kernel,...>      Kernels to measure (default: all of them)." << std::endl;
+    std::cout << "  -o <csv>             Write the results to the given CSV file." << std::endl;
+    std::cout << "  -b <csv>             Compare the results with a previous CSV output, exit with 1 if a kernel got slower." << std::endl;
+    std::cout << "  -T <percent>         Slowdown tolerated by -b (default: 10)." << std::endl;
+    std::cout << "  -S <level>           Widest instruction set of the dispatched kernels: 0 = best of the cpu, 1 = build flags only, 2 = AVX2, 3 = AVX-512 (default: the SimdLevel option)." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Kernels:" << std::endl;
+
+    for (const auto list : {&bayerKernels, &xtransKernels, &labKernels}) {
+        std::cout << " ";
+
+        for (const auto& kernel : *list) {
+            std::cout << " " << kernel;
+        }
+
+        std::cout << std::endl;
+    }
+}
+
+std::vector<std::string> splitList (const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream stream (list);
+    std::string item;
+
+    while (std::getline (stream, item, ',')) {
+        if (!item.empty ()) {
+            items.push_back (item);
+        }
+    }
+
+    return items;
+}
+
+}
+
+int main (int argc, char **argv)
+{
+    setlocale (LC_ALL, "");
+    setlocale (LC_NUMERIC, "C"); // to set decimal point to "."
+
+    Glib::init ();
+    Gio::init ();
+
+#ifdef BUILD_BUNDLE
+    char exname[512] = {0};
+    Glib::ustring exePath;
+    // get the path where the rawtherapee executable is stored
+#ifdef WIN32
+    WCHAR exnameU[512] = {0};
+    GetModuleFileNameW (NULL, exnameU, 512);
+    WideCharToMultiByte (CP_UTF8, 0, exnameU, -1, exname, 512, 0, 0 );
+#else
+
+    if (readlink ("/proc/self/exe", exname, 512) < 0) {
+        strncpy (exname, argv[0], 512);
+    }
+
+#endif
+    exePath = Glib::path_get_dirname (exname);
+
+    // set paths
+    if (Glib::path_is_absolute (DATA_SEARCH_PATH)) {
+        argv0 = DATA_SEARCH_PATH;
+    } else {
+        argv0 = Glib::build_filename (exePath, DATA_SEARCH_PATH);
+    }
+
+#else
+    argv0 = DATA_SEARCH_PATH;
+#endif
+
+    simpleEditor = false;
+
+    int width = 4000;
+    int height = 3000;
+    int runs = 3;
+    double tolerance = 10.0;
+    std::vector<int> threadCounts;
+    std::vector<std::string> kernels;
+    Glib::ustring outputFile;
+    Glib::ustring baselineFile;
+    int simdLevel = -1;
+
+    for (int iArg = 1; iArg < argc; iArg++) {
+        if (!strcmp (argv[iArg], "-s") && iArg + 1 < argc) {
+            if (sscanf (argv[++iArg], "%dx%d", &width, &height) != 2) {
+                width = 0;
+            }
+        } else if (!strcmp (argv[iArg], "-t") && iArg + 1 < argc) {
+            for (const auto& item : splitList (argv[++iArg])) {
+                threadCounts.push_back (atoi (item.c_str ()));
+            }
+        } else if (!strcmp (argv[iArg], "-r") && iArg + 1 < argc) {
+            runs = atoi (argv[++iArg]);
+        } else if (!strcmp (argv[iArg], "-k") && iArg + 1 < argc) {
+            kernels = splitList (argv[++iArg]);
+        } else if (!strcmp (argv[iArg], "-o") && iArg + 1 < argc) {
+            outputFile = argv[++iArg];
+        } else if (!strcmp (argv[iArg], "-b") && iArg + 1 < argc) {
+            baselineFile = argv[++iArg];
+        } else if (!strcmp (argv[iArg], "-T") && iArg + 1 < argc) {
+            tolerance = atof (argv[++iArg]);
+        } else if (!strcmp (argv[iArg], "-S") && iArg + 1 < argc) {
+            simdLevel = atoi (argv[++iArg]);
+
+            if (simdLevel < 0 || simdLevel > 3) {
+                printUsage (argv[0]);
+                return -1;
+            }
+        } else {
+            printUsage (argv[0]);
+            return -1;
+        }
+    }
+
+    // The demosaicers need some margin around their borders and tiles
+    if (width < 64 || height < 64 || runs < 1 || tolerance < 0.0
+            || std::any_of (threadCounts.begin (), threadCounts.end (), [] (int n) { return n < 1; })) {
+        printUsage (argv[0]);
+        return -1;
+    }
+
+    for (const auto& kernel : kernels) {
+        if (std::find (bayerKernels.begin (), bayerKernels.end (), kernel) == bayerKernels.end ()
+                && std::find (xtransKernels.begin (), xtransKernels.end (), kernel) == xtransKernels.end ()
+                && std::find (labKernels.begin (), labKernels.end (), kernel) == labKernels.end ()) {
+            std::cerr << "Error: unknown kernel \"" << kernel << "\"" << std::endl;
+            return -1;
+        }
+    }
+
+    if (threadCounts.empty ()) {
+#ifdef _OPENMP
+        const int maxThreads = omp_get_num_procs ();
+#else
+        const int maxThreads = 1;
+#endif
+
+        for (int n = 1; n < maxThreads; n *= 2) {
+            threadCounts.push_back (n);
+        }
+
+        threadCounts.push_back (maxThreads);
+    }
+
+    if (!Options::load ()) {
+        std::cerr << "Fatal error!\nThe RT_SETTINGS and/or RT_PATH environment variables are set, but use a relative path. The path must be absolute!" << std::endl;
+        return -2;
+    }
+
+    if (simdLevel >= 0) {
+        options.rtSettings.simdLevel = simdLevel;
+    }
+
+    std::cout << "RawTherapee, version " << RTVERSION << std::endl;
+    std::cout << "Vector kernels: " << rtengine::getSimdLevelName (rtengine::getSimdLevel ()) << std::endl;
+    std::cout << "Synthetic images of " << width << "x" << height << " (" << std::fixed << std::setprecision (1) << width * height / 1e6 << " MP), fastest of " << runs << " runs" << std::endl;
+    std::cout << std::endl;
+    std::cout << std::left << std::setw (20) << "kernel" << std::right << std::setw (8) << "threads" << std::setw (12) << "ms" << std::setw (10) << "MP/s" << std::setw (11) << "efficiency" << std::endl;
+
+    Bench bench (width, height, threadCounts, runs, kernels);
+    ProcParams params;
+
+    runRawKernels (bench, params);
+    runLabKernels (bench, params);
+
+    rtengine::cleanup ();
+
+    if (!outputFile.empty () && !saveResults (outputFile, bench)) {
+        return -3;
+    }
+
+    if (!baselineFile.empty ()) {
+        bool regression;
+        std::cout << std::endl;
+
+        if (!compareResults (baselineFile, bench, tolerance, regression)) {
+            return -3;
+        }
+
+        return regression ? 1 : 0;
+    }
+
+    return 0;
+}
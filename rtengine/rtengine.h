@@ -505,6 +505,15 @@ public:
                    * @return the next ProcessingJob to process */
     virtual ProcessingJob* imageReady (IImage16* img) = 0;
     virtual void error(Glib::ustring message) = 0;
+    /** This function is called before an image gets processed, to know which input is likely to be processed next, so that it can be loaded in
+                   * the background. Returning false disables the background loading.
+                   * @param fname is the file name of the next input image
+                   * @param isRaw is set to true if the next input image is a raw file
+                   * @return true if a next input image is known */
+    virtual bool getNextJobInput (Glib::ustring& fname, bool& isRaw)
+    {
+        return false;
+    }
 };
 /** This function performs all the image processinf steps corresponding to the given ProcessingJob. It runs in the background, thus it returns immediately,
    * When it finishes, it calls the BatchProcessingListener with the resulting image and asks for the next job. It the listener gives a new job, it goes on
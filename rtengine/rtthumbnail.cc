@@ -23,6 +23,7 @@
 #include <lcms2.h>
 #include "curves.h"
 #include <glibmm.h>
+#include <zlib.h>
 #include "improcfun.h"
 #include "colortemp.h"
 #include "mytime.h"
@@ -200,7 +201,10 @@ Thumbnail* Thumbnail::loadQuickFromRaw (const Glib::ustring& fname, RawMetaDataL
         const char* data((const char*)fdata(ri->get_thumbOffset(), ri->get_file()));
 
         if ( (unsigned char)data[1] == 0xd8 ) {
-            err = img->loadJPEGFromMemory(data, ri->get_thumbLength());
+            // the image is resized to the requested size below, so it doesn't have to be decoded at full size
+            const int minW = inspectorMode || fixwh == 1 ? 0 : w;
+            const int minH = inspectorMode || fixwh != 1 ? 0 : h;
+            err = img->loadJPEGFromMemory(data, ri->get_thumbLength(), minW, minH);
         } else if (ri->is_ppmThumb()) {
             err = img->loadPPMFromMemory(data, ri->get_thumbWidth(), ri->get_thumbHeight(), ri->get_thumbSwap(), ri->get_thumbBPS());
         }
@@ -1634,45 +1638,233 @@ unsigned char* Thumbnail::getGrayscaleHistEQ (int trim_width)
     return tmpdata;
 }
 
-bool Thumbnail::writeImage (const Glib::ustring& fname, int format)
+namespace
 {
 
-    if (!thumbImg) {
+/*
+ * The thumbnail images are stored as their type, optionally followed by ";z" and the number of low bits dropped
+ * from the samples, a newline, the width and the height, then either the raw dump of the data, or the data
+ * compressed by deflate after replacing each sample by its difference to the previous one of the same channel.
+ * The rows are inflated directly into the image, the differences being undone in place.
+ */
+
+// rows of the image, in the order of the raw dump
+std::vector<unsigned char*> getRows (Image8* image)
+{
+    std::vector<unsigned char*> rows;
+
+    for (int i = 0; i < image->getHeight (); i++) {
+        rows.push_back (image->r (i));
+    }
+
+    return rows;
+}
+
+template<class T>
+std::vector<unsigned char*> getRows (PlanarRGBData<T>* image)
+{
+    std::vector<unsigned char*> rows;
+
+    for (T** plane : {image->r.ptrs, image->g.ptrs, image->b.ptrs}) {
+        for (int i = 0; i < image->getHeight (); i++) {
+            rows.push_back (reinterpret_cast<unsigned char*> (plane[i]));
+        }
+    }
+
+    return rows;
+}
+
+// U is an unsigned integer of the size of the samples, the floats are handled by their bit pattern
+template<typename U>
+void applyDelta (const unsigned char* src, unsigned char* dst, int n, int stride, int shift)
+{
+    U prev[3] = {};
+
+    for (int i = 0, c = 0; i < n; i++) {
+        U value;
+        memcpy (&value, src + i * sizeof (U), sizeof (U));
+        const U q = value >> shift;
+        const U delta = q - prev[c];
+        prev[c] = q;
+        memcpy (dst + i * sizeof (U), &delta, sizeof (U));
+        c = c + 1 == stride ? 0 : c + 1;
+    }
+}
+
+template<typename U>
+void undoDelta (unsigned char* row, int n, int stride, int shift)
+{
+    // the dropped bits are set to the middle of their range
+    const U half = shift ? U (1) << (shift - 1) : 0;
+    U prev[3] = {};
+
+    for (int i = 0, c = 0; i < n; i++) {
+        U delta;
+        memcpy (&delta, row + i * sizeof (U), sizeof (U));
+        prev[c] += delta;
+        const U value = U (prev[c] << shift) | half;
+        memcpy (row + i * sizeof (U), &value, sizeof (U));
+        c = c + 1 == stride ? 0 : c + 1;
+    }
+}
+
+template<typename U>
+bool compressRows (const std::vector<unsigned char*>& rows, int n, int stride, int shift, std::string& buffer)
+{
+    z_stream stream = {};
+
+    if (deflateInit (&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
         return false;
     }
 
-    Glib::ustring fullFName = fname + ".rtti";
+    std::vector<unsigned char> line (n * sizeof (U));
+    std::vector<unsigned char> out (64 * 1024);
+    bool ok = true;
+
+    for (size_t i = 0; ok && i < rows.size (); i++) {
+        applyDelta<U> (rows[i], line.data (), n, stride, shift);
+        stream.next_in = line.data ();
+        stream.avail_in = line.size ();
+        const int flush = i + 1 == rows.size () ? Z_FINISH : Z_NO_FLUSH;
+
+        do {
+            stream.next_out = out.data ();
+            stream.avail_out = out.size ();
+            ok = deflate (&stream, flush) != Z_STREAM_ERROR;
+            buffer.append (reinterpret_cast<const char*> (out.data ()), out.size () - stream.avail_out);
+        } while (ok && stream.avail_out == 0);
+    }
+
+    deflateEnd (&stream);
+    return ok;
+}
+
+template<typename U>
+bool decompressRows (const std::vector<unsigned char*>& rows, int n, int stride, int shift, const char* data, size_t size)
+{
+    z_stream stream = {};
+    stream.next_in = reinterpret_cast<Bytef*> (const_cast<char*> (data));
+    stream.avail_in = size;
+
+    if (inflateInit (&stream) != Z_OK) {
+        return false;
+    }
+
+    bool ok = true;
+
+    for (size_t i = 0; ok && i < rows.size (); i++) {
+        stream.next_out = rows[i];
+        stream.avail_out = n * sizeof (U);
+
+        while (ok && stream.avail_out > 0) {
+            const int result = inflate (&stream, Z_NO_FLUSH);
+            ok = (result == Z_OK || result == Z_STREAM_END) && (result != Z_STREAM_END || stream.avail_out == 0);
+        }
+
+        if (ok) {
+            undoDelta<U> (rows[i], n, stride, shift);
+        }
+    }
+
+    inflateEnd (&stream);
+    return ok;
+}
+
+template<class T, typename U>
+T* readImageData (const char* data, size_t size, guint32 width, guint32 height, bool compressed, int shift)
+{
+    // a damaged record mustn't make us allocate a huge image
+    if (width == 0 || height == 0 || static_cast<uint64_t> (width) * height > (1 << 26) || shift >= static_cast<int> (8 * sizeof (U))
+            || (!compressed && 3 * sizeof (U) * static_cast<uint64_t> (width) * height != size)) {
+        return nullptr;
+    }
+
+    T* image = new T(width, height);
+
+    const std::vector<unsigned char*> rows = getRows (image);
+    // the rows of the chunky images hold the 3 channels
+    const int stride = rows.size () == height ? 3 : 1;
+    const int n = stride * width;
+    bool ok = true;
 
-    FILE* f = g_fopen (fullFName.c_str (), "wb");
+    if (compressed) {
+        ok = decompressRows<U> (rows, n, stride, shift, data, size);
+    } else {
+        for (size_t i = 0; i < rows.size (); i++) {
+            memcpy (rows[i], data + i * n * sizeof (U), n * sizeof (U));
+        }
+    }
 
-    if (!f) {
+    if (!ok) {
+        delete image;
+        return nullptr;
+    }
+
+    return image;
+}
+
+}
+
+bool Thumbnail::writeImage (std::string& buffer)
+{
+
+    if (!thumbImg) {
         return false;
     }
 
-    fwrite (thumbImg->getType(), sizeof (char), strlen(thumbImg->getType()), f);
-    fputc ('\n', f);
+    // 0: raw dump, 1: lossless, 2: lossy, keeping 10 significant bits, which is enough for a thumbnail
+    const int compression = options.thumbnailCacheCompression;
+    const bool lossy = compression == 2;
+    int shift = 0;
+
+    if (lossy && thumbImg->getType() == sImage16) {
+        shift = 6;
+    } else if (lossy && thumbImg->getType() == sImagefloat) {
+        shift = 13;
+    }
+
+    buffer = thumbImg->getType();
+
+    if (compression) {
+        buffer += ";z" + std::to_string (shift);
+    }
+
+    buffer += '\n';
     guint32 w = guint32(thumbImg->getWidth());
     guint32 h = guint32(thumbImg->getHeight());
-    fwrite (&w, sizeof (guint32), 1, f);
-    fwrite (&h, sizeof (guint32), 1, f);
+    buffer.append (reinterpret_cast<const char*>(&w), sizeof (guint32));
+    buffer.append (reinterpret_cast<const char*>(&h), sizeof (guint32));
 
     if (thumbImg->getType() == sImage8) {
         Image8 *image = static_cast<Image8*>(thumbImg);
-        image->writeData(f);
+
+        if (compression) {
+            return compressRows<uint8_t> (getRows (image), 3 * w, 3, shift, buffer);
+        }
+
+        image->writeData(buffer);
     } else if (thumbImg->getType() == sImage16) {
         Image16 *image = static_cast<Image16*>(thumbImg);
-        image->writeData(f);
+
+        if (compression) {
+            return compressRows<uint16_t> (getRows (image), w, 1, shift, buffer);
+        }
+
+        image->writeData(buffer);
     } else if (thumbImg->getType() == sImagefloat) {
         Imagefloat *image = static_cast<Imagefloat*>(thumbImg);
-        image->writeData(f);
+
+        if (compression) {
+            return compressRows<uint32_t> (getRows (image), w, 1, shift, buffer);
+        }
+
+        image->writeData(buffer);
     }
 
-    //thumbImg->writeData(f);
-    fclose (f);
     return true;
 }
 
-bool Thumbnail::readImage (const Glib::ustring& fname)
+bool Thumbnail::readImage (const char* data, size_t size)
 {
 
     if (thumbImg) {
@@ -1680,52 +1872,44 @@ bool Thumbnail::readImage (const Glib::ustring& fname)
         thumbImg = nullptr;
     }
 
-    Glib::ustring fullFName = fname + ".rtti";
+    const char* const typeEnd = static_cast<const char*> (memchr (data, '\n', std::min<size_t> (size, 31)));
 
-    if (!Glib::file_test (fullFName, Glib::FILE_TEST_EXISTS)) {
+    // 30 -> arbitrary size, but should be enough for all image type's name
+    if (!typeEnd || data + size < typeEnd + 1 + 2 * sizeof (guint32)) {
         return false;
     }
 
-    FILE* f = g_fopen (fullFName.c_str (), "rb");
+    std::string imgType (data, typeEnd);
+    bool compressed = false;
+    int shift = 0;
+    const size_t codec = imgType.find (";z");
 
-    if (!f) {
-        return false;
+    if (codec != std::string::npos) {
+        compressed = true;
+        shift = atoi (imgType.c_str () + codec + 2);
+        imgType.resize (codec);
     }
 
-    char imgType[31];  // 30 -> arbitrary size, but should be enough for all image type's name
-    fgets(imgType, 30, f);
-    imgType[strlen(imgType) - 1] = '\0'; // imgType has a \n trailing character, so we overwrite it by the \0 char
-
     guint32 width, height;
-    fread (&width, 1, sizeof (guint32), f);
-    fread (&height, 1, sizeof (guint32), f);
-
-    bool success = false;
-
-    if (!strcmp(imgType, sImage8)) {
-        Image8 *image = new Image8(width, height);
-        image->readData(f);
-        thumbImg = image;
-        success = true;
-    } else if (!strcmp(imgType, sImage16)) {
-        Image16 *image = new Image16(width, height);
-        image->readData(f);
-        thumbImg = image;
-        success = true;
-    } else if (!strcmp(imgType, sImagefloat)) {
-        Imagefloat *image = new Imagefloat(width, height);
-        image->readData(f);
-        thumbImg = image;
-        success = true;
+    memcpy (&width, typeEnd + 1, sizeof (guint32));
+    memcpy (&height, typeEnd + 1 + sizeof (guint32), sizeof (guint32));
+    const char* const pixels = typeEnd + 1 + 2 * sizeof (guint32);
+    const size_t pixelsSize = data + size - pixels;
+
+    if (imgType == sImage8) {
+        thumbImg = readImageData<Image8, uint8_t> (pixels, pixelsSize, width, height, compressed, shift);
+    } else if (imgType == sImage16) {
+        thumbImg = readImageData<Image16, uint16_t> (pixels, pixelsSize, width, height, compressed, shift);
+    } else if (imgType == sImagefloat) {
+        thumbImg = readImageData<Imagefloat, uint32_t> (pixels, pixelsSize, width, height, compressed, shift);
     } else {
-        printf("readImage: Unsupported image type \"%s\"!\n", imgType);
+        printf("readImage: Unsupported image type \"%s\"!\n", imgType.c_str());
     }
 
-    fclose(f);
-    return success;
+    return thumbImg != nullptr;
 }
 
-bool Thumbnail::readData  (const Glib::ustring& fname)
+bool Thumbnail::readData  (const std::string& buffer)
 {
     setlocale(LC_NUMERIC, "C"); // to set decimal point to "."
     Glib::KeyFile keyFile;
@@ -1734,7 +1918,7 @@ bool Thumbnail::readData  (const Glib::ustring& fname)
         MyMutex::MyLock thmbLock(thumbMutex);
 
         try {
-            keyFile.load_from_file (fname);
+            keyFile.load_from_data (buffer);
         } catch (Glib::Error&) {
             return false;
         }
@@ -1810,18 +1994,18 @@ bool Thumbnail::readData  (const Glib::ustring& fname)
         return true;
     } catch (Glib::Error &err) {
         if (options.rtSettings.verbose) {
-            printf("Thumbnail::readData / Error code %d while reading values from \"%s\":\n%s\n", err.code(), fname.c_str(), err.what().c_str());
+            printf("Thumbnail::readData / Error code %d while reading values:\n%s\n", err.code(), err.what().c_str());
         }
     } catch (...) {
         if (options.rtSettings.verbose) {
-            printf("Thumbnail::readData / Unknown exception while trying to load \"%s\"!\n", fname.c_str());
+            printf("Thumbnail::readData / Unknown exception while trying to load the values!\n");
         }
     }
 
     return false;
 }
 
-bool Thumbnail::writeData  (const Glib::ustring& fname)
+bool Thumbnail::writeData  (std::string& buffer)
 {
     MyMutex::MyLock thmbLock(thumbMutex);
 
@@ -1832,7 +2016,9 @@ bool Thumbnail::writeData  (const Glib::ustring& fname)
         Glib::KeyFile keyFile;
 
         try {
-            keyFile.load_from_file (fname);
+            if (!buffer.empty ()) {
+                keyFile.load_from_data (buffer);
+            }
         } catch (Glib::Error&) {}
 
         keyFile.set_double  ("LiveThumbData", "CamWBRed", camwbRed);
@@ -1856,11 +2042,11 @@ bool Thumbnail::writeData  (const Glib::ustring& fname)
 
     } catch (Glib::Error& err) {
         if (options.rtSettings.verbose) {
-            printf("Thumbnail::writeData / Error code %d while reading values from \"%s\":\n%s\n", err.code(), fname.c_str(), err.what().c_str());
+            printf("Thumbnail::writeData / Error code %d while writing values:\n%s\n", err.code(), err.what().c_str());
         }
     } catch (...) {
         if (options.rtSettings.verbose) {
-            printf("Thumbnail::writeData / Unknown exception while trying to save \"%s\"!\n", fname.c_str());
+            printf("Thumbnail::writeData / Unknown exception while trying to save the values!\n");
         }
     }
 
@@ -1868,38 +2054,21 @@ bool Thumbnail::writeData  (const Glib::ustring& fname)
         return false;
     }
 
-    FILE *f = g_fopen (fname.c_str (), "wt");
-
-    if (!f) {
-        if (options.rtSettings.verbose) {
-            printf("Thumbnail::writeData / Error: unable to open file \"%s\" with write access!\n", fname.c_str());
-        }
-
-        return false;
-    } else {
-        fprintf (f, "%s", keyData.c_str ());
-        fclose (f);
-    }
-
+    buffer = keyData.raw ();
     return true;
 }
 
-bool Thumbnail::readEmbProfile  (const Glib::ustring& fname)
+bool Thumbnail::readEmbProfile  (const std::string& buffer)
 {
 
-    FILE* f = g_fopen (fname.c_str (), "rb");
-
-    if (!f) {
+    if (buffer.empty ()) {
         embProfileData = nullptr;
         embProfile = nullptr;
         embProfileLength = 0;
     } else {
-        fseek (f, 0, SEEK_END);
-        embProfileLength = ftell (f);
-        fseek (f, 0, SEEK_SET);
+        embProfileLength = buffer.size ();
         embProfileData = new unsigned char[embProfileLength];
-        fread (embProfileData, 1, embProfileLength, f);
-        fclose (f);
+        memcpy (embProfileData, buffer.data (), embProfileLength);
         embProfile = cmsOpenProfileFromMem (embProfileData, embProfileLength);
         return true;
     }
@@ -1907,50 +2076,39 @@ bool Thumbnail::readEmbProfile  (const Glib::ustring& fname)
     return false;
 }
 
-bool Thumbnail::writeEmbProfile (const Glib::ustring& fname)
+bool Thumbnail::writeEmbProfile (std::string& buffer)
 {
 
     if (embProfileData) {
-        FILE* f = g_fopen(fname.c_str (), "wb");
-
-        if (f) {
-            fwrite (embProfileData, 1, embProfileLength, f);
-            fclose (f);
-            return true;
-        }
+        buffer.assign (reinterpret_cast<const char*>(embProfileData), embProfileLength);
+        return true;
     }
 
     return false;
 }
 
-bool Thumbnail::readAEHistogram  (const Glib::ustring& fname)
+bool Thumbnail::readAEHistogram  (const std::string& buffer)
 {
 
-    FILE* f = g_fopen (fname.c_str (), "rb");
+    const size_t size = (65536 >> aeHistCompression) * sizeof(aeHistogram[0]);
 
-    if (!f) {
+    if (buffer.size () != size) {
         aeHistogram(0);
     } else {
         aeHistogram(65536 >> aeHistCompression);
-        fread (&aeHistogram[0], 1, (65536 >> aeHistCompression)*sizeof(aeHistogram[0]), f);
-        fclose (f);
+        memcpy (&aeHistogram[0], buffer.data (), size);
         return true;
     }
 
     return false;
 }
 
-bool Thumbnail::writeAEHistogram (const Glib::ustring& fname)
+bool Thumbnail::writeAEHistogram (std::string& buffer)
 {
 
     if (aeHistogram) {
-        FILE* f = g_fopen (fname.c_str (), "wb");
-
-        if (f) {
-            fwrite (&aeHistogram[0], 1, (65536 >> aeHistCompression)*sizeof(aeHistogram[0]), f);
-            fclose (f);
-            return true;
-        }
+        buffer.assign (reinterpret_cast<const char*>(&aeHistogram[0]), (65536 >> aeHistCompression) * sizeof(aeHistogram[0]));
+        return true;
     }
 
     return false;
@@ -89,17 +89,18 @@ public:
     void applyAutoExp (procparams::ProcParams& pparams);
 
     unsigned char* getGrayscaleHistEQ (int trim_width);
-    bool writeImage (const Glib::ustring& fname, int format);
-    bool readImage (const Glib::ustring& fname);
+    // the cache records are serialized to and from memory buffers, the cache manager stores them
+    bool writeImage (std::string& buffer);
+    bool readImage (const char* data, size_t size);
 
-    bool readData  (const Glib::ustring& fname);
-    bool writeData  (const Glib::ustring& fname);
+    bool readData  (const std::string& buffer);
+    bool writeData  (std::string& buffer);  // the values are merged into the key file held by buffer
 
-    bool readEmbProfile  (const Glib::ustring& fname);
-    bool writeEmbProfile (const Glib::ustring& fname);
+    bool readEmbProfile  (const std::string& buffer);
+    bool writeEmbProfile (std::string& buffer);
 
-    bool readAEHistogram  (const Glib::ustring& fname);
-    bool writeAEHistogram (const Glib::ustring& fname);
+    bool readAEHistogram  (const std::string& buffer);
+    bool writeAEHistogram (std::string& buffer);
 
     unsigned char* getImage8Data();  // accessor to the 8bit image if it is one, which should be the case for the "Inspector" mode.
 
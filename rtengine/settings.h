@@ -50,6 +50,7 @@ public:
     bool            verbose;
     Glib::ustring   darkFramesPath;         ///< The default directory for dark frames
     Glib::ustring   flatFieldsPath;         ///< The default directory for flat fields
+    int             masterFrameStacking;    ///< Combination of the files of a dark frame or flat field (see framestacker.h): 0 = mean, 1 = sigma-clipped mean, 2 = median
     Glib::ustring   adobe;                  // default name of AdobeRGB1998
     Glib::ustring   prophoto;               // default name of Prophoto
     Glib::ustring   prophoto10;             // default name of Prophoto
@@ -92,6 +93,17 @@ public:
     double          ed_low;
     double          ed_lipinfl;
     double          ed_lipampl;
+    int             processingMemoryBudget; ///< MiB of the band buffers of the banded full size pipeline of processImage, on top of the demosaiced image and the output; 0 processes the whole image at once
+    int             simdLevel;              ///< Widest instruction set of the kernels dispatched at runtime (see cpudispatch.h): 0 = best supported by the cpu, 1 = build flags only, 2 = AVX2, 3 = AVX-512
+    int             demosaicCacheSize;      ///< MiB of the on-disk cache of the demosaiced raw files (see demosaiccache.h); 0 disables it
+    Glib::ustring   demosaicCacheDir;       ///< Directory of the cache of the demosaiced raw files
+    bool            fftwWisdom;             ///< Load the FFTW wisdom at startup and save it at exit (see fftwplancache.h)
+    Glib::ustring   fftwWisdomFile;         ///< File of the FFTW wisdom
+    bool            masterFrameCache;       ///< Keep the dark frames and flat fields averaged from several files on disk (see masterframecache.h)
+    Glib::ustring   masterFrameCacheDir;    ///< Directory of the cache of the averaged dark frames and flat fields
+    bool            flatFieldMapsOnDisk;    ///< Keep the blurred flat field correction maps in masterFrameCacheDir too, not only in memory (see flatfieldmaps.h)
+    bool            dcpBakedLuts;           ///< Apply the hue/sat maps, look tables and tone curves of the DCP profiles through 3D LUTs baked once (see DCPLut in dcp.cc)
+    Glib::ustring   profileFile;            ///< If set, the stages of the processing pipelines are profiled, and written to this file by cleanup() (.json: Chrome trace, CSV otherwise)
     /** Creates a new instance of Settings.
       * @return a pointer to the new Settings instance. */
     static Settings* create  ();
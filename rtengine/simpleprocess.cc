@@ -29,18 +29,316 @@
 #include "rawimagesource.h"
 #include "../rtgui/multilangmgr.h"
 #include "mytime.h"
+#include "profiler.h"
+#include <cstring>
+#include <functional>
 #undef THREAD_PRIORITY_NORMAL
 
 namespace rtengine
 {
 extern const Settings* settings;
 
+namespace
+{
+
+// Number of rows above and below a band needed by the sharpening tool to produce the same result as on the whole image
+int getSharpeningHalo (const SharpeningParams &sharpenParam)
+{
+    if (!sharpenParam.enabled) {
+        return 0;
+    }
+
+    if (sharpenParam.method == "rld") {
+        return sharpenParam.deconviter * (int)ceil(3.0 * sharpenParam.deconvradius) + 1;
+    }
+
+    int halo = (int)ceil(3.0 * sharpenParam.radius);
+
+    if (sharpenParam.edgesonly) {
+        halo += (int)ceil(3.0 * sharpenParam.edges_radius);
+    }
+
+    if (sharpenParam.halocontrol) {
+        halo += 2;
+    }
+
+    return halo;
+}
+
+// Returns the number of output rows that processImage handles at once with the configured memory budget,
+// or 0 if the image has to be processed as a whole, either because there is no budget or because one of
+// the enabled tools needs the full image (global statistics or large neighbourhoods)
+int getProcessingBandHeight (const ProcParams &params, int width, bool labResize, double scale, int outputWidth)
+{
+    if (settings->processingMemoryBudget <= 0) {
+        return 0;
+    }
+
+    if (params.sh.enabled || !params.lensProf.lcpFile.empty() || params.dirpyrequalizer.enabled
+            || params.colorappearance.enabled || params.epd.enabled || params.impulseDenoise.enabled || params.defringe.enabled
+            || params.sharpenEdge.enabled || params.sharpenMicro.enabled || params.wavelet.enabled || params.labCurve.contrast != 0
+            || (params.colorToning.enabled && params.colorToning.autosat) || (params.blackwhite.enabled && params.blackwhite.autoc)) {
+        return 0;
+    }
+
+    // per band pixel: Imagefloat and LabImage working copies, the sharpening buffers and the Image16 output,
+    // which is made of the resized LabImage when the Lab data is resized
+    const size_t bytesPerSourceRow = size_t(width) * (3 * sizeof(float) + 3 * sizeof(float) + 2 * sizeof(float) + (labResize ? 0 : 3 * sizeof(unsigned short)));
+    const size_t bytesPerResizedRow = labResize ? size_t(outputWidth) * (3 * sizeof(float) + 2 * sizeof(float) + 3 * sizeof(unsigned short)) : 0;
+    double halo = getSharpeningHalo (params.sharpening);
+
+    if (labResize) {
+        // in rows of the resized image: the source rows the Lanczos filter reaches, and the halo of the output sharpening
+        halo = (halo + 3.0 / std::min (scale, 1.0) + 2) * scale + getSharpeningHalo (params.prsharpening);
+    }
+
+    const double bytesPerRow = labResize ? bytesPerSourceRow / scale + bytesPerResizedRow : bytesPerSourceRow;
+    const int rows = int(size_t(settings->processingMemoryBudget) * 1024 * 1024 / bytesPerRow - 2 * halo);
+
+    return std::max (rows, 16);
+}
+
+void copyImageBand (Imagefloat* src, Imagefloat* dst, int x, int y)
+{
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+
+    for (int i = 0; i < dst->getHeight(); i++) {
+        memcpy (dst->r(i), src->r(y + i) + x, dst->getWidth() * sizeof(float));
+        memcpy (dst->g(i), src->g(y + i) + x, dst->getWidth() * sizeof(float));
+        memcpy (dst->b(i), src->b(y + i) + x, dst->getWidth() * sizeof(float));
+    }
+}
+
+void sharpenBand (ImProcFunctions &ipf, LabImage* lab, const SharpeningParams &sharpenParam)
+{
+    float **buffer = new float*[lab->H];
+
+    for (int i = 0; i < lab->H; i++) {
+        buffer[i] = new float[lab->W];
+    }
+
+    ipf.sharpening (lab, (float**)buffer, sharpenParam);
+
+    for (int i = 0; i < lab->H; i++) {
+        delete [] buffer[i];
+    }
+
+    delete [] buffer;
+}
+
+// The banded pipeline of processImage: only the rows of the current band of the output, plus the halo needed by
+// sharpening and by the Lab resizing, are transformed and converted to Lab, the results being written straight into
+// the output image. rgbProc runs ImProcFunctions::rgbProc with the curves of processImage.
+Image16* processBands (ImProcFunctions &ipf, const ProcParams &params, ImageSource* imgsrc, Imagefloat* baseImg, int cx, int cy, int cw, int ch,
+                       bool labResize, double scale, int imw, int imh, int bandHeight, LUTu &hist16, GammaValues* ga, bool &bwonly,
+                       const std::function<void (Imagefloat*, LabImage*)> &rgbProc)
+{
+    const int fw = baseImg->getWidth();
+    const int fh = baseImg->getHeight();
+
+    // the Lab curves get their own LUTs as the ones of processImage are still used by rgbProc for the next bands
+    LUTf lumacurve (32770, 0);
+    LUTf clcurve (65536, 0);
+    LUTf labACurve (65536, 0);
+    LUTf labBCurve (65536, 0);
+    LUTf satcurve (65536, 0);
+    LUTf lhskcurve (65536, 0);
+    LUTu dummy;
+    bool utili, clcutili;
+    bool autili, butili, ccutili, cclutili;
+
+    CurveFactory::complexLCurve (params.labCurve.brightness, params.labCurve.contrast, params.labCurve.lcurve, hist16, lumacurve, dummy, 1, utili);
+    CurveFactory::curveCL(clcutili, params.labCurve.clcurve, clcurve, 1);
+    CurveFactory::complexsgnCurve (autili, butili, ccutili, cclutili, params.labCurve.acurve, params.labCurve.bcurve, params.labCurve.cccurve,
+                                   params.labCurve.lccurve, labACurve, labBCurve, satcurve, lhskcurve, 1);
+    bwonly = params.blackwhite.enabled && !params.colorToning.enabled && !autili && !butili;
+
+    const int halo = getSharpeningHalo (params.sharpening);
+    const int resizedHalo = labResize ? getSharpeningHalo (params.prsharpening) : 0;
+    const int outputWidth = labResize ? imw : cw;
+    const int outputHeight = labResize ? imh : ch;
+    Image16* readyImg = new Image16 (outputWidth, outputHeight);
+    ProfileStage bandsStage ("processImage", "bands");
+
+    for (int top = 0; top < outputHeight; top += bandHeight) {
+        const int bottom = std::min (top + bandHeight, outputHeight);
+        // the rows of the cropped image the band is made of
+        int sourceTop = top, sourceBottom = bottom;
+        int resizedTop = top, resizedBottom = bottom;
+
+        if (labResize) {
+            // the rows of the resized image sharpened with the band, and the rows they are resampled from
+            resizedTop = std::max (top - resizedHalo, 0);
+            resizedBottom = std::min (bottom + resizedHalo, imh);
+            ImProcFunctions::getLanczosRows (scale, resizedTop, resizedBottom, ch, sourceTop, sourceBottom);
+        }
+
+        // the halo is taken from the full image, even outside of the crop, like in the whole image path
+        const int haloTop = std::max (cy + sourceTop - halo, 0);
+        const int haloBottom = std::min (cy + sourceBottom + halo, fh);
+        const int bh = haloBottom - haloTop;
+
+        Imagefloat* bandImg = new Imagefloat (cw, bh);
+
+        if (ipf.needsTransform() && !ipf.needsLuminanceOnly()) {
+            // geometric transformations sample the whole base image
+            ipf.transform (baseImg, bandImg, cx, haloTop, 0, 0, fw, fh, fw, fh, imgsrc->getMetaData()->getFocalLen(), imgsrc->getMetaData()->getFocalLen35mm(),
+                           imgsrc->getMetaData()->getFocusDist(), imgsrc->getRotateDegree(), true);
+        } else {
+            copyImageBand (baseImg, bandImg, cx, haloTop);
+
+            if (ipf.needsTransform()) {
+                // vignetting and graduated filters only scale the pixels, so they can be applied in place
+                ipf.transform (bandImg, bandImg, cx, haloTop, 0, 0, fw, fh, fw, fh, imgsrc->getMetaData()->getFocalLen(), imgsrc->getMetaData()->getFocalLen35mm(),
+                               imgsrc->getMetaData()->getFocusDist(), imgsrc->getRotateDegree(), true);
+            }
+        }
+
+        LabImage* labBand = new LabImage (cw, bh);
+        rgbProc (bandImg, labBand);
+        delete bandImg;
+
+        ipf.chromiLuminanceCurve (nullptr, 1, labBand, labBand, labACurve, labBCurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+        ipf.vibrance(labBand);
+
+        if (params.sharpening.enabled) {
+            sharpenBand (ipf, labBand, params.sharpening);
+        }
+
+        // the row of the band which is the first row of the output band
+        int bandTop = cy + top - haloTop;
+
+        if (labResize) {
+            LabImage* resizedBand = new LabImage (imw, resizedBottom - resizedTop);
+            ipf.Lanczos (labBand, resizedBand, scale, haloTop - cy, ch, resizedTop);
+            delete labBand;
+            labBand = resizedBand;
+            bandTop = top - resizedTop;
+
+            if (params.prsharpening.enabled) {
+                for (int i = 0; i < labBand->H; i++)
+                    for (int j = 0; j < labBand->W; j++) {
+                        labBand->L[i][j] = labBand->L[i][j] < 0.f ? 0.f : labBand->L[i][j];
+                    }
+
+                sharpenBand (ipf, labBand, params.prsharpening);
+            }
+        }
+
+        Image16* readyBand = ipf.lab2rgb16 (labBand, 0, bandTop, outputWidth, bottom - top, params.icm, bwonly, ga);
+        delete labBand;
+
+        for (int i = 0; i < bottom - top; i++) {
+            memcpy (readyImg->r(top + i), readyBand->r(i), outputWidth * sizeof(unsigned short));
+            memcpy (readyImg->g(top + i), readyBand->g(i), outputWidth * sizeof(unsigned short));
+            memcpy (readyImg->b(top + i), readyBand->b(i), outputWidth * sizeof(unsigned short));
+        }
+
+        delete readyBand;
+    }
+
+    return readyImg;
+}
+
+// The end of processImage, whether the image was processed in bands or not: forces the black and white images to grey,
+// resizes the image with the nearest neighbour method, sets its metadata and its output profile, and releases the job
+IImage16* finishImage (ImProcFunctions &ipf, Image16* readyImg, ProcessingJobImpl* job, InitialImage* ii, ProgressListener* pl, bool tunnelMetaData,
+                       bool bwonly, bool customGamma, cmsHPROFILE jprof, bool useLCMS, double tmpScale, int imw, int imh)
+{
+    const procparams::ProcParams& params = job->pparams;
+
+    if(bwonly) { //force BW r=g=b
+        if (settings->verbose) {
+            printf("Force BW\n");
+        }
+
+        for (int ccw = 0; ccw < readyImg->getWidth(); ccw++) {
+            for (int cch = 0; cch < readyImg->getHeight(); cch++) {
+                readyImg->r(cch, ccw) = readyImg->g(cch, ccw);
+                readyImg->b(cch, ccw) = readyImg->g(cch, ccw);
+            }
+        }
+    }
+
+    if (pl) {
+        pl->setProgress (0.70);
+    }
+
+    if (tmpScale != 1.0 && params.resize.method == "Nearest") { // resize rgb data (gamma applied)
+        Image16* tempImage = new Image16 (imw, imh);
+        ipf.resize (readyImg, tempImage, tmpScale);
+        delete readyImg;
+        readyImg = tempImage;
+    }
+
+    if (tunnelMetaData) {
+        readyImg->setMetadata (ii->getMetaData()->getExifData ());
+    } else {
+        readyImg->setMetadata (ii->getMetaData()->getExifData (), params.exif, params.iptc);
+    }
+
+
+    // Setting the output curve to readyImg
+    if (customGamma) {
+        if (!useLCMS) {
+            // use corrected sRGB profile in order to apply a good TRC if present, otherwise use LCMS2 profile generated by lab2rgb16 w/ gamma
+            ProfileContent pc(jprof);
+            readyImg->setOutputProfile (pc.data, pc.length);
+        }
+    } else {
+        // use the selected output profile if present, otherwise use LCMS2 profile generate by lab2rgb16 w/ gamma
+
+        if (params.icm.output != "" && params.icm.output != ColorManagementParams::NoICMString) {
+
+            // if iccStore->getProfile send back an object, then iccStore->getContent will do too
+            cmsHPROFILE jprof = iccStore->getProfile(params.icm.output); //get outProfile
+
+            if (jprof == nullptr) {
+                if (settings->verbose) {
+                    printf("\"%s\" ICC output profile not found!\n - use LCMS2 substitution\n", params.icm.output.c_str());
+                }
+            } else {
+                if (settings->verbose) {
+                    printf("Using \"%s\" output profile\n", params.icm.output.c_str());
+                }
+
+                ProfileContent pc = iccStore->getContent (params.icm.output);
+                readyImg->setOutputProfile (pc.data, pc.length);
+            }
+        } else {
+            // No ICM
+            readyImg->setOutputProfile (nullptr, 0);
+        }
+    }
+
+//    t2.set();
+//    if( settings->verbose )
+//           printf("Total:- %d usec\n", t2.etime(t1));
+
+    if (!job->initialImage) {
+        ii->decreaseRef ();
+    }
+
+    delete job;
+
+    if (pl) {
+        pl->setProgress (0.75);
+    }
+
+    return readyImg;
+}
+
+}
+
 IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* pl, bool tunnelMetaData, bool flush)
 {
 
     errorCode = 0;
 
     ProcessingJobImpl* job = static_cast<ProcessingJobImpl*>(pjob);
+    ProfileStage totalStage ("processImage", "total");
 
     if (pl) {
         pl->setProgressStr ("PROGRESSBAR_PROCESSING");
@@ -50,6 +348,7 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
     InitialImage* ii = job->initialImage;
 
     if (!ii) {
+        ProfileStage loadStage ("processImage", "load");
         ii = InitialImage::load (job->fname, job->isRaw, &errorCode);
 
         if (errorCode) {
@@ -102,7 +401,9 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
     ImProcFunctions ipf (&params, true);
 
     PreviewProps pp (0, 0, fw, fh, 1);
+    ProfileStage preprocessStage ("processImage", "preprocess");
     imgsrc->preprocess( params.raw, params.lensProf, params.coarse, params.dirpyrDenoise.enabled);
+    preprocessStage.stop ();
 
     if (params.toneCurve.autoexp) {// this enabled HLRecovery
         LUTu histRedRaw(256), histGreenRaw(256), histBlueRaw(256);
@@ -118,13 +419,16 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
         pl->setProgress (0.20);
     }
 
+    ProfileStage demosaicStage ("processImage", "demosaic");
     imgsrc->demosaic( params.raw);
+    demosaicStage.stop ();
 
     if (pl) {
         pl->setProgress (0.30);
     }
 
     if(params.retinex.enabled) { //enabled Retinex
+        ProfileStage retinexStage ("processImage", "retinex");
         LUTf cdcurve (65536, 0);
         LUTf mapcurve (65536, 0);
         LUTu dummy;
@@ -638,8 +942,10 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
 
 
 
+    ProfileStage getImageStage ("processImage", "getImage");
     Imagefloat* baseImg = new Imagefloat (fw, fh);
     imgsrc->getImage (currWB, tr, baseImg, pp, params.toneCurve, params.icm, params.raw);
+    getImageStage.stop ();
 
     if (pl) {
         pl->setProgress (0.50);
@@ -711,6 +1017,7 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
 //      ipf.RGB_denoise(baseImg, baseImg, calclum, imgsrc->isRAW(), denoiseParams, params.defringe, imgsrc->getDirPyrDenoiseExpComp(), noiseLCurve, lldenoiseutili);
         float chaut, redaut, blueaut, maxredaut, maxblueaut, nresi, highresi;
         int kall = 2;
+        ProfileStage denoiseStage ("processImage", "RGB_denoise");
         ipf.RGB_denoise(kall, baseImg, baseImg, calclum, ch_M, max_r, max_b, imgsrc->isRAW(), denoiseParams, imgsrc->getDirPyrDenoiseExpComp(), noiseLCurve, noiseCCurve, chaut, redaut, blueaut, maxredaut, maxblueaut, nresi, highresi);
 
     }
@@ -734,8 +1041,20 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
 
     ipf.firstAnalysis (baseImg, params, hist16);
 
+    int imw, imh;
+    double tmpScale = ipf.resizeScale(&params, fw, fh, imw, imh);
+    bool labResize = params.resize.enabled && params.resize.method != "Nearest" && tmpScale != 1.0;
+
+    // with a memory budget, transform and the following point-wise tools are run band by band (see below)
+    const int bandHeight = getProcessingBandHeight (params, params.crop.enabled ? params.crop.w : fw, labResize, tmpScale, imw);
+
+    if (bandHeight && settings->verbose) {
+        printf("Processing the image in bands of %d rows\n", bandHeight);
+    }
+
     // perform transform (excepted resizing)
-    if (ipf.needsTransform()) {
+    if (!bandHeight && ipf.needsTransform()) {
+        ProfileStage transformStage ("processImage", "transform");
         Imagefloat* trImg = new Imagefloat (fw, fh);
         ipf.transform (baseImg, trImg, 0, 0, 0, 0, fw, fh, fw, fh, imgsrc->getMetaData()->getFocalLen(), imgsrc->getMetaData()->getFocalLen35mm(),
                        imgsrc->getMetaData()->getFocusDist(), imgsrc->getRotateDegree(), true);
@@ -747,6 +1066,7 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
     if (params.dirpyrequalizer.cbdlMethod == "bef" && params.dirpyrequalizer.enabled && !params.colorappearance.enabled) {
         const int W = baseImg->getWidth();
         const int H = baseImg->getHeight();
+        ProfileStage cbdlStage ("processImage", "dirpyrequalizer");
         LabImage labcbdl(W, H);
         ipf.rgb2lab(*baseImg, labcbdl, params.icm.working);
         ipf.dirpyrequalizer (&labcbdl, 1);
@@ -824,7 +1144,7 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
         CurveFactory::curveToning(params.colorToning.cl2curve, cl2Toningcurve, 1);
     }
 
-    LabImage* labView = new LabImage (fw, fh);
+    LabImage* labView = bandHeight ? nullptr : new LabImage (fw, fh);
 
     if(params.blackwhite.enabled) {
         CurveFactory::curveBW (params.blackwhite.beforeCurve, params.blackwhite.afterCurve, hist16, dummy, customToneCurvebw1, customToneCurvebw2, 1);
@@ -860,7 +1180,43 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
 
     LUTu histToneCurve;
 
+    if (bandHeight) {
+        int cx = 0, cy = 0, cw = fw, ch = fh;
+
+        if (params.crop.enabled) {
+            cx = params.crop.x;
+            cy = params.crop.y;
+            cw = params.crop.w;
+            ch = params.crop.h;
+        }
+
+        GammaValues ga;
+        const bool customGamma = params.icm.gamma != "default" || params.icm.freegamma;
+        bool bwonly;
+        Image16* readyImg = processBands (ipf, params, imgsrc, baseImg, cx, cy, cw, ch, labResize, tmpScale, imw, imh, bandHeight, hist16,
+                                          customGamma ? &ga : nullptr, bwonly, [&] (Imagefloat* src, LabImage* dst) {
+            ipf.rgbProc (src, dst, nullptr, curve1, curve2, curve, nullptr, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit , satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve);
+        });
+
+        if ( params.filmSimulation.enabled && !params.filmSimulation.clutFilename.empty() && options.clutCacheSize == 1) {
+            CLUTStore::getInstance().clearCache();
+        }
+
+        delete baseImg;
+
+        cmsHPROFILE jprof = nullptr;
+        bool useLCMS = false;
+
+        if (customGamma && (jprof = iccStore->createCustomGammaOutputProfile (params.icm, ga)) == nullptr) {
+            useLCMS = true;
+        }
+
+        return finishImage (ipf, readyImg, job, ii, pl, tunnelMetaData, bwonly, customGamma, jprof, useLCMS, tmpScale, imw, imh);
+    }
+
+    ProfileStage rgbProcStage ("processImage", "rgbProc");
     ipf.rgbProc (baseImg, labView, nullptr, curve1, curve2, curve, shmap, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit , satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve);
+    rgbProcStage.stop ();
 
     if (settings->verbose) {
         printf("Output image / Auto B&W coefs:   R=%.2f   G=%.2f   B=%.2f\n", autor, autog, autob);
@@ -935,37 +1291,47 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
     CurveFactory::complexsgnCurve (autili, butili, ccutili, cclutili, params.labCurve.acurve, params.labCurve.bcurve, params.labCurve.cccurve,
                                    params.labCurve.lccurve, curve1, curve2, satcurve, lhskcurve, 1);
 
+    ProfileStage labCurveStage ("processImage", "chromiLuminanceCurve");
     ipf.chromiLuminanceCurve (nullptr, 1, labView, labView, curve1, curve2, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+    labCurveStage.stop ();
 
     if((params.colorappearance.enabled && !params.colorappearance.tonecie) || (!params.colorappearance.enabled)) {
+        ProfileStage epdStage ("processImage", "EPDToneMap");
         ipf.EPDToneMap(labView, 5, 1);
     }
 
 
+    ProfileStage vibranceStage ("processImage", "vibrance");
     ipf.vibrance(labView);
+    vibranceStage.stop ();
 
     if((params.colorappearance.enabled && !settings->autocielab) || (!params.colorappearance.enabled)) {
+        ProfileStage impulseStage ("processImage", "impulsedenoise");
         ipf.impulsedenoise (labView);
     }
 
     // for all treatments Defringe, Sharpening, Contrast detail ,Microcontrast they are activated if "CIECAM" function are disabled
 
     if((params.colorappearance.enabled && !settings->autocielab) || (!params.colorappearance.enabled)) {
+        ProfileStage defringeStage ("processImage", "defringe");
         ipf.defringe (labView);
     }
 
     if (params.sharpenEdge.enabled) {
+        ProfileStage sharpenEdgeStage ("processImage", "MLsharpen");
         ipf.MLsharpen(labView);
     }
 
     if (params.sharpenMicro.enabled) {
         if((params.colorappearance.enabled && !settings->autocielab) ||  (!params.colorappearance.enabled)) {
+            ProfileStage microStage ("processImage", "MLmicrocontrast");
             ipf.MLmicrocontrast (labView);    //!params.colorappearance.sharpcie
         }
     }
 
     if(((params.colorappearance.enabled && !settings->autocielab) || (!params.colorappearance.enabled)) && params.sharpening.enabled) {
 
+        ProfileStage sharpeningStage ("processImage", "sharpening");
         float **buffer = new float*[fh];
 
         for (int i = 0; i < fh; i++) {
@@ -994,6 +1360,7 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
     // directional pyramid wavelet
     if(params.dirpyrequalizer.cbdlMethod == "aft") {
         if((params.colorappearance.enabled && !settings->autocielab)  || !params.colorappearance.enabled) {
+            ProfileStage cbdlStage ("processImage", "dirpyrequalizer");
             ipf.dirpyrequalizer (labView, 1);    //TODO: this is the luminance tonecurve, not the RGB one
         }
     }
@@ -1003,6 +1370,7 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
     CurveFactory::curveWavContL(wavcontlutili, params.wavelet.wavclCurve, wavclCurve,/* hist16C, dummy,*/ 1);
 
     if(params.wavelet.enabled) {
+        ProfileStage waveletStage ("processImage", "ip_wavelet");
         ipf.ip_wavelet(labView, labView, 2, WaveParams, wavCLVCurve, waOpacityCurveRG, waOpacityCurveBY, waOpacityCurveW,  waOpacityCurveWL, wavclCurve, wavcontlutili, 1);
     }
 
@@ -1052,6 +1420,7 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
         LUTf CAMBrightCurveJ;
         LUTf CAMBrightCurveQ;
         float CAMMean = NAN;
+        ProfileStage ciecamStage ("processImage", settings->ciecamfloat ? "ciecam_02float" : "ciecam_02");
 
         if (params.sharpening.enabled) {
             if(settings->ciecamfloat) {
@@ -1086,9 +1455,6 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
         pl->setProgress (0.60);
     }
 
-    int imw, imh;
-    double tmpScale = ipf.resizeScale(&params, fw, fh, imw, imh);
-    bool labResize = params.resize.enabled && params.resize.method != "Nearest" && tmpScale != 1.0;
     LabImage *tmplab;
 
     // crop and convert to rgb16
@@ -1120,8 +1486,10 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
 
     if (labResize) { // resize lab data
         // resize image
+        ProfileStage resizeStage ("processImage", "Lanczos");
         tmplab = new LabImage(imw, imh);
         ipf.Lanczos (labView, tmplab, tmpScale);
+        resizeStage.stop ();
         delete labView;
         labView = tmplab;
         cw = labView->W;
@@ -1133,6 +1501,7 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
                     labView->L[i][j] = labView->L[i][j] < 0.f ? 0.f : labView->L[i][j];
                 }
 
+            ProfileStage prsharpeningStage ("processImage", "prsharpening");
             float **buffer = new float*[ch];
 
             for (int i = 0; i < ch; i++) {
@@ -1154,6 +1523,7 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
     bool customGamma = false;
     bool useLCMS = false;
     bool bwonly = params.blackwhite.enabled && !params.colorToning.enabled && !autili && !butili ;
+    ProfileStage lab2rgbStage ("processImage", "lab2rgb16");
 
     if(params.icm.gamma != "default" || params.icm.freegamma) { // if select gamma output between BT709, sRGB, linear, low, high, 2.2 , 1.8
 
@@ -1180,109 +1550,146 @@ IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* p
         }
     }
 
+    lab2rgbStage.stop ();
     delete labView;
     labView = nullptr;
 
+    /*  curve1.reset();curve2.reset();
+        curve.reset();
+        satcurve.reset();
+        lhskcurve.reset();
 
+        rCurve.reset();
+        gCurve.reset();
+        bCurve.reset();
+        hist16.reset();
+        hist16C.reset();
+    */
+    return finishImage (ipf, readyImg, job, ii, pl, tunnelMetaData, bwonly, customGamma, jprof, useLCMS, tmpScale, imw, imh);
+}
 
-    if(bwonly) { //force BW r=g=b
-        if (settings->verbose) {
-            printf("Force BW\n");
-        }
+namespace
+{
 
-        for (int ccw = 0; ccw < cw; ccw++) {
-            for (int cch = 0; cch < ch; cch++) {
-                readyImg->r(cch, ccw) = readyImg->g(cch, ccw);
-                readyImg->b(cch, ccw) = readyImg->g(cch, ccw);
-            }
-        }
-    }
+// Loads the input image of the upcoming job in the background while the current one is processed
+class InputPrefetcher
+{
+public:
+    InputPrefetcher () : thread(nullptr), isRaw(true), image(nullptr), errorCode(0) {}
 
-    if (pl) {
-        pl->setProgress (0.70);
+    ~InputPrefetcher ()
+    {
+        drop ();
     }
 
-    if (tmpScale != 1.0 && params.resize.method == "Nearest") { // resize rgb data (gamma applied)
-        Image16* tempImage = new Image16 (imw, imh);
-        ipf.resize (readyImg, tempImage, tmpScale);
-        delete readyImg;
-        readyImg = tempImage;
+    void start (const Glib::ustring& fn, bool iR)
+    {
+        drop ();
+        fname = fn;
+        isRaw = iR;
+        thread = Glib::Threads::Thread::create (sigc::mem_fun (*this, &InputPrefetcher::load));
     }
 
-    if (tunnelMetaData) {
-        readyImg->setMetadata (ii->getMetaData()->getExifData ());
-    } else {
-        readyImg->setMetadata (ii->getMetaData()->getExifData (), params.exif, params.iptc);
-    }
+    // returns the prefetched image if it belongs to fn, the caller becomes its owner
+    InitialImage* take (const Glib::ustring& fn)
+    {
+        join ();
 
-
-    // Setting the output curve to readyImg
-    if (customGamma) {
-        if (!useLCMS) {
-            // use corrected sRGB profile in order to apply a good TRC if present, otherwise use LCMS2 profile generated by lab2rgb16 w/ gamma
-            ProfileContent pc(jprof);
-            readyImg->setOutputProfile (pc.data, pc.length);
+        if (!image || fname != fn) {
+            drop ();
+            return nullptr;
         }
-    } else {
-        // use the selected output profile if present, otherwise use LCMS2 profile generate by lab2rgb16 w/ gamma
-
-        if (params.icm.output != "" && params.icm.output != ColorManagementParams::NoICMString) {
 
-            // if iccStore->getProfile send back an object, then iccStore->getContent will do too
-            cmsHPROFILE jprof = iccStore->getProfile(params.icm.output); //get outProfile
+        InitialImage* ret = image;
+        image = nullptr;
+        return ret;
+    }
 
-            if (jprof == nullptr) {
-                if (settings->verbose) {
-                    printf("\"%s\" ICC output profile not found!\n - use LCMS2 substitution\n", params.icm.output.c_str());
-                }
-            } else {
-                if (settings->verbose) {
-                    printf("Using \"%s\" output profile\n", params.icm.output.c_str());
-                }
+private:
+    void load ()
+    {
+        image = InitialImage::load (fname, isRaw, &errorCode);
+    }
 
-                ProfileContent pc = iccStore->getContent (params.icm.output);
-                readyImg->setOutputProfile (pc.data, pc.length);
-            }
-        } else {
-            // No ICM
-            readyImg->setOutputProfile (nullptr, 0);
+    void join ()
+    {
+        if (thread) {
+            thread->join ();
+            thread = nullptr;
         }
     }
 
-//    t2.set();
-//    if( settings->verbose )
-//           printf("Total:- %d usec\n", t2.etime(t1));
+    void drop ()
+    {
+        join ();
 
-    if (!job->initialImage) {
-        ii->decreaseRef ();
+        if (image) {
+            image->decreaseRef ();
+            image = nullptr;
+        }
     }
 
-    delete job;
+    Glib::Threads::Thread* thread;
+    Glib::ustring fname;
+    bool isRaw;
+    InitialImage* image;
+    int errorCode;
+};
+
+// Whether the input of the next job may be decoded while the input ii is processed. The next input is assumed to be
+// about the size of this one, as the images of a batch usually come from the same camera; with a memory budget, it
+// must fit in half of it, the other half being left to the bands of the image being processed.
+bool canPrefetch (InitialImage* ii, bool isRaw)
+{
+    if (settings->processingMemoryBudget <= 0) {
+        return true;
+    }
 
-    if (pl) {
-        pl->setProgress (0.75);
+    if (!ii) {
+        return false;
     }
 
-    /*  curve1.reset();curve2.reset();
-        curve.reset();
-        satcurve.reset();
-        lhskcurve.reset();
+    int w = 0, h = 0;
+    ii->getImageSource ()->getFullSize (w, h);
+
+    // a decoded raw keeps the raw values and the 3 planes of the demosaic, the other images a float RGB image
+    const size_t bytesPerPixel = isRaw ? 4 * sizeof(float) : 3 * sizeof(float);
+    const size_t bytes = size_t (std::max (w, 0)) * std::max (h, 0) * bytesPerPixel;
+
+    return bytes <= (size_t (settings->processingMemoryBudget) << 20) / 2;
+}
 
-        rCurve.reset();
-        gCurve.reset();
-        bCurve.reset();
-        hist16.reset();
-        hist16C.reset();
-    */
-    return readyImg;
 }
 
 void batchProcessingThread (ProcessingJob* job, BatchProcessingListener* bpl, bool tunnelMetaData)
 {
 
     ProcessingJob* currentJob = job;
+    InputPrefetcher prefetcher;
 
     while (currentJob) {
+        ProcessingJobImpl* jobImpl = static_cast<ProcessingJobImpl*>(currentJob);
+
+        if (!jobImpl->initialImage) {
+            // the job takes over the reference of the prefetched image, if any
+            jobImpl->initialImage = prefetcher.take (jobImpl->fname);
+        }
+
+        if (!jobImpl->initialImage && settings->processingMemoryBudget > 0 && !jobImpl->fname.empty ()) {
+            // the size of the input is needed to decide on the prefetch; if it can't be loaded, processImage reports it
+            ProfileStage loadStage ("processImage", "load");
+            int loadError = 0;
+            jobImpl->initialImage = InitialImage::load (jobImpl->fname, jobImpl->isRaw, &loadError);
+        }
+
+        // decode the next input while this one is processed, if the memory budget allows it
+        Glib::ustring nextFname;
+        bool nextIsRaw;
+
+        if (bpl->getNextJobInput (nextFname, nextIsRaw) && nextFname != jobImpl->fname && canPrefetch (jobImpl->initialImage, jobImpl->isRaw)) {
+            prefetcher.start (nextFname, nextIsRaw);
+        }
+
         int errorCode;
         IImage16* img = processImage (currentJob, errorCode, bpl, tunnelMetaData, true);
 
@@ -0,0 +1,165 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// xlogf and xexpf of sleefsseavx.c, written with the vector extension of GCC and clang so that the same code gives 8
+// or 16 floats per register depending on the compiler flags. Same algorithms and coefficients as the SSE versions,
+// FMA contraction aside. The translation units including it define RT_SIMD_WIDTH and RT_SIMD_NAMESPACE, and have the
+// same restrictions as the ones of gauss_simd_impl.h: no inline functions or templates of other headers.
+
+#pragma once
+
+#include <cstring>
+
+namespace rtengine
+{
+
+namespace RT_SIMD_NAMESPACE
+{
+
+namespace sleef
+{
+
+constexpr int N = RT_SIMD_WIDTH;
+
+typedef float vfloatN __attribute__ ((vector_size (RT_SIMD_WIDTH * sizeof (float))));
+typedef int vintN __attribute__ ((vector_size (RT_SIMD_WIDTH * sizeof (int))));
+
+inline vfloatN broadcast (float x)
+{
+    vfloatN v;
+
+    for (int k = 0; k < N; ++k) {
+        v[k] = x;
+    }
+
+    return v;
+}
+
+inline vintN broadcasti (int x)
+{
+    vintN v;
+
+    for (int k = 0; k < N; ++k) {
+        v[k] = x;
+    }
+
+    return v;
+}
+
+inline vfloatN load (const float* p)
+{
+    vfloatN v;
+    memcpy (&v, p, sizeof (v));
+    return v;
+}
+
+inline void store (float* p, const vfloatN& v)
+{
+    memcpy (p, &v, sizeof (v));
+}
+
+// the comparisons of the vector extension give all bits set in the lanes where they are true
+inline vfloatN select (const vintN& mask, const vfloatN& a, const vfloatN& b)
+{
+    return (vfloatN) (((vintN)a & mask) | ((vintN)b & ~mask));
+}
+
+inline vintN selecti (const vintN& mask, const vintN& a, const vintN& b)
+{
+    return (a & mask) | (b & ~mask);
+}
+
+inline vfloatN tofloat (const vintN& v)
+{
+    return __builtin_convertvector (v, vfloatN);
+}
+
+// rounds to the nearest, ties away from zero (_mm_cvtps_epi32 rounds them to even, which gives the same results)
+inline vintN rint (const vfloatN& v)
+{
+    const vintN sign = (vintN)v & broadcasti (0x80000000);
+    return __builtin_convertvector (v + (vfloatN) ((vintN)broadcast (0.5f) | sign), vintN);
+}
+
+inline vintN ilogbp1 (vfloatN d)
+{
+    const vintN m = d < broadcast (5.421010862427522E-20f);
+    d = select (m, broadcast (1.8446744073709552E19f) * d, d);
+    vintN q = ((vintN)d >> 23) & broadcasti (0xff);
+    return q - selecti (m, broadcasti (64 + 0x7e), broadcasti (0x7e));
+}
+
+inline vfloatN ldexp (vfloatN x, vintN q)
+{
+    vintN m = q >> 31;
+    m = (((m + q) >> 6) - m) << 4;
+    q = q - (m << 2);
+    vfloatN u = (vfloatN) ((m + broadcasti (0x7f)) << 23);
+    x = x * u * u * u * u;
+    u = (vfloatN) ((q + broadcasti (0x7f)) << 23);
+    return x * u;
+}
+
+inline vfloatN xlogf (const vfloatN& d)
+{
+    const vintN e = ilogbp1 (d * broadcast (0.7071f));
+    const vfloatN m = ldexp (d, -e);
+
+    vfloatN x = (m - broadcast (1.f)) / (m + broadcast (1.f));
+    const vfloatN x2 = x * x;
+
+    vfloatN t = broadcast (0.2371599674224853515625f);
+    t = t * x2 + broadcast (0.285279005765914916992188f);
+    t = t * x2 + broadcast (0.400005519390106201171875f);
+    t = t * x2 + broadcast (0.666666567325592041015625f);
+    t = t * x2 + broadcast (2.0f);
+
+    x = x * t + broadcast (0.693147180559945286226764f) * tofloat (e);
+
+    x = select (d == broadcast (__builtin_inff ()), broadcast (__builtin_inff ()), x);
+    x = select (d < broadcast (0.f), broadcast (__builtin_nanf ("")), x);
+    x = select (d == broadcast (0.f), broadcast (-__builtin_inff ()), x);
+
+    return x;
+}
+
+inline vfloatN xexpf (const vfloatN& d)
+{
+    const vintN q = rint (d * broadcast (1.442695040888963407359924681001892137426645954152985934135449406931f));
+
+    vfloatN s = tofloat (q) * broadcast (-0.693145751953125f) + d;
+    s = tofloat (q) * broadcast (-1.428606765330187045e-06f) + s;
+
+    vfloatN u = broadcast (0.00136324646882712841033936f);
+    u = u * s + broadcast (0.00836596917361021041870117f);
+    u = u * s + broadcast (0.0416710823774337768554688f);
+    u = u * s + broadcast (0.166665524244308471679688f);
+    u = u * s + broadcast (0.499999850988388061523438f);
+
+    u = broadcast (1.f) + (s * s * u + s);
+
+    u = ldexp (u, q);
+
+    // also covers -inf
+    return select (d < broadcast (-104.f), broadcast (0.f), u);
+}
+
+}
+
+}
+
+}
@@ -19,6 +19,7 @@
 #include "stdimagesource.h"
 #include "mytime.h"
 #include "iccstore.h"
+#include "cmstransformcache.h"
 #include "imageio.h"
 #include "curves.h"
 #include "color.h"
@@ -252,21 +253,17 @@ void StdImageSource::colorSpaceConversion (Imagefloat* im, const ColorManagement
             in = iccStore->getsRGBProfile ();
         }
 
-        lcmsMutex->lock ();
-        cmsHTRANSFORM hTransform = cmsCreateTransform (in, TYPE_RGB_FLT, out, TYPE_RGB_FLT, INTENT_RELATIVE_COLORIMETRIC,
-                                   cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE);
-        lcmsMutex->unlock ();
+        const auto transform = CmsTransformCache::getInstance ()->get (in, TYPE_RGB_FLT, out, TYPE_RGB_FLT, INTENT_RELATIVE_COLORIMETRIC,
+                               cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE);
 
-        if(hTransform) {
+        if(transform) {
             // Convert to the [0.0 ; 1.0] range
             im->normalizeFloatTo1();
 
-            im->ExecCMSTransform(hTransform);
+            im->ExecCMSTransform(transform.get ());
 
             // Converting back to the [0.0 ; 65535.0] range
             im->normalizeFloatTo65535();
-
-            cmsDeleteTransform(hTransform);
         } else {
             printf("Could not convert from %s to %s\n", in == embedded ? "embedded profile" : cmp.input.data(), cmp.working.data());
         }
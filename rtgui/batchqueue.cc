@@ -37,7 +37,24 @@
 using namespace std;
 using namespace rtengine;
 
-BatchQueue::BatchQueue (FileCatalog* aFileCatalog) : processing(nullptr), fileCatalog(aFileCatalog), sequence(0), listener(nullptr)
+struct NLParams {
+    BatchQueueListener* listener;
+    int qsize;
+    bool queueEmptied;
+    bool queueError;
+    Glib::ustring queueErrorMessage;
+};
+
+int bqnotifylistenerUI (void* data)
+{
+    NLParams* params = static_cast<NLParams*>(data);
+    params->listener->queueSizeChanged (params->qsize, params->queueEmptied, params->queueError, params->queueErrorMessage);
+    delete params;
+    return 0;
+}
+
+BatchQueue::BatchQueue (FileCatalog* aFileCatalog) : processing(nullptr), fileCatalog(aFileCatalog), sequence(0), listener(nullptr),
+    saver(nullptr), saveBytes(0), stopSaver(false), saveFailed(false)
 {
 
     location = THLOC_BATCHQUEUE;
@@ -85,6 +102,18 @@ BatchQueue::BatchQueue (FileCatalog* aFileCatalog) : processing(nullptr), fileCa
 
 BatchQueue::~BatchQueue ()
 {
+    if (saver) {
+        // let the saver finish the pending images, it may need the GUI lock to do so
+        GThreadUnLock unlock;
+        {
+            Glib::Threads::Mutex::Lock lock(saveMutex);
+            stopSaver = true;
+            saveCond.broadcast ();
+        }
+        saver->join ();
+        saver = nullptr;
+    }
+
     idle_register.destroy();
 
     MYWRITERLOCK(l, entryRW);
@@ -541,10 +570,15 @@ void BatchQueue::startProcessing ()
     if (!processing) {
         MYWRITERLOCK(l, entryRW);
 
-        if (!fd.empty()) {
+        saveFailed = false;
+
+        // skip the entries still being saved
+        const auto pos = std::find_if (fd.begin (), fd.end (), [] (const ThumbBrowserEntryBase* fdEntry) { return !fdEntry->processing; });
+
+        if (pos != fd.end()) {
             BatchQueueEntry* next;
 
-            next = static_cast<BatchQueueEntry*>(fd[0]);
+            next = static_cast<BatchQueueEntry*>(*pos);
             // tag it as processing and set sequence
             next->processing = true;
             next->sequence = sequence = 1;
@@ -599,38 +633,27 @@ rtengine::ProcessingJob* BatchQueue::imageReady (rtengine::IImage16* img)
 
     //printf ("fname=%s, %s\n", fname.c_str(), removeExtension(fname).c_str());
 
-    if (img && fname != "") {
-        int err = 0;
-
-        if (saveFormat.format == "tif") {
-            err = img->saveAsTIFF (fname, saveFormat.tiffBits, saveFormat.tiffUncompressed);
-        } else if (saveFormat.format == "png") {
-            err = img->saveAsPNG (fname, saveFormat.pngCompression, saveFormat.pngBits);
-        } else if (saveFormat.format == "jpg") {
-            err = img->saveAsJPEG (fname, saveFormat.jpegQuality, saveFormat.jpegSubSamp);
-        }
+    // entry to delete from the queue, unless its image is saved in the background
+    BatchQueueEntry* processed = processing;
 
-        img->free ();
-
-        if (err) {
-            throw Glib::FileError(Glib::FileError::FAILED, M("MAIN_MSG_CANNOTSAVE") + "\n" + fname);
-        }
+    if (img && fname != "") {
+        if (options.batchPipelineDepth > 2) {
+            // Reserve the file name, so that autoCompleteFileName doesn't hand it out again before the image is written
+            FILE* f = g_fopen (fname.c_str (), "wb");
 
-        if (saveFormat.saveParams) {
-            // We keep the extension to avoid overwriting the profile when we have
-            // the same output filename with different extension
-            //processing->params.save (removeExtension(fname) + paramFileExtension);
-            processing->params.save (fname + ".out" + paramFileExtension);
-        }
+            if (f) {
+                fclose (f);
+            }
 
-        if (processing->thumbnail) {
-            processing->thumbnail->imageDeveloped ();
-            processing->thumbnail->imageRemovedFromQueue ();
+            queueSave ({processing, img, fname, saveFormat});
+            processed = nullptr;
+        } else {
+            saveImage (processing, img, fname, saveFormat);
         }
     }
 
     // save temporary params file name: delete as last thing
-    Glib::ustring processedParams = processing->savedParamsFile;
+    Glib::ustring processedParams = processed ? processed->savedParamsFile : Glib::ustring ();
 
     // delete from the queue
     bool queueEmptied = false;
@@ -639,16 +662,20 @@ rtengine::ProcessingJob* BatchQueue::imageReady (rtengine::IImage16* img)
     {
         MYWRITERLOCK(l, entryRW);
 
-        delete processing;
         processing = nullptr;
 
-        fd.erase (fd.begin());
+        if (processed) {
+            fd.erase (std::find (fd.begin (), fd.end (), processed));
+            delete processed;
+        }
+
+        // return next job, the entries still being saved are tagged as processing
+        const auto nextPos = std::find_if (fd.begin (), fd.end (), [] (const ThumbBrowserEntryBase* fdEntry) { return !fdEntry->processing; });
 
-        // return next job
         if (fd.empty()) {
             queueEmptied = true;
-        } else if (listener && listener->canStartNext ()) {
-            BatchQueueEntry* next = static_cast<BatchQueueEntry*>(fd[0]);
+        } else if (nextPos != fd.end() && !saveFailed && listener && listener->canStartNext ()) {
+            BatchQueueEntry* next = static_cast<BatchQueueEntry*>(*nextPos);
             // tag it as selected and set sequence
             next->processing = true;
             next->sequence = ++sequence;
@@ -676,6 +703,167 @@ rtengine::ProcessingJob* BatchQueue::imageReady (rtengine::IImage16* img)
         processing->removeButtonSet ();
     }
 
+    if (processed) {
+        removeProcessedParams (processedParams);
+    }
+
+    redraw ();
+    notifyListener (queueEmptied);
+
+    return processing ? processing->job : nullptr;
+}
+
+bool BatchQueue::getNextJobInput (Glib::ustring& fname, bool& isRaw)
+{
+    if (options.batchPipelineDepth < 2) {
+        return false;
+    }
+
+    MYREADERLOCK(l, entryRW);
+
+    // the first entry not tagged as processing is the one imageReady will hand out next
+    const auto pos = std::find_if (fd.begin (), fd.end (), [] (const ThumbBrowserEntryBase* fdEntry) { return !fdEntry->processing; });
+
+    if (pos == fd.end() || !(*pos)->thumbnail) {
+        return false;
+    }
+
+    fname = (*pos)->filename;
+    isRaw = (*pos)->thumbnail->getType() == FT_Raw;
+    return true;
+}
+
+void BatchQueue::saveImage (BatchQueueEntry* entry, rtengine::IImage16* img, const Glib::ustring& fname, const SaveFormat& saveFormat)
+{
+    int err = 0;
+
+    if (saveFormat.format == "tif") {
+        err = img->saveAsTIFF (fname, saveFormat.tiffBits, saveFormat.tiffUncompressed);
+    } else if (saveFormat.format == "png") {
+        err = img->saveAsPNG (fname, saveFormat.pngCompression, saveFormat.pngBits);
+    } else if (saveFormat.format == "jpg") {
+        err = img->saveAsJPEG (fname, saveFormat.jpegQuality, saveFormat.jpegSubSamp);
+    }
+
+    img->free ();
+
+    if (err) {
+        throw Glib::FileError(Glib::FileError::FAILED, M("MAIN_MSG_CANNOTSAVE") + "\n" + fname);
+    }
+
+    if (saveFormat.saveParams) {
+        // We keep the extension to avoid overwriting the profile when we have
+        // the same output filename with different extension
+        //entry->params.save (removeExtension(fname) + paramFileExtension);
+        entry->params.save (fname + ".out" + paramFileExtension);
+    }
+
+    if (entry->thumbnail) {
+        entry->thumbnail->imageDeveloped ();
+        entry->thumbnail->imageRemovedFromQueue ();
+    }
+}
+
+void BatchQueue::queueSave (const SaveTask& task)
+{
+    const size_t bytes = size_t (task.img->getWidth ()) * task.img->getHeight () * 3 * sizeof (unsigned short);
+    const size_t budget = size_t (std::max (options.rtSettings.processingMemoryBudget, 0)) << 20;
+
+    Glib::Threads::Mutex::Lock lock(saveMutex);
+
+    if (!saver) {
+        saver = Glib::Threads::Thread::create (sigc::mem_fun (*this, &BatchQueue::saverThread));
+    }
+
+    // Admission: besides the image being written, at most one more may wait, and only if it fits in the memory budget.
+    // Otherwise the processing thread waits here, which keeps the number of images alive bounded.
+    while (saveTasks.size () > 1 || (!saveTasks.empty () && budget && saveBytes + bytes > budget)) {
+        saveCond.wait (saveMutex);
+    }
+
+    saveTasks.push_back (task);
+    saveBytes += bytes;
+    saveCond.broadcast ();
+}
+
+void BatchQueue::saverThread ()
+{
+    Glib::Threads::Mutex::Lock lock(saveMutex);
+
+    while (true) {
+        while (saveTasks.empty () && !stopSaver) {
+            saveCond.wait (saveMutex);
+        }
+
+        if (saveTasks.empty ()) {
+            return;
+        }
+
+        SaveTask task = saveTasks.front ();
+        const size_t bytes = size_t (task.img->getWidth ()) * task.img->getHeight () * 3 * sizeof (unsigned short);
+        BatchQueueEntry* entry = task.entry;
+        Glib::ustring errorMessage;
+
+        lock.release ();
+
+        try {
+            saveImage (entry, task.img, task.fname, task.saveFormat);
+        } catch (Glib::Exception& ex) {
+            errorMessage = ex.what ();
+            ::g_remove (task.fname.c_str ());
+        }
+
+        bool queueEmptied = false;
+
+        if (errorMessage.empty ()) {
+            Glib::ustring processedParams = entry->savedParamsFile;
+
+            {
+                MYWRITERLOCK(l, entryRW);
+
+                fd.erase (std::find (fd.begin (), fd.end (), entry));
+                delete entry;
+                queueEmptied = fd.empty ();
+            }
+
+            removeProcessedParams (processedParams);
+        } else {
+            // restore failed thumb, and stop the queue once the current job is done
+            {
+                GThreadLock tlock;
+                BatchQueueButtonSet* bqbs = new BatchQueueButtonSet (entry);
+                bqbs->setButtonListener (this);
+                entry->addButtonSet (bqbs);
+            }
+
+            MYWRITERLOCK(l, entryRW);
+            entry->processing = false;
+            entry->job = rtengine::ProcessingJob::create(entry->filename, entry->thumbnail->getType() == FT_Raw, entry->params);
+            saveFailed = true;
+        }
+
+        redraw ();
+
+        if (errorMessage.empty ()) {
+            notifyListener (queueEmptied);
+        } else if (listener) {
+            NLParams* params = new NLParams;
+            params->listener = listener;
+            params->queueEmptied = false;
+            params->queueError = true;
+            params->queueErrorMessage = errorMessage;
+            idle_register.add(bqnotifylistenerUI, params);
+        }
+
+        lock.acquire ();
+        saveTasks.pop_front ();
+        saveBytes -= bytes;
+        saveCond.broadcast ();
+    }
+}
+
+void BatchQueue::removeProcessedParams (const Glib::ustring& processedParams)
+{
     if (saveBatchQueue ()) {
         ::g_remove (processedParams.c_str ());
 
@@ -703,11 +891,6 @@ rtengine::ProcessingJob* BatchQueue::imageReady (rtengine::IImage16* img)
             } catch (Glib::Exception&) {}
         }
     }
-
-    redraw ();
-    notifyListener (queueEmptied);
-
-    return processing ? processing->job : nullptr;
 }
 
 // Calculates automatic filename of processed batch entry, but just the base name
@@ -911,22 +1094,6 @@ void BatchQueue::buttonPressed (LWButton* button, int actionCode, void* actionDa
     }
 }
 
-struct NLParams {
-    BatchQueueListener* listener;
-    int qsize;
-    bool queueEmptied;
-    bool queueError;
-    Glib::ustring queueErrorMessage;
-};
-
-int bqnotifylistenerUI (void* data)
-{
-    NLParams* params = static_cast<NLParams*>(data);
-    params->listener->queueSizeChanged (params->qsize, params->queueEmptied, params->queueError, params->queueErrorMessage);
-    delete params;
-    return 0;
-}
-
 void BatchQueue::notifyListener (bool queueEmptied)
 {
 
@@ -18,6 +18,7 @@
 #ifndef _BATCHQUEUE_
 #define _BATCHQUEUE_
 
+#include <deque>
 #include <gtkmm.h>
 #include "threadutils.h"
 #include "batchqueueentry.h"
@@ -64,6 +65,7 @@ public:
 
     rtengine::ProcessingJob* imageReady (rtengine::IImage16* img);
     void error (Glib::ustring msg);
+    bool getNextJobInput (Glib::ustring& fname, bool& isRaw);
     void setProgress (double p);
     void rightClicked (ThumbBrowserEntryBase* entry);
     void doubleClicked (ThumbBrowserEntryBase* entry);
@@ -92,6 +94,19 @@ protected:
     bool saveBatchQueue ();
     void notifyListener (bool queueEmptied);
 
+    // Background saving of the processed images, used when options.batchPipelineDepth > 2
+    struct SaveTask {
+        BatchQueueEntry* entry;
+        rtengine::IImage16* img;
+        Glib::ustring fname;
+        SaveFormat saveFormat;
+    };
+
+    void saveImage (BatchQueueEntry* entry, rtengine::IImage16* img, const Glib::ustring& fname, const SaveFormat& saveFormat);
+    void queueSave (const SaveTask& task);
+    void saverThread ();
+    void removeProcessedParams (const Glib::ustring& processedParams);
+
     BatchQueueEntry* processing;  // holds the currently processed image
     FileCatalog* fileCatalog;
     int sequence; // holds the current sequence index
@@ -108,6 +123,14 @@ protected:
 
     BatchQueueListener* listener;
 
+    Glib::Threads::Thread* saver;
+    Glib::Threads::Mutex saveMutex;
+    Glib::Threads::Cond saveCond;
+    std::deque<SaveTask> saveTasks; // the front task is the one being saved
+    size_t saveBytes;               // memory held by the images of saveTasks
+    bool stopSaver;
+    bool saveFailed;                // stops the queue after the current job
+
     IdleRegister idle_register;
 };
 
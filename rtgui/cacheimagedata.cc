@@ -33,14 +33,14 @@ CacheImageData::CacheImageData ()
 /*
  * Load the General, DateTime, ExifInfo, File info and ExtraRawInfo sections of the image data file
  */
-int CacheImageData::load (const Glib::ustring& fname)
+int CacheImageData::load (const std::string& buffer)
 {
     setlocale(LC_NUMERIC, "C"); // to set decimal point to "."
 
     Glib::KeyFile keyFile;
 
     try {
-        if (keyFile.load_from_file (fname)) {
+        if (keyFile.load_from_data (buffer)) {
 
             if (keyFile.has_group ("General")) {
                 if (keyFile.has_key ("General", "MD5")) {
@@ -175,11 +175,11 @@ int CacheImageData::load (const Glib::ustring& fname)
         }
     } catch (Glib::Error &err) {
         if (options.rtSettings.verbose) {
-            printf("CacheImageData::load / Error code %d while reading values from \"%s\":\n%s\n", err.code(), fname.c_str(), err.what().c_str());
+            printf("CacheImageData::load / Error code %d while reading values:\n%s\n", err.code(), err.what().c_str());
         }
     } catch (...) {
         if (options.rtSettings.verbose) {
-            printf("CacheImageData::load / Unknown exception while trying to load \"%s\"!\n", fname.c_str());
+            printf("CacheImageData::load / Unknown exception while trying to load the values!\n");
         }
     }
 
@@ -189,7 +189,7 @@ int CacheImageData::load (const Glib::ustring& fname)
 /*
  * Save the General, DateTime, ExifInfo, File info and ExtraRawInfo sections of the image data file
  */
-int CacheImageData::save (const Glib::ustring& fname)
+int CacheImageData::save (std::string& buffer)
 {
 
     Glib::ustring keyData;
@@ -199,7 +199,9 @@ int CacheImageData::save (const Glib::ustring& fname)
     Glib::KeyFile keyFile;
 
     try {
-        keyFile.load_from_file (fname);
+        if (!buffer.empty ()) {
+            keyFile.load_from_data (buffer);
+        }
     } catch (Glib::Error&) {}
 
     keyFile.set_string  ("General", "MD5", md5);
@@ -251,11 +253,11 @@ int CacheImageData::save (const Glib::ustring& fname)
 
     } catch (Glib::Error &err) {
         if (options.rtSettings.verbose) {
-            printf("CacheImageData::save / Error code %d while reading values from \"%s\":\n%s\n", err.code(), fname.c_str(), err.what().c_str());
+            printf("CacheImageData::save / Error code %d while writing values:\n%s\n", err.code(), err.what().c_str());
         }
     } catch (...) {
         if (options.rtSettings.verbose) {
-            printf("CacheImageData::save / Unknown exception while trying to save \"%s\"!\n", fname.c_str());
+            printf("CacheImageData::save / Unknown exception while trying to save the values!\n");
         }
     }
 
@@ -263,18 +265,6 @@ int CacheImageData::save (const Glib::ustring& fname)
         return 1;
     }
 
-    FILE *f = g_fopen (fname.c_str (), "wt");
-
-    if (!f) {
-        if (options.rtSettings.verbose) {
-            printf("CacheImageData::save / Error: unable to open file \"%s\" with write access!\n", fname.c_str());
-        }
-
-        return 1;
-    } else {
-        fprintf (f, "%s", keyData.c_str ());
-        fclose (f);
-        return 0;
-    }
+    buffer = keyData.raw ();
+    return 0;
 }
-
@@ -73,8 +73,9 @@ public:
 
     CacheImageData ();
 
-    int load (const Glib::ustring& fname);
-    int save (const Glib::ustring& fname);
+    // the values are read from and merged into the key file held by buffer
+    int load (const std::string& buffer);
+    int save (std::string& buffer);
 
     Glib::ustring getCamera() const
     {
@@ -18,11 +18,12 @@
  */
 #include "cachemanager.h"
 
+#include <cstring>
 #include <memory>
 #include <iostream>
 
 #include <glib/gstdio.h>
-#include <giomm.h>
+#include <glibmm.h>
 
 #ifdef WIN32
 #include <windows.h>
@@ -37,7 +38,41 @@ namespace
 {
 
 constexpr int cacheDirMode = 0777;
-constexpr const char* cacheDirs[] = { "profiles", "images", "aehistograms", "embprofiles", "data" };
+constexpr int64_t identitiesValidity = 10 * G_USEC_PER_SEC;
+constexpr const char* cacheDirs[] = { "profiles" };
+// the other records used to be stored in files of their own, they are now in the pack and the old files are deleted
+constexpr const char* legacyCacheDirs[] = { "images", "aehistograms", "embprofiles", "data" };
+constexpr const char* imageRecords[] = { "images", "aehistograms", "embprofiles" };
+
+std::string getRecordKey (const std::string& kind, const Glib::ustring& fname, const std::string& md5)
+{
+    return kind + '/' + Glib::path_get_basename (fname) + '.' + md5;
+}
+
+template<typename T>
+void appendValue (std::string& buffer, const T& value)
+{
+    buffer.append (reinterpret_cast<const char*> (&value), sizeof (T));
+}
+
+template<typename T>
+bool readValue (const std::string& buffer, size_t& pos, T& value)
+{
+    if (buffer.size () - pos < sizeof (T)) {
+        return false;
+    }
+
+    memcpy (&value, buffer.data () + pos, sizeof (T));
+    pos += sizeof (T);
+    return true;
+}
+
+constexpr uint32_t identitiesVersion = 1;
+
+std::string getIdentitiesKey (const Glib::ustring& dirName)
+{
+    return "identities/" + Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, dirName);
+}
 
 }
 
@@ -63,6 +98,15 @@ void CacheManager::init ()
     if (error != 0 && options.rtSettings.verbose) {
         std::cerr << "Failed to create all cache directories: " << g_strerror(errno) << std::endl;
     }
+
+    deleteLegacyDirs ();
+
+    if (!pack.open (Glib::build_filename (baseDir, "thumbcache.pack")) && options.rtSettings.verbose) {
+        std::cerr << "Failed to open the cache pack in '" << baseDir << "'" << std::endl;
+    }
+
+    // the parsed processing profiles cached by former versions, keyed by the image only
+    pack.removeAll ("params");
 }
 
 Thumbnail* CacheManager::getEntry (const Glib::ustring& fname)
@@ -93,13 +137,13 @@ Thumbnail* CacheManager::getEntry (const Glib::ustring& fname)
         return nullptr;
     }
 
-    const auto cacheName = getCacheFileName ("data", fname, ".txt", md5);
-
     // let's see if we have it in the cache
-    {
+    std::string data;
+
+    if (readRecord ("data", fname, md5, data)) {
         CacheImageData imageData;
 
-        const auto error = imageData.load (cacheName);
+        const auto error = imageData.load (data);
         if (error == 0 && imageData.supported) {
 
             thumbnail.reset (new Thumbnail (this, fname, &imageData));
@@ -181,14 +225,16 @@ void CacheManager::renameEntry (const std::string& oldfilename, const std::strin
 
     const auto newmd5 = getMD5 (newfilename);
 
-    auto error = g_rename (getCacheFileName ("profiles", oldfilename, paramFileExtension, oldmd5).c_str (), getCacheFileName ("profiles", newfilename, paramFileExtension, newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("images", oldfilename, ".rtti", oldmd5).c_str (), getCacheFileName ("images", newfilename, ".rtti", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("images", oldfilename, ".cust16", oldmd5).c_str (), getCacheFileName ("images", newfilename, ".cust16", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("images", oldfilename, ".cust", oldmd5).c_str (), getCacheFileName ("images", newfilename, ".cust", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("images", oldfilename, ".jpg", oldmd5).c_str (), getCacheFileName ("images", newfilename, ".jpg", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("aehistograms", oldfilename, "", oldmd5).c_str (), getCacheFileName ("aehistograms", newfilename, "", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("embprofiles", oldfilename, ".icc", oldmd5).c_str (), getCacheFileName ("embprofiles", newfilename, ".icc", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("data", oldfilename, ".txt", oldmd5).c_str (), getCacheFileName ("data", newfilename, ".txt", newmd5).c_str ());
+    const auto error = g_rename (getCacheFileName ("profiles", oldfilename, paramFileExtension, oldmd5).c_str (), getCacheFileName ("profiles", newfilename, paramFileExtension, newmd5).c_str ());
+
+    std::string buffer;
+
+    for (const auto& kind : legacyCacheDirs) {
+        if (readRecord (kind, oldfilename, oldmd5, buffer)) {
+            writeRecord (kind, newfilename, newmd5, buffer);
+            removeRecord (kind, oldfilename, oldmd5);
+        }
+    }
 
     if (error != 0 && options.rtSettings.verbose) {
         std::cerr << "Failed to rename all files for cache entry '" << oldfilename << "': " << g_strerror(errno) << std::endl;
@@ -222,7 +268,18 @@ void CacheManager::closeCache () const
 {
     MyMutex::MyLock lock (mutex);
 
+    {
+        MyMutex::MyLock identitiesLock (identitiesMutex);
+
+        for (auto& directory : identities) {
+            if (directory.second.dirty) {
+                saveIdentities (directory.first, directory.second);
+            }
+        }
+    }
+
     applyCacheSizeLimitation ();
+    pack.close ();
 }
 
 void CacheManager::clearAll () const
@@ -232,15 +289,20 @@ void CacheManager::clearAll () const
     for (const auto& cacheDir : cacheDirs) {
         deleteDir (cacheDir);
     }
+
+    deleteLegacyDirs ();
+
+    pack.removeAll ({});
 }
 
 void CacheManager::clearImages () const
 {
     MyMutex::MyLock lock (mutex);
 
-    deleteDir ("images");
-    deleteDir ("aehistograms");
-    deleteDir ("embprofiles");
+    for (const auto& kind : imageRecords) {
+        deleteDir (kind);
+        pack.removeAll (kind);
+    }
 }
 
 void CacheManager::clearProfiles () const
@@ -248,6 +310,7 @@ void CacheManager::clearProfiles () const
     MyMutex::MyLock lock (mutex);
 
     deleteDir ("profiles");
+    pack.removeAll ("parsedprofiles");
 }
 
 void CacheManager::deleteDir (const Glib::ustring& dirName) const
@@ -268,124 +331,273 @@ void CacheManager::deleteDir (const Glib::ustring& dirName) const
     } catch (Glib::Error&) {}
 }
 
+void CacheManager::deleteLegacyDirs () const
+{
+    // their records are regenerated on demand, like after a clear
+    for (const auto& cacheDir : legacyCacheDirs) {
+        const Glib::ustring dirName = Glib::build_filename (baseDir, cacheDir);
+
+        if (Glib::file_test (dirName, Glib::FILE_TEST_IS_DIR)) {
+            deleteDir (cacheDir);
+
+            if (g_rmdir (dirName.c_str ()) != 0 && options.rtSettings.verbose) {
+                std::cerr << "Failed to delete the former cache directory '" << cacheDir << "': " << g_strerror(errno) << std::endl;
+            }
+        }
+    }
+}
+
 void CacheManager::deleteFiles (const Glib::ustring& fname, const std::string& md5, bool purgeData, bool purgeProfile) const
 {
     if (md5.empty ()) {
         return;
     }
 
-    auto error = g_remove (getCacheFileName ("images", fname, ".rtti", md5).c_str ());
-    error |= g_remove (getCacheFileName ("images", fname, ".cust16", md5).c_str ());
-    error |= g_remove (getCacheFileName ("images", fname, ".cust", md5).c_str ());
-    error |= g_remove (getCacheFileName ("images", fname, ".jpg", md5).c_str ());
-    error |= g_remove (getCacheFileName ("aehistograms", fname, "", md5).c_str ());
-    error |= g_remove (getCacheFileName ("embprofiles", fname, ".icc", md5).c_str ());
-
-    if (purgeData) {
-        error |= g_remove (getCacheFileName ("data", fname, ".txt", md5).c_str ());
+    for (const auto& kind : imageRecords) {
+        removeRecord (kind, fname, md5);
     }
 
-    if (purgeProfile) {
-        error |= g_remove (getCacheFileName ("profiles", fname, paramFileExtension, md5).c_str ());
+    if (purgeData) {
+        removeRecord ("data", fname, md5);
     }
 
-    if (error != 0 && options.rtSettings.verbose) {
-        std::cerr << "Failed to delete all files for cache entry '" << fname << "': " << g_strerror(errno) << std::endl;
+    if (purgeProfile && g_remove (getCacheFileName ("profiles", fname, paramFileExtension, md5).c_str ()) != 0 && options.rtSettings.verbose) {
+        std::cerr << "Failed to delete the profile of cache entry '" << fname << "': " << g_strerror(errno) << std::endl;
     }
 }
 
-std::string CacheManager::getMD5 (const Glib::ustring& fname)
+std::string CacheManager::getMD5 (const Glib::ustring& fname) const
 {
+    const Glib::ustring dirName = Glib::path_get_dirname (fname);
+    const std::string baseName = Glib::path_get_basename (fname);
 
-    auto file = Gio::File::create_for_path (fname);
-
-    if (file && file->query_exists ())   {
+    std::string md5;
+    ModifiedFiles modified;
 
-#ifdef WIN32
+    {
+        MyMutex::MyLock lock (identitiesMutex);
 
-        std::unique_ptr<wchar_t, GFreeFunc> wfname (reinterpret_cast<wchar_t*>(g_utf8_to_utf16 (fname.c_str (), -1, NULL, NULL, NULL)), g_free);
+        DirectoryIdentities& directory = identities[dirName];
+        const int64_t now = g_get_monotonic_time ();
 
-        WIN32_FILE_ATTRIBUTE_DATA fileAttr;
-        if (GetFileAttributesExW (wfname.get (), GetFileExInfoStandard, &fileAttr)) {
-            // We use name, size and creation time to identify a file.
-            const auto identifier = Glib::ustring::compose ("%1-%2-%3-%4", fileAttr.nFileSizeLow, fileAttr.ftCreationTime.dwHighDateTime, fileAttr.ftCreationTime.dwLowDateTime, fname);
-            return Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, identifier);
+        // a folder is opened in a burst of lookups, it's enumerated again when reopened later
+        if (!directory.validated || now - directory.validated > identitiesValidity) {
+            validateDirectory (dirName, directory, modified);
+            directory.validated = now;
         }
 
-#else
+        const auto file = directory.files.find (baseName);
 
-        try
-        {
+        if (file != directory.files.end ()) {
+            md5 = file->second.md5;
+        } else {
+            // created since the enumeration
+            GStatBuf fileStat;
 
-            if (auto info = file->query_info ()) {
-                // We only use name and size to identify a file.
-                const auto identifier = Glib::ustring::compose ("%1%2", fname, info->get_size ());
-                return Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, identifier);
-            }
+            if (g_stat (fname.c_str (), &fileStat) == 0 && S_ISREG (fileStat.st_mode)) {
+                md5 = computeMD5 (fname, fileStat.st_size);
 
-        } catch(Gio::Error&) {}
+                if (!md5.empty ()) {
+                    directory.files[baseName] = {static_cast<uint64_t> (fileStat.st_ino), static_cast<int64_t> (fileStat.st_size), static_cast<int64_t> (fileStat.st_mtime), md5};
+                    directory.dirty = true;
+                }
+            }
+        }
+    }
 
-#endif
+    for (const auto& file : modified) {
+        if (options.rtSettings.verbose) {
+            std::cout << "File '" << file.first << "' was modified, its thumbnail is dropped from the cache" << std::endl;
+        }
 
+        deleteFiles (file.first, file.second, true, false);
     }
 
-    return {};
+    return md5;
 }
 
-Glib::ustring CacheManager::getCacheFileName (const Glib::ustring& subDir,
-                                              const Glib::ustring& fname,
-                                              const Glib::ustring& fext,
-                                              const Glib::ustring& md5) const
+void CacheManager::validateDirectory (const Glib::ustring& dirName, DirectoryIdentities& directory, ModifiedFiles& modified) const
 {
-    const auto dirName = Glib::build_filename (baseDir, subDir);
-    const auto baseName = Glib::path_get_basename (fname) + "." + md5;
-    return Glib::build_filename (dirName, baseName + fext);
-}
+    if (!directory.loaded) {
+        loadIdentities (dirName, directory);
+        directory.loaded = true;
+    }
 
-void CacheManager::applyCacheSizeLimitation () const
-{
-    using FNameMTime = std::pair<Glib::ustring, Glib::TimeVal>;
-    std::vector<FNameMTime> files;
+    std::unordered_map<std::string, FileIdentity> files;
 
     try {
 
-        const auto dirName = Glib::build_filename (baseDir, "data");
-        const auto dir = Gio::File::create_for_path (dirName);
+        Glib::Dir dir (dirName);
 
-        auto enumerator = dir->enumerate_children ("standard::name,time::modified");
+        for (auto entry = dir.begin (); entry != dir.end (); ++entry) {
+            const std::string name = *entry;
+            const Glib::ustring path = Glib::build_filename (dirName, name);
+            GStatBuf fileStat;
+
+            if (g_stat (path.c_str (), &fileStat) != 0 || !S_ISREG (fileStat.st_mode)) {
+                continue;
+            }
+
+            FileIdentity identity = {static_cast<uint64_t> (fileStat.st_ino), static_cast<int64_t> (fileStat.st_size), static_cast<int64_t> (fileStat.st_mtime), {}};
+            const auto known = directory.files.find (name);
+
+            if (known != directory.files.end () && known->second.inode == identity.inode && known->second.size == identity.size && known->second.mtime == identity.mtime) {
+                identity.md5 = known->second.md5;
+            } else {
+                identity.md5 = computeMD5 (path, identity.size);
+                directory.dirty = true;
 
-        while (auto file = enumerator->next_file ()) {
-            files.emplace_back (file->get_name (), file->modification_time ());
+                if (identity.md5.empty ()) {
+                    continue;
+                }
+
+                if (known != directory.files.end ()) {
+                    modified.emplace_back (path, known->second.md5);
+                }
+            }
+
+            files.emplace (name, std::move (identity));
         }
 
     } catch (Glib::Exception&) {}
 
-    if (files.size () <= options.maxCacheEntries) {
+    // some files were removed
+    if (files.size () != directory.files.size ()) {
+        directory.dirty = true;
+    }
+
+    directory.files.swap (files);
+
+    if (directory.dirty) {
+        saveIdentities (dirName, directory);
+    }
+}
+
+void CacheManager::loadIdentities (const Glib::ustring& dirName, DirectoryIdentities& directory) const
+{
+    std::string buffer;
+
+    if (!pack.get (getIdentitiesKey (dirName), buffer)) {
         return;
     }
 
-    std::sort (files.begin (), files.end (), [] (const FNameMTime& lhs, const FNameMTime& rhs)
-    {
-        return lhs.second < rhs.second;
-    });
+    // the name of the directory guards against a collision of the keys
+    size_t pos = 0;
+    uint32_t version, size;
 
-    auto cacheEntries = files.size ();
+    if (!readValue (buffer, pos, version) || version != identitiesVersion || !readValue (buffer, pos, size)
+            || buffer.compare (pos, size, dirName.raw ()) != 0) {
+        return;
+    }
+
+    pos += size;
 
-    for (auto entry = files.begin (); cacheEntries-- > options.maxCacheEntries; ++entry) {
+    while (pos < buffer.size ()) {
+        FileIdentity identity;
+        uint32_t md5Size;
 
-        const auto& name = entry->first;
+        if (!readValue (buffer, pos, size) || buffer.size () - pos < size) {
+            break;
+        }
 
-        constexpr auto md5_size = 32;
-        const auto name_size = name.size();
+        const std::string name = buffer.substr (pos, size);
+        pos += size;
 
-        if (name_size < md5_size + 5) {
-            continue;
+        if (!readValue (buffer, pos, identity.inode) || !readValue (buffer, pos, identity.size) || !readValue (buffer, pos, identity.mtime)
+                || !readValue (buffer, pos, md5Size) || buffer.size () - pos < md5Size) {
+            break;
         }
 
-        const auto fname = name.substr (0, name_size - md5_size - 5);
-        const auto md5 = name.substr (name_size - md5_size - 4, md5_size);
+        identity.md5 = buffer.substr (pos, md5Size);
+        pos += md5Size;
+
+        directory.files.emplace (name, std::move (identity));
+    }
+}
+
+void CacheManager::saveIdentities (const Glib::ustring& dirName, DirectoryIdentities& directory) const
+{
+    std::string buffer;
+
+    appendValue (buffer, identitiesVersion);
+    appendValue (buffer, static_cast<uint32_t> (dirName.bytes ()));
+    buffer += dirName.raw ();
+
+    for (const auto& file : directory.files) {
+        appendValue (buffer, static_cast<uint32_t> (file.first.size ()));
+        buffer += file.first;
+        appendValue (buffer, file.second.inode);
+        appendValue (buffer, file.second.size);
+        appendValue (buffer, file.second.mtime);
+        appendValue (buffer, static_cast<uint32_t> (file.second.md5.size ()));
+        buffer += file.second.md5;
+    }
 
-        deleteFiles (fname, md5, true, false);
+    if (pack.put (getIdentitiesKey (dirName), buffer)) {
+        directory.dirty = false;
     }
 }
 
+std::string CacheManager::computeMD5 (const Glib::ustring& fname, int64_t size)
+{
+
+#ifdef WIN32
+
+    std::unique_ptr<wchar_t, GFreeFunc> wfname (reinterpret_cast<wchar_t*>(g_utf8_to_utf16 (fname.c_str (), -1, NULL, NULL, NULL)), g_free);
+
+    WIN32_FILE_ATTRIBUTE_DATA fileAttr;
+    if (GetFileAttributesExW (wfname.get (), GetFileExInfoStandard, &fileAttr)) {
+        // We use name, size and creation time to identify a file.
+        const auto identifier = Glib::ustring::compose ("%1-%2-%3-%4", fileAttr.nFileSizeLow, fileAttr.ftCreationTime.dwHighDateTime, fileAttr.ftCreationTime.dwLowDateTime, fname);
+        return Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, identifier);
+    }
+
+    return {};
+
+#else
+
+    // We only use name and size to identify a file, the modifications are detected by the directory index.
+    const auto identifier = Glib::ustring::compose ("%1%2", fname, size);
+    return Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, identifier);
+
+#endif
+
+}
+
+Glib::ustring CacheManager::getCacheFileName (const Glib::ustring& subDir,
+                                              const Glib::ustring& fname,
+                                              const Glib::ustring& fext,
+                                              const Glib::ustring& md5) const
+{
+    const auto dirName = Glib::build_filename (baseDir, subDir);
+    const auto baseName = Glib::path_get_basename (fname) + "." + md5;
+    return Glib::build_filename (dirName, baseName + fext);
+}
+
+bool CacheManager::readRecord (const std::string& kind, const Glib::ustring& fname, const std::string& md5, std::string& buffer) const
+{
+    return pack.get (getRecordKey (kind, fname, md5), buffer);
+}
+
+bool CacheManager::readRecord (const std::string& kind, const Glib::ustring& fname, const std::string& md5, const std::function<bool (const char* data, size_t size)>& reader) const
+{
+    return pack.read (getRecordKey (kind, fname, md5), reader);
+}
+
+void CacheManager::writeRecord (const std::string& kind, const Glib::ustring& fname, const std::string& md5, const std::string& buffer) const
+{
+    if (!pack.put (getRecordKey (kind, fname, md5), buffer) && options.rtSettings.verbose) {
+        std::cerr << "Failed to write the " << kind << " record of cache entry '" << fname << "'" << std::endl;
+    }
+}
+
+void CacheManager::removeRecord (const std::string& kind, const Glib::ustring& fname, const std::string& md5) const
+{
+    pack.remove (getRecordKey (kind, fname, md5));
+}
+
+void CacheManager::applyCacheSizeLimitation () const
+{
+    // the least recently used entries go first, their profiles are kept
+    pack.trim (static_cast<uint64_t> (options.maxCacheSize) << 20);
+}
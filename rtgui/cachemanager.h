@@ -19,13 +19,19 @@
 #ifndef _CACHEMANAGER_
 #define _CACHEMANAGER_
 
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <glibmm/ustring.h>
 
 #include "../rtengine/noncopyable.h"
 
+#include "cachepack.h"
 #include "threadutils.h"
 
 class Thumbnail;
@@ -38,8 +44,36 @@ private:
     Entries openEntries;
     Glib::ustring    baseDir;
     mutable MyMutex  mutex;
+    mutable CachePack pack;
+
+    // The identity of the files, i.e. the key of their cache entry, is looked up in an index of their directory,
+    // validated with a single enumeration of the directory and stored in the pack between the sessions
+    struct FileIdentity {
+        uint64_t inode;
+        int64_t size;
+        int64_t mtime;
+        std::string md5;
+    };
+
+    struct DirectoryIdentities {
+        std::unordered_map<std::string, FileIdentity> files;   // by base name
+        int64_t validated = 0;  // monotonic time of the last enumeration, 0 if none
+        bool loaded = false;    // from the pack
+        bool dirty = false;     // not yet written to the pack
+    };
+
+    using ModifiedFiles = std::vector<std::pair<Glib::ustring, std::string>>;   // name and former key of the files
+
+    mutable std::unordered_map<std::string, DirectoryIdentities> identities;
+    mutable MyMutex identitiesMutex;
+
+    void validateDirectory (const Glib::ustring& dirName, DirectoryIdentities& directory, ModifiedFiles& modified) const;
+    void loadIdentities (const Glib::ustring& dirName, DirectoryIdentities& directory) const;
+    void saveIdentities (const Glib::ustring& dirName, DirectoryIdentities& directory) const;
+    static std::string computeMD5 (const Glib::ustring& fname, int64_t size);
 
     void deleteDir   (const Glib::ustring& dirName) const;
+    void deleteLegacyDirs () const;
     void deleteFiles (const Glib::ustring& fname, const std::string& md5, bool purgeData, bool purgeProfile) const;
 
     void applyCacheSizeLimitation () const;
@@ -61,7 +95,17 @@ public:
     void clearProfiles () const;
     void clearFromCache (const Glib::ustring& fname, bool purge) const;
 
-    static std::string getMD5 (const Glib::ustring& fname);
+    /** @return the key of the cache entry of the file, empty if it doesn't exist. The cache entry of a file which
+      * was modified since its key was computed is dropped, apart from its processing profile */
+    std::string getMD5 (const Glib::ustring& fname) const;
+
+    /** The data, image, AE histogram, embedded profile and parsed processing profiles of the entries are stored in a pack file.
+      * @param kind is "data", "images", "aehistograms", "embprofiles" or "parsedprofiles" */
+    bool readRecord   (const std::string& kind, const Glib::ustring& fname, const std::string& md5, std::string& buffer) const;
+    /** Decodes a record in place, see CachePack::read */
+    bool readRecord   (const std::string& kind, const Glib::ustring& fname, const std::string& md5, const std::function<bool (const char* data, size_t size)>& reader) const;
+    void writeRecord  (const std::string& kind, const Glib::ustring& fname, const std::string& md5, const std::string& buffer) const;
+    void removeRecord (const std::string& kind, const Glib::ustring& fname, const std::string& md5) const;
 
     Glib::ustring    getCacheFileName (const Glib::ustring& subDir,
                                        const Glib::ustring& fname,
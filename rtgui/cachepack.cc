@@ -0,0 +1,773 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "cachepack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <glib/gstdio.h>
+#include <glibmm.h>
+#include <zlib.h>
+
+#ifdef WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "options.h"
+
+namespace
+{
+
+constexpr char packMagic[4] = {'R', 'T', 'C', 'P'};
+constexpr char indexMagic[4] = {'R', 'T', 'C', 'I'};
+constexpr uint32_t packVersion = 1;
+constexpr uint32_t maxKeySize = 4096;
+constexpr uint32_t tombstone = 0xffffffff;
+
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t generation;
+};
+
+struct RecordHeader {
+    uint32_t keySize;
+    uint32_t dataSize;      // tombstone if the record removes the key
+    uint32_t checksum;      // crc32 of the key and the data
+};
+
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t generation;
+    uint64_t end;
+    uint64_t clock;
+    uint64_t count;
+};
+
+struct IndexEntry {
+    uint64_t offset;
+    uint64_t used;
+    uint32_t size;
+    uint32_t keySize;
+};
+
+bool seek (FILE* f, uint64_t offset)
+{
+#ifdef WIN32
+    return _fseeki64 (f, offset, SEEK_SET) == 0;
+#else
+    return fseeko (f, offset, SEEK_SET) == 0;
+#endif
+}
+
+uint64_t fileSize (FILE* f)
+{
+#ifdef WIN32
+    return _fseeki64 (f, 0, SEEK_END) == 0 ? _ftelli64 (f) : 0;
+#else
+    return fseeko (f, 0, SEEK_END) == 0 ? ftello (f) : 0;
+#endif
+}
+
+uint64_t recordSize (size_t keySize, uint32_t dataSize)
+{
+    return sizeof (RecordHeader) + keySize + dataSize;
+}
+
+uint32_t checksum (const std::string& key, const char* data, uint32_t size)
+{
+    uLong crc = crc32 (0L, reinterpret_cast<const Bytef*> (key.data ()), key.size ());
+
+    if (size) {
+        crc = crc32 (crc, reinterpret_cast<const Bytef*> (data), size);
+    }
+
+    return crc;
+}
+
+uint64_t newGeneration ()
+{
+    return (static_cast<uint64_t> (g_random_int ()) << 32) | g_random_int ();
+}
+
+}
+
+class CachePack::Mapping :
+    public rtengine::NonCopyable
+{
+public:
+    Mapping (FILE* file, uint64_t length, std::atomic<int>& count) :
+        data (nullptr),
+        size (0),
+        count (count)
+#ifdef WIN32
+        , handle (nullptr)
+#endif
+    {
+        ++count;
+
+        // a 32 bit build may not have the address space for a big pack
+        if (length == 0 || length > std::numeric_limits<size_t>::max ()) {
+            return;
+        }
+
+#ifdef WIN32
+        handle = CreateFileMappingW (reinterpret_cast<HANDLE> (_get_osfhandle (_fileno (file))), nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        if (handle) {
+            data = static_cast<const char*> (MapViewOfFile (handle, FILE_MAP_READ, 0, 0, length));
+        }
+#else
+        void* const address = mmap (nullptr, length, PROT_READ, MAP_SHARED, fileno (file), 0);
+
+        if (address != MAP_FAILED) {
+            data = static_cast<const char*> (address);
+        }
+#endif
+
+        if (data) {
+            size = length;
+        }
+    }
+
+    ~Mapping ()
+    {
+#ifdef WIN32
+        if (data) {
+            UnmapViewOfFile (data);
+        }
+
+        if (handle) {
+            CloseHandle (handle);
+        }
+#else
+        if (data) {
+            munmap (const_cast<char*> (data), size);
+        }
+#endif
+
+        --count;
+    }
+
+    const char* data;
+    uint64_t size;
+
+private:
+    std::atomic<int>& count;
+#ifdef WIN32
+    HANDLE handle;
+#endif
+};
+
+CachePack::CachePack () :
+    file (nullptr),
+    generation (0),
+    end (0),
+    live (0),
+    clock (0),
+    mappings (0)
+{
+}
+
+CachePack::~CachePack ()
+{
+    close ();
+}
+
+bool CachePack::open (const Glib::ustring& fileName)
+{
+    MyMutex::MyLock lock (mutex);
+
+    closeLocked ();
+
+    packName = fileName;
+    indexName = fileName + ".index";
+
+    // left over by an interrupted compaction, the pack and the index themselves are replaced atomically
+    g_remove ((packName + ".tmp").c_str ());
+    g_remove ((indexName + ".tmp").c_str ());
+
+    file = g_fopen (packName.c_str (), "r+b");
+
+    PackHeader header;
+
+    if (!file || fread (&header, sizeof (header), 1, file) != 1
+            || memcmp (header.magic, packMagic, sizeof (packMagic)) != 0 || header.version != packVersion) {
+        return create ();
+    }
+
+    generation = header.generation;
+
+    const uint64_t start = loadIndex () ? end : sizeof (PackHeader);
+    end = replay (start);
+
+    return true;
+}
+
+void CachePack::close ()
+{
+    MyMutex::MyLock lock (mutex);
+
+    closeLocked ();
+}
+
+void CachePack::closeLocked ()
+{
+    if (!file) {
+        return;
+    }
+
+    const uint64_t dead = end - sizeof (PackHeader) - live;
+
+    if (!(dead > live && compactLocked ())) {
+        saveIndex (generation, end, records);
+    }
+
+    unmap ();
+
+    if (file) {
+        fclose (file);
+        file = nullptr;
+    }
+
+    records.clear ();
+    live = 0;
+    clock = 0;
+}
+
+bool CachePack::create ()
+{
+    unmap ();
+    records.clear ();
+    live = 0;
+    clock = 0;
+    g_remove (indexName.c_str ());
+
+    // written aside too, a reader of the previous pack may still use it
+    const Glib::ustring tmpName = packName + ".tmp";
+    FILE* const out = g_fopen (tmpName.c_str (), "wb");
+
+    PackHeader header;
+    memcpy (header.magic, packMagic, sizeof (packMagic));
+    header.version = packVersion;
+    header.generation = newGeneration ();
+
+    bool ok = out && fwrite (&header, sizeof (header), 1, out) == 1;
+
+    if (out && fclose (out) != 0) {
+        ok = false;
+    }
+
+    if (!ok || !replaceWith (tmpName)) {
+        if (options.rtSettings.verbose) {
+            printf ("Cache pack: unable to create %s\n", packName.c_str ());
+        }
+
+        if (file) {
+            fclose (file);
+            file = nullptr;
+        }
+
+        g_remove (tmpName.c_str ());
+        return false;
+    }
+
+    generation = header.generation;
+    end = sizeof (header);
+    return true;
+}
+
+bool CachePack::replaceWith (const Glib::ustring& tmpName)
+{
+    // the readers use their mapping unlocked, they would see other records or even fault if the file changed under it
+    unmap ();
+
+    if (mappings != 0) {
+        g_remove (tmpName.c_str ());
+        return false;
+    }
+
+    // an open file can't be replaced on Windows
+    if (file) {
+        fclose (file);
+    }
+
+    const bool ok = g_rename (tmpName.c_str (), packName.c_str ()) == 0;
+
+    if (!ok) {
+        g_remove (tmpName.c_str ());
+    }
+
+    // the new pack, or the old one if it couldn't be replaced
+    file = g_fopen (packName.c_str (), "r+b");
+    return ok && file;
+}
+
+uint64_t CachePack::replay (uint64_t start)
+{
+    const uint64_t length = fileSize (file);
+    uint64_t pos = start;
+
+    RecordHeader header;
+    std::string key;
+    std::vector<char> data;
+
+    while (pos + sizeof (header) <= length && seek (file, pos) && fread (&header, sizeof (header), 1, file) == 1) {
+        const bool removal = header.dataSize == tombstone;
+        const uint32_t size = removal ? 0 : header.dataSize;
+
+        if (header.keySize == 0 || header.keySize > maxKeySize || pos + recordSize (header.keySize, size) > length) {
+            break;
+        }
+
+        key.resize (header.keySize);
+        data.resize (size);
+
+        if (fread (&key[0], 1, key.size (), file) != key.size () || (size && fread (data.data (), 1, size, file) != size)
+                || checksum (key, data.data (), size) != header.checksum) {
+            break;
+        }
+
+        const auto record = records.find (key);
+
+        if (record != records.end ()) {
+            live -= recordSize (key.size (), record->second.size);
+            records.erase (record);
+        }
+
+        if (!removal) {
+            records[key] = {pos + sizeof (header) + key.size (), size, ++clock};
+            live += recordSize (key.size (), size);
+        }
+
+        pos += recordSize (key.size (), size);
+    }
+
+    if (pos < length && options.rtSettings.verbose) {
+        printf ("Cache pack: dropped %llu bytes of incomplete records\n", static_cast<unsigned long long> (length - pos));
+    }
+
+    return pos;
+}
+
+bool CachePack::append (const std::string& key, const char* data, uint32_t size)
+{
+    // no data makes a tombstone
+    RecordHeader header;
+    header.keySize = key.size ();
+    header.dataSize = data ? size : tombstone;
+    header.checksum = checksum (key, data, data ? size : 0);
+
+    const bool ok = seek (file, end)
+                    && fwrite (&header, sizeof (header), 1, file) == 1
+                    && fwrite (key.data (), 1, key.size (), file) == key.size ()
+                    && (!data || !size || fwrite (data, 1, size, file) == size)
+                    && fflush (file) == 0;
+
+    // a partial record is overwritten by the next one, and dropped if it stays the last one
+    if (ok) {
+        end += recordSize (key.size (), data ? size : 0);
+    }
+
+    return ok;
+}
+
+bool CachePack::get (const std::string& key, std::string& data)
+{
+    MyMutex::MyLock lock (mutex);
+
+    const auto record = records.find (key);
+
+    if (!file || record == records.end ()) {
+        return false;
+    }
+
+    data.resize (record->second.size);
+
+    if (!seek (file, record->second.offset) || (!data.empty () && fread (&data[0], 1, data.size (), file) != data.size ())) {
+        data.clear ();
+        return false;
+    }
+
+    record->second.used = ++clock;
+    return true;
+}
+
+bool CachePack::read (const std::string& key, const std::function<bool (const char* data, size_t size)>& reader)
+{
+    std::shared_ptr<const Mapping> map;
+    uint64_t offset;
+    uint32_t size;
+
+    {
+        MyMutex::MyLock lock (mutex);
+
+        const auto record = records.find (key);
+
+        if (!file || record == records.end ()) {
+            return false;
+        }
+
+        offset = record->second.offset;
+        size = record->second.size;
+        record->second.used = ++clock;
+
+        // the records appended since the pack was mapped are out of the mapping
+        if (!mapping || offset + size > mapping->size) {
+            mapping.reset ();
+            std::shared_ptr<const Mapping> newMapping = std::make_shared<Mapping> (file, end, mappings);
+
+            if (newMapping->data) {
+                mapping = newMapping;
+            }
+        }
+
+        map = mapping;
+    }
+
+    if (map) {
+        return reader (map->data + offset, size);
+    }
+
+    std::string data;
+    return get (key, data) && reader (data.data (), data.size ());
+}
+
+void CachePack::unmap ()
+{
+    mapping.reset ();
+}
+
+bool CachePack::put (const std::string& key, const std::string& data)
+{
+    MyMutex::MyLock lock (mutex);
+
+    if (!file || key.empty () || key.size () > maxKeySize || data.size () >= tombstone) {
+        return false;
+    }
+
+    const uint64_t offset = end + sizeof (RecordHeader) + key.size ();
+
+    if (!append (key, data.data (), data.size ())) {
+        return false;
+    }
+
+    const auto record = records.find (key);
+
+    if (record != records.end ()) {
+        live -= recordSize (key.size (), record->second.size);
+    }
+
+    records[key] = {offset, static_cast<uint32_t> (data.size ()), ++clock};
+    live += recordSize (key.size (), data.size ());
+    return true;
+}
+
+void CachePack::remove (const std::string& key)
+{
+    MyMutex::MyLock lock (mutex);
+
+    const auto record = records.find (key);
+
+    if (!file || record == records.end () || !append (key, nullptr, 0)) {
+        return;
+    }
+
+    live -= recordSize (key.size (), record->second.size);
+    records.erase (record);
+}
+
+void CachePack::removeAll (const std::string& kind)
+{
+    MyMutex::MyLock lock (mutex);
+
+    if (!file) {
+        return;
+    }
+
+    if (kind.empty ()) {
+        // rewritten empty when no reader uses the pack, the records are removed one by one otherwise
+        const uint64_t previousGeneration = generation;
+        const uint64_t previousLive = live;
+        Records previous;
+        previous.swap (records);
+        live = 0;
+
+        if (compactLocked () || generation != previousGeneration || !file) {
+            return;
+        }
+
+        records.swap (previous);
+        live = previousLive;
+    }
+
+    const std::string prefix = kind.empty () ? std::string () : kind + '/';
+
+    for (auto record = records.begin (); record != records.end ();) {
+        if (record->first.compare (0, prefix.size (), prefix) == 0 && append (record->first, nullptr, 0)) {
+            live -= recordSize (record->first.size (), record->second.size);
+            record = records.erase (record);
+        } else {
+            ++record;
+        }
+    }
+}
+
+void CachePack::trim (uint64_t maxBytes)
+{
+    MyMutex::MyLock lock (mutex);
+
+    if (!file || live <= maxBytes) {
+        return;
+    }
+
+    struct Entry {
+        uint64_t used = 0;
+        std::vector<std::string> keys;
+    };
+
+    std::unordered_map<std::string, Entry> entries;
+
+    for (const auto& record : records) {
+        Entry& entry = entries[record.first.substr (record.first.find ('/') + 1)];
+        entry.used = std::max (entry.used, record.second.used);
+        entry.keys.push_back (record.first);
+    }
+
+    std::vector<const Entry*> lru;
+    lru.reserve (entries.size ());
+
+    for (const auto& entry : entries) {
+        lru.push_back (&entry.second);
+    }
+
+    std::sort (lru.begin (), lru.end (), [] (const Entry * a, const Entry * b) {
+        return a->used < b->used;
+    });
+
+    for (const Entry* entry : lru) {
+        if (live <= maxBytes) {
+            break;
+        }
+
+        for (const auto& key : entry->keys) {
+            const auto record = records.find (key);
+
+            if (append (key, nullptr, 0)) {
+                live -= recordSize (key.size (), record->second.size);
+                records.erase (record);
+            }
+        }
+    }
+}
+
+bool CachePack::compact ()
+{
+    MyMutex::MyLock lock (mutex);
+
+    return compactLocked ();
+}
+
+bool CachePack::compactLocked ()
+{
+    if (!file) {
+        return false;
+    }
+
+    // not worth writing the new pack if it can't replace the old one yet
+    unmap ();
+
+    if (mappings != 0) {
+        return false;
+    }
+
+    const Glib::ustring tmpName = packName + ".tmp";
+    FILE* const out = g_fopen (tmpName.c_str (), "wb");
+
+    if (!out) {
+        return false;
+    }
+
+    PackHeader header;
+    memcpy (header.magic, packMagic, sizeof (packMagic));
+    header.version = packVersion;
+    header.generation = newGeneration ();
+
+    bool ok = fwrite (&header, sizeof (header), 1, out) == 1;
+
+    // the records are copied as they are, in the order of the pack
+    std::vector<Records::const_iterator> order;
+    order.reserve (records.size ());
+
+    for (auto record = records.cbegin (); record != records.cend (); ++record) {
+        order.push_back (record);
+    }
+
+    std::sort (order.begin (), order.end (), [] (const Records::const_iterator & a, const Records::const_iterator & b) {
+        return a->second.offset < b->second.offset;
+    });
+
+    Records compacted;
+    uint64_t pos = sizeof (header);
+    std::vector<char> buffer;
+
+    for (const auto& record : order) {
+        if (!ok) {
+            break;
+        }
+
+        const uint64_t size = recordSize (record->first.size (), record->second.size);
+        buffer.resize (size);
+
+        ok = seek (file, record->second.offset - sizeof (RecordHeader) - record->first.size ())
+             && fread (buffer.data (), 1, size, file) == size
+             && fwrite (buffer.data (), 1, size, out) == size;
+
+        compacted[record->first] = {pos + sizeof (RecordHeader) + record->first.size (), record->second.size, record->second.used};
+        pos += size;
+    }
+
+    if (fclose (out) != 0) {
+        ok = false;
+    }
+
+    if (!ok) {
+        g_remove (tmpName.c_str ());
+        return false;
+    }
+
+    // until the new index is written, the old one is stale as it belongs to another generation
+    if (!replaceWith (tmpName)) {
+        if (!file) {
+            create ();
+        }
+
+        return false;
+    }
+
+    if (options.rtSettings.verbose) {
+        printf ("Cache pack: compacted from %llu to %llu bytes\n", static_cast<unsigned long long> (end), static_cast<unsigned long long> (pos));
+    }
+
+    generation = header.generation;
+    end = pos;
+    records.swap (compacted);
+    saveIndex (generation, end, records);
+    return true;
+}
+
+bool CachePack::loadIndex ()
+{
+    FILE* const f = g_fopen (indexName.c_str (), "rb");
+
+    if (!f) {
+        return false;
+    }
+
+    IndexHeader header;
+    bool ok = fread (&header, sizeof (header), 1, f) == 1
+              && memcmp (header.magic, indexMagic, sizeof (indexMagic)) == 0 && header.version == packVersion
+              && header.generation == generation && header.end >= sizeof (PackHeader) && header.end <= fileSize (file);
+
+    IndexEntry entry;
+    std::string key;
+
+    for (uint64_t i = 0; ok && i < header.count; ++i) {
+        ok = fread (&entry, sizeof (entry), 1, f) == 1
+             && entry.keySize > 0 && entry.keySize <= maxKeySize && entry.offset + entry.size <= header.end;
+
+        if (ok) {
+            key.resize (entry.keySize);
+            ok = fread (&key[0], 1, key.size (), f) == key.size ();
+        }
+
+        if (ok) {
+            records[key] = {entry.offset, entry.size, entry.used};
+            live += recordSize (key.size (), entry.size);
+        }
+    }
+
+    fclose (f);
+
+    if (!ok) {
+        records.clear ();
+        live = 0;
+        return false;
+    }
+
+    end = header.end;
+    clock = header.clock;
+    return true;
+}
+
+bool CachePack::saveIndex (uint64_t gen, uint64_t packEnd, const Records& recs) const
+{
+    const Glib::ustring tmpName = indexName + ".tmp";
+    FILE* const f = g_fopen (tmpName.c_str (), "wb");
+
+    if (!f) {
+        return false;
+    }
+
+    IndexHeader header;
+    memcpy (header.magic, indexMagic, sizeof (indexMagic));
+    header.version = packVersion;
+    header.generation = gen;
+    header.end = packEnd;
+    header.clock = clock;
+    header.count = recs.size ();
+
+    bool ok = fwrite (&header, sizeof (header), 1, f) == 1;
+
+    for (const auto& record : recs) {
+        if (!ok) {
+            break;
+        }
+
+        IndexEntry entry;
+        entry.offset = record.second.offset;
+        entry.used = record.second.used;
+        entry.size = record.second.size;
+        entry.keySize = record.first.size ();
+
+        ok = fwrite (&entry, sizeof (entry), 1, f) == 1 && fwrite (record.first.data (), 1, record.first.size (), f) == record.first.size ();
+    }
+
+    if (fclose (f) != 0) {
+        ok = false;
+    }
+
+    if (!ok || g_rename (tmpName.c_str (), indexName.c_str ()) != 0) {
+        g_remove (tmpName.c_str ());
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t CachePack::getLiveBytes () const
+{
+    MyMutex::MyLock lock (mutex);
+
+    return live;
+}
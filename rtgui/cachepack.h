@@ -0,0 +1,111 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <glibmm/ustring.h>
+
+#include "../rtengine/noncopyable.h"
+
+#include "threadutils.h"
+
+/** Store of the records of the thumbnail cache in a single file.
+  *
+  * The records are appended to the pack file, a record superseding the previous one of the same key and a
+  * tombstone removing it. The index of the live records is kept in memory and written to a separate file when the
+  * pack is closed; on opening, the records appended since the index was written, e.g. before a crash, are replayed
+  * and an incomplete record at the end of the pack is dropped. The space of the superseded records is reclaimed by
+  * compact, which writes a new pack aside and then replaces the old one.
+  *
+  * The pack is memory mapped when possible, so that the large records can be decoded in place. Since the readers
+  * use their mapping unlocked, the pack is never truncated nor rewritten in place: a new pack is always written aside,
+  * and it only replaces the old one when no reader holds a mapping of it anymore, the old file being closed first so
+  * that the rename works on Windows too. Until then, compact fails and the records are only removed from the index.
+  *
+  * The keys are made of a kind and an entry name separated by a '/', the records of an entry being evicted together.
+  */
+class CachePack :
+    public rtengine::NonCopyable
+{
+public:
+    CachePack ();
+    ~CachePack ();
+
+    /** Opens the pack, creating it if needed; the index is stored in fileName + ".index" */
+    bool open (const Glib::ustring& fileName);
+    /** Compacts the pack if more than half of it is dead, writes the index and closes the pack */
+    void close ();
+
+    bool get (const std::string& key, std::string& data);
+    /** Calls reader with the data of the record, which is mapped rather than copied when possible.
+      * The pack isn't locked while reader runs.
+      * @return false if there is no such record, the result of reader otherwise */
+    bool read (const std::string& key, const std::function<bool (const char* data, size_t size)>& reader);
+    bool put (const std::string& key, const std::string& data);
+    void remove (const std::string& key);
+    /** Removes the records of the given kind, all the records if kind is empty */
+    void removeAll (const std::string& kind);
+
+    /** Evicts the least recently used entries until the live records take at most maxBytes */
+    void trim (uint64_t maxBytes);
+
+    /** Rewrites the pack without the superseded and removed records
+      * @return false if it wasn't, e.g. while a reader still uses the pack */
+    bool compact ();
+
+    uint64_t getLiveBytes () const;
+
+private:
+    struct Record {
+        uint64_t offset;    // of the data in the pack
+        uint32_t size;      // of the data
+        uint64_t used;      // value of clock when the record was last read or written
+    };
+
+    using Records = std::unordered_map<std::string, Record>;
+
+    class Mapping;
+
+    bool create ();
+    bool replaceWith (const Glib::ustring& tmpName);
+    uint64_t replay (uint64_t start);
+    bool append (const std::string& key, const char* data, uint32_t size);
+    bool loadIndex ();
+    bool saveIndex (uint64_t gen, uint64_t packEnd, const Records& recs) const;
+    bool compactLocked ();
+    void closeLocked ();
+    void unmap ();
+
+    Glib::ustring packName;
+    Glib::ustring indexName;
+    FILE* file;
+    uint64_t generation;    // changes each time the pack is rewritten, an index of another generation is stale
+    uint64_t end;           // of the valid records, i.e. where the next one is appended
+    uint64_t live;          // bytes taken by the live records, headers included
+    uint64_t clock;
+    Records records;
+    std::shared_ptr<const Mapping> mapping;    // the readers keep the mapping they use alive
+    std::atomic<int> mappings;                 // alive, ours and the ones of the readers
+    mutable MyMutex mutex;
+};
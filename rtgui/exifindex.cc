@@ -0,0 +1,147 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "exifindex.h"
+
+#include "cacheimagedata.h"
+
+#include "../rtengine/rtengine.h"
+
+namespace
+{
+
+constexpr double tol = 0.01;
+constexpr double tol2 = 1e-8;
+
+}
+
+ExifIndex::Key::Key () :
+    exifValid (false), camera (0), lens (0), filetype (0), expcomp (0), shutter (0), fnumber (0), focalLen (0.), iso (0)
+{
+}
+
+ExifIndex::Key ExifIndex::add (const CacheImageData& cfs)
+{
+    Key key;
+
+    key.exifValid = cfs.exifValid;
+    key.camera = add (cameras, cfs.getCamera (), &ExifIndex::matchCamera);
+    key.lens = add (lenses, cfs.lens, &ExifIndex::matchLens);
+    key.filetype = add (filetypes, cfs.filetype, &ExifIndex::matchFiletype);
+    key.expcomp = add (expcomps, cfs.expcomp, &ExifIndex::matchExpComp);
+
+    if (cfs.exifValid) {
+        key.shutter = add (shutters, rtengine::ImageMetaData::shutterToString (cfs.shutter), &ExifIndex::matchShutter);
+        key.fnumber = add (fnumbers, rtengine::ImageMetaData::apertureToString (cfs.fnumber), &ExifIndex::matchFNumber);
+        key.focalLen = cfs.focalLen;
+        key.iso = cfs.iso;
+    }
+
+    return key;
+}
+
+void ExifIndex::setFilter (const ExifFilterSettings& filter)
+{
+    this->filter = filter;
+
+    update (cameras, &ExifIndex::matchCamera);
+    update (lenses, &ExifIndex::matchLens);
+    update (filetypes, &ExifIndex::matchFiletype);
+    update (expcomps, &ExifIndex::matchExpComp);
+    update (shutters, &ExifIndex::matchShutter);
+    update (fnumbers, &ExifIndex::matchFNumber);
+}
+
+bool ExifIndex::matches (const Key& key) const
+{
+    if (!key.exifValid) {
+        return (!filter.filterCamera || cameras.matching[key.camera])
+               && (!filter.filterLens || lenses.matching[key.lens])
+               && (!filter.filterFiletype || filetypes.matching[key.filetype])
+               && (!filter.filterExpComp || expcomps.matching[key.expcomp]);
+    }
+
+    return (!filter.filterShutter || shutters.matching[key.shutter])
+           && (!filter.filterFNumber || fnumbers.matching[key.fnumber])
+           && (!filter.filterFocalLen || (key.focalLen >= filter.focalFrom - tol && key.focalLen <= filter.focalTo + tol))
+           && (!filter.filterISO || (key.iso >= filter.isoFrom && key.iso <= filter.isoTo))
+           && (!filter.filterExpComp || expcomps.matching[key.expcomp])
+           && (!filter.filterCamera || cameras.matching[key.camera])
+           && (!filter.filterLens || lenses.matching[key.lens])
+           && (!filter.filterFiletype || filetypes.matching[key.filetype]);
+}
+
+void ExifIndex::clear ()
+{
+    for (auto values : {&cameras, &lenses, &filetypes, &expcomps, &shutters, &fnumbers}) {
+        values->ids.clear ();
+        values->values.clear ();
+        values->matching.clear ();
+    }
+}
+
+int ExifIndex::add (Values& values, const std::string& value, bool (ExifIndex::*match) (const std::string&) const)
+{
+    const auto id = values.ids.find (value);
+
+    if (id != values.ids.end ()) {
+        return id->second;
+    }
+
+    values.ids.emplace (value, values.values.size ());
+    values.values.push_back (value);
+    values.matching.push_back ((this->*match) (value));
+    return values.values.size () - 1;
+}
+
+void ExifIndex::update (Values& values, bool (ExifIndex::*match) (const std::string&) const)
+{
+    for (size_t i = 0; i < values.values.size (); ++i) {
+        values.matching[i] = (this->*match) (values.values[i]);
+    }
+}
+
+bool ExifIndex::matchCamera (const std::string& value) const
+{
+    return filter.cameras.count (value) > 0;
+}
+
+bool ExifIndex::matchLens (const std::string& value) const
+{
+    return filter.lenses.count (value) > 0;
+}
+
+bool ExifIndex::matchFiletype (const std::string& value) const
+{
+    return filter.filetypes.count (value) > 0;
+}
+
+bool ExifIndex::matchExpComp (const std::string& value) const
+{
+    return filter.expcomp.count (value) > 0;
+}
+
+bool ExifIndex::matchShutter (const std::string& value) const
+{
+    const double shutter = rtengine::ImageMetaData::shutterFromString (value);
+    return shutter >= filter.shutterFrom - tol2 && shutter <= filter.shutterTo + tol2;
+}
+
+bool ExifIndex::matchFNumber (const std::string& value) const
+{
+    const double fnumber = rtengine::ImageMetaData::apertureFromString (value);
+    return fnumber >= filter.fnumberFrom - tol2 && fnumber <= filter.fnumberTo + tol2;
+}
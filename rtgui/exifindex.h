@@ -0,0 +1,84 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "exiffiltersettings.h"
+
+class CacheImageData;
+
+/** Index of the EXIF fields the file browser filters on.
+  *
+  * The distinct values of the entries of a directory are stored once and the entries only keep their ids. The
+  * filter is evaluated once per distinct value when it is set, so that checking an entry comes down to a few
+  * lookups instead of formatting and comparing its values.
+  */
+class ExifIndex
+{
+public:
+    /** Ids of the values of an entry */
+    struct Key {
+        Key ();
+
+        bool exifValid;
+        int camera;
+        int lens;
+        int filetype;
+        int expcomp;
+        int shutter;    // of the shutter speed as displayed, the filter works on these rounded values
+        int fnumber;    // same
+        double focalLen;
+        unsigned iso;
+    };
+
+    /** Adds the values of an entry, which are matched against the current filter */
+    Key add (const CacheImageData& cfs);
+
+    void setFilter (const ExifFilterSettings& filter);
+    bool matches (const Key& key) const;
+
+    /** Forgets the values, e.g. when the directory is closed */
+    void clear ();
+
+private:
+    struct Values {
+        std::unordered_map<std::string, int> ids;
+        std::vector<std::string> values;
+        std::vector<char> matching;     // for the current filter
+    };
+
+    int add (Values& values, const std::string& value, bool (ExifIndex::*match) (const std::string&) const);
+    void update (Values& values, bool (ExifIndex::*match) (const std::string&) const);
+
+    bool matchCamera (const std::string& value) const;
+    bool matchLens (const std::string& value) const;
+    bool matchFiletype (const std::string& value) const;
+    bool matchExpComp (const std::string& value) const;
+    bool matchShutter (const std::string& value) const;
+    bool matchFNumber (const std::string& value) const;
+
+    ExifFilterSettings filter;
+    Values cameras;
+    Values lenses;
+    Values filetypes;
+    Values expcomps;
+    Values shutters;
+    Values fnumbers;
+};
@@ -126,7 +126,7 @@ void findOriginalEntries (const std::vector<ThumbBrowserEntryBase*>& entries)
 }
 
 FileBrowser::FileBrowser ()
-    : tbl(nullptr), numFiltered(0)
+    : tbl(nullptr), queryFileNameMatchEqual(true), numFiltered(0)
 {
 
     fbih = new FileBrowserIdleHelper;
@@ -609,6 +609,8 @@ void FileBrowser::addEntry_ (FileBrowserEntry* entry)
 
         fd.insert (i, entry);
 
+        entry->exifKey = exifIndex.add (*entry->thumbnail->getCacheImageData());
+
         initEntry (entry);
     }
     redraw ();
@@ -681,6 +683,7 @@ void FileBrowser::close ()
         }
 
         fd.clear ();
+        exifIndex.clear ();
     }
 
     lastClicked = nullptr;
@@ -1409,12 +1412,33 @@ void FileBrowser::applyFilter (const BrowserFilter& filter)
 
     this->filter = filter;
 
+    // the parts of the filter which don't depend on the entries are evaluated once
+    queryFileNames.clear ();
+    queryFileNameMatchEqual = filter.queryFileName.find ("!=") != 0;
+
+    if (!filter.queryFileName.empty()) {
+        // Consider that queryFileName consist of comma separated values (FilterString)
+        // Evaluate if ANY of these FilterString are contained in the filename
+        // This will construct OR filter within the filter.queryFileName
+        const Glib::ustring decodedQueryFileName = queryFileNameMatchEqual ? filter.queryFileName : filter.queryFileName.substr (2);
+
+        for (const auto& value : Glib::Regex::split_simple (",", decodedQueryFileName.uppercase())) {
+            // ignore empty values. Otherwise filter will always return true if
+            // e.g. filter.queryFileName ends on "," and will stop being a filter
+            if (!value.empty()) {
+                queryFileNames.push_back (value);
+            }
+        }
+    }
+
     // remove items not complying the filter from the selection
     bool selchanged = false;
     numFiltered = 0;
     {
         MYWRITERLOCK(l, entryRW);
 
+        exifIndex.setFilter (filter.exifFilter);
+
         if (filter.showOriginal) {
             findOriginalEntries(fd);
         }
@@ -1472,47 +1496,19 @@ bool FileBrowser::checkFilter (ThumbBrowserEntryBase* entryb)   // true -> entry
     if (!filter.queryFileName.empty()) {
         // check if image's FileName contains queryFileName (case insensitive)
         // TODO should we provide case-sensitive search option via preferences?
-        Glib::ustring FileName;
-        FileName = Glib::path_get_basename (entry->thumbnail->getFileName());
-        FileName = FileName.uppercase();
-        //printf("FileBrowser::checkFilter FileName = '%s'; find() result= %i \n",FileName.c_str(), FileName.find(filter.queryFileName.uppercase()));
-
-        Glib::ustring decodedQueryFileName;
-        bool MatchEqual;
-
-        // Determine the match mode - check if the first 2 characters are equal to "!="
-        if (filter.queryFileName.find("!=") == 0) {
-            decodedQueryFileName = filter.queryFileName.substr (2, filter.queryFileName.length() - 2);
-            MatchEqual = false;
-        } else {
-            decodedQueryFileName = filter.queryFileName;
-            MatchEqual = true;
-        }
+        const Glib::ustring FileName = Glib::path_get_basename (entry->thumbnail->getFileName()).uppercase();
 
-        // Consider that queryFileName consist of comma separated values (FilterString)
-        // Evaluate if ANY of these FilterString are contained in the filename
-        // This will construct OR filter within the filter.queryFileName
-        int iFilenameMatch = 0;
-        std::vector<Glib::ustring> vFilterStrings = Glib::Regex::split_simple(",", decodedQueryFileName.uppercase());
+        bool matched = false;
 
-        for(int i = 0; i < vFilterStrings.size(); i++) {
-            // ignore empty vFilterStrings. Otherwise filter will always return true if
-            // e.g. filter.queryFileName ends on "," and will stop being a filter
-            if (!vFilterStrings.at(i).empty()) {
-                if (FileName.find(vFilterStrings.at(i)) != -1) {
-                    iFilenameMatch++;
-                }
+        for (const auto& value : queryFileNames) {
+            if (FileName.find (value) != Glib::ustring::npos) {
+                matched = true;
+                break;
             }
         }
 
-        if (MatchEqual) {
-            if (iFilenameMatch == 0) { //none of the vFilterStrings found in FileName
-                return false;
-            }
-        } else {
-            if (iFilenameMatch > 0) { // match is found for at least one of vFilterStrings in FileName
-                return false;
-            }
+        if (matched != queryFileNameMatchEqual) {
+            return false;
         }
 
         /*experimental Regex support, this is unlikely to be useful to photographers*/
@@ -1521,31 +1517,7 @@ bool FileBrowser::checkFilter (ThumbBrowserEntryBase* entryb)   // true -> entry
     }
 
     // check exif filter
-    const CacheImageData* cfs = entry->thumbnail->getCacheImageData();
-    double tol = 0.01;
-    double tol2 = 1e-8;
-
-    if (!filter.exifFilterEnabled) {
-        return true;
-    }
-
-    Glib::ustring camera(cfs->getCamera());
-
-    if (!cfs->exifValid)
-        return (!filter.exifFilter.filterCamera || filter.exifFilter.cameras.count(camera) > 0)
-               && (!filter.exifFilter.filterLens || filter.exifFilter.lenses.count(cfs->lens) > 0)
-               && (!filter.exifFilter.filterFiletype || filter.exifFilter.filetypes.count(cfs->filetype) > 0)
-               && (!filter.exifFilter.filterExpComp || filter.exifFilter.expcomp.count(cfs->expcomp) > 0);
-
-    return
-        (!filter.exifFilter.filterShutter || (rtengine::ImageMetaData::shutterFromString(rtengine::ImageMetaData::shutterToString(cfs->shutter)) >= filter.exifFilter.shutterFrom - tol2 && rtengine::ImageMetaData::shutterFromString(rtengine::ImageMetaData::shutterToString(cfs->shutter)) <= filter.exifFilter.shutterTo + tol2))
-        && (!filter.exifFilter.filterFNumber || (rtengine::ImageMetaData::apertureFromString(rtengine::ImageMetaData::apertureToString(cfs->fnumber)) >= filter.exifFilter.fnumberFrom - tol2 && rtengine::ImageMetaData::apertureFromString(rtengine::ImageMetaData::apertureToString(cfs->fnumber)) <= filter.exifFilter.fnumberTo + tol2))
-        && (!filter.exifFilter.filterFocalLen || (cfs->focalLen >= filter.exifFilter.focalFrom - tol && cfs->focalLen <= filter.exifFilter.focalTo + tol))
-        && (!filter.exifFilter.filterISO     || (cfs->iso >= filter.exifFilter.isoFrom && cfs->iso <= filter.exifFilter.isoTo))
-        && (!filter.exifFilter.filterExpComp || filter.exifFilter.expcomp.count(cfs->expcomp) > 0)
-        && (!filter.exifFilter.filterCamera  || filter.exifFilter.cameras.count(camera) > 0)
-        && (!filter.exifFilter.filterLens    || filter.exifFilter.lenses.count(cfs->lens) > 0)
-        && (!filter.exifFilter.filterFiletype  || filter.exifFilter.filetypes.count(cfs->filetype) > 0);
+    return !filter.exifFilterEnabled || exifIndex.matches (entry->exifKey);
 }
 
 void FileBrowser::toTrashRequested (std::vector<FileBrowserEntry*> tbe)
@@ -1928,6 +1900,14 @@ void FileBrowser::selectionChanged ()
     notifySelectionListener ();
 }
 
+void FileBrowser::visibleRangeChanged (const VisibleRange& range)
+{
+
+    if (tbl) {
+        tbl->visibleRangeChanged (range);
+    }
+}
+
 void FileBrowser::notifySelectionListener ()
 {
 
@@ -23,6 +23,7 @@
 #include <map>
 #include "thumbbrowserbase.h"
 #include "exiffiltersettings.h"
+#include "exifindex.h"
 #include "filebrowserentry.h"
 #include "browserfilter.h"
 #include "pparamschangelistener.h"
@@ -47,6 +48,7 @@ public:
     virtual void copyMoveRequested      (std::vector<FileBrowserEntry*> tbe, bool moveRequested) {}
     virtual void selectionChanged       (std::vector<Thumbnail*> tbe) {}
     virtual void clearFromCacheRequested(std::vector<FileBrowserEntry*> tbe, bool leavenotrace) {}
+    virtual void visibleRangeChanged    (const ThumbBrowserBase::VisibleRange& range) {}
     virtual bool isInTabMode            ()
     {
         return false;
@@ -127,6 +129,9 @@ protected:
     BatchPParamsChangeListener* bppcl;
     FileBrowserListener* tbl;
     BrowserFilter filter;
+    std::vector<Glib::ustring> queryFileNames;  // the comma separated values of filter.queryFileName, uppercased
+    bool queryFileNameMatchEqual;
+    ExifIndex exifIndex;
     int numFiltered;
     FileBrowserIdleHelper* fbih;
 
@@ -200,6 +205,7 @@ public:
     void _thumbRearrangementNeeded ();
 
     void selectionChanged ();
+    void visibleRangeChanged (const VisibleRange& range);
 
     void setExportPanel (ExportPanel* expanel);
     // exportpanel interface
@@ -92,6 +92,11 @@ void FileBrowserEntry::refreshThumbnailImage ()
     }
 
     thumbImageUpdater->add (this, &updatepriority, false, this);
+
+    // The embedded preview of a new raw is replaced by the processed thumbnail once the new images are shown
+    if (thumbnail->isQuick ()) {
+        refreshQuickThumbnailImage ();
+    }
 }
 
 void FileBrowserEntry::refreshQuickThumbnailImage ()
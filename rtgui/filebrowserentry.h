@@ -29,6 +29,7 @@
 #include "editenums.h"
 #include "../rtengine/rtengine.h"
 #include "crophandler.h"
+#include "exifindex.h"
 
 
 class FileBrowserEntry;
@@ -68,6 +69,8 @@ public:
     static Glib::RefPtr<Gdk::Pixbuf> recentlySavedIcon;
     static Glib::RefPtr<Gdk::Pixbuf> enqueuedIcon;
 
+    ExifIndex::Key exifKey;  // set by the browser the entry is added to
+
     FileBrowserEntry (Thumbnail* thm, const Glib::ustring& fname);
     ~FileBrowserEntry ();
     void draw (Cairo::RefPtr<Cairo::Context> cc);
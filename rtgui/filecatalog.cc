@@ -1918,6 +1918,14 @@ void FileCatalog::selectionChanged (std::vector<Thumbnail*> tbe)
     }
 }
 
+// Called within GTK UI thread
+void FileCatalog::visibleRangeChanged (const ThumbBrowserBase::VisibleRange& range)
+{
+
+    // the previews of the directory which would show up in the visible area are loaded first
+    previewLoader->setVisibleRange (selectedDirectoryId, range);
+}
+
 // Called within GTK UI thread
 void FileCatalog::exifFilterChanged ()
 {
@@ -230,6 +230,7 @@ public:
     void renameRequested        (std::vector<FileBrowserEntry*> tbe);
     void clearFromCacheRequested(std::vector<FileBrowserEntry*> tbe, bool leavenotrace);
     void selectionChanged       (std::vector<Thumbnail*> tbe);
+    void visibleRangeChanged    (const ThumbBrowserBase::VisibleRange& range);
     void emptyTrash ();
     bool trashIsEmpty ();
 
@@ -216,34 +216,6 @@ void thumbInterp (const unsigned char* src, int sw, int sh, unsigned char* dst,
     }
 }
 
-Glib::ustring removeExtension (const Glib::ustring& filename)
-{
-
-    Glib::ustring bname = Glib::path_get_basename(filename);
-    size_t lastdot = bname.find_last_of ('.');
-    size_t lastwhitespace = bname.find_last_of (" \t\f\v\n\r");
-
-    if (lastdot != bname.npos && (lastwhitespace == bname.npos || lastdot > lastwhitespace)) {
-        return filename.substr (0, filename.size() - (bname.size() - lastdot));
-    } else {
-        return filename;
-    }
-}
-
-Glib::ustring getExtension (const Glib::ustring& filename)
-{
-
-    Glib::ustring bname = Glib::path_get_basename(filename);
-    size_t lastdot = bname.find_last_of ('.');
-    size_t lastwhitespace = bname.find_last_of (" \t\f\v\n\r");
-
-    if (lastdot != bname.npos && (lastwhitespace == bname.npos || lastdot > lastwhitespace)) {
-        return filename.substr (filename.size() - (bname.size() - lastdot) + 1, filename.npos);
-    } else {
-        return "";
-    }
-}
-
 bool confirmOverwrite (Gtk::Window& parent, const std::string& filename)
 {
     bool safe = true;
@@ -0,0 +1,483 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  Copyright (c) 2004-2010 Gabor Horvath <hgabor@rawtherapee.com>
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __GNUC__
+#if defined(__FAST_MATH__)
+#error Using the -ffast-math CFLAG is known to lead to problems. Disable it to compile RawTherapee.
+#endif
+#endif
+
+#include "config.h"
+#include <glibmm.h>
+#include <giomm.h>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <tiffio.h>
+#include <cstring>
+#include <cstdlib>
+#include <locale.h>
+#include "options.h"
+#include "pathutils.h"
+#include "version.h"
+#include "../rtengine/mytime.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+extern Options options;
+
+// stores path to data files
+Glib::ustring argv0;
+Glib::ustring argv1;
+bool simpleEditor;
+
+namespace
+{
+
+// For an unknown reason, Glib::filename_to_utf8 doesn't work on reliably Windows,
+// so we're using Glib::filename_to_utf8 for Linux/Apple and Glib::locale_to_utf8 for Windows.
+Glib::ustring fname_to_utf8 (const char* fname)
+{
+#ifdef WIN32
+
+    try {
+        return Glib::locale_to_utf8 (fname);
+    } catch (Glib::Error&) {
+        return Glib::convert_with_fallback (fname, "UTF-8", "ISO-8859-1", "?");
+    }
+
+#else
+
+    return Glib::filename_to_utf8 (fname);
+
+#endif
+}
+
+// One line of the manifest: <input>|<pp3>|<output format>|<output>
+struct ManifestJob {
+    Glib::ustring inputFile;
+    Glib::ustring paramsFile;   // empty: sidecar file if present, neutral values otherwise
+    Glib::ustring outputFile;
+    std::string outputType;
+    int compression;
+    int subsampling;
+    int bits;
+    int line;
+};
+
+// Parses the output format field, which uses the syntax of the rawtherapee switches without the dash, e.g. "j90 js3", "tz b16" or "n"
+bool parseOutputFormat (const std::string& field, ManifestJob& job)
+{
+    job.outputType = "jpg";
+    job.compression = 92;
+    job.subsampling = 3;
+    job.bits = -1;
+
+    std::istringstream tokens (field);
+    std::string token;
+
+    while (tokens >> token) {
+        if (token.compare (0, 2, "js") == 0) {
+            if (sscanf (token.c_str () + 2, "%d", &job.subsampling) != 1 || job.subsampling < 1 || job.subsampling > 3) {
+                return false;
+            }
+        } else if (token[0] == 'j') {
+            job.outputType = "jpg";
+
+            if (token.size () > 1 && (sscanf (token.c_str () + 1, "%d", &job.compression) != 1 || job.compression < 0 || job.compression > 100)) {
+                return false;
+            }
+        } else if (token[0] == 'b') {
+            if (sscanf (token.c_str () + 1, "%d", &job.bits) != 1 || (job.bits != 8 && job.bits != 16)) {
+                return false;
+            }
+        } else if (token == "t" || token == "tz") {
+            job.outputType = "tif";
+            job.compression = token == "tz" ? 1 : 0;
+        } else if (token == "n") {
+            job.outputType = "png";
+            job.compression = -1;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool loadManifest (const Glib::ustring& fileName, std::vector<ManifestJob>& jobs)
+{
+    std::ifstream file (fileName, std::ios::binary);
+
+    if (!file.is_open ()) {
+        std::cerr << "Error: can't open the manifest \"" << fileName << "\"" << std::endl;
+        return false;
+    }
+
+    std::string row;
+    int line = 0;
+    bool ok = true;
+
+    while (std::getline (file, row)) {
+        ++line;
+
+        if (!row.empty () && row.back () == '\r') {
+            row.pop_back ();
+        }
+
+        if (row.empty () || row[0] == '#') {
+            continue;
+        }
+
+        std::vector<std::string> fields;
+        std::string::size_type start = 0, end;
+
+        while ((end = row.find ('|', start)) != std::string::npos) {
+            fields.push_back (row.substr (start, end - start));
+            start = end + 1;
+        }
+
+        fields.push_back (row.substr (start));
+        fields.resize (std::max<size_t> (fields.size (), 4));
+
+        ManifestJob job;
+        job.line = line;
+        job.inputFile = fields[0];
+        job.paramsFile = fields[1];
+
+        if (job.inputFile.empty () || !parseOutputFormat (fields[2], job)) {
+            std::cerr << "Error: invalid manifest entry at line " << line << std::endl;
+            ok = false;
+            continue;
+        }
+
+        // Saves alongside the input file if no output is given, the extension is forced to the output format
+        job.outputFile = removeExtension (fields[3].empty () ? job.inputFile : Glib::ustring (fields[3])) + "." + job.outputType;
+        jobs.push_back (job);
+    }
+
+    return ok;
+}
+
+class JobRunner
+{
+public:
+    JobRunner (const std::vector<ManifestJob>& jobs, int threadsPerImage, bool overwriteFiles, bool copyParamsFile)
+        : jobs (jobs), threadsPerImage (threadsPerImage), overwriteFiles (overwriteFiles), copyParamsFile (copyParamsFile), next (0), done (0), errors (0) {}
+
+    void run (int workers)
+    {
+        std::vector<Glib::Threads::Thread*> threads;
+
+        for (int i = 1; i < workers; ++i) {
+            threads.push_back (Glib::Threads::Thread::create (sigc::mem_fun (*this, &JobRunner::worker)));
+        }
+
+        worker ();
+
+        for (auto thread : threads) {
+            thread->join ();
+        }
+    }
+
+    unsigned int getErrors () const
+    {
+        return errors;
+    }
+
+private:
+    void worker ()
+    {
+#ifdef _OPENMP
+        // The ICV is per thread, so this only limits the parallel regions started by this worker
+        omp_set_num_threads (threadsPerImage);
+#endif
+
+        while (true) {
+            size_t index;
+
+            {
+                Glib::Threads::Mutex::Lock lock (mutex);
+
+                if (next == jobs.size ()) {
+                    return;
+                }
+
+                index = next++;
+            }
+
+            if (!process (jobs[index])) {
+                Glib::Threads::Mutex::Lock lock (mutex);
+                ++errors;
+            }
+        }
+    }
+
+    void report (const ManifestJob& job, const Glib::ustring& message, bool error)
+    {
+        Glib::Threads::Mutex::Lock lock (mutex);
+        ++done;
+        (error ? std::cerr : std::cout) << "[" << done << "/" << jobs.size () << "] " << job.inputFile << ": " << message << std::endl;
+    }
+
+    bool process (const ManifestJob& job)
+    {
+        MyTime t0, t1, t2, t3;
+        t0.set ();
+
+        if (job.inputFile == job.outputFile) {
+            report (job, "cannot overwrite the input file", true);
+            return false;
+        }
+
+        if (!overwriteFiles && Glib::file_test (job.outputFile, Glib::FILE_TEST_EXISTS)) {
+            report (job, job.outputFile + " already exists: use -Y option to overwrite. This image has been skipped.", true);
+            return false;
+        }
+
+        rtengine::procparams::ProcParams currentParams;
+        const Glib::ustring paramsFile = job.paramsFile.empty () ? job.inputFile + paramFileExtension : job.paramsFile;
+
+        if (Glib::file_test (paramsFile, Glib::FILE_TEST_EXISTS)) {
+            if (currentParams.load (paramsFile)) {
+                report (job, "can't load the processing profile " + paramsFile, true);
+                return false;
+            }
+        } else if (!job.paramsFile.empty ()) {
+            report (job, "\"" + paramsFile + "\" not found", true);
+            return false;
+        }
+
+        const Glib::ustring ext = getExtension (job.inputFile).lowercase ();
+        const bool isRaw = !(ext == "jpg" || ext == "jpeg" || ext == "tif" || ext == "tiff" || ext == "png");
+
+        int errorCode;
+        rtengine::InitialImage* ii = rtengine::InitialImage::load (job.inputFile, isRaw, &errorCode, nullptr);
+
+        if (!ii) {
+            report (job, "error loading file", true);
+            return false;
+        }
+
+        t1.set ();
+
+        rtengine::ProcessingJob* pjob = rtengine::ProcessingJob::create (ii, currentParams);
+        rtengine::IImage16* resultImage = rtengine::processImage (pjob, errorCode, nullptr, options.tunnelMetaData);
+        ii->decreaseRef ();
+
+        if (!resultImage) {
+            report (job, "error processing", true);
+            return false;
+        }
+
+        t2.set ();
+
+        if (job.outputType == "jpg") {
+            errorCode = resultImage->saveAsJPEG (job.outputFile, job.compression, job.subsampling);
+        } else if (job.outputType == "tif") {
+            errorCode = resultImage->saveAsTIFF (job.outputFile, job.bits, job.compression == 0);
+        } else {
+            errorCode = resultImage->saveAsPNG (job.outputFile, job.compression, job.bits);
+        }
+
+        resultImage->free ();
+
+        if (errorCode) {
+            report (job, "error saving to " + job.outputFile, true);
+            return false;
+        }
+
+        if (copyParamsFile) {
+            currentParams.save (job.outputFile + paramFileExtension);
+        }
+
+        t3.set ();
+
+        report (job, Glib::ustring::compose ("%1 (load %2 ms, process %3 ms, save %4 ms, total %5 ms)", job.outputFile,
+                                             t1.etime (t0) / 1000, t2.etime (t1) / 1000, t3.etime (t2) / 1000, t3.etime (t0) / 1000), false);
+        return true;
+    }
+
+    const std::vector<ManifestJob>& jobs;
+    const int threadsPerImage;
+    const bool overwriteFiles;
+    const bool copyParamsFile;
+
+    Glib::Threads::Mutex mutex;
+    size_t next;
+    size_t done;
+    unsigned int errors;
+};
+
+void printUsage (const char* argv0)
+{
+    const Glib::ustring name = Glib::path_get_basename (argv0);
+    const Glib::ustring pparamsExt = paramFileExtension.substr (1);
+
+    std::cout << "  Headless batch converter of RawTherapee." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Usage:" << std::endl;
+    std::cout << "  " << name << " [-t <threads>] [-w <workers>] [-O] [-Y] [-P <profile>] -m <manifest>" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -m <manifest>    Process the jobs listed in the manifest file, one per line:" << std::endl;
+    std::cout << "                   <input>|<" << pparamsExt << " file>|<output format>|<output file>" << std::endl;
+    std::cout << "                   Empty lines and lines starting with # are ignored." << std::endl;
+    std::cout << "                   If the " << pparamsExt << " file is empty, the sidecar file of the input is used if present," << std::endl;
+    std::cout << "                   neutral values otherwise." << std::endl;
+    std::cout << "                   The output format uses the syntax of the rawtherapee switches without the dash," << std::endl;
+    std::cout << "                   e.g. \"j90 js3\", \"t b16\", \"tz\" or \"n b8\". JPEG quality 92 is used if empty." << std::endl;
+    std::cout << "                   If the output file is empty, the image is saved alongside the input." << std::endl;
+    std::cout << "  -t <threads>     Total number of threads to use (default: number of processors)." << std::endl;
+    std::cout << "  -w <workers>     Number of images processed concurrently (default: threads / 4)." << std::endl;
+    std::cout << "                   The threads are split evenly between the workers." << std::endl;
+    std::cout << "  -O               Copy the " << pparamsExt << " file alongside the output file." << std::endl;
+    std::cout << "  -Y               Overwrite output if present." << std::endl;
+    std::cout << "  -P <profile>     Profile the processing stages and write them to the given file at exit," << std::endl;
+    std::cout << "                   as Chrome trace if its extension is .json, as CSV otherwise." << std::endl;
+}
+
+}
+
+int main (int argc, char **argv)
+{
+    setlocale (LC_ALL, "");
+    setlocale (LC_NUMERIC, "C"); // to set decimal point to "."
+
+    Glib::init ();
+    Gio::init ();
+
+#ifdef BUILD_BUNDLE
+    char exname[512] = {0};
+    Glib::ustring exePath;
+    // get the path where the rawtherapee executable is stored
+#ifdef WIN32
+    WCHAR exnameU[512] = {0};
+    GetModuleFileNameW (NULL, exnameU, 512);
+    WideCharToMultiByte (CP_UTF8, 0, exnameU, -1, exname, 512, 0, 0 );
+#else
+
+    if (readlink ("/proc/self/exe", exname, 512) < 0) {
+        strncpy (exname, argv[0], 512);
+    }
+
+#endif
+    exePath = Glib::path_get_dirname (exname);
+
+    // set paths
+    if (Glib::path_is_absolute (DATA_SEARCH_PATH)) {
+        argv0 = DATA_SEARCH_PATH;
+    } else {
+        argv0 = Glib::build_filename (exePath, DATA_SEARCH_PATH);
+    }
+
+#else
+    argv0 = DATA_SEARCH_PATH;
+#endif
+
+    simpleEditor = false;
+
+    Glib::ustring manifest;
+    Glib::ustring profileFile;
+    int threads = g_get_num_processors ();
+    int workers = 0;
+    bool overwriteFiles = false;
+    bool copyParamsFile = false;
+
+    for (int iArg = 1; iArg < argc; iArg++) {
+        if (!strcmp (argv[iArg], "-m") && iArg + 1 < argc) {
+            manifest = fname_to_utf8 (argv[++iArg]);
+        } else if (!strcmp (argv[iArg], "-t") && iArg + 1 < argc) {
+            threads = atoi (argv[++iArg]);
+        } else if (!strcmp (argv[iArg], "-w") && iArg + 1 < argc) {
+            workers = atoi (argv[++iArg]);
+        } else if (!strcmp (argv[iArg], "-O")) {
+            copyParamsFile = true;
+        } else if (!strcmp (argv[iArg], "-Y")) {
+            overwriteFiles = true;
+        } else if (!strcmp (argv[iArg], "-P") && iArg + 1 < argc) {
+            profileFile = fname_to_utf8 (argv[++iArg]);
+        } else {
+            printUsage (argv[0]);
+            return -1;
+        }
+    }
+
+    if (manifest.empty () || threads < 1 || workers < 0) {
+        printUsage (argv[0]);
+        return -1;
+    }
+
+    if (!Options::load ()) {
+        std::cerr << "Fatal error!\nThe RT_SETTINGS and/or RT_PATH environment variables are set, but use a relative path. The path must be absolute!" << std::endl;
+        return -2;
+    }
+
+    if (!profileFile.empty ()) {
+        options.rtSettings.profileFile = profileFile;
+    }
+
+    if (!options.rtSettings.verbose) {
+        TIFFSetWarningHandler (nullptr);
+    }
+
+    std::cout << "RawTherapee, version " << RTVERSION << std::endl;
+
+    std::vector<ManifestJob> jobs;
+
+    if (!loadManifest (manifest, jobs)) {
+        return -3;
+    }
+
+    if (jobs.empty ()) {
+        return 0;
+    }
+
+    // Each image is processed with OpenMP as well, so by default only one image is started per 4 threads
+    if (workers == 0) {
+        workers = std::max (1, threads / 4);
+    }
+
+    workers = std::min<int> (workers, std::min<int> (threads, jobs.size ()));
+    const int threadsPerImage = std::max (1, threads / workers);
+
+    std::cout << "Processing " << jobs.size () << " images with " << workers << " workers of " << threadsPerImage << " threads" << std::endl;
+
+    MyTime t0, t1;
+    t0.set ();
+
+    JobRunner runner (jobs, threadsPerImage, overwriteFiles, copyParamsFile);
+    runner.run (workers);
+
+    t1.set ();
+
+    std::cout << "Processed " << jobs.size () - runner.getErrors () << " of " << jobs.size () << " images in " << t1.etime (t0) / 1000 << " ms" << std::endl;
+
+    rtengine::cleanup ();
+
+    return runner.getErrors () ? -2 : 0;
+}
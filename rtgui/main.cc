@@ -38,6 +38,7 @@
 #include "version.h"
 #include "extprog.h"
 #include "dynamicprofile.h"
+#include "profilestore.h"
 
 #ifndef WIN32
 #include <glibmm/fileutils.h>
@@ -176,6 +177,7 @@ int main(int argc, char **argv)
         return -2;
     }
 
+    profileStore.init ();
     extProgStore->init();
     SoundManager::init();
 
@@ -22,7 +22,7 @@
 #include <sstream>
 #include "multilangmgr.h"
 #include "addsetids.h"
-#include "guiutils.h"
+#include "pathutils.h"
 #include "version.h"
 
 #ifdef _OPENMP
@@ -381,7 +381,8 @@ void Options::setDefaults ()
     overwriteOutputFile = false;        // if TRUE, existing output JPGs/PNGs are overwritten, instead of adding ..-1.jpg, -2.jpg etc.
     theme = "RawTherapee";
     maxThumbnailHeight = 250;
-    maxCacheEntries = 20000;
+    maxCacheSize = 1024;
+    thumbnailCacheCompression = 1;
     thumbInterp = 1;
     autoSuffix = true;
     forceFormatOpts = true;
@@ -413,6 +414,7 @@ void Options::setDefaults ()
     overlayedFileNames = false;
     filmStripOverlayedFileNames = false;
     internalThumbIfUntouched = true;    // if TRUE, only fast, internal preview images are taken if the image is not edited yet
+    thumbnailEmbeddedFirst = true;      // if TRUE, the internal preview image of a new raw is shown until its processed thumbnail is ready
     showFileNames = true;
     filmStripShowFileNames = false;
     tabbedUI = false;
@@ -433,6 +435,7 @@ void Options::setDefaults ()
     filledProfile = false;
     maxInspectorBuffers = 2; //  a rather conservative value for low specced systems...
     serializeTiffRead = true;
+    batchPipelineDepth = 3;
 
     FileBrowserToolbarSingleRow = false;
     hideTPVScrollbar = false;
@@ -613,6 +616,7 @@ void Options::setDefaults ()
 
     rtSettings.darkFramesPath = "";
     rtSettings.flatFieldsPath = "";
+    rtSettings.masterFrameStacking = 0;
 #ifdef WIN32
     const gchar* sysRoot = g_getenv ("SystemRoot"); // Returns e.g. "c:\Windows"
 
@@ -690,6 +694,14 @@ void Options::setDefaults ()
 //rtSettings.decaction =0.3;
 //  rtSettings.ciebadpixgauss=false;
     rtSettings.rgbcurveslumamode_gamut = true;
+    rtSettings.processingMemoryBudget = 0;
+    rtSettings.profileFile = "";
+    rtSettings.simdLevel = 0;
+    rtSettings.demosaicCacheSize = 0;
+    rtSettings.fftwWisdom = true;
+    rtSettings.masterFrameCache = true;
+    rtSettings.flatFieldMapsOnDisk = false;
+    rtSettings.dcpBakedLuts = true;
     lastIccDir = rtSettings.iccDirectory;
     lastDarkframeDir = rtSettings.darkFramesPath;
     lastFlatfieldDir = rtSettings.flatFieldsPath;
@@ -809,6 +821,10 @@ int Options::readFromFile (Glib::ustring fname)
                     rtSettings.flatFieldsPath = keyFile.get_string ("General", "FlatFieldsPath");
                 }
 
+                if ( keyFile.has_key ("General", "MasterFrameStacking")) {
+                    rtSettings.masterFrameStacking = rtengine::LIM (keyFile.get_integer ("General", "MasterFrameStacking"), 0, 2);
+                }
+
                 if ( keyFile.has_key ("General", "Verbose")) {
                     rtSettings.verbose = keyFile.get_boolean ( "General", "Verbose");
                 }
@@ -1068,8 +1084,12 @@ int Options::readFromFile (Glib::ustring fname)
                     maxThumbnailHeight = keyFile.get_integer ("File Browser", "MaxPreviewHeight");
                 }
 
-                if (keyFile.has_key ("File Browser", "MaxCacheEntries")) {
-                    maxCacheEntries    = keyFile.get_integer ("File Browser", "MaxCacheEntries");
+                if (keyFile.has_key ("File Browser", "MaxCacheSize")) {
+                    maxCacheSize       = keyFile.get_integer ("File Browser", "MaxCacheSize");
+                }
+
+                if (keyFile.has_key ("File Browser", "ThumbnailCacheCompression")) {
+                    thumbnailCacheCompression = rtengine::LIM (keyFile.get_integer ("File Browser", "ThumbnailCacheCompression"), 0, 2);
                 }
 
                 if (keyFile.has_key ("File Browser", "ParseExtensions")) {
@@ -1124,6 +1144,10 @@ int Options::readFromFile (Glib::ustring fname)
                     internalThumbIfUntouched    = keyFile.get_boolean ("File Browser", "InternalThumbIfUntouched");
                 }
 
+                if (keyFile.has_key ("File Browser", "ThumbnailEmbeddedFirst")) {
+                    thumbnailEmbeddedFirst      = keyFile.get_boolean ("File Browser", "ThumbnailEmbeddedFirst");
+                }
+
                 if (keyFile.has_key ("File Browser", "menuGroupRank")) {
                     menuGroupRank               = keyFile.get_boolean ("File Browser", "menuGroupRank");
                 }
@@ -1233,6 +1257,42 @@ int Options::readFromFile (Glib::ustring fname)
                 if (keyFile.has_key ("Performance", "SerializeTiffRead")) {
                     serializeTiffRead          = keyFile.get_boolean ("Performance", "SerializeTiffRead");
                 }
+
+                if (keyFile.has_key ("Performance", "ProcessingMemoryBudget")) {
+                    rtSettings.processingMemoryBudget = keyFile.get_integer ("Performance", "ProcessingMemoryBudget");
+                }
+
+                if (keyFile.has_key ("Performance", "ProfileFile")) {
+                    rtSettings.profileFile     = keyFile.get_string ("Performance", "ProfileFile");
+                }
+
+                if (keyFile.has_key ("Performance", "SimdLevel")) {
+                    rtSettings.simdLevel       = rtengine::LIM (keyFile.get_integer ("Performance", "SimdLevel"), 0, 3);
+                }
+
+                if (keyFile.has_key ("Performance", "DemosaicCacheSize")) {
+                    rtSettings.demosaicCacheSize = rtengine::max (keyFile.get_integer ("Performance", "DemosaicCacheSize"), 0);
+                }
+
+                if (keyFile.has_key ("Performance", "FftwWisdom")) {
+                    rtSettings.fftwWisdom      = keyFile.get_boolean ("Performance", "FftwWisdom");
+                }
+
+                if (keyFile.has_key ("Performance", "MasterFrameCache")) {
+                    rtSettings.masterFrameCache = keyFile.get_boolean ("Performance", "MasterFrameCache");
+                }
+
+                if (keyFile.has_key ("Performance", "FlatFieldMapsOnDisk")) {
+                    rtSettings.flatFieldMapsOnDisk = keyFile.get_boolean ("Performance", "FlatFieldMapsOnDisk");
+                }
+
+                if (keyFile.has_key ("Performance", "DCPBakedLuts")) {
+                    rtSettings.dcpBakedLuts = keyFile.get_boolean ("Performance", "DCPBakedLuts");
+                }
+
+                if (keyFile.has_key ("Performance", "BatchPipelineDepth")) {
+                    batchPipelineDepth         = rtengine::LIM (keyFile.get_integer ("Performance", "BatchPipelineDepth"), 1, 3);
+                }
             }
 
             if (keyFile.has_group ("GUI")) {
@@ -1873,6 +1933,7 @@ int Options::saveToFile (Glib::ustring fname)
         keyFile.set_string  ("General", "Version", RTVERSION);
         keyFile.set_string  ("General", "DarkFramesPath", rtSettings.darkFramesPath);
         keyFile.set_string  ("General", "FlatFieldsPath", rtSettings.flatFieldsPath);
+        keyFile.set_integer ("General", "MasterFrameStacking", rtSettings.masterFrameStacking);
         keyFile.set_boolean ("General", "Verbose", rtSettings.verbose);
         keyFile.set_double ("General", "BotLeft", rtSettings.bot_left);
         keyFile.set_double ("General", "TopLeft", rtSettings.top_left);
@@ -1900,7 +1961,8 @@ int Options::saveToFile (Glib::ustring fname)
         keyFile.set_integer ("File Browser", "ThumbnailSizeQueue", thumbSizeQueue);
         keyFile.set_integer ("File Browser", "SameThumbSize", sameThumbSize);
         keyFile.set_integer ("File Browser", "MaxPreviewHeight", maxThumbnailHeight);
-        keyFile.set_integer ("File Browser", "MaxCacheEntries", maxCacheEntries);
+        keyFile.set_integer ("File Browser", "MaxCacheSize", maxCacheSize);
+        keyFile.set_integer ("File Browser", "ThumbnailCacheCompression", thumbnailCacheCompression);
         Glib::ArrayHandle<Glib::ustring> pext = parseExtensions;
         keyFile.set_string_list ("File Browser", "ParseExtensions", pext);
         Glib::ArrayHandle<int> pextena = parseExtensionsEnabled;
@@ -1919,6 +1981,7 @@ int Options::saveToFile (Glib::ustring fname)
         keyFile.set_boolean ("File Browser", "ShowFileNames", showFileNames );
         keyFile.set_boolean ("File Browser", "FilmStripShowFileNames", filmStripShowFileNames );
         keyFile.set_boolean ("File Browser", "InternalThumbIfUntouched", internalThumbIfUntouched );
+        keyFile.set_boolean ("File Browser", "ThumbnailEmbeddedFirst", thumbnailEmbeddedFirst );
         keyFile.set_boolean ("File Browser", "menuGroupRank", menuGroupRank);
         keyFile.set_boolean ("File Browser", "menuGroupLabel", menuGroupLabel);
         keyFile.set_boolean ("File Browser", "menuGroupFileOperations", menuGroupFileOperations);
@@ -1954,6 +2017,15 @@ int Options::saveToFile (Glib::ustring fname)
         keyFile.set_integer ("Performance", "PreviewDemosaicFromSidecar", prevdemo);
         keyFile.set_boolean ("Performance", "Daubechies", rtSettings.daubech);
         keyFile.set_boolean ("Performance", "SerializeTiffRead", serializeTiffRead);
+        keyFile.set_integer ("Performance", "ProcessingMemoryBudget", rtSettings.processingMemoryBudget);
+        keyFile.set_integer ("Performance", "BatchPipelineDepth", batchPipelineDepth);
+        keyFile.set_string  ("Performance", "ProfileFile", rtSettings.profileFile);
+        keyFile.set_integer ("Performance", "SimdLevel", rtSettings.simdLevel);
+        keyFile.set_integer ("Performance", "DemosaicCacheSize", rtSettings.demosaicCacheSize);
+        keyFile.set_boolean ("Performance", "FftwWisdom", rtSettings.fftwWisdom);
+        keyFile.set_boolean ("Performance", "MasterFrameCache", rtSettings.masterFrameCache);
+        keyFile.set_boolean ("Performance", "FlatFieldMapsOnDisk", rtSettings.flatFieldMapsOnDisk);
+        keyFile.set_boolean ("Performance", "DCPBakedLuts", rtSettings.dcpBakedLuts);
 
         keyFile.set_string  ("Output", "Format", saveFormat.format);
         keyFile.set_integer ("Output", "JpegQuality", saveFormat.jpegQuality);
@@ -2263,6 +2335,11 @@ bool Options::load ()
         printf ("Cache directory (cacheBaseDir) = %s\n", cacheBaseDir.c_str());
     }
 
+    options.rtSettings.demosaicCacheDir = Glib::build_filename (cacheBaseDir, "demosaic");
+    options.rtSettings.masterFrameCacheDir = Glib::build_filename (cacheBaseDir, "masters");
+    // the wisdom depends on the machine, it isn't shared with the settings of the other ones
+    options.rtSettings.fftwWisdomFile = Glib::build_filename (rtdir, "fftw_wisdom");
+
     // Update profile's path and recreate it if necessary
     options.updatePaths();
 
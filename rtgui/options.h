@@ -192,7 +192,8 @@ public:
     CPBKeyType CPBKeys; // Custom Profile Builder's key type
     int editorToSendTo;
     int maxThumbnailHeight;
-    std::size_t maxCacheEntries;
+    int maxCacheSize;           // of the thumbnail cache pack, in MiB
+    int thumbnailCacheCompression; // of the cached thumbnail images, 0: none, 1: lossless, 2: lossy
     int thumbInterp; // 0: nearest, 1: bilinear
     std::vector<Glib::ustring> parseExtensions;   // List containing all extensions type
     std::vector<int> parseExtensionsEnabled;      // List of bool to retain extension or not
@@ -206,6 +207,7 @@ public:
     std::vector<Glib::ustring> renameTemplates;
     bool renameUseTemplates;
     bool internalThumbIfUntouched;
+    bool thumbnailEmbeddedFirst;
     bool overwriteOutputFile;
 
     std::vector<double> thumbnailZoomRatios;
@@ -245,6 +247,7 @@ public:
     bool filledProfile;  // Used as reminder for the ProfilePanel "mode"
     prevdemo_t prevdemo; // Demosaicing method used for the <100% preview
     bool serializeTiffRead;
+    int batchPipelineDepth;    // 1 = process the queue sequentially, 2 = also load the next image while processing, 3 = also save in the background
 
     bool menuGroupRank;
     bool menuGroupLabel;
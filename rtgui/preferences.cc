@@ -1370,16 +1370,26 @@ Gtk::Widget* Preferences::getFileBrowserPanel ()
     vbc->pack_start (*hb3, Gtk::PACK_SHRINK, 4);
 
     Gtk::HBox* hb4 = Gtk::manage( new Gtk::HBox () );
-    Gtk::Label* celab = Gtk::manage( new Gtk::Label (M("PREFERENCES_CACHEMAXENTRIES") + ":") );
-    maxCacheEntries = Gtk::manage( new Gtk::SpinButton () );
+    Gtk::Label* celab = Gtk::manage( new Gtk::Label (M("PREFERENCES_CACHEMAXSIZE") + ":") );
+    maxCacheSize = Gtk::manage( new Gtk::SpinButton () );
     hb4->pack_start (*celab, Gtk::PACK_SHRINK, 4);
-    hb4->pack_start (*maxCacheEntries, Gtk::PACK_SHRINK, 4);
+    hb4->pack_start (*maxCacheSize, Gtk::PACK_SHRINK, 4);
 
-    maxCacheEntries->set_digits (0);
-    maxCacheEntries->set_increments (1, 10);
-    maxCacheEntries->set_range (10, 100000);
+    maxCacheSize->set_digits (0);
+    maxCacheSize->set_increments (16, 256);
+    maxCacheSize->set_range (16, 65536);
     vbc->pack_start (*hb4, Gtk::PACK_SHRINK, 4);
 
+    Gtk::HBox* hb41 = Gtk::manage( new Gtk::HBox () );
+    Gtk::Label* cclab = Gtk::manage( new Gtk::Label (M("PREFERENCES_CACHECOMPRESSION") + ":") );
+    thumbnailCacheCompression = Gtk::manage( new Gtk::ComboBoxText () );
+    thumbnailCacheCompression->append (M("PREFERENCES_CACHECOMPRESSION_NONE"));
+    thumbnailCacheCompression->append (M("PREFERENCES_CACHECOMPRESSION_LOSSLESS"));
+    thumbnailCacheCompression->append (M("PREFERENCES_CACHECOMPRESSION_LOSSY"));
+    hb41->pack_start (*cclab, Gtk::PACK_SHRINK, 4);
+    hb41->pack_start (*thumbnailCacheCompression, Gtk::PACK_SHRINK, 4);
+    vbc->pack_start (*hb41, Gtk::PACK_SHRINK, 4);
+
     Gtk::HBox* hb5 = Gtk::manage( new Gtk::HBox () );
     clearThumbnails = Gtk::manage( new Gtk::Button (M("PREFERENCES_CACHECLEARTHUMBS")) );
     clearProfiles = Gtk::manage( new Gtk::Button (M("PREFERENCES_CACHECLEARPROFILES")) );
@@ -1721,7 +1731,8 @@ void Preferences::storePreferences ()
 
     moptions.maxRecentFolders = (int)maxRecentFolders->get_value();
     moptions.maxThumbnailHeight = (int)maxThumbSize->get_value ();
-    moptions.maxCacheEntries = (int)maxCacheEntries->get_value ();
+    moptions.maxCacheSize = (int)maxCacheSize->get_value ();
+    moptions.thumbnailCacheCompression = thumbnailCacheCompression->get_active_row_number ();
     moptions.overlayedFileNames = overlayedFileNames->get_active ();
     moptions.filmStripOverlayedFileNames = filmStripOverlayedFileNames->get_active();
     moptions.sameThumbSize = sameThumbSize->get_active();
@@ -1939,7 +1950,8 @@ void Preferences::fillPreferences ()
 
     maxThumbSize->set_value (moptions.maxThumbnailHeight);
     maxRecentFolders->set_value(moptions.maxRecentFolders);
-    maxCacheEntries->set_value (moptions.maxCacheEntries);
+    maxCacheSize->set_value (moptions.maxCacheSize);
+    thumbnailCacheCompression->set_active (moptions.thumbnailCacheCompression);
     overlayedFileNames->set_active (moptions.overlayedFileNames);
     filmStripOverlayedFileNames->set_active(moptions.filmStripOverlayedFileNames);
     sameThumbSize->set_active(moptions.sameThumbSize);
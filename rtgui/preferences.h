@@ -148,7 +148,8 @@ class Preferences : public Gtk::Dialog, public ProfileStoreListener
     Gtk::ColorButton* butNavGuideCol;
 
     Gtk::SpinButton*   maxThumbSize;
-    Gtk::SpinButton*   maxCacheEntries;
+    Gtk::SpinButton*   maxCacheSize;
+    Gtk::ComboBoxText* thumbnailCacheCompression;
     Gtk::SpinButton*   maxRecentFolders;
     Gtk::Button*       clearThumbnails;
     Gtk::Button*       clearProfiles;
@@ -118,7 +118,10 @@ int delImageUI (void* data)
         return 0;
     }
 
-    if (pih->phandler->image) {
+    // the image may have been replaced already, then the preview is the one of the new image and it stays
+    const bool current = pih->phandler->image == iap->image;
+
+    if (current) {
         IImage8* oldImg = pih->phandler->image;
         oldImg->getMutex().lock ();
         pih->phandler->image = nullptr;
@@ -126,9 +129,12 @@ int delImageUI (void* data)
     }
 
     iap->image->free ();
-    pih->phandler->previewImgMutex.lock ();
-    pih->phandler->previewImg.clear ();
-    pih->phandler->previewImgMutex.unlock ();
+
+    if (current) {
+        pih->phandler->previewImgMutex.lock ();
+        pih->phandler->previewImg.clear ();
+        pih->phandler->previewImgMutex.unlock ();
+    }
 
     pih->pending--;
     delete iap;
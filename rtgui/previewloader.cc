@@ -34,20 +34,34 @@ class PreviewLoader::Impl :
 {
 public:
     struct Job {
-        Job(int dir_id, const Glib::ustring& dir_entry, PreviewLoaderListener* listener):
+        Job(int dir_id, const Glib::ustring& dir_entry, PreviewLoaderListener* listener, int generation):
             dir_id_(dir_id),
             dir_entry_(dir_entry),
-            listener_(listener)
+            sort_key_(Glib::path_get_basename(dir_entry).casefold()),
+            priority_(PRIORITY_VISIBLE),
+            listener_(listener),
+            generation_(generation)
         {}
 
         Job():
             dir_id_(0),
-            listener_(nullptr)
+            priority_(PRIORITY_VISIBLE),
+            listener_(nullptr),
+            generation_(0)
         {}
 
         int dir_id_;
         Glib::ustring dir_entry_;
+        Glib::ustring sort_key_;    // same order as the file browser
+        int priority_;
         PreviewLoaderListener* listener_;
+        int generation_;
+    };
+
+    enum Priority {
+        PRIORITY_VISIBLE,
+        PRIORITY_NEAR_VISIBLE,
+        PRIORITY_HIDDEN
     };
     /* Issue 2406
         struct OutputJob
@@ -61,17 +75,25 @@ public:
     struct JobCompare {
         bool operator()(const Job& lhs, const Job& rhs)
         {
-            if ( lhs.dir_id_ == rhs.dir_id_ ) {
-                return lhs.dir_entry_ < rhs.dir_entry_;
+            if ( lhs.priority_ != rhs.priority_ ) {
+                return lhs.priority_ < rhs.priority_;
+            }
+
+            if ( lhs.dir_id_ != rhs.dir_id_ ) {
+                return lhs.dir_id_ < rhs.dir_id_;
             }
 
-            return lhs.dir_id_ < rhs.dir_id_;
+            if ( lhs.sort_key_ != rhs.sort_key_ ) {
+                return lhs.sort_key_ < rhs.sort_key_;
+            }
+
+            return lhs.dir_entry_ < rhs.dir_entry_;
         }
     };
 
     typedef std::set<Job, JobCompare> JobSet;
 
-    Impl(): nConcurrentThreads(0)
+    Impl(): nConcurrentThreads(0), generation_(0), rangeDirId_(-1)
     {
 #ifdef _OPENMP
         int threadCount = omp_get_num_procs();
@@ -86,8 +108,39 @@ public:
     MyMutex mutex_;
     JobSet jobs_;
     gint nConcurrentThreads;
+    int generation_;            // incremented when the jobs are removed, so that the running ones are dropped
+    int rangeDirId_;
+    ThumbBrowserBase::VisibleRange range_;
 // Issue 2406   std::vector<OutputJob *> output_;
 
+    static bool inRange(const Glib::ustring& key, const Glib::ustring& first, const Glib::ustring& last)
+    {
+        return (first.empty() || first <= key) && (last.empty() || key <= last);
+    }
+
+    int getPriority(const Job& job) const
+    {
+        if ( job.dir_id_ != rangeDirId_ ) {
+            return rangeDirId_ == -1 ? PRIORITY_VISIBLE : PRIORITY_HIDDEN;
+        }
+
+        if ( inRange(job.sort_key_, range_.first, range_.last) ) {
+            return PRIORITY_VISIBLE;
+        }
+
+        if ( inRange(job.sort_key_, range_.nearFirst, range_.nearLast) ) {
+            return PRIORITY_NEAR_VISIBLE;
+        }
+
+        return PRIORITY_HIDDEN;
+    }
+
+    bool isCancelled(const Job& job)
+    {
+        MyMutex::MyLock lock(mutex_);
+        return job.generation_ != generation_;
+    }
+
     void processNextJob()
     {
         Job j;
@@ -129,7 +182,11 @@ public:
                 }
             }
 
-            if ( tmb ) {
+            if ( tmb && isCancelled(j) ) {
+                // the jobs were removed meanwhile, e.g. another directory was selected
+                DEBUG("Preview dropped");
+                tmb->decreaseRef();
+            } else if ( tmb ) {
                 DEBUG("Preview Ready\n");
                 j.listener_->previewReady(j.dir_id_, new FileBrowserEntry(tmb, j.dir_entry_));
 // Issue 2406               fdn = new FileBrowserEntry(tmb,j.dir_entry_);
@@ -183,7 +240,9 @@ void PreviewLoader::add(int dir_id, const Glib::ustring& dir_entry, PreviewLoade
 
             // create a new job and append to queue
             DEBUG("saving job %s", dir_entry.c_str());
-            impl_->jobs_.insert(Impl::Job(dir_id, dir_entry, l));
+            Impl::Job job(dir_id, dir_entry, l, impl_->generation_);
+            job.priority_ = impl_->getPriority(job);
+            impl_->jobs_.insert(job);
         }
 
         // queue a run request
@@ -192,11 +251,32 @@ void PreviewLoader::add(int dir_id, const Glib::ustring& dir_entry, PreviewLoade
     }
 }
 
+void PreviewLoader::setVisibleRange(int dir_id, const ThumbBrowserBase::VisibleRange& range)
+{
+    MyMutex::MyLock lock(impl_->mutex_);
+
+    impl_->rangeDirId_ = dir_id;
+    impl_->range_ = range;
+
+    // reorder the pending jobs
+    Impl::JobSet jobs;
+
+    for (Impl::Job job : impl_->jobs_) {
+        job.priority_ = impl_->getPriority(job);
+        jobs.insert(job);
+    }
+
+    impl_->jobs_.swap(jobs);
+}
+
 void PreviewLoader::removeAllJobs()
 {
     DEBUG("stop %d", impl_->nConcurrentThreads);
     MyMutex::MyLock lock(impl_->mutex_);
     impl_->jobs_.clear();
+    ++impl_->generation_;
+    impl_->rangeDirId_ = -1;
+    impl_->range_ = ThumbBrowserBase::VisibleRange();
 }
 
 
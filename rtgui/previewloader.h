@@ -25,6 +25,7 @@
 #include "../rtengine/noncopyable.h"
 
 #include "filebrowserentry.h"
+#include "thumbbrowserbase.h"
 
 class PreviewLoaderListener
 {
@@ -76,10 +77,22 @@ public:
      */
     void add(int dir_id, const Glib::ustring& dir_entry, PreviewLoaderListener* l);
 
+    /**
+     * @brief Set the range of the entries shown by the file browser.
+     *
+     * The pending jobs of the directory are reordered: the ones of the entries which would be
+     * visible are run first, then the ones of the entries near the visible area, then the others.
+     * Within a priority, the jobs are run in the order of the browser.
+     *
+     * @param dir_id directory shown by the browser
+     * @param range visible range, see ThumbBrowserBase::VisibleRange
+     */
+    void setVisibleRange(int dir_id, const ThumbBrowserBase::VisibleRange& range);
+
     /**
      * @brief Stop processing and remove all jobs.
      *
-     * Will not return till all jobs have completed.
+     * The previews of the running jobs are dropped instead of being delivered to the listener.
      *
      * @note expects to be called inside gtk thread lock
      */
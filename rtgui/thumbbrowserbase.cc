@@ -855,18 +855,73 @@ bool ThumbBrowserBase::Internal::on_draw(const ::Cairo::RefPtr< Cairo::Context>
     Glib::RefPtr<Pango::Context> context = get_pango_context ();
     context->set_font_description (style->get_font());
 
+    VisibleRange range;
+
     {
         MYWRITERLOCK(l, parent->entryRW);
 
+        const ThumbBrowserEntryBase* firstDrawable = nullptr;
+        const ThumbBrowserEntryBase* lastDrawable = nullptr;
+        const ThumbBrowserEntryBase* firstVisible = nullptr;
+        const ThumbBrowserEntryBase* lastVisible = nullptr;
+        const ThumbBrowserEntryBase* firstNear = nullptr;
+        const ThumbBrowserEntryBase* lastNear = nullptr;
+
         for (size_t i = 0; i < parent->fd.size() && !dirty; i++) { // if dirty meanwhile, cancel and wait for next redraw
-            if (!parent->fd[i]->drawable || !parent->fd[i]->insideWindow (0, 0, w, h)) {
-                parent->fd[i]->updatepriority = false;
+            ThumbBrowserEntryBase* const entry = parent->fd[i];
+
+            if (!entry->drawable) {
+                entry->updatepriority = ThumbBrowserEntryBase::UPDATE_HIDDEN;
+                continue;
+            }
+
+            if (!firstDrawable) {
+                firstDrawable = entry;
+            }
+
+            lastDrawable = entry;
+
+            if (entry->insideWindow (0, 0, w, h)) {
+                entry->updatepriority = ThumbBrowserEntryBase::UPDATE_VISIBLE;
+                entry->draw (cr);
+
+                if (!firstVisible) {
+                    firstVisible = entry;
+                }
+
+                lastVisible = entry;
+            } else if (parent->arrangement == TB_Horizontal ? entry->insideWindow (-w, 0, 3 * w, h) : entry->insideWindow (0, -h, w, 3 * h)) {
+                entry->updatepriority = ThumbBrowserEntryBase::UPDATE_NEAR_VISIBLE;
             } else {
-                parent->fd[i]->updatepriority = true;
-                parent->fd[i]->draw (cr);
+                entry->updatepriority = ThumbBrowserEntryBase::UPDATE_HIDDEN;
+                continue;
+            }
+
+            if (!firstNear) {
+                firstNear = entry;
             }
+
+            lastNear = entry;
+        }
+
+        // the range is open on the sides where the browser isn't filled
+        const auto getKey = [] (const ThumbBrowserEntryBase* entry, const ThumbBrowserEntryBase* end) {
+            return !entry || entry == end ? Glib::ustring() : entry->shortname.casefold();
+        };
+
+        if (firstVisible) {
+            range.first = getKey (firstVisible, firstDrawable);
+            range.last = getKey (lastVisible, lastDrawable);
+            range.nearFirst = getKey (firstNear, firstDrawable);
+            range.nearLast = getKey (lastNear, lastDrawable);
         }
     }
+
+    if (!dirty && range != parent->visibleRange) {
+        parent->visibleRange = range;
+        parent->visibleRangeChanged (range);
+    }
+
     style->render_frame(cr, 0., 0., w, h);
 
     return true;
@@ -136,6 +136,22 @@ public:
     void disableInspector();
     void enableInspector();
     enum Arrangement {TB_Horizontal, TB_Vertical};
+
+    /** Sort keys, i.e. casefolded short names, of the first and last visible entries and of the first and last
+      * entries within a page of the visible area. An empty key leaves the range open on its side: the entries
+      * which would be added there would be visible too. */
+    struct VisibleRange {
+        Glib::ustring first;
+        Glib::ustring last;
+        Glib::ustring nearFirst;
+        Glib::ustring nearLast;
+
+        bool operator != (const VisibleRange& other) const
+        {
+            return first != other.first || last != other.last || nearFirst != other.nearFirst || nearLast != other.nearLast;
+        }
+    };
+
     void configScrollBars ();
     void scrollChanged ();
     void scroll (int direction);
@@ -176,6 +192,8 @@ protected:
 
     Arrangement arrangement;
 
+    VisibleRange visibleRange;  // as of the last draw
+
     std::set<Glib::ustring> editedFiles;
 
     void arrangeFiles ();
@@ -227,6 +245,7 @@ public:
 
     virtual void redrawNeeded (ThumbBrowserEntryBase* entry);
     virtual void thumbRearrangementNeeded () {}
+    virtual void visibleRangeChanged (const VisibleRange& range) {}
 
     Gtk::Widget* getDrawingArea ()
     {
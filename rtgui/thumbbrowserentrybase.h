@@ -37,6 +37,13 @@ public:
         WFNAME_FULL
     };
 
+    // order in which the thumbnail images are updated, see ThumbImageUpdater
+    enum eUpdatePriority {
+        UPDATE_VISIBLE,
+        UPDATE_NEAR_VISIBLE,    // within a page of the visible area
+        UPDATE_HIDDEN
+    };
+
 protected:
     int fnlabw, fnlabh; // dimensions of the filename label
     int dtlabw, dtlabh; // dimensions of the date/time label
@@ -107,7 +114,7 @@ public:
     bool italicstyle;
     bool edited;
     bool recentlysaved;
-    bool updatepriority;
+    int updatepriority;
     eWithFilename withFilename;
 
     explicit ThumbBrowserEntryBase   (const Glib::ustring& fname);
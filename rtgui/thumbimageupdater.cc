@@ -17,6 +17,7 @@
  *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <iterator>
 #include <set>
 #include "thumbimageupdater.h"
 #include <gtkmm.h>
@@ -36,7 +37,7 @@ class ThumbImageUpdater::Impl :
 public:
 
     struct Job {
-        Job(ThumbBrowserEntryBase* tbe, bool* priority, bool upgrade,
+        Job(ThumbBrowserEntryBase* tbe, int* priority, bool upgrade,
             ThumbImageUpdateListener* listener):
             tbe_(tbe),
     /*pparams_(pparams),
@@ -56,7 +57,7 @@ public:
         ThumbBrowserEntryBase* tbe_;
         /*rtengine::procparams::ProcParams pparams_;
         int height_;*/
-        bool* priority_;
+        int* priority_;
         bool upgrade_;
         ThumbImageUpdateListener* listener_;
     };
@@ -106,31 +107,17 @@ public:
                 return;
             }
 
-            JobList::iterator i;
+            // run the job of the lowest priority level, the new images before the upgrades of the same level,
+            // the oldest one first; the levels follow the scrolling of the browser
+            JobList::iterator i = jobs_.begin();
 
-            // see if any priority jobs exist
-            for ( i = jobs_.begin(); i != jobs_.end(); ++i) {
-                if ( *(i->priority_) ) {
-                    DEBUG("processing(priority) %s", i->tbe_->thumbnail->getFileName().c_str());
-                    break;
+            for (JobList::iterator k = std::next(jobs_.begin()); k != jobs_.end() && (*(i->priority_) != 0 || i->upgrade_); ++k) {
+                if ( *(k->priority_) < *(i->priority_) || (*(k->priority_) == *(i->priority_) && i->upgrade_ && !k->upgrade_) ) {
+                    i = k;
                 }
             }
 
-            // see if any none upgrade jobs exist
-            if ( i == jobs_.end() ) {
-                for ( i = jobs_.begin(); i != jobs_.end(); ++i) {
-                    if ( !i->upgrade_ ) {
-                        DEBUG("processing(not-upgrade) %s", i->tbe_->thumbnail->getFileName().c_str());
-                        break;
-                    }
-                }
-            }
-
-            // if none, then use first
-            if ( i == jobs_.end() ) {
-                i = jobs_.begin();
-                DEBUG("processing(first) %s", i->tbe_->thumbnail->getFileName().c_str());
-            }
+            DEBUG("processing(%d) %s", *(i->priority_), i->tbe_->thumbnail->getFileName().c_str());
 
             // copy found job
             j = *i;
@@ -185,7 +172,7 @@ ThumbImageUpdater::ThumbImageUpdater():
 }
 
 void
-ThumbImageUpdater::add(ThumbBrowserEntryBase* tbe, bool* priority, bool upgrade, ThumbImageUpdateListener* l)
+ThumbImageUpdater::add(ThumbBrowserEntryBase* tbe, int* priority, bool upgrade, ThumbImageUpdateListener* l)
 {
     // nobody listening?
     if ( l == nullptr ) {
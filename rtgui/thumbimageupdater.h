@@ -68,10 +68,10 @@ public:
      * @param t thumbnail
      * @param params processing params (?)
      * @param height how big
-     * @param priority if \c true then run as soon as possible
+     * @param priority level of the job, read each time a job is picked, the lowest level is run first
      * @param l listener waiting on update
      */
-    void add(ThumbBrowserEntryBase* tbe, bool* priority, bool upgrade, ThumbImageUpdateListener* l);
+    void add(ThumbBrowserEntryBase* tbe, int* priority, bool upgrade, ThumbImageUpdateListener* l);
 
     /**
      * @brief Remove jobs associated with listener \c l.
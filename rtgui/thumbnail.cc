@@ -25,6 +25,7 @@
 #include <cstdlib>
 #include <glibmm.h>
 #include "../rtengine/imagedata.h"
+#include "../rtengine/paramsdigest.h"
 #include <glib/gstdio.h>
 #include "guiutils.h"
 #include "profilestore.h"
@@ -128,10 +129,13 @@ void Thumbnail::_generateThumbnailImage ()
         //  1. if we are here it's because we aren't in the cache so load the JPG
         //     image out of the RAW. Mark as "quick".
         //  2. if we don't find that then just grab the real image.
+        // With thumbnailEmbeddedFirst, the quick thumbnail is also taken when the processed one is wanted, so that
+        // the browser fills up fast; FileBrowserEntry then queues its upgrade at a low priority in ThumbImageUpdater.
+        // The embedded preview is decoded downscaled to about the thumbnail size, see loadQuickFromRaw.
         bool quick = false;
         rtengine::RawMetaDataLocation ri;
 
-        if ( initial_ && options.internalThumbIfUntouched) {
+        if ( initial_ && (options.internalThumbIfUntouched || options.thumbnailEmbeddedFirst)) {
             quick = true;
             tpp = rtengine::Thumbnail::loadQuickFromRaw (fname, ri, tw, th, 1, TRUE);
         }
@@ -154,7 +158,7 @@ void Thumbnail::_generateThumbnailImage ()
         cfs.supported = true;
         needsReProcessing = true;
 
-        cfs.save (getCacheFileName ("data", ".txt"));
+        saveCacheImageData ();
 
         generateExifDateTimeStrings ();
     }
@@ -316,20 +320,20 @@ void Thumbnail::loadProcParams ()
 
     if (options.paramsLoadLocation == PLL_Input) {
         // try to load it from params file next to the image file
-        int ppres = pparams.load (fname + paramFileExtension);
+        int ppres = loadProcParamsFile (fname + paramFileExtension, "sidecar");
         pparamsValid = !ppres && pparams.ppVersion >= 220;
 
         // if no success, try to load the cached version of the procparams
         if (!pparamsValid) {
-            pparamsValid = !pparams.load (getCacheFileName ("profiles", paramFileExtension));
+            pparamsValid = !loadProcParamsFile (getCacheFileName ("profiles", paramFileExtension), "cache");
         }
     } else {
         // try to load it from cache
-        pparamsValid = !pparams.load (getCacheFileName ("profiles", paramFileExtension));
+        pparamsValid = !loadProcParamsFile (getCacheFileName ("profiles", paramFileExtension), "cache");
 
         // if no success, try to load it from params file next to the image file
         if (!pparamsValid) {
-            int ppres = pparams.load (fname + paramFileExtension);
+            int ppres = loadProcParamsFile (fname + paramFileExtension, "sidecar");
             pparamsValid = !ppres && pparams.ppVersion >= 220;
         }
     }
@@ -466,7 +470,7 @@ void Thumbnail::imageDeveloped ()
 {
 
     cfs.recentlySaved = true;
-    cfs.save (getCacheFileName ("data", ".txt"));
+    saveCacheImageData ();
 
     if (options.saveParamsCache) {
         pparams.save (getCacheFileName ("profiles", paramFileExtension));
@@ -766,7 +770,7 @@ int Thumbnail::infoFromImage (const Glib::ustring& fname, rtengine::RawMetaDataL
 /*
  * Read all thumbnail's data from the cache; build and save them if doesn't exist - NON PROTECTED
  * This includes:
- *  - image's bitmap (*.rtti)
+ *  - image's bitmap
  *  - auto exposure's histogram (full thumbnail only)
  *  - embedded profile (full thumbnail only)
  *  - LiveThumbData section of the data file
@@ -782,14 +786,17 @@ void Thumbnail::_loadThumbnail(bool firstTrial)
     tpp->isRaw = (cfs.format == (int) FT_Raw);
 
     // load supplementary data
-    bool succ = tpp->readData (getCacheFileName ("data", ".txt"));
+    std::string buffer;
+    bool succ = readCacheRecord ("data", buffer) && tpp->readData (buffer);
 
     if (succ) {
         tpp->getAutoWBMultipliers(cfs.redAWBMul, cfs.greenAWBMul, cfs.blueAWBMul);
     }
 
     // thumbnail image
-    succ = succ && tpp->readImage (getCacheFileName ("images", ""));
+    succ = succ && cachemgr->readRecord ("images", fname, cfs.md5, [this] (const char* data, size_t size) {
+        return tpp->readImage (data, size);
+    });
 
     if (!succ && firstTrial) {
         _generateThumbnailImage ();
@@ -809,10 +816,14 @@ void Thumbnail::_loadThumbnail(bool firstTrial)
 
     if ( cfs.thumbImgType == CacheImageData::FULL_THUMBNAIL ) {
         // load aehistogram
-        tpp->readAEHistogram (getCacheFileName ("aehistograms", ""));
+        buffer.clear ();
+        readCacheRecord ("aehistograms", buffer);
+        tpp->readAEHistogram (buffer);
 
         // load embedded profile
-        tpp->readEmbProfile (getCacheFileName ("embprofiles", ".icc"));
+        buffer.clear ();
+        readCacheRecord ("embprofiles", buffer);
+        tpp->readEmbProfile (buffer);
 
         tpp->init ();
     }
@@ -825,7 +836,7 @@ void Thumbnail::_loadThumbnail(bool firstTrial)
 /*
  * Read all thumbnail's data from the cache; build and save them if doesn't exist - MUTEX PROTECTED
  * This includes:
- *  - image's bitmap (*.rtti)
+ *  - image's bitmap
  *  - auto exposure's histogram (full thumbnail only)
  *  - embedded profile (full thumbnail only)
  *  - LiveThumbData section of the data file
@@ -839,7 +850,7 @@ void Thumbnail::loadThumbnail (bool firstTrial)
 /*
  * Save thumbnail's data to the cache - NON PROTECTED
  * This includes:
- *  - image's bitmap (*.rtti)
+ *  - image's bitmap
  *  - auto exposure's histogram (full thumbnail only)
  *  - embedded profile (full thumbnail only)
  *  - LiveThumbData section of the data file
@@ -851,30 +862,33 @@ void Thumbnail::_saveThumbnail ()
         return;
     }
 
-    if (g_remove (getCacheFileName ("images", ".rtti").c_str ()) != 0) {
-        // No file deleted, so we try to deleted obsolete files, if any
-        g_remove (getCacheFileName ("images", ".cust").c_str ());
-        g_remove (getCacheFileName ("images", ".cust16").c_str ());
-        g_remove (getCacheFileName ("images", ".jpg").c_str ());
-    }
+    // the records which can't be written are removed, so that no stale one stays
+    std::string buffer;
 
     // save thumbnail image
-    tpp->writeImage (getCacheFileName ("images", ""), 1);
+    writeCacheRecord ("images", tpp->writeImage (buffer) ? buffer : std::string ());
 
     // save aehistogram
-    tpp->writeAEHistogram (getCacheFileName ("aehistograms", ""));
+    buffer.clear ();
+    writeCacheRecord ("aehistograms", tpp->writeAEHistogram (buffer) ? buffer : std::string ());
 
     // save embedded profile
-    tpp->writeEmbProfile (getCacheFileName ("embprofiles", ".icc"));
+    buffer.clear ();
+    writeCacheRecord ("embprofiles", tpp->writeEmbProfile (buffer) ? buffer : std::string ());
+
+    // save supplementary data, merged into the record of the cache image data
+    buffer.clear ();
+    readCacheRecord ("data", buffer);
 
-    // save supplementary data
-    tpp->writeData (getCacheFileName ("data", ".txt"));
+    if (tpp->writeData (buffer)) {
+        writeCacheRecord ("data", buffer);
+    }
 }
 
 /*
  * Save thumbnail's data to the cache - MUTEX PROTECTED
  * This includes:
- *  - image's bitmap (*.rtti)
+ *  - image's bitmap
  *  - auto exposure's histogram (full thumbnail only)
  *  - embedded profile (full thumbnail only)
  *  - LiveThumbData section of the data file
@@ -903,7 +917,7 @@ void Thumbnail::updateCache (bool updatePParams, bool updateCacheImageData)
     }
 
     if (updateCacheImageData) {
-        cfs.save (getCacheFileName ("data", ".txt"));
+        saveCacheImageData ();
     }
 }
 
@@ -921,6 +935,74 @@ Glib::ustring Thumbnail::getCacheFileName (const Glib::ustring& subdir, const Gl
     return cachemgr->getCacheFileName (subdir, fname, fext, cfs.md5);
 }
 
+bool Thumbnail::readCacheRecord (const std::string& kind, std::string& buffer) const
+{
+    return cachemgr->readRecord (kind, fname, cfs.md5, buffer);
+}
+
+void Thumbnail::writeCacheRecord (const std::string& kind, const std::string& buffer) const
+{
+    // an empty buffer removes the record
+    if (buffer.empty ()) {
+        cachemgr->removeRecord (kind, fname, cfs.md5);
+    } else {
+        cachemgr->writeRecord (kind, fname, cfs.md5, buffer);
+    }
+}
+
+/*
+ * Load the params from a pp3 file. The key files of the pp3 files loaded are kept in the cache in binary form, under
+ * the source of the file, i.e. the sidecar or the cached profile, and a hash of its text: the text is read again but
+ * only parsed once it changed. The records of the former texts are left to the trimming of the cache.
+ */
+int Thumbnail::loadProcParamsFile (const Glib::ustring& fileName, const std::string& source)
+{
+    std::string content;
+
+    if (ProcParams::readFile (fileName, content)) {
+        return 1;
+    }
+
+    const std::string recordMD5 = cfs.md5 + '.' + source + '.' + Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, content);
+    Glib::KeyFile keyFile;
+
+    if (cachemgr->readRecord ("parsedprofiles", fname, recordMD5, [&keyFile] (const char* data, size_t size) {
+        return keyFileFromBinary (data, size, keyFile);
+    })) {
+        return pparams.loadFromKeyFile (keyFile, fileName);
+    }
+
+    try {
+        if (!keyFile.load_from_data (content)) {
+            return 1;
+        }
+    } catch (const Glib::Error&) {
+        // let load handle the malformed files
+        return pparams.load (fileName);
+    }
+
+    const int error = pparams.loadFromKeyFile (keyFile, fileName);
+
+    if (!error) {
+        std::string buffer;
+        keyFileToBinary (keyFile, buffer);
+        cachemgr->writeRecord ("parsedprofiles", fname, recordMD5, buffer);
+    }
+
+    return error;
+}
+
+void Thumbnail::saveCacheImageData ()
+{
+    // the record also holds the LiveThumbData group of rtengine::Thumbnail, the values are merged into it
+    std::string buffer;
+    readCacheRecord ("data", buffer);
+
+    if (cfs.save (buffer) == 0) {
+        writeCacheRecord ("data", buffer);
+    }
+}
+
 void Thumbnail::setFileName (const Glib::ustring &fn)
 {
 
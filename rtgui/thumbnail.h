@@ -76,6 +76,10 @@ class Thumbnail
     void            generateExifDateTimeStrings ();
 
     Glib::ustring    getCacheFileName (const Glib::ustring& subdir, const Glib::ustring& fext) const;
+    bool             readCacheRecord (const std::string& kind, std::string& buffer) const;
+    void             writeCacheRecord (const std::string& kind, const std::string& buffer) const;
+    void             saveCacheImageData ();
+    int              loadProcParamsFile (const Glib::ustring& fileName, const std::string& source);
 
 public:
     Thumbnail (CacheManager* cm, const Glib::ustring& fname, CacheImageData* cf);
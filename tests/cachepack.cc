@@ -0,0 +1,189 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The records of the thumbnail cache pack: invalidation, persistence and rewrites while the records are read
+
+#include <cstdio>
+#include <string>
+
+#include <glib/gstdio.h>
+
+#include "rttests.h"
+#include "../rtgui/cachepack.h"
+
+namespace
+{
+
+std::string makeData (char c, size_t size)
+{
+    return std::string (size, c);
+}
+
+bool hasRecord (CachePack& pack, const std::string& key, const std::string& expected)
+{
+    std::string data;
+    return pack.get (key, data) && data == expected;
+}
+
+}
+
+RT_TEST (cachePackRecords)
+{
+    const Glib::ustring packName = Glib::build_filename (rttests::makeTempDir (), "test.pack");
+    CachePack pack;
+    RT_REQUIRE (pack.open (packName));
+
+    RT_CHECK (pack.put ("images/a.jpg.1", makeData ('a', 1000)));
+    RT_CHECK (pack.put ("data/a.jpg.1", makeData ('b', 10)));
+    RT_CHECK (pack.put ("images/b.jpg.2", makeData ('c', 2000)));
+
+    // a record supersedes the previous one of its key
+    RT_CHECK (pack.put ("images/a.jpg.1", makeData ('d', 500)));
+    RT_CHECK (hasRecord (pack, "images/a.jpg.1", makeData ('d', 500)));
+
+    pack.remove ("images/b.jpg.2");
+    RT_CHECK (!hasRecord (pack, "images/b.jpg.2", makeData ('c', 2000)));
+
+    // only the records of the kind
+    pack.removeAll ("images");
+    RT_CHECK (!hasRecord (pack, "images/a.jpg.1", makeData ('d', 500)));
+    RT_CHECK (hasRecord (pack, "data/a.jpg.1", makeData ('b', 10)));
+
+    RT_CHECK (pack.put ("images/c.jpg.3", makeData ('e', 3000)));
+    pack.close ();
+
+    // from the index
+    RT_REQUIRE (pack.open (packName));
+    RT_CHECK (hasRecord (pack, "images/c.jpg.3", makeData ('e', 3000)));
+    RT_CHECK (hasRecord (pack, "data/a.jpg.1", makeData ('b', 10)));
+    RT_CHECK (!hasRecord (pack, "images/a.jpg.1", makeData ('d', 500)));
+
+    pack.removeAll ({});
+    RT_CHECK (!hasRecord (pack, "images/c.jpg.3", makeData ('e', 3000)));
+    RT_CHECK (pack.getLiveBytes () == 0);
+    pack.close ();
+
+    RT_REQUIRE (pack.open (packName));
+    RT_CHECK (!hasRecord (pack, "data/a.jpg.1", makeData ('b', 10)));
+    pack.close ();
+}
+
+RT_TEST (cachePackReplay)
+{
+    const Glib::ustring packName = Glib::build_filename (rttests::makeTempDir (), "test.pack");
+    CachePack pack;
+    RT_REQUIRE (pack.open (packName));
+    RT_CHECK (pack.put ("images/a.jpg.1", makeData ('a', 100)));
+    pack.close ();
+
+    // appended after the index was written, then a partial record, as left by a crash
+    RT_REQUIRE (pack.open (packName));
+    RT_CHECK (pack.put ("images/b.jpg.2", makeData ('b', 100)));
+    pack.remove ("images/a.jpg.1");
+    {
+        CachePack copy;
+        const Glib::ustring copyName = packName + ".copy";
+        std::string contents;
+        FILE* f = g_fopen (packName.c_str (), "rb");
+        RT_REQUIRE (f);
+        char buffer[4096];
+
+        for (size_t n; (n = fread (buffer, 1, sizeof (buffer), f)) > 0;) {
+            contents.append (buffer, n);
+        }
+
+        fclose (f);
+        contents.append ("\x08\0\0\0\x10", 5);
+        f = g_fopen (copyName.c_str (), "wb");
+        RT_REQUIRE (f);
+        fwrite (contents.data (), 1, contents.size (), f);
+        fclose (f);
+
+        // the index of the original pack belongs to the same generation
+        RT_REQUIRE (Glib::file_test (packName + ".index", Glib::FILE_TEST_EXISTS));
+        const std::string index = Glib::file_get_contents (packName + ".index");
+        Glib::file_set_contents (copyName + ".index", index);
+
+        RT_REQUIRE (copy.open (copyName));
+        RT_CHECK (hasRecord (copy, "images/b.jpg.2", makeData ('b', 100)));
+        RT_CHECK (!hasRecord (copy, "images/a.jpg.1", makeData ('a', 100)));
+        copy.close ();
+    }
+    pack.close ();
+}
+
+// The readers use the mapped records unlocked, the pack mustn't be rewritten under them
+RT_TEST (cachePackRewriteWhileReading)
+{
+    const Glib::ustring packName = Glib::build_filename (rttests::makeTempDir (), "test.pack");
+    CachePack pack;
+    RT_REQUIRE (pack.open (packName));
+
+    for (int i = 0; i < 20; ++i) {
+        RT_CHECK (pack.put ("images/" + std::to_string (i), makeData ('a' + i, 10000)));
+        RT_CHECK (pack.put ("images/" + std::to_string (i), makeData ('A' + i, 10000)));
+    }
+
+    bool compacted = true;
+    bool intact = false;
+
+    RT_CHECK (pack.read ("images/3", [&] (const char* data, size_t size) {
+        compacted = pack.compact ();
+        pack.removeAll ({});
+        pack.put ("images/new", makeData ('z', 100000));
+        intact = std::string (data, size) == makeData ('D', 10000);
+        return true;
+    }));
+
+    RT_CHECK (!compacted);
+    RT_CHECK (intact);
+    RT_CHECK (!hasRecord (pack, "images/3", makeData ('D', 10000)));
+    RT_CHECK (hasRecord (pack, "images/new", makeData ('z', 100000)));
+
+    // once the reader is done
+    RT_CHECK (pack.compact ());
+    RT_CHECK (hasRecord (pack, "images/new", makeData ('z', 100000)));
+    RT_CHECK (pack.read ("images/new", [] (const char* data, size_t size) {
+        return std::string (data, size) == makeData ('z', 100000);
+    }));
+    pack.close ();
+
+    RT_REQUIRE (pack.open (packName));
+    RT_CHECK (hasRecord (pack, "images/new", makeData ('z', 100000)));
+    RT_CHECK (!hasRecord (pack, "images/3", makeData ('D', 10000)));
+    pack.close ();
+}
+
+RT_TEST (cachePackTrim)
+{
+    const Glib::ustring packName = Glib::build_filename (rttests::makeTempDir (), "test.pack");
+    CachePack pack;
+    RT_REQUIRE (pack.open (packName));
+
+    RT_CHECK (pack.put ("images/old.1", makeData ('a', 1000)));
+    RT_CHECK (pack.put ("data/old.1", makeData ('b', 1000)));
+    RT_CHECK (pack.put ("images/new.2", makeData ('c', 1000)));
+    RT_CHECK (pack.put ("data/new.2", makeData ('d', 1000)));
+
+    // the records of an entry go together, the least recently used entry first
+    pack.trim (2500);
+    RT_CHECK (!hasRecord (pack, "images/old.1", makeData ('a', 1000)));
+    RT_CHECK (!hasRecord (pack, "data/old.1", makeData ('b', 1000)));
+    RT_CHECK (hasRecord (pack, "images/new.2", makeData ('c', 1000)));
+    RT_CHECK (hasRecord (pack, "data/new.2", makeData ('d', 1000)));
+    pack.close ();
+}
@@ -0,0 +1,84 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The transforms of CmsTransformCache: the profiles of ICCStore, known by handle, and the profiles built on the fly,
+// known by content whatever their handle
+
+#include "rttests.h"
+#include "../rtengine/cmstransformcache.h"
+#include "../rtengine/iccstore.h"
+#include "../rtengine/rtengine.h"
+
+using namespace rtengine;
+
+namespace
+{
+
+CmsTransform getTransform (cmsHPROFILE input, cmsHPROFILE output)
+{
+    return CmsTransformCache::getInstance ()->get (input, TYPE_RGB_FLT, output, TYPE_RGB_FLT, INTENT_RELATIVE_COLORIMETRIC,
+            cmsFLAGS_NOOPTIMIZE | cmsFLAGS_NOCACHE);
+}
+
+cmsHPROFILE createProfile (const Glib::ustring& workingSpace)
+{
+    MyMutex::MyLock lock (*lcmsMutex);
+    return ICCStore::createFromMatrix (iccStore->workingSpaceMatrix (workingSpace));
+}
+
+void closeProfile (cmsHPROFILE profile)
+{
+    MyMutex::MyLock lock (*lcmsMutex);
+    cmsCloseProfile (profile);
+}
+
+}
+
+RT_TEST (cmsTransformCacheProfiles)
+{
+    const cmsHPROFILE srgb = iccStore->workingSpace ("sRGB");
+    const cmsHPROFILE prophoto = iccStore->workingSpace ("ProPhoto");
+    RT_REQUIRE (srgb && prophoto);
+    RT_CHECK (iccStore->isStoreProfile (srgb));
+
+    const CmsTransform transform = getTransform (srgb, prophoto);
+    RT_REQUIRE (transform);
+    RT_CHECK (getTransform (srgb, prophoto) == transform);
+    RT_CHECK (getTransform (prophoto, srgb) != transform);
+
+    // the same content as the working space, from a handle of its own
+    const cmsHPROFILE copy = createProfile ("sRGB");
+    RT_REQUIRE (copy);
+    RT_CHECK (!iccStore->isStoreProfile (copy));
+    RT_CHECK (getTransform (copy, prophoto) == transform);
+    closeProfile (copy);
+
+    // the handles of the closed profiles are often reused, the digest of the former content mustn't be
+    for (int i = 0; i < 4; ++i) {
+        const cmsHPROFILE other = createProfile (i % 2 ? "sRGB" : "Rec2020");
+        RT_REQUIRE (other);
+        RT_CHECK ((getTransform (other, prophoto) == transform) == (i % 2 == 1));
+        closeProfile (other);
+    }
+
+    // the conversions of Lab, by intent
+    const auto conversion = CmsTransformCache::getInstance ()->getLab2Rgb (srgb, INTENT_RELATIVE_COLORIMETRIC, false);
+    RT_REQUIRE (conversion);
+    RT_CHECK (CmsTransformCache::getInstance ()->getLab2Rgb (srgb, INTENT_RELATIVE_COLORIMETRIC, false) == conversion);
+    RT_CHECK (CmsTransformCache::getInstance ()->getLab2Rgb (srgb, INTENT_PERCEPTUAL, false) != conversion);
+    RT_CHECK (!CmsTransformCache::getInstance ()->getLab2Rgb (srgb, INTENT_ABSOLUTE_COLORIMETRIC, false));
+}
@@ -0,0 +1,232 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The hue/sat map of the DCP profiles applied per pixel or through the LUT baked per white balance
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glib/gstdio.h>
+
+#include "rttests.h"
+#include "../rtengine/dcp.h"
+#include "../rtgui/options.h"
+
+extern Options options;
+
+using namespace rtengine;
+
+namespace
+{
+
+constexpr int hueDivisions = 6;
+constexpr int satDivisions = 3;
+
+// A little endian DCP of an identity colour matrix and of 2 hue/sat maps without value divisions, for the
+// illuminants A and D65
+class SyntheticDcp
+{
+public:
+    void write (const Glib::ustring& fileName) const
+    {
+        std::vector<std::pair<int, std::string>> entries;
+        std::vector<uint32_t> matrix;
+
+        for (int i = 0; i < 9; ++i) {
+            matrix.push_back (i % 4 == 0 ? 1 : 0);
+            matrix.push_back (1);
+        }
+
+        entries.emplace_back (50721, makeEntry (10, matrix));                         // ColorMatrix1
+        entries.emplace_back (50722, makeEntry (10, matrix));                         // ColorMatrix2
+        entries.emplace_back (50778, makeEntry (3, {17}));                            // CalibrationIlluminant1
+        entries.emplace_back (50779, makeEntry (3, {21}));                            // CalibrationIlluminant2
+        entries.emplace_back (50937, makeEntry (4, {hueDivisions, satDivisions, 1})); // ProfileHueSatMapDims
+        entries.emplace_back (50938, makeEntry (11, makeMap (1.f)));                  // ProfileHueSatMapData1
+        entries.emplace_back (50939, makeEntry (11, makeMap (-1.f)));                 // ProfileHueSatMapData2
+
+        std::string file ("II\x2a\0\x08\0\0\0", 8);
+        std::string data;
+        const uint32_t dataOffset = 8 + 2 + 12 * entries.size () + 4;
+        append16 (file, entries.size ());
+
+        for (const auto& entry : entries) {
+            // the type, the count and the values, stored after the directory if they don't fit in the entry
+            append16 (file, entry.first);
+            file += entry.second.substr (0, 6);
+            const std::string values = entry.second.substr (6);
+
+            if (values.size () <= 4) {
+                file += values + std::string (4 - values.size (), '\0');
+            } else {
+                append32 (file, dataOffset + data.size ());
+                data += values;
+            }
+        }
+
+        append32 (file, 0);
+        file += data;
+
+        FILE* const f = g_fopen (fileName.c_str (), "wb");
+        fwrite (file.data (), 1, file.size (), f);
+        fclose (f);
+    }
+
+private:
+    static void append16 (std::string& s, uint32_t value)
+    {
+        s += char (value & 0xff);
+        s += char (value >> 8);
+    }
+
+    static void append32 (std::string& s, uint32_t value)
+    {
+        append16 (s, value & 0xffff);
+        append16 (s, value >> 16);
+    }
+
+    static std::string makeEntry (int type, const std::vector<uint32_t>& values)
+    {
+        // the rationals are given as numerator, denominator
+        const size_t count = type == 10 ? values.size () / 2 : values.size ();
+        std::string entry;
+        append16 (entry, type);
+        append32 (entry, count);
+
+        for (uint32_t value : values) {
+            if (type == 3) {
+                append16 (entry, value);
+            } else {
+                append32 (entry, value);
+            }
+        }
+
+        return entry;
+    }
+
+    static std::vector<uint32_t> makeMap (float sign)
+    {
+        std::vector<uint32_t> values;
+
+        for (int hue = 0; hue < hueDivisions; ++hue) {
+            for (int sat = 0; sat < satDivisions; ++sat) {
+                const float delta[3] = {
+                    sign * 12.f * std::sin (hue + 0.5f * sat), // hue shift in degrees
+                    1.f + sign * 0.1f * std::cos (2 * hue + sat),
+                    1.f - 0.03f * sat
+                };
+
+                for (float value : delta) {
+                    uint32_t bits;
+                    memcpy (&bits, &value, sizeof (bits));
+                    values.push_back (bits);
+                }
+            }
+        }
+
+        return values;
+    }
+};
+
+// Camera RGB without clipped or negative values, the whole range of hues and saturations
+std::unique_ptr<Imagefloat> applyProfile (const DCPProfile& profile, int width, int height, double temperature, bool bakedLuts)
+{
+    std::unique_ptr<Imagefloat> image (new Imagefloat (width, height));
+    uint32_t state = 0x9e3779b9;
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float rgb[3];
+
+            for (float& value : rgb) {
+                state = state * 1664525u + 1013904223u;
+                value = 1000.f + (state >> 8) * (30000.f / (1 << 24));
+            }
+
+            image->r (y, x) = rgb[0];
+            image->g (y, x) = rgb[1];
+            image->b (y, x) = rgb[2];
+        }
+    }
+
+    const DCPProfile::Triple preMul = {1.0, 1.0, 1.0};
+    const DCPProfile::Matrix camMatrix = {{{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}}};
+    const bool previous = options.rtSettings.dcpBakedLuts;
+    options.rtSettings.dcpBakedLuts = bakedLuts;
+    profile.apply (image.get (), 0, "ProPhoto", ColorTemp (temperature, 1.0, 1.0, "Custom"), preMul, camMatrix);
+    options.rtSettings.dcpBakedLuts = previous;
+
+    return image;
+}
+
+// 0 if the images are the same, else the largest difference relative to the largest channel of the pixel
+float getDifference (Imagefloat* a, Imagefloat* b)
+{
+    float difference = 0.f;
+
+    for (int y = 0; y < a->getHeight (); ++y) {
+        for (int x = 0; x < a->getWidth (); ++x) {
+            const float scale = std::max ({std::fabs (b->r (y, x)), std::fabs (b->g (y, x)), std::fabs (b->b (y, x)), 1.f});
+            difference = std::max ({
+                difference,
+                std::fabs (a->r (y, x) - b->r (y, x)) / scale,
+                std::fabs (a->g (y, x) - b->g (y, x)) / scale,
+                std::fabs (a->b (y, x) - b->b (y, x)) / scale
+            });
+        }
+    }
+
+    return difference;
+}
+
+}
+
+RT_TEST (dcpHueSatMapLut)
+{
+    const Glib::ustring fileName = Glib::build_filename (rttests::makeTempDir (), "synthetic.dcp");
+    SyntheticDcp ().write (fileName);
+    const DCPProfile profile (fileName);
+    RT_REQUIRE (profile && profile.getHasHueSatMap ());
+
+    // the previews of a few white balances evaluate the map per pixel
+    for (double temperature : {3000.0, 4500.0, 5500.0}) {
+        const auto image = applyProfile (profile, 300, 200, temperature, true);
+        const auto exact = applyProfile (profile, 300, 200, temperature, false);
+        RT_CHECK (getDifference (image.get (), exact.get ()) == 0.f);
+    }
+
+    // the LUT is baked for an image of many more pixels than nodes, then used by the previews of its white balance
+    const auto large = applyProfile (profile, 1500, 1500, 4500.0, true);
+    const auto largeExact = applyProfile (profile, 1500, 1500, 4500.0, false);
+    const float largeDifference = getDifference (large.get (), largeExact.get ());
+    RT_CHECK (largeDifference > 0.f && largeDifference < 0.02f);
+
+    const auto image = applyProfile (profile, 300, 200, 4500.0, true);
+    const auto exact = applyProfile (profile, 300, 200, 4500.0, false);
+    const float difference = getDifference (image.get (), exact.get ());
+    RT_CHECK (difference > 0.f && difference < 0.02f);
+
+    const auto other = applyProfile (profile, 300, 200, 6000.0, true);
+    const auto otherExact = applyProfile (profile, 300, 200, 6000.0, false);
+    RT_CHECK (getDifference (other.get (), otherExact.get ()) == 0.f);
+}
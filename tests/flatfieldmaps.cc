@@ -0,0 +1,198 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The cache of the flat field correction maps: the keys, which follow the flat field, the blur and the black levels,
+// and the maps kept in memory and on disk
+
+#include <memory>
+#include <string>
+
+#include "rttests.h"
+#include "../rtengine/flatfieldmaps.h"
+#include "../rtengine/rawimage.h"
+#include "../rtgui/options.h"
+
+extern Options options;
+
+using namespace rtengine;
+
+namespace
+{
+
+constexpr int frameWidth = 40;
+constexpr int frameHeight = 30;
+
+// The settings of the cache for the duration of a test
+class CacheSettings
+{
+public:
+    CacheSettings (bool onDisk, const Glib::ustring& dir) :
+        previousOnDisk (options.rtSettings.flatFieldMapsOnDisk),
+        previousDir (options.rtSettings.masterFrameCacheDir)
+    {
+        options.rtSettings.flatFieldMapsOnDisk = onDisk;
+        options.rtSettings.masterFrameCacheDir = dir;
+    }
+
+    ~CacheSettings ()
+    {
+        options.rtSettings.flatFieldMapsOnDisk = previousOnDisk;
+        options.rtSettings.masterFrameCacheDir = previousDir;
+    }
+
+private:
+    const bool previousOnDisk;
+    const Glib::ustring previousDir;
+};
+
+class SyntheticFrame :
+    public RawImage
+{
+public:
+    SyntheticFrame (const Glib::ustring& name, unsigned bayerFilters) :
+        RawImage (name)
+    {
+        width = frameWidth;
+        height = frameHeight;
+        filters = bayerFilters;
+        colors = 3;
+
+        allocation = new float[frameWidth * frameHeight];
+        data = new float*[frameHeight];
+
+        for (int row = 0; row < frameHeight; ++row) {
+            data[row] = allocation + row * frameWidth;
+
+            for (int col = 0; col < frameWidth; ++col) {
+                data[row][col] = 3000 + (row * 7 + col * 13) % 61;
+            }
+        }
+    }
+};
+
+std::shared_ptr<const FlatFieldMaps> makeMaps (float value, bool lines)
+{
+    std::shared_ptr<FlatFieldMaps> maps (new FlatFieldMaps);
+    maps->width = frameWidth;
+    maps->height = frameHeight;
+    maps->vignette.assign (frameWidth * frameHeight, value);
+
+    if (lines) {
+        maps->lines.assign (frameWidth * frameHeight, value / 2);
+    }
+
+    return maps;
+}
+
+bool sameMaps (const std::shared_ptr<const FlatFieldMaps>& a, const std::shared_ptr<const FlatFieldMaps>& b)
+{
+    return a && b && a->width == b->width && a->height == b->height && a->vignette == b->vignette && a->lines == b->lines;
+}
+
+int countFiles (const Glib::ustring& dir)
+{
+    int count = 0;
+    Glib::Dir entries (dir);
+
+    for (const auto& entry : entries) {
+        if (Glib::str_has_suffix (entry, ".rtfm")) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+}
+
+RT_TEST (flatFieldMapKeys)
+{
+    FlatFieldMapCache* const cache = FlatFieldMapCache::getInstance ();
+    SyntheticFrame flatField ("flat.raw", 0x94949494);
+    SyntheticFrame image ("image.raw", 0x94949494);
+    const unsigned short black[4] = {512, 512, 512, 512};
+
+    const std::string key = cache->getKey (&flatField, &image, frameWidth, frameHeight, "Area Flatfield", 32, black);
+    RT_CHECK (cache->getKey (&flatField, &image, frameWidth, frameHeight, "Area Flatfield", 32, black) == key);
+
+    // the blur and the black levels
+    RT_CHECK (cache->getKey (&flatField, &image, frameWidth, frameHeight, "Vertical Flatfield", 32, black) != key);
+    RT_CHECK (cache->getKey (&flatField, &image, frameWidth, frameHeight, "Area Flatfield", 16, black) != key);
+    const unsigned short otherBlack[4] = {512, 512, 512, 600};
+    RT_CHECK (cache->getKey (&flatField, &image, frameWidth, frameHeight, "Area Flatfield", 32, otherBlack) != key);
+
+    // the image
+    SyntheticFrame otherImage ("image.raw", 0x61616161);
+    RT_CHECK (cache->getKey (&flatField, &otherImage, frameWidth, frameHeight, "Area Flatfield", 32, black) != key);
+    RT_CHECK (cache->getKey (&flatField, &image, frameWidth - 2, frameHeight, "Area Flatfield", 32, black) != key);
+
+    // the flat field, by name and by pixels: a combined flat field is named after its first file
+    SyntheticFrame otherFlatField ("other flat.raw", 0x94949494);
+    RT_CHECK (cache->getKey (&otherFlatField, &image, frameWidth, frameHeight, "Area Flatfield", 32, black) != key);
+    flatField.data[0][0] += 1.f;
+    RT_CHECK (cache->getKey (&flatField, &image, frameWidth, frameHeight, "Area Flatfield", 32, black) != key);
+}
+
+RT_TEST (flatFieldMapEntries)
+{
+    FlatFieldMapCache* const cache = FlatFieldMapCache::getInstance ();
+    const Glib::ustring dir = Glib::build_filename (rttests::makeTempDir (), "masters");
+
+    {
+        const CacheSettings inMemory (false, dir);
+        const auto maps = makeMaps (1.5f, true);
+        cache->put ("memory 1", maps);
+        RT_CHECK (cache->get ("memory 1") == maps);
+        RT_CHECK (!cache->get ("memory 2"));
+
+        // only the most recently used maps are kept
+        cache->put ("memory 2", makeMaps (2.f, false));
+        cache->get ("memory 1");
+        cache->put ("memory 3", makeMaps (3.f, false));
+        RT_CHECK (cache->get ("memory 1") == maps);
+        RT_CHECK (!cache->get ("memory 2"));
+        RT_CHECK (!Glib::file_test (dir, Glib::FILE_TEST_EXISTS));
+    }
+
+    const CacheSettings onDisk (true, dir);
+    const auto maps = makeMaps (1.25f, true);
+    const auto otherMaps = makeMaps (0.75f, false);
+    cache->put ("disk 1", maps);
+    cache->put ("disk 2", otherMaps);
+
+    // read back once the maps are out of memory
+    cache->put ("disk 3", makeMaps (1.f, false));
+    cache->put ("disk 4", makeMaps (1.f, false));
+    const auto loaded = cache->get ("disk 1");
+    RT_CHECK (loaded != maps && sameMaps (loaded, maps));
+    cache->put ("disk 5", makeMaps (1.f, false));
+    cache->put ("disk 6", makeMaps (1.f, false));
+
+    // a partial file is removed
+    const Glib::ustring fileName = Glib::build_filename (dir, Glib::Checksum::compute_checksum (Glib::Checksum::CHECKSUM_MD5, "disk 2") + ".rtfm");
+    const std::string contents = Glib::file_get_contents (fileName);
+    Glib::file_set_contents (fileName, contents.substr (0, contents.size () - 4));
+    RT_CHECK (!cache->get ("disk 2"));
+    RT_CHECK (!Glib::file_test (fileName, Glib::FILE_TEST_EXISTS));
+
+    // only the most recent files are kept
+    for (int i = 0; i < 12; ++i) {
+        cache->put ("disk trim " + std::to_string (i), makeMaps (i, false));
+    }
+
+    RT_CHECK (countFiles (dir) == 8);
+}
@@ -0,0 +1,187 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The stacking of the master frames against the former averaging loops of dfInfo and ffInfo, and the frames kept in
+// memory against the ones of the temporary file
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rttests.h"
+#include "../rtengine/framestacker.h"
+
+using namespace rtengine;
+
+namespace
+{
+
+constexpr int frameWidth = 37;
+constexpr int frameHeight = 23;
+constexpr size_t numFiles = 9;
+constexpr size_t brokenFile = 3;    // can't be loaded
+constexpr size_t otherFile = 6;     // of another geometry
+
+// Noise around a dark level, in quarters so that the truncation of the mean shows, with an outlier in some frames
+class SyntheticFrame :
+    public RawImage
+{
+public:
+    SyntheticFrame (bool bayer, int W, int H, uint32_t seed) :
+        RawImage ("synthetic " + std::to_string (seed))
+    {
+        width = W;
+        height = H;
+        filters = bayer ? 0x94949494 : 0;
+        colors = 3;
+        is_foveon = 0;
+
+        const int rowSize = bayer ? W : 3 * W;
+        allocation = new float[H * rowSize];
+        data = new float*[H];
+        uint32_t state = seed * 2654435761u;
+
+        for (int row = 0; row < H; ++row) {
+            data[row] = allocation + row * rowSize;
+
+            for (int col = 0; col < rowSize; ++col) {
+                state = state * 1664525u + 1013904223u;
+                data[row][col] = 512 + (state >> 22) * 0.25f;
+            }
+        }
+
+        if (seed % 4 == 1) {
+            data[seed % H][seed % rowSize] = 60000.f;
+        }
+    }
+};
+
+int getRowSize (bool bayer)
+{
+    return bayer ? frameWidth : 3 * frameWidth;
+}
+
+FrameDecoder makeDecoder (bool bayer)
+{
+    return [bayer] (size_t i) -> RawImage* {
+        if (i == brokenFile) {
+            return nullptr;
+        }
+
+        return new SyntheticFrame (bayer, i == otherFile ? frameWidth + 2 : frameWidth, frameHeight, i);
+    };
+}
+
+// the frames which are stacked
+std::vector<std::unique_ptr<SyntheticFrame>> getValidFrames (bool bayer)
+{
+    std::vector<std::unique_ptr<SyntheticFrame>> frames;
+
+    for (size_t i = 0; i < numFiles; ++i) {
+        if (i != brokenFile && i != otherFile) {
+            frames.emplace_back (new SyntheticFrame (bayer, frameWidth, frameHeight, i));
+        }
+    }
+
+    return frames;
+}
+
+bool samePixels (RawImage* a, RawImage* b, int rowSize)
+{
+    for (int row = 0; row < frameHeight; ++row) {
+        if (memcmp (a->data[row], b->data[row], rowSize * sizeof (float))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+RT_TEST (frameStackerMean)
+{
+    for (bool bayer : {true, false}) {
+        const int rowSize = getRowSize (bayer);
+        std::unique_ptr<RawImage> stacked (stackRawFrames (numFiles, makeDecoder (bayer), StackingMethod::MEAN, 1 << 20));
+        RT_REQUIRE (stacked);
+
+        // the loops of dfInfo::updateRawImage before the stacking
+        const auto frames = getValidFrames (bayer);
+        bool same = true;
+
+        for (int row = 0; row < frameHeight; ++row) {
+            for (int col = 0; col < rowSize; ++col) {
+                unsigned int acc = frames[0]->data[row][col];
+
+                for (size_t f = 1; f < frames.size (); ++f) {
+                    acc += frames[f]->data[row][col];
+                }
+
+                same = same && stacked->data[row][col] == acc / frames.size ();
+            }
+        }
+
+        RT_CHECK (same);
+    }
+}
+
+RT_TEST (frameStackerSpill)
+{
+    for (bool bayer : {true, false}) {
+        const int rowSize = getRowSize (bayer);
+        const auto frames = getValidFrames (bayer);
+        const size_t frameBytes = frameHeight * rowSize * sizeof (float);
+
+        for (StackingMethod method : {StackingMethod::SIGMA_CLIPPED_MEAN, StackingMethod::MEDIAN}) {
+            // all the frames in memory, then in the temporary file by bands of one row and of a few rows
+            std::unique_ptr<RawImage> inMemory (stackRawFrames (numFiles, makeDecoder (bayer), method, numFiles * frameBytes));
+            std::unique_ptr<RawImage> oneRow (stackRawFrames (numFiles, makeDecoder (bayer), method, 0));
+            std::unique_ptr<RawImage> fewRows (stackRawFrames (numFiles, makeDecoder (bayer), method, 5 * frames.size () * rowSize * sizeof (float)));
+            RT_REQUIRE (inMemory && oneRow && fewRows);
+            RT_CHECK (samePixels (inMemory.get (), oneRow.get (), rowSize));
+            RT_CHECK (samePixels (inMemory.get (), fewRows.get (), rowSize));
+
+            bool expected = true;
+            std::vector<float> values (frames.size ());
+
+            for (int row = 0; row < frameHeight; ++row) {
+                for (int col = 0; col < rowSize; ++col) {
+                    for (size_t f = 0; f < frames.size (); ++f) {
+                        values[f] = frames[f]->data[row][col];
+                    }
+
+                    std::sort (values.begin (), values.end ());
+                    const float result = inMemory->data[row][col];
+
+                    if (method == StackingMethod::MEDIAN) {
+                        // an odd number of frames
+                        expected = expected && result == values[values.size () / 2];
+                    } else {
+                        // the outliers are dropped, the values are within a few units of each other otherwise
+                        expected = expected && result >= values.front () && result <= 512 + 1024 * 0.25f;
+                    }
+                }
+            }
+
+            RT_CHECK (expected);
+        }
+    }
+}
@@ -0,0 +1,185 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The reader of the compressed RAF strips against the former one, kept as reference in fujicompressed.cc
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "rttests.h"
+#include "../rtengine/rawimage.h"
+
+namespace
+{
+
+// Compressed strips made of pseudo random bits: they decode to noise, but go through all the paths of the reader
+class SyntheticRaf :
+    public DCraw
+{
+public:
+    SyntheticRaf (bool xtrans, int bits, int lines, int blocks)
+    {
+        static const char xtransPattern[6][6] = {
+            {1, 1, 0, 1, 1, 2},
+            {1, 1, 2, 1, 1, 0},
+            {2, 0, 1, 0, 2, 1},
+            {1, 1, 2, 1, 1, 0},
+            {1, 1, 0, 1, 1, 2},
+            {0, 2, 1, 2, 0, 1}
+        };
+
+        fuji_total_lines = lines;
+        fuji_total_blocks = blocks;
+        fuji_block_width = 0x300;
+        fuji_bits = bits;
+        fuji_raw_type = xtrans ? 16 : 0;
+        filters = xtrans ? 9 : 0x94949494;
+        memcpy (xtrans_abs, xtransPattern, sizeof (xtrans_abs));
+        raw_width = blocks * fuji_block_width - 24; // the last block is partial, as in the files
+        raw_height = 6 * lines;
+        data_offset = 0;
+        ifname = "synthetic";
+
+        // the big endian sizes of the strips, padded to 16 bytes, then the strips, larger than the 64 KiB buffer
+        // of the reference reader so that it refills it
+        std::vector<unsigned char> file ((4 * blocks + 15) & ~15);
+        uint32_t state = 0x2545f491 + bits + 7 * fuji_raw_type;
+
+        for (int block = 0; block < blocks; ++block) {
+            const unsigned size = 150000 + 4099 * block;
+
+            for (int i = 0; i < 4; ++i) {
+                file[4 * block + i] = size >> (24 - 8 * i);
+            }
+
+            for (unsigned i = 0; i < size; ++i) {
+                state = state * 1664525u + 1013904223u;
+                file.push_back (state >> 24);
+            }
+        }
+
+        fileData.resize ((file.size () + 3) / 4);
+        memcpy (fileData.data (), file.data (), file.size ());
+        fileSize = file.size ();
+    }
+
+    std::vector<ushort> decode (bool referenceReader, unsigned& errors)
+    {
+        std::vector<ushort> pixels (raw_width * raw_height);
+        raw_image = pixels.data ();
+        data_error = 0;
+        setFujiReferenceReader (referenceReader);
+        ifp = fopen (fileData.data (), fileSize);
+        fuji_compressed_load_raw ();
+        fclose (ifp);
+        ifp = nullptr;
+        raw_image = nullptr;
+        errors = data_error;
+        return pixels;
+    }
+
+private:
+    std::vector<unsigned> fileData;
+    int fileSize;
+};
+
+class RafFile :
+    public rtengine::RawImage
+{
+public:
+    using RawImage::RawImage;
+
+    bool isCompressed () const
+    {
+        return load_raw == &DCraw::fuji_compressed_load_raw;
+    }
+};
+
+}
+
+RT_TEST (fujiCompressedSynthetic)
+{
+    for (bool xtrans : {true, false}) {
+        for (int bits : {12, 14}) {
+            SyntheticRaf raf (xtrans, bits, 16, 3);
+            unsigned referenceErrors, errors;
+            const std::vector<unsigned short> reference = raf.decode (true, referenceErrors);
+            const std::vector<unsigned short> pixels = raf.decode (false, errors);
+
+            RT_CHECK (pixels == reference);
+            RT_CHECK (errors == referenceErrors);
+        }
+    }
+}
+
+// On the compressed RAF files of the directory given by the TEST_RAF_DIR CMake variable, if any
+RT_TEST (fujiCompressedFiles)
+{
+    const char* const dirName = g_getenv ("RT_TEST_RAF_DIR");
+
+    if (!dirName || !*dirName) {
+        std::cout << "fujiCompressedFiles: no sample directory, skipped" << std::endl;
+        return;
+    }
+
+    int compared = 0;
+    Glib::Dir dir (dirName);
+
+    for (const auto& name : dir) {
+        if (Glib::ustring (name).lowercase ().find (".raf") == Glib::ustring::npos) {
+            continue;
+        }
+
+        const Glib::ustring fileName = Glib::build_filename (dirName, name);
+        RafFile reference (fileName);
+        RafFile raf (fileName);
+        reference.setFujiReferenceReader (true);
+
+        RT_REQUIRE (reference.loadRaw (true) == 0);
+        RT_REQUIRE (raf.loadRaw (true) == 0);
+
+        if (!raf.isCompressed ()) {
+            continue;
+        }
+
+        const int width = raf.get_width ();
+        const int height = raf.get_height ();
+        RT_REQUIRE (reference.get_width () == width && reference.get_height () == height);
+
+        float** const referenceData = reference.compress_image ();
+        float** const data = raf.compress_image ();
+        RT_REQUIRE (referenceData && data);
+
+        bool same = true;
+
+        for (int row = 0; row < height && same; ++row) {
+            same = !memcmp (referenceData[row], data[row], width * sizeof (float));
+        }
+
+        if (!same) {
+            std::cerr << fileName << ": the readers give different pixels" << std::endl;
+        }
+
+        RT_CHECK (same);
+        ++compared;
+    }
+
+    std::cout << "fujiCompressedFiles: " << compared << " compressed files compared" << std::endl;
+    RT_CHECK (compared > 0);
+}
@@ -0,0 +1,319 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The parallel decoder of the lossless JPEG tiles of the DNG files against the sequential one of dcraw
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "rttests.h"
+#include "../rtengine/dcraw.h"
+
+namespace
+{
+
+// The code lengths of the bit counts of the differences, the codes are the canonical ones of the table
+constexpr int codeLengths[17] = {3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8};
+
+// The bits of the entropy coded segments, with the 0 byte stuffed after the 0xff ones
+class BitWriter
+{
+public:
+    explicit BitWriter (std::vector<unsigned char>& out) :
+        out (out)
+    {
+    }
+
+    void put (unsigned value, int count)
+    {
+        for (int i = count - 1; i >= 0; --i) {
+            byte = (byte << 1) | ((value >> i) & 1);
+
+            if (++bits == 8) {
+                out.push_back (byte);
+
+                if (byte == 0xff) {
+                    out.push_back (0);
+                }
+
+                byte = bits = 0;
+            }
+        }
+    }
+
+    // pads the last byte with 1 bits, before a marker
+    void flush ()
+    {
+        while (bits) {
+            put (1, 1);
+        }
+    }
+
+private:
+    std::vector<unsigned char>& out;
+    unsigned byte = 0;
+    int bits = 0;
+};
+
+void putSegment (std::vector<unsigned char>& out, unsigned char marker, const std::vector<unsigned char>& payload)
+{
+    const unsigned length = payload.size () + 2;
+    out.insert (out.end (), {0xff, marker, static_cast<unsigned char> (length >> 8), static_cast<unsigned char> (length)});
+    out.insert (out.end (), payload.begin (), payload.end ());
+}
+
+// A tile of 2 interleaved components, as the DNG files of the Bayer sensors, with a restart marker every restartRows
+// rows if not 0. The predictions are the ones of ljpeg_row(): the rows above are kept across the restart markers, and
+// are only the previous rows for the odd rows, the even ones are predicted from 0.
+std::vector<unsigned char> encodeTile (const std::vector<unsigned short>& pixels, int width, int height, int bits, int predictor, int restartRows)
+{
+    const int wide = width / 2;
+    unsigned codes[17];
+    std::vector<unsigned char> table = {0x00};
+    table.resize (17);
+
+    for (int length = 1, code = 0; length <= 16; ++length, code <<= 1) {
+        for (int ssss = 0; ssss <= 16; ++ssss) {
+            if (codeLengths[ssss] == length) {
+                codes[ssss] = code++;
+                ++table[length];
+            }
+        }
+    }
+
+    for (int ssss = 0; ssss <= 16; ++ssss) {
+        table.push_back (ssss);
+    }
+
+    std::vector<unsigned char> out = {0xff, 0xd8};
+    putSegment (out, 0xc3, {static_cast<unsigned char> (bits), 0, static_cast<unsigned char> (height), 0, static_cast<unsigned char> (wide), 2, 1, 0x11, 0, 2, 0x11, 0});
+    putSegment (out, 0xc4, table);
+
+    if (restartRows) {
+        const int interval = restartRows * wide;
+        putSegment (out, 0xdd, {static_cast<unsigned char> (interval >> 8), static_cast<unsigned char> (interval)});
+    }
+
+    putSegment (out, 0xda, {2, 1, 0x00, 2, 0x00, static_cast<unsigned char> (predictor), 0, 0});
+
+    BitWriter writer (out);
+    const std::vector<unsigned short> zeros (width);
+    int vpred[2];
+    int restarts = 0;
+
+    for (int jrow = 0; jrow < height; ++jrow) {
+        if (restartRows ? jrow % restartRows == 0 : jrow == 0) {
+            vpred[0] = vpred[1] = 1 << (bits - 1);
+
+            if (jrow) {
+                writer.flush ();
+                out.insert (out.end (), {0xff, static_cast<unsigned char> (0xd0 + (restarts++ & 7))});
+            }
+        }
+
+        const unsigned short* const line = pixels.data () + jrow * width;
+        const unsigned short* const above = jrow & 1 ? line - width : zeros.data ();
+
+        for (int col = 0; col < wide; ++col) {
+            for (int c = 0; c < 2; ++c) {
+                const int x = 2 * col + c;
+                int pred;
+
+                if (col) {
+                    pred = line[x - 2];
+                } else {
+                    pred = vpred[c];
+                    vpred[c] = line[x];
+                }
+
+                if (predictor != 1 && jrow && col) {
+                    switch (predictor) {
+                        case 4:
+                            pred = pred + above[x] - above[x - 2];
+                            break;
+
+                        case 6:
+                            pred = above[x] + ((pred - above[x - 2]) >> 1);
+                            break;
+
+                        case 7:
+                            pred = (pred + above[x]) >> 1;
+                            break;
+
+                        default:
+                            std::abort ();
+                    }
+                }
+
+                const int diff = line[x] - pred;
+                int ssss = 0;
+
+                while (std::abs (diff) >> ssss) {
+                    ++ssss;
+                }
+
+                writer.put (codes[ssss], codeLengths[ssss]);
+
+                if (ssss) {
+                    writer.put (diff < 0 ? diff + (1 << ssss) - 1 : diff, ssss);
+                }
+            }
+        }
+    }
+
+    writer.flush ();
+    out.insert (out.end (), {0xff, 0xd9});
+    return out;
+}
+
+// The tiles of the right and of the bottom go past the edges of the image, as in the files. If truncated, the file
+// ends in the middle of the last tile.
+class SyntheticDng :
+    public DCraw
+{
+public:
+    SyntheticDng (int bits, int predictor, int restartRows, bool truncated)
+    {
+        raw_width = 150;
+        raw_height = 80;
+        tile_width = 64;
+        tile_length = 32;
+        filters = 0x94949494;
+        is_raw = 1;
+        tiff_samples = 1;
+        dng_version = 0x1040000;
+        order = 0x4949;
+        ifname = "synthetic";
+
+        for (int i = 0; i < 0x10000; ++i) {
+            curve[i] = i;
+        }
+
+        // a gradient with noise, and some values anywhere in the range for the largest differences
+        const int tilesAcross = (raw_width + tile_width - 1) / tile_width;
+        const int tilesDown = (raw_height + tile_length - 1) / tile_length;
+        const int sourceWidth = tilesAcross * tile_width;
+        source.resize (sourceWidth * tilesDown * tile_length);
+        uint32_t state = 0x2545f491 + bits + 7 * predictor;
+
+        for (size_t i = 0; i < source.size (); ++i) {
+            state = state * 1664525u + 1013904223u;
+            const int row = i / sourceWidth;
+            const int col = i % sourceWidth;
+            const int value = i % 37 ? row * 29 + col * 7 + (state >> 26) : state >> 8;
+            source[i] = value & ((1 << bits) - 1);
+        }
+
+        // the little endian offsets of the tiles, then the tiles
+        std::vector<unsigned char> file (4 * tilesAcross * tilesDown);
+        size_t lastTile = 0;
+
+        for (int tile = 0; tile < tilesAcross * tilesDown; ++tile) {
+            std::vector<unsigned short> pixels (tile_width * tile_length);
+
+            for (unsigned row = 0; row < tile_length; ++row) {
+                const int sourceRow = tile / tilesAcross * tile_length + row;
+                const int sourceCol = tile % tilesAcross * tile_width;
+                memcpy (pixels.data () + row * tile_width, source.data () + sourceRow * sourceWidth + sourceCol, tile_width * sizeof (unsigned short));
+            }
+
+            lastTile = file.size ();
+
+            for (int i = 0; i < 4; ++i) {
+                file[4 * tile + i] = lastTile >> (8 * i);
+            }
+
+            const std::vector<unsigned char> stream = encodeTile (pixels, tile_width, tile_length, bits, predictor, restartRows);
+            file.insert (file.end (), stream.begin (), stream.end ());
+        }
+
+        if (truncated) {
+            file.resize ((lastTile + file.size ()) / 2);
+        }
+
+        fileData.resize ((file.size () + 3) / 4);
+        memcpy (fileData.data (), file.data (), file.size ());
+        fileSize = file.size ();
+    }
+
+    std::vector<ushort> decode (bool sequential, unsigned& errors)
+    {
+        std::vector<ushort> pixels (raw_width * raw_height);
+        raw_image = pixels.data ();
+        data_error = 0;
+        setSequentialDngTiles (sequential);
+        ifp = fopen (fileData.data (), fileSize);
+        lossless_dng_load_raw ();
+        fclose (ifp);
+        ifp = nullptr;
+        raw_image = nullptr;
+        errors = data_error;
+        return pixels;
+    }
+
+    // the values encoded, within the image
+    std::vector<ushort> getSource () const
+    {
+        const int sourceWidth = source.size () / ((raw_height + tile_length - 1) / tile_length * tile_length);
+        std::vector<ushort> pixels;
+
+        for (int row = 0; row < raw_height; ++row) {
+            pixels.insert (pixels.end (), source.begin () + row * sourceWidth, source.begin () + row * sourceWidth + raw_width);
+        }
+
+        return pixels;
+    }
+
+private:
+    std::vector<ushort> source;
+    std::vector<unsigned> fileData;
+    int fileSize;
+};
+
+}
+
+RT_TEST (losslessDngTiles)
+{
+    for (int bits : {12, 14}) {
+        for (int predictor : {1, 4, 6, 7}) {
+            for (int restartRows : {0, 8}) {
+                SyntheticDng dng (bits, predictor, restartRows, false);
+                unsigned referenceErrors, errors;
+                const std::vector<unsigned short> reference = dng.decode (true, referenceErrors);
+                const std::vector<unsigned short> pixels = dng.decode (false, errors);
+
+                RT_CHECK (reference == dng.getSource ());
+                RT_CHECK (pixels == reference);
+                RT_CHECK (referenceErrors == 0 && errors == 0);
+            }
+        }
+    }
+
+    // both decoders report the end of the data, the counts of the errors differ, and so do the pixels past it as
+    // getbithuff() shifts by 32 bits once it has no bits left
+    SyntheticDng truncated (14, 6, 8, true);
+    unsigned referenceErrors, errors;
+    const std::vector<unsigned short> reference = truncated.decode (true, referenceErrors);
+    const std::vector<unsigned short> pixels = truncated.decode (false, errors);
+    const size_t completeRows = 64 * 150;
+
+    RT_CHECK (std::equal (pixels.begin (), pixels.begin () + completeRows, reference.begin ()));
+    RT_CHECK (referenceErrors > 0 && errors > 0);
+}
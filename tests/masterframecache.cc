@@ -0,0 +1,174 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The entries of the master frame cache: their keys, which follow the files of the masters, and the entries of the
+// former versions of the files, which are removed
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rttests.h"
+#include "../rtengine/masterframecache.h"
+#include "../rtgui/options.h"
+
+extern Options options;
+
+using namespace rtengine;
+
+namespace
+{
+
+// The settings of the cache for the duration of a test
+class CacheSettings
+{
+public:
+    CacheSettings (bool enabled, const Glib::ustring& dir) :
+        previousEnabled (options.rtSettings.masterFrameCache),
+        previousDir (options.rtSettings.masterFrameCacheDir)
+    {
+        options.rtSettings.masterFrameCache = enabled;
+        options.rtSettings.masterFrameCacheDir = dir;
+    }
+
+    ~CacheSettings ()
+    {
+        options.rtSettings.masterFrameCache = previousEnabled;
+        options.rtSettings.masterFrameCacheDir = previousDir;
+    }
+
+private:
+    const bool previousEnabled;
+    const Glib::ustring previousDir;
+};
+
+class SyntheticMaster :
+    public RawImage
+{
+public:
+    SyntheticMaster (int W, int H) :
+        RawImage ("synthetic master")
+    {
+        width = W;
+        height = H;
+        filters = 0x94949494;
+        colors = 3;
+
+        allocation = new float[W * H];
+        data = new float*[H];
+
+        for (int row = 0; row < H; ++row) {
+            data[row] = allocation + row * W;
+
+            for (int col = 0; col < W; ++col) {
+                data[row][col] = 500 + (row * 7 + col * 13) % 61;
+            }
+        }
+    }
+};
+
+const std::vector<badPix> hotPixels = {badPix (3, 4), badPix (10, 20), badPix (39, 29)};
+
+bool hasHotPixels (const MasterFrame& master)
+{
+    const std::vector<badPix>& loaded = master.getHotPixels ();
+
+    if (loaded.size () != hotPixels.size ()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < loaded.size (); ++i) {
+        if (loaded[i].x != hotPixels[i].x || loaded[i].y != hotPixels[i].y) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+RT_TEST (masterFrameCacheKeys)
+{
+    MasterFrameCache* const cache = MasterFrameCache::getInstance ();
+    const Glib::ustring dir = rttests::makeTempDir ();
+    const Glib::ustring a = Glib::build_filename (dir, "a.raw");
+    const Glib::ustring b = Glib::build_filename (dir, "b.raw");
+    Glib::file_set_contents (a, "first frame");
+    Glib::file_set_contents (b, "second frame");
+
+    const Glib::ustring key = cache->getKey ("dark", "Camera 100", {a, b}, "mean");
+    RT_REQUIRE (!key.empty ());
+    RT_CHECK (cache->getKey ("dark", "Camera 100", {a, b}, "mean") == key);
+
+    // anything the master is made of
+    RT_CHECK (cache->getKey ("flat", "Camera 100", {a, b}, "mean") != key);
+    RT_CHECK (cache->getKey ("dark", "Camera 200", {a, b}, "mean") != key);
+    RT_CHECK (cache->getKey ("dark", "Camera 100", {a}, "mean") != key);
+    RT_CHECK (cache->getKey ("dark", "Camera 100", {a, b}, "median") != key);
+    RT_CHECK (cache->getKey ("dark", "Camera 100", {a, Glib::build_filename (dir, "missing.raw")}, "mean").empty ());
+
+    // an other version of a file, the master keeps its name
+    Glib::file_set_contents (b, "second frame, edited");
+    const Glib::ustring edited = cache->getKey ("dark", "Camera 100", {a, b}, "mean");
+    RT_CHECK (!edited.empty () && edited != key);
+    RT_CHECK (edited.substr (0, edited.rfind ('-')) == key.substr (0, key.rfind ('-')));
+}
+
+RT_TEST (masterFrameCacheEntries)
+{
+    MasterFrameCache* const cache = MasterFrameCache::getInstance ();
+    const Glib::ustring dir = rttests::makeTempDir ();
+    const Glib::ustring cacheDir = Glib::build_filename (dir, "masters");
+    const CacheSettings cacheSettings (true, cacheDir);
+    const Glib::ustring a = Glib::build_filename (dir, "a.raw");
+    const Glib::ustring b = Glib::build_filename (dir, "b.raw");
+    Glib::file_set_contents (a, "first frame");
+    Glib::file_set_contents (b, "second frame");
+
+    SyntheticMaster master (40, 30);
+    const Glib::ustring key = cache->getKey ("dark", "Camera 100", {a, b}, "mean");
+    const Glib::ustring otherKey = cache->getKey ("dark", "Camera 200", {a}, "mean");
+    RT_CHECK (!cache->load (key));
+    cache->store (key, &master, hotPixels);
+    cache->store (otherKey, &master, hotPixels);
+
+    {
+        // the entries mapped can't be removed on Windows
+        const std::unique_ptr<MasterFrame> loaded = cache->load (key);
+        RT_REQUIRE (loaded);
+        RT_CHECK (hasHotPixels (*loaded));
+    }
+
+    // the entry of the new version of the files replaces the former one, the entries of the other masters are kept
+    Glib::file_set_contents (b, "second frame, edited");
+    const Glib::ustring edited = cache->getKey ("dark", "Camera 100", {a, b}, "mean");
+    RT_CHECK (!cache->load (edited));
+    cache->store (edited, &master, hotPixels);
+    RT_CHECK (!cache->load (key));
+    RT_CHECK (cache->load (edited));
+    RT_CHECK (cache->load (otherKey));
+
+    // a partial entry
+    const Glib::ustring fileName = Glib::build_filename (cacheDir, edited + ".rtmf");
+    const std::string contents = Glib::file_get_contents (fileName);
+    Glib::file_set_contents (fileName, contents.substr (0, contents.size () - 3));
+    RT_CHECK (!cache->load (edited));
+
+    const CacheSettings disabled (false, cacheDir);
+    RT_CHECK (!cache->load (otherKey));
+}
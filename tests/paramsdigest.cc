@@ -0,0 +1,181 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The digest of the params by pp3 group, the stages of PipelineCache which it invalidates, and the binary form of the
+// key files of the pp3 files cached by the thumbnails
+
+#include <vector>
+
+#include "rttests.h"
+#include "../rtengine/paramsdigest.h"
+#include "../rtengine/pipelinecache.h"
+#include "../rtengine/procparams.h"
+#include "../rtengine/refreshmap.h"
+
+using namespace rtengine;
+using namespace rtengine::procparams;
+
+namespace
+{
+
+std::vector<PipelineCache::Stage> testStages ()
+{
+    return {
+        {M_RAW, {"RAW", "RAW Bayer"}},
+        {M_LUMACURVE, {"Exposure"}},
+        {M_LUMINANCE, {"Sharpening"}}
+    };
+}
+
+}
+
+RT_TEST (paramsDigestGroups)
+{
+    ProcParams params;
+    const ParamsDigest digest (params);
+    RT_REQUIRE (!digest.empty ());
+    RT_CHECK (digest == ParamsDigest (params));
+    RT_CHECK (digest.getHash ("Exposure") != 0);
+    RT_CHECK (digest.getHash ("No such group") == 0);
+
+    params.toneCurve.expcomp += 0.5;
+    const ParamsDigest exposure (params);
+    RT_CHECK (exposure != digest);
+    RT_CHECK (digest.diff (exposure) == std::vector<Glib::ustring> {"Exposure"});
+
+    params.raw.bayersensor.method = params.raw.bayersensor.method == "amaze" ? "dcb" : "amaze";
+    const ParamsDigest demosaic (params);
+    RT_CHECK (exposure.diff (demosaic) == std::vector<Glib::ustring> {"RAW Bayer"});
+    RT_CHECK (digest.diff (demosaic) == std::vector<Glib::ustring> ({"Exposure", "RAW Bayer"}));
+
+    // back to the first values
+    params.toneCurve.expcomp -= 0.5;
+    params.raw.bayersensor.method = ProcParams ().raw.bayersensor.method;
+    RT_CHECK (ParamsDigest (params) == digest);
+}
+
+RT_TEST (paramsKeyFileBinary)
+{
+    ProcParams params;
+    params.toneCurve.expcomp = 1.25;
+    params.exif["Exif.Image.Artist"] = "Tab\tand ; semicolon";
+    Glib::KeyFile keyFile;
+    RT_REQUIRE (!params.saveToKeyFile (keyFile));
+
+    // the raw values are kept, i.e. the loaded params are the same
+    std::string data;
+    keyFileToBinary (keyFile, data);
+    Glib::KeyFile loadedKeyFile;
+    RT_REQUIRE (keyFileFromBinary (data.data (), data.size (), loadedKeyFile));
+    RT_CHECK (loadedKeyFile.to_data () == keyFile.to_data ());
+
+    ProcParams loaded;
+    RT_REQUIRE (!loaded.loadFromKeyFile (loadedKeyFile, ""));
+    RT_CHECK (ParamsDigest (loaded) == ParamsDigest (params));
+
+    // the partial data and the data of an other version
+    Glib::KeyFile partial;
+    RT_CHECK (!keyFileFromBinary (data.data (), data.size () - 1, partial));
+    std::string otherVersion = data;
+    otherVersion[4] += 1;
+    RT_CHECK (!keyFileFromBinary (otherVersion.data (), otherVersion.size (), partial));
+}
+
+RT_TEST (pipelineCacheStages)
+{
+    PipelineCache cache (testStages ());
+    ProcParams params;
+    const int all = M_RAW | M_LUMACURVE | M_LUMINANCE;
+
+    // nothing is stored yet
+    RT_CHECK (cache.update (M_LUMINANCE, params, 1) == M_LUMINANCE);
+    cache.done (all, params);
+    RT_CHECK (cache.update (all, params, 1) == 0);
+    cache.done (0, params);
+
+    // a stage whose groups changed runs, with the following ones
+    params.toneCurve.expcomp += 0.5;
+    RT_CHECK (cache.update (all, params, 1) == (M_LUMACURVE | M_LUMINANCE));
+    cache.done (M_LUMACURVE | M_LUMINANCE, params);
+    RT_CHECK (cache.update (all, params, 1) == 0);
+    cache.done (0, params);
+
+    params.sharpening.radius += 0.1;
+    RT_CHECK (cache.update (all, params, 1) == M_LUMINANCE);
+
+    // a stage which didn't complete is run again
+    RT_CHECK (cache.update (all, params, 1) == M_LUMINANCE);
+    cache.done (M_LUMINANCE, params);
+
+    // the params changed by the run, e.g. by an auto tool, are the ones of the stored output
+    params.sharpening.radius += 0.1;
+    cache.done (M_LUMINANCE, params);
+    RT_CHECK (cache.update (all, params, 1) == 0);
+    cache.done (0, params);
+
+    // the other context of the outputs, and the outputs freed
+    RT_CHECK (cache.update (all, params, 2) == all);
+    cache.done (all, params);
+    RT_CHECK (cache.update (all, params, 2) == 0);
+    cache.done (0, params);
+    cache.invalidate ();
+    RT_CHECK (cache.update (M_LUMACURVE, params, 2) == (M_LUMACURVE | M_LUMINANCE));
+}
+
+// What the progressive updates of ImProcCoordinator ask to the caches of the preview and of the coarse buffers
+RT_TEST (pipelineCacheProgressive)
+{
+    PipelineCache cache (testStages ());
+    PipelineCache coarseCache (testStages ());
+    ProcParams params;
+    const int all = M_RAW | M_LUMACURVE | M_LUMINANCE;
+
+    RT_CHECK (cache.getDuration (all) == 0);
+    RT_CHECK (cache.update (all, params, 1) == all);
+    cache.done (all, params, 500);
+    RT_CHECK (coarseCache.update (all, params, 3) == all);
+    coarseCache.done (all, params, 50);
+
+    // getPending doesn't change the stored outputs
+    params.sharpening.radius += 0.1;
+    RT_CHECK (cache.getPending (all, params, 1) == M_LUMINANCE);
+    RT_CHECK (cache.getPending (M_LUMACURVE, params, 1) == 0);
+    RT_CHECK (cache.getPending (M_LUMINANCE, params, 2) == M_LUMINANCE);
+    RT_CHECK (cache.getPending (all, params, 1) == M_LUMINANCE);
+
+    // the run which started at the same stage, or else at an earlier one
+    RT_CHECK (cache.getDuration (M_LUMINANCE) == 500);
+    RT_CHECK (cache.update (all, params, 1) == M_LUMINANCE);
+    cache.done (M_LUMINANCE, params, 200);
+    RT_CHECK (cache.getDuration (M_LUMINANCE) == 200);
+    RT_CHECK (cache.getDuration (M_LUMACURVE | M_LUMINANCE) == 500);
+    RT_CHECK (cache.getDuration (0) == 0);
+
+    // the outputs go with the buffers they are in
+    cache.swap (coarseCache);
+    RT_CHECK (cache.getDuration (all) == 50);
+    RT_CHECK (cache.update (all, params, 3) == M_LUMINANCE);
+    cache.done (M_LUMINANCE, params);
+    cache.swap (coarseCache);
+    RT_CHECK (cache.update (all, params, 1) == 0);
+    cache.done (0, params);
+
+    // the stages forgotten run with the ones following them, the other ones are kept
+    cache.invalidate (M_LUMACURVE);
+    RT_CHECK (cache.getPending (M_RAW, params, 1) == 0);
+    RT_CHECK (cache.update (all, params, 1) == (M_LUMACURVE | M_LUMINANCE));
+}
@@ -0,0 +1,190 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef __GNUC__
+#if defined(__FAST_MATH__)
+#error Using the -ffast-math CFLAG is known to lead to problems. Disable it to compile RawTherapee.
+#endif
+#endif
+
+#include "config.h"
+#include <glibmm.h>
+#include <giomm.h>
+#include <glib/gstdio.h>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include <locale.h>
+
+#include "rttests.h"
+#include "../rtengine/rtengine.h"
+#include "../rtgui/options.h"
+
+extern Options options;
+
+// stores path to data files
+Glib::ustring argv0;
+Glib::ustring argv1;
+bool simpleEditor;
+
+namespace
+{
+
+struct RequiredFailure {};
+
+std::vector<std::pair<const char*, rttests::TestFunction>>& getTests ()
+{
+    static std::vector<std::pair<const char*, rttests::TestFunction>> tests;
+    return tests;
+}
+
+Glib::ustring runDir;
+int tempDirCount = 0;
+int failures = 0;
+
+void removeTree (const std::string& path)
+{
+    if (Glib::file_test (path, Glib::FILE_TEST_IS_DIR) && !Glib::file_test (path, Glib::FILE_TEST_IS_SYMLINK)) {
+        try {
+            Glib::Dir dir (path);
+
+            for (const auto& name : dir) {
+                removeTree (Glib::build_filename (path, name));
+            }
+        } catch (Glib::Error&) {}
+
+        g_rmdir (path.c_str ());
+    } else {
+        g_remove (path.c_str ());
+    }
+}
+
+bool runTest (const char* name, rttests::TestFunction function)
+{
+    const int previousFailures = failures;
+
+    try {
+        function ();
+    } catch (RequiredFailure&) {
+    } catch (std::exception& e) {
+        std::cerr << name << ": unexpected exception: " << e.what () << std::endl;
+        ++failures;
+    } catch (Glib::Exception& e) {
+        std::cerr << name << ": unexpected exception: " << e.what () << std::endl;
+        ++failures;
+    }
+
+    std::cout << (failures == previousFailures ? "passed: " : "FAILED: ") << name << std::endl;
+    return failures == previousFailures;
+}
+
+}
+
+namespace rttests
+{
+
+Registration::Registration (const char* name, TestFunction function)
+{
+    getTests ().emplace_back (name, function);
+}
+
+void check (bool condition, const char* expression, const char* file, int line, bool required)
+{
+    if (!condition) {
+        std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+        ++failures;
+
+        if (required) {
+            throw RequiredFailure ();
+        }
+    }
+}
+
+Glib::ustring makeTempDir ()
+{
+    const Glib::ustring path = Glib::build_filename (runDir, "test" + std::to_string (++tempDirCount));
+    g_mkdir_with_parents (path.c_str (), 0700);
+    return path;
+}
+
+}
+
+int main (int argc, char **argv)
+{
+    setlocale (LC_ALL, "");
+    setlocale (LC_NUMERIC, "C"); // to set decimal point to "."
+
+    Glib::init ();
+    Gio::init ();
+
+    argv0 = DATA_SEARCH_PATH;
+    simpleEditor = false;
+
+    if (argc > 2 || (argc == 2 && !strcmp (argv[1], "-h"))) {
+        std::cout << "Usage: " << argv[0] << " [test]" << std::endl;
+        std::cout << "Runs the given test, or all of them. The tests are:" << std::endl;
+
+        for (const auto& test : getTests ()) {
+            std::cout << "  " << test.first << std::endl;
+        }
+
+        return -1;
+    }
+
+    gchar* const tmp = g_dir_make_tmp ("rttests-XXXXXX", nullptr);
+
+    if (!tmp) {
+        std::cerr << "Error: can't create the temporary directory" << std::endl;
+        return -2;
+    }
+
+    runDir = tmp;
+    g_free (tmp);
+
+    const Glib::ustring settingsDir = Glib::build_filename (runDir, "settings");
+    const Glib::ustring cacheDir = Glib::build_filename (runDir, "cache");
+    g_mkdir_with_parents (settingsDir.c_str (), 0700);
+    g_setenv ("RT_SETTINGS", settingsDir.c_str (), TRUE);
+    g_setenv ("RT_CACHE", cacheDir.c_str (), TRUE);
+
+    if (!Options::load ()) {
+        std::cerr << "Error: can't load the options" << std::endl;
+        removeTree (runDir);
+        return -2;
+    }
+
+    bool found = false;
+    bool passed = true;
+
+    for (const auto& test : getTests ()) {
+        if (argc == 1 || !strcmp (argv[1], test.first)) {
+            found = true;
+            passed = runTest (test.first, test.second) && passed;
+        }
+    }
+
+    rtengine::cleanup ();
+    removeTree (runDir);
+
+    if (!found) {
+        std::cerr << "Error: unknown test \"" << argv[1] << "\"" << std::endl;
+        return -1;
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <glibmm.h>
+
+/*
+ * The tests of rttests: each one is a function registered under its name with RT_TEST, which reports its failures
+ * with RT_CHECK and stops at the first failed RT_REQUIRE. "rttests <name>" runs one test, which is what the add_test
+ * of tests/CMakeLists.txt do, and "rttests" alone runs all of them.
+ *
+ * The options are loaded from an empty settings directory and the cache base dir is a directory of its own, both
+ * in the temporary directory of the run, so the tests never see nor touch the settings and the cache of the user.
+ */
+
+namespace rttests
+{
+
+using TestFunction = void (*) ();
+
+class Registration
+{
+public:
+    Registration (const char* name, TestFunction function);
+};
+
+/** Records a failure if condition is false; with required, the test stops there */
+void check (bool condition, const char* expression, const char* file, int line, bool required);
+
+/** @return a new empty directory in the temporary directory of the run, removed at its end */
+Glib::ustring makeTempDir ();
+
+}
+
+#define RT_TEST(name) \
+    static void name (); \
+    static rttests::Registration name##Registration (#name, name); \
+    static void name ()
+
+#define RT_CHECK(condition) rttests::check ((condition), #condition, __FILE__, __LINE__, false)
+#define RT_REQUIRE(condition) rttests::check ((condition), #condition, __FILE__, __LINE__, true)